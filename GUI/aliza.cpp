@@ -18,6 +18,7 @@
 #include "dicomutils.h"
 #include "updateqtcommand.h"
 #include "histogramgen.h"
+#include "memorybudget.h"
 #include "itkVersion.h"
 #include "itkImage.h"
 #include "itkIndex.h"
@@ -53,6 +54,21 @@ static btCollisionWorld                * g_collisionWorld         = NULL;
 static btAlignedObjectArray<btCollisionShape*> g_collision_shapes;
 static bool show_all_study_collisions = true;
 
+// Selected and animated images and images in the 2D views
+// are kept in memory.
+static void enforce_memory_budget(
+	const GraphicsWidget * m,
+	const GraphicsWidget * y,
+	const GraphicsWidget * x)
+{
+	QList<ImageVariant*> keep = selected_images;
+	keep += animation_images;
+	if (m) keep.push_back(m->image_container.image3D);
+	if (y) keep.push_back(y->image_container.image3D);
+	if (x) keep.push_back(x->image_container.image3D);
+	MemoryBudget::enforce(scene3dimages.values(), keep);
+}
+
 static void search_frame_of_ref(
 	const int id,
 	const QString & frame_uid,
@@ -652,6 +668,7 @@ quit__:
 		}
 #endif
 		add_histogram(ivariants.at(x), pb);
+		MemoryBudget::touch(ivariants[x]);
 		scene3dimages[ivariants.at(x)->id] = ivariants[x];
 		disconnect(imagesbox->listWidget, SIGNAL(itemSelectionChanged()), this, SLOT(update_selection()));
 		imagesbox->listWidget->reset();
@@ -829,7 +846,12 @@ void Aliza::delete_image2(ImageVariant * v)
 ImageVariant * Aliza::get_image(int id)
 {
 	if (id<0) return NULL;
-	if (scene3dimages.contains(id)) return scene3dimages[id];
+	if (scene3dimages.contains(id))
+	{
+		ImageVariant * v = scene3dimages[id];
+		if (v && !MemoryBudget::restore(v)) return NULL;
+		return v;
+	}
 	return NULL;
 }
 
@@ -858,7 +880,9 @@ ImageVariant * Aliza::get_selected_image()
 	if (!l.empty())
 	{
 		ListWidgetItem2 * i = static_cast<ListWidgetItem2*>(l.at(0));
-		if (i) return i->get_image_from_item();
+		ImageVariant * v = (i) ? i->get_image_from_item() : NULL;
+		if (v && !MemoryBudget::restore(v)) return NULL;
+		return v;
 	}
 	return NULL;
 }
@@ -2291,8 +2315,9 @@ void Aliza::update_selection()
 		QListWidgetItem * s = l.at(0);
 		ListWidgetItem2 * i = static_cast<ListWidgetItem2*>(s);
 		ImageVariant * v = (i) ? i->get_image_from_item() : NULL;
-		if (v)
+		if (v && MemoryBudget::restore(v))
 		{
+			MemoryBudget::touch(v);
 			graphicswidget_m->set_slice_2D(
 				v,0,true);
 			if (multiview) graphicswidget_y->set_slice_2D(v,0,false);
@@ -2312,8 +2337,9 @@ void Aliza::update_selection2()
 	{
 		ListWidgetItem2 * i = static_cast<ListWidgetItem2*>(s);
 		ImageVariant * v = (i) ? i->get_image_from_item() : NULL;
-		if (v)
+		if (v && MemoryBudget::restore(v))
 		{
+			MemoryBudget::touch(v);
 			graphicswidget_m->graphicsview->global_flip_x = false;
 			graphicswidget_m->graphicsview->global_flip_y = false;
 			graphicswidget_x->graphicsview->global_flip_x = false;
@@ -2364,6 +2390,7 @@ void Aliza::update_selection_common2(QListWidgetItem * s)
 	QList<double> deltas;
 	ListWidgetItem2 * k = static_cast<ListWidgetItem2*>(s);
 	ImageVariant    * v = k ? k->get_image_from_item() : NULL;
+	if (v && !MemoryBudget::restore(v)) v = NULL;
 	if (v)
 	{
  		selected_images.push_back(v);
@@ -2381,7 +2408,7 @@ void Aliza::update_selection_common2(QListWidgetItem * s)
 			if (k1)
 			{
 				ImageVariant * v1 = k1->get_image_from_item();
-				if (v1)
+				if (v1 && MemoryBudget::restore(v1))
 				{
  					selected_images.push_back(v1);
 					if (v1->image_type == 300) spect_images.push_back(v1);
@@ -2434,6 +2461,8 @@ void Aliza::update_selection_common2(QListWidgetItem * s)
 		}
 		calculate_bb();
 	}
+	enforce_memory_budget(
+		graphicswidget_m, graphicswidget_y, graphicswidget_x);
 }
 
 void Aliza::clear_views()
@@ -2845,7 +2874,8 @@ QString Aliza::create_group_(bool * ok, bool lock_mutex)
 			v2->di->idimx == dimx &&
 			v2->di->idimy == dimy &&
 			v2->di->idimz == dimz &&
-			v2->image_type == image_type)
+			v2->image_type == image_type &&
+			MemoryBudget::restore(v2))
 		{
 			tmp_images.push_back(v2);
 		}
@@ -3779,6 +3809,7 @@ quit__:
 				ivariants[j]->di->close();
 				ivariants[j]->di->skip_texture=true;
 			}
+			MemoryBudget::touch(ivariants[j]);
 			scene3dimages[ivariants.at(j)->id] = ivariants[j];
 			if (true)
 			{
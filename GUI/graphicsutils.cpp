@@ -1,8 +1,12 @@
 #include "graphicsutils.h"
 #include "structures.h"
+#include "commonutils.h"
+#include "brickvolume.h"
+#include "prconfigutils.h"
 #include <QPainter>
 #include <QPixmap>
 #include <iostream>
+#include <cstring>
 #include "imageinfodialog.h"
 
 template<typename T> const QString print_itk_info(
@@ -27,8 +31,10 @@ template<typename T> QString get_scalar_pixel_value__(
 {
 	QString s("");
 	if (x < 0 || y < 0) return s;
-	if (image.IsNull()) return s;
 	if (!ivariant)      return s;
+	// out-of-core image and lazy presentation state have no ITK image
+	if (image.IsNull() && !ivariant->bricks && !ivariant->pr_slices)
+		return s;
 	const unsigned int x_ = static_cast<unsigned int>(x);
 	const unsigned int y_ = static_cast<unsigned int>(y);
 	typename T::IndexType idx;
@@ -89,7 +95,37 @@ template<typename T> QString get_scalar_pixel_value__(
 			QVariant(static_cast<int>(idx[1])).toString() + QString(",") +
 			QVariant(static_cast<int>(idx[2])).toString() +
 			QString(" ]");
-		const typename T::PixelType p = image->GetPixel(idx);
+		typename T::PixelType p = 0;
+		if (ivariant->bricks)
+		{
+			ivariant->bricks->read_voxel(
+				idx[0], idx[1], idx[2], reinterpret_cast<char*>(&p));
+		}
+		else if (ivariant->pr_slices)
+		{
+			double d = 0.0;
+			if (!ivariant->pr_slices->get_value(
+					idx[0], idx[1], idx[2], &d))
+			{
+				return s;
+			}
+			p = static_cast<typename T::PixelType>(d);
+		}
+		else
+		{
+			p = image->GetPixel(idx);
+		}
+		double intercept, slope;
+		const bool rescaled = CommonUtils::get_slice_rescale(
+			ivariant, static_cast<int>(idx[2]), &intercept, &slope);
+		if (rescaled)
+		{
+			const double tmp0 = static_cast<double>(p) * slope + intercept;
+			*label = static_cast<long long>(p);
+			s.sprintf("%.6f",tmp0);
+			s.append(idx_);
+			return s;
+		}
 		switch(ivariant->image_type)
 		{
 		case 0:
@@ -527,41 +563,91 @@ void GraphicsUtils::gen_labels(
 	}
 }
 
+// Overlay bits are written directly into RGB888 and 32 bits images,
+// other formats are composed with QPainter.
 void GraphicsUtils::draw_overlays(
 	const ImageVariant * ivariant,
 	QImage & tmpi)
 {
-	if (!ivariant->image_overlays.all_overlays.empty())
+	if (ivariant->image_overlays.all_overlays.empty()) return;
+	QMap<int, SliceOverlays>::const_iterator it =
+		ivariant->image_overlays.all_overlays.constFind(
+			ivariant->di->selected_z_slice);
+	if (it == ivariant->image_overlays.all_overlays.constEnd()) return;
+	const SliceOverlays & ov = it.value();
+	short pixel_size = 0;
+	if (tmpi.format() == QImage::Format_RGB888) pixel_size = 3;
+	else if (tmpi.depth() == 32) pixel_size = 4;
+	if (pixel_size == 0)
+	{
+		for (int ox = 0; ox < ov.size(); ox++)
+		{
+			const SliceOverlay & o = ov.at(ox);
+			if (o.data.size() < o.stride() * o.dimy) continue;
+			if (o.dimx < 1 || o.dimy < 1) continue;
+			QImage oi(
+				reinterpret_cast<const unsigned char*>(o.data.constData()),
+				o.dimx,
+				o.dimy,
+				o.stride(),
+				QImage::Format_MonoLSB);
+			oi.setColor(0, qRgb(0, 0, 0));
+			oi.setColor(1, qRgb(255, 255, 255));
+			QPainter painter;
+			painter.begin(&tmpi);
+			painter.setCompositionMode(QPainter::CompositionMode_Lighten);
+			painter.drawImage(
+				QPointF((float)(o.x - 1), (float)(o.y - 1)), oi);
+			painter.end();
+		}
+		return;
+	}
+	const int w = tmpi.width();
+	const int h = tmpi.height();
+	unsigned char * bits = NULL;
+	int bpl = 0;
+	for (int ox = 0; ox < ov.size(); ox++)
 	{
-		const int ov_idx = ivariant->di->selected_z_slice;
-		if (ivariant->image_overlays.all_overlays.contains(ov_idx))
+		const SliceOverlay & o = ov.at(ox);
+		if (o.data.isEmpty()) continue;
+		const int stride = o.stride();
+		if (o.data.size() < stride * o.dimy) continue;
+		// Overlay Origin is 1-based
+		const int x0 = o.x - 1;
+		const int y0 = o.y - 1;
+		const int i0 = (x0 < 0) ? -x0 : 0;
+		const int i1 = (x0 + o.dimx > w) ? w - x0 : o.dimx;
+		const int j0 = (y0 < 0) ? -y0 : 0;
+		const int j1 = (y0 + o.dimy > h) ? h - y0 : o.dimy;
+		if (i0 >= i1 || j0 >= j1) continue;
+		if (!bits)
+		{
+			// RGBA slice may wrap the pixel buffer of the image
+			if (pixel_size == 4) tmpi = tmpi.copy();
+			bits = tmpi.bits();
+			bpl = tmpi.bytesPerLine();
+		}
+		const unsigned char * src =
+			reinterpret_cast<const unsigned char*>(o.data.constData());
+		for (int j = j0; j < j1; j++)
 		{
-			const SliceOverlays ov =
-				ivariant->image_overlays.all_overlays.value(ov_idx);
-			for (int ox = 0; ox < ov.size(); ox++)
+			const unsigned char * row = src + j * stride;
+			unsigned char * dst = bits + (y0 + j) * bpl + pixel_size * x0;
+			int i = i0;
+			while (i < i1)
 			{
-				const unsigned char * tmp_p_ =
-					reinterpret_cast< const unsigned char* >(
-						&(ov.at(ox).data[0]));
-				if (tmp_p_)
+				const unsigned char b = row[i >> 3];
+				if (b == 0)
+				{
+					i = (i | 7) + 1;
+					continue;
+				}
+				if (b & (1 << (i & 7)))
 				{
-					QImage oi(
-						tmp_p_,
-						ov.at(ox).dimx,
-						ov.at(ox).dimy,
-						ov.at(ox).dimx,
-						QImage::Format_Indexed8);
-					QPainter * painter = new QPainter;
-					painter->begin(&tmpi);
-					painter->setCompositionMode(
-						QPainter::CompositionMode_Lighten);
-					painter->drawPixmap(
-						QPointF((float)(ov.at(ox).x-1),
-						(float)(ov.at(ox).y-1)),
-						QPixmap::fromImage(oi));
-					painter->end();
-					delete painter;
+					// white, opaque in 32 bits formats
+					memset(dst + pixel_size * i, 255, pixel_size);
 				}
+				i++;
 			}
 		}
 	}
@@ -29,10 +29,16 @@
 #include "processimagethreadLUT.hxx"
 #include "graphicsutils.h"
 #include "commonutils.h"
+#include "brickvolume.h"
+#include "prconfigutils.h"
 #include "contourutils.h"
 #include "aliza.h"
 #include "updateqtcommand.h"
 
+#if QT_VERSION >= QT_VERSION_CHECK(4,7,0)
+#include <QElapsedTimer>
+#endif
+
 #ifndef WIN32
 #include <unistd.h>
 #if QT_VERSION < QT_VERSION_CHECK(4,7,0)
@@ -155,7 +161,7 @@ static void draw_contours(
 	}
 }
 
-template<typename Tin, typename Tout> QString get_slice_(
+template<typename Tin, typename Tout> QString extract_slice_(
 	short axis,
 	const typename Tin::Pointer & image,
 	ImageVariant2D * v2d,
@@ -163,7 +169,7 @@ template<typename Tin, typename Tout> QString get_slice_(
 	int idx)
 {
 	if (image.IsNull())
-		return QString("get_slice_<>() : image.IsNull()");
+		return QString("extract_slice_<>() : image.IsNull()");
 	typedef itk::ExtractImageFilter<Tin, Tout> FilterType;
 	const typename Tin::RegionType inRegion =
 		image->GetLargestPossibleRegion();
@@ -223,6 +229,223 @@ template<typename Tin, typename Tout> QString get_slice_(
 	return QString();
 }
 
+// Output image with the geometry of ExtractImageFilter with
+// DirectionCollapseToIdentity, the input region starts at 0.
+template<typename T2d> QString allocate_slice_(
+	short axis,
+	const itk::ImageBase<3> * image,
+	typename T2d::Pointer & out_image)
+{
+	const itk::ImageBase<3>::SizeType size =
+		image->GetLargestPossibleRegion().GetSize();
+	const itk::ImageBase<3>::SpacingType spacing = image->GetSpacing();
+	const itk::ImageBase<3>::PointType origin = image->GetOrigin();
+	unsigned int d0, d1;
+	switch(axis)
+	{
+	case 0: d0 = 1; d1 = 2; break;
+	case 1: d0 = 0; d1 = 2; break;
+	case 2: d0 = 0; d1 = 1; break;
+	default :
+		return QString("internal error: axis not set");
+	}
+	typename T2d::RegionType region;
+	typename T2d::SizeType out_size;
+	typename T2d::IndexType out_index;
+	typename T2d::SpacingType out_spacing;
+	typename T2d::PointType out_origin;
+	out_size[0] = size[d0];
+	out_size[1] = size[d1];
+	out_index.Fill(0);
+	region.SetSize(out_size);
+	region.SetIndex(out_index);
+	out_spacing[0] = spacing[d0];
+	out_spacing[1] = spacing[d1];
+	out_origin[0] = origin[d0];
+	out_origin[1] = origin[d1];
+	out_image = T2d::New();
+	try
+	{
+		out_image->SetRegions(region);
+		out_image->SetOrigin(out_origin);
+		out_image->SetSpacing(out_spacing);
+		out_image->Allocate();
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		out_image = NULL;
+		return QString(ex.GetDescription());
+	}
+	return QString();
+}
+
+// Copies from the buffer, does not update the pipeline of the input,
+// so slices of the same image can be taken from different threads.
+template<typename Tin, typename Tout> QString get_slice_(
+	short axis,
+	const typename Tin::Pointer & image,
+	ImageVariant2D * v2d,
+	typename Tout::Pointer & out_image,
+	int idx)
+{
+	if (image.IsNull())
+		return QString("get_slice_<>() : image.IsNull()");
+	const typename Tin::RegionType region =
+		image->GetLargestPossibleRegion();
+	if (!(image->GetBufferedRegion() == region) ||
+		region.GetIndex()[0] != 0 ||
+		region.GetIndex()[1] != 0 ||
+		region.GetIndex()[2] != 0)
+	{
+		return extract_slice_<Tin, Tout>(axis, image, v2d, out_image, idx);
+	}
+	const typename Tin::SizeType size = region.GetSize();
+	if (axis < 0 || axis > 2 || idx < 0 ||
+		static_cast<itk::SizeValueType>(idx) >= size[axis])
+	{
+		return QString("get_slice_<>() : index is out of range");
+	}
+	const QString error_ =
+		allocate_slice_<Tout>(axis, image.GetPointer(), out_image);
+	if (!error_.isEmpty()) return error_;
+	const size_t dimx = size[0];
+	const size_t dimy = size[1];
+	const size_t dimz = size[2];
+	const typename Tin::PixelType * in = image->GetBufferPointer();
+	typename Tout::PixelType * out = out_image->GetBufferPointer();
+	switch(axis)
+	{
+	case 0:
+		for (size_t z = 0; z < dimz; z++)
+		{
+			for (size_t y = 0; y < dimy; y++)
+			{
+				out[z * dimy + y] = in[(z * dimy + y) * dimx + idx];
+			}
+		}
+		break;
+	case 1:
+		for (size_t z = 0; z < dimz; z++)
+		{
+			const typename Tin::PixelType * r = in + (z * dimy + idx) * dimx;
+			for (size_t x = 0; x < dimx; x++)
+			{
+				out[z * dimx + x] = r[x];
+			}
+		}
+		break;
+	default:
+		{
+			const typename Tin::PixelType * r = in + idx * dimx * dimy;
+			for (size_t j = 0; j < dimx * dimy; j++)
+			{
+				out[j] = r[j];
+			}
+		}
+		break;
+	}
+	if (v2d)
+	{
+		v2d->idimx = out_image->GetLargestPossibleRegion().GetSize()[0];
+		v2d->idimy = out_image->GetLargestPossibleRegion().GetSize()[1];
+	}
+	return QString();
+}
+
+template<typename T2d> QString rescale_slice_(
+	short axis,
+	const typename T2d::Pointer & tmp0,
+	Image2DTypeF::Pointer & out_image,
+	int idx,
+	const QList< QPair<double, double> > & slice_rescale)
+{
+	const typename T2d::RegionType region =
+		tmp0->GetLargestPossibleRegion();
+	out_image = Image2DTypeF::New();
+	try
+	{
+		out_image->SetRegions(region);
+		out_image->SetOrigin(tmp0->GetOrigin());
+		out_image->SetSpacing(tmp0->GetSpacing());
+		out_image->SetDirection(tmp0->GetDirection());
+		out_image->Allocate();
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		out_image = NULL;
+		return QString(ex.GetDescription());
+	}
+	const size_t dimx = region.GetSize()[0];
+	const size_t dimy = region.GetSize()[1];
+	const typename T2d::PixelType * in = tmp0->GetBufferPointer();
+	float * out = out_image->GetBufferPointer();
+	// for sagittal and coronal slices the rows are the z slices
+	for (size_t j = 0; j < dimy; j++)
+	{
+		const int z = (axis == 2) ? idx : static_cast<int>(j);
+		double intercept = 0.0, slope = 1.0;
+		if (z >= 0 && z < slice_rescale.size())
+		{
+			intercept = slice_rescale.at(z).first;
+			slope     = slice_rescale.at(z).second;
+		}
+		const size_t k = j * dimx;
+		for (size_t i = 0; i < dimx; i++)
+		{
+			out[k + i] = static_cast<float>(
+				static_cast<double>(in[k + i]) * slope + intercept);
+		}
+	}
+	return QString();
+}
+
+template<typename Tin, typename T2d> QString get_rescaled_slice_(
+	short axis,
+	const typename Tin::Pointer & image,
+	ImageVariant2D * v2d,
+	Image2DTypeF::Pointer & out_image,
+	int idx,
+	const QList< QPair<double, double> > & slice_rescale)
+{
+	typename T2d::Pointer tmp0;
+	const QString error_ =
+		get_slice_<Tin, T2d>(axis, image, v2d, tmp0, idx);
+	if (!error_.isEmpty()) return error_;
+	return rescale_slice_<T2d>(axis, tmp0, out_image, idx, slice_rescale);
+}
+
+// Slice of an out-of-core image, rescaled values go to 'out_rescaled'.
+template<typename T2d> QString get_bricked_slice_(
+	short axis,
+	const ImageVariant * v,
+	ImageVariant2D * v2d,
+	typename T2d::Pointer & out_image,
+	Image2DTypeF::Pointer & out_rescaled,
+	int idx)
+{
+	if (!v->bricks || v->bricks_geometry.IsNull())
+		return QString("get_bricked_slice_<>() : no bricks");
+	typename T2d::Pointer tmp0;
+	const QString error_ =
+		allocate_slice_<T2d>(axis, v->bricks_geometry.GetPointer(), tmp0);
+	if (!error_.isEmpty()) return error_;
+	if (!v->bricks->read_slice(
+			axis, idx, reinterpret_cast<char*>(tmp0->GetBufferPointer())))
+		return QString("Could not read cache file");
+	if (v2d)
+	{
+		v2d->idimx = tmp0->GetLargestPossibleRegion().GetSize()[0];
+		v2d->idimy = tmp0->GetLargestPossibleRegion().GetSize()[1];
+	}
+	if (v->slice_rescale.empty())
+	{
+		out_image = tmp0;
+		return QString();
+	}
+	return rescale_slice_<T2d>(
+		axis, tmp0, out_rescaled, idx, v->slice_rescale);
+}
+
 template<typename T> QString contour_from_path(
 		ROI * roi,
 		const typename T::Pointer & image,
@@ -1114,7 +1337,7 @@ template<typename T> void load_image(const typename T::Pointer & image,
 	const short axis = widget->get_axis();
 	const bool global_flip_x = widget->graphicsview->global_flip_x;
 	const bool global_flip_y = widget->graphicsview->global_flip_y;
-	const int num_threads = QThread::idealThreadCount();
+	const int num_threads = CommonUtils::get_max_threads();
 	const int tmp99 = size[1]%num_threads;
 	if (!widget->threadsLUT_.empty())
 	{
@@ -1448,6 +1671,20 @@ GraphicsWidget::GraphicsWidget(
 	slider_m = NULL;
 	anim2D_timer = new QTimer(this);
 	anim2D_timer->setSingleShot(true);
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+	anim2D_timer->setTimerType(Qt::PreciseTimer);
+#endif
+	cine_thread = NULL;
+	cine_next = new ImageVariant2D();
+	cine_next_image = NULL;
+	cine_next_slice = -1;
+	cine_start = 0;
+	cine_next_due = 0.0;
+	cine_fps_start = 0;
+	cine_fps_frames = 0;
+	cine_fps = 0.0;
+	cine_dropped = 0;
+	pr_usregs = false;
 	connect(anim2D_timer, SIGNAL(timeout()), this, SLOT(animate_()));
 	image_container.image3D = NULL;
 	image_container.image2D = new ImageVariant2D();
@@ -1462,6 +1699,9 @@ GraphicsWidget::GraphicsWidget(
 GraphicsWidget::~GraphicsWidget()
 {
 	run__ = false;
+	stop_cine_prefetch();
+	delete cine_next;
+	cine_next = NULL;
 	if (mutex.tryLock(30000))
 	{
 		for (unsigned int i=0; i<threads_.size(); i++)
@@ -1846,6 +2086,7 @@ void GraphicsWidget::update_image(
 void GraphicsWidget::clear_(bool lock)
 {
 	if (lock) mutex.lock();
+	stop_cine_prefetch();
 	if (graphicsview->image_item)
 	{
 #ifdef DELETE_GRAPHICSIMAGEITEM
@@ -2068,6 +2309,212 @@ float GraphicsWidget::get_offset_y()
 	return offset_y;
 }
 
+static void reset_image2D(ImageVariant2D * image2D)
+{
+	image2D->image_type=-1;
+	image2D->orientation_string = QString("");
+	image2D->laterality = QString("");
+	image2D->body_part  = QString("");
+	image2D->idimx=0;
+	image2D->idimy=0;
+	if (image2D->pSS.IsNotNull())
+		image2D->pSS->DisconnectPipeline();
+	image2D->pSS=NULL;
+	if (image2D->pUS.IsNotNull())
+		image2D->pUS->DisconnectPipeline();
+	image2D->pUS=NULL;
+	if (image2D->pSI.IsNotNull())
+		image2D->pSI->DisconnectPipeline();
+	image2D->pSI=NULL;
+	if (image2D->pUI.IsNotNull())
+		image2D->pUI->DisconnectPipeline();
+	image2D->pUI=NULL;
+	if (image2D->pUC.IsNotNull())
+		image2D->pUC->DisconnectPipeline();
+	image2D->pUC=NULL;
+	if (image2D->pF.IsNotNull())
+		image2D->pF->DisconnectPipeline();
+	image2D->pF=NULL;
+	if (image2D->pD.IsNotNull())
+		image2D->pD->DisconnectPipeline();
+	image2D->pD=NULL;
+	if (image2D->pSLL.IsNotNull())
+		image2D->pSLL->DisconnectPipeline();
+	image2D->pSLL=NULL;
+	if (image2D->pULL.IsNotNull())
+		image2D->pULL->DisconnectPipeline();
+	image2D->pULL=NULL;
+	if (image2D->pSS_rgb.IsNotNull())
+		image2D->pSS_rgb->DisconnectPipeline();
+	image2D->pSS_rgb=NULL;
+	if (image2D->pUS_rgb.IsNotNull())
+		image2D->pUS_rgb->DisconnectPipeline();
+	image2D->pUS_rgb=NULL;
+	if (image2D->pSI_rgb.IsNotNull())
+		image2D->pSI_rgb->DisconnectPipeline();
+	image2D->pSI_rgb=NULL;
+	if (image2D->pUI_rgb.IsNotNull())
+		image2D->pUI_rgb->DisconnectPipeline();
+	image2D->pUI_rgb=NULL;
+	if (image2D->pUC_rgb.IsNotNull())
+		image2D->pUC_rgb ->DisconnectPipeline();
+	image2D->pUC_rgb=NULL;
+	if (image2D->pF_rgb.IsNotNull())
+		image2D->pF_rgb->DisconnectPipeline();
+	image2D->pF_rgb=NULL;
+	if (image2D->pD_rgb.IsNotNull())
+		image2D->pD_rgb->DisconnectPipeline();
+	image2D->pD_rgb=NULL;
+	if (image2D->pSS_rgba.IsNotNull())
+		image2D->pSS_rgba->DisconnectPipeline();
+	image2D->pSS_rgba=NULL;
+	if (image2D->pUS_rgba.IsNotNull())
+		image2D->pUS_rgba->DisconnectPipeline();
+	image2D->pUS_rgba=NULL;
+	if (image2D->pSI_rgba.IsNotNull())
+		image2D->pSI_rgba->DisconnectPipeline();
+	image2D->pSI_rgba=NULL;
+	if (image2D->pUI_rgba.IsNotNull())
+		image2D->pUI_rgba->DisconnectPipeline();
+	image2D->pUI_rgba=NULL;
+	if (image2D->pUC_rgba.IsNotNull())
+		image2D->pUC_rgba->DisconnectPipeline();
+	image2D->pUC_rgba=NULL;
+	if (image2D->pF_rgba.IsNotNull())
+		image2D->pF_rgba->DisconnectPipeline();
+	image2D->pF_rgba=NULL;
+	if (image2D->pD_rgba.IsNotNull())
+		image2D->pD_rgba->DisconnectPipeline();
+	image2D->pD_rgba=NULL;
+}
+
+// Extracts the slice of the 3D image to 'image2D', returns false
+// if the image type is not supported, 'error_' is set on failure.
+// If 'stand_in' is not NULL, a slice processed in a thread is not
+// waited for, see PrSlices::get_slice.
+static bool extract_slice_2D(
+	const ImageVariant * v,
+	short axis,
+	int x,
+	ImageVariant2D * image2D,
+	QString & error_,
+	bool * stand_in = NULL)
+{
+	if (v->pr_slices)
+	{
+		// the presentation state is applied to original slices only
+		if (axis != 2) return false;
+		error_ = v->pr_slices->get_slice(x, image2D, stand_in);
+		if (error_.isEmpty()) v->pr_slices->prefetch(x);
+	}
+	else if (v->bricks)
+	{
+		switch(v->image_type)
+		{
+		case 0: error_ = get_bricked_slice_<Image2DTypeSS>(axis, v, image2D, image2D->pSS, image2D->pF, x);
+			break;
+		case 1: error_ = get_bricked_slice_<Image2DTypeUS>(axis, v, image2D, image2D->pUS, image2D->pF, x);
+			break;
+		case 2: error_ = get_bricked_slice_<Image2DTypeSI>(axis, v, image2D, image2D->pSI, image2D->pF, x);
+			break;
+		case 3: error_ = get_bricked_slice_<Image2DTypeUI>(axis, v, image2D, image2D->pUI, image2D->pF, x);
+			break;
+		case 4: error_ = get_bricked_slice_<Image2DTypeUC>(axis, v, image2D, image2D->pUC, image2D->pF, x);
+			break;
+		case 5: error_ = get_bricked_slice_<Image2DTypeF>(axis, v, image2D, image2D->pF, image2D->pF, x);
+			break;
+		case 6: error_ = get_bricked_slice_<Image2DTypeD>(axis, v, image2D, image2D->pD, image2D->pF, x);
+			break;
+		default: return false;
+		}
+		if (error_.isEmpty())
+			image2D->image_type =
+				v->slice_rescale.empty() ? v->image_type : 5;
+	}
+	else if (!v->slice_rescale.empty())
+	{
+		switch(v->image_type)
+		{
+		case 0: error_ = get_rescaled_slice_<ImageTypeSS, Image2DTypeSS>(axis, v->pSS, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		case 1: error_ = get_rescaled_slice_<ImageTypeUS, Image2DTypeUS>(axis, v->pUS, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		case 2: error_ = get_rescaled_slice_<ImageTypeSI, Image2DTypeSI>(axis, v->pSI, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		case 3: error_ = get_rescaled_slice_<ImageTypeUI, Image2DTypeUI>(axis, v->pUI, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		case 4: error_ = get_rescaled_slice_<ImageTypeUC, Image2DTypeUC>(axis, v->pUC, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		case 7: error_ = get_rescaled_slice_<ImageTypeSLL, Image2DTypeSLL>(axis, v->pSLL, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		case 8: error_ = get_rescaled_slice_<ImageTypeULL, Image2DTypeULL>(axis, v->pULL, image2D, image2D->pF, x, v->slice_rescale);
+			break;
+		default: return false;
+		}
+		// the 2D slice holds the rescaled values
+		if (error_.isEmpty()) image2D->image_type = 5;
+	}
+	else
+	{
+		switch(v->image_type)
+		{
+		case 0: error_ = get_slice_<ImageTypeSS, Image2DTypeSS>(axis, v->pSS, image2D, image2D->pSS, x);
+			break;
+		case 1: error_ = get_slice_<ImageTypeUS, Image2DTypeUS>(axis, v->pUS, image2D, image2D->pUS, x);
+			break;
+		case 2: error_ = get_slice_<ImageTypeSI, Image2DTypeSI>(axis, v->pSI, image2D, image2D->pSI, x);
+			break;
+		case 3: error_ = get_slice_<ImageTypeUI, Image2DTypeUI>(axis, v->pUI, image2D, image2D->pUI, x);
+			break;
+		case 4: error_ = get_slice_<ImageTypeUC, Image2DTypeUC>(axis, v->pUC, image2D, image2D->pUC, x);
+			break;
+		case 5: error_ = get_slice_<ImageTypeF, Image2DTypeF>(axis, v->pF, image2D, image2D->pF, x);
+			break;
+		case 6: error_ = get_slice_<ImageTypeD, Image2DTypeD>(axis, v->pD, image2D, image2D->pD, x);
+			break;
+		case 7: error_ = get_slice_<ImageTypeSLL, Image2DTypeSLL>(axis, v->pSLL, image2D, image2D->pSLL, x);
+			break;
+		case 8: error_ = get_slice_<ImageTypeULL, Image2DTypeULL>(axis, v->pULL, image2D, image2D->pULL, x);
+			break;
+		case 10: error_ = get_slice_<RGBImageTypeSS, RGBImage2DTypeSS>(axis, v->pSS_rgb, image2D, image2D->pSS_rgb, x);
+			break;
+		case 11: error_ = get_slice_<RGBImageTypeUS, RGBImage2DTypeUS>(axis, v->pUS_rgb, image2D, image2D->pUS_rgb, x);
+			break;
+		case 12: error_ = get_slice_<RGBImageTypeSI, RGBImage2DTypeSI>(axis, v->pSI_rgb, image2D, image2D->pSI_rgb, x);
+			break;
+		case 13: error_ = get_slice_<RGBImageTypeUI, RGBImage2DTypeUI>(axis, v->pUI_rgb, image2D, image2D->pUI_rgb, x);
+			break;
+		case 14: error_ = get_slice_<RGBImageTypeUC, RGBImage2DTypeUC>(axis, v->pUC_rgb, image2D, image2D->pUC_rgb, x);
+			break;
+		case 15: error_ = get_slice_<RGBImageTypeF, RGBImage2DTypeF>(axis, v->pF_rgb, image2D, image2D->pF_rgb, x);
+			break;
+		case 16: error_ = get_slice_<RGBImageTypeD, RGBImage2DTypeD>(axis, v->pD_rgb, image2D, image2D->pD_rgb, x);
+			break;
+		case 20: error_ = get_slice_<RGBAImageTypeSS, RGBAImage2DTypeSS>(axis, v->pSS_rgba, image2D, image2D->pSS_rgba, x);
+			break;
+		case 21: error_ = get_slice_<RGBAImageTypeUS, RGBAImage2DTypeUS>(axis, v->pUS_rgba, image2D, image2D->pUS_rgba, x);
+			break;
+		case 22: error_ = get_slice_<RGBAImageTypeSI, RGBAImage2DTypeSI>(axis, v->pSI_rgba, image2D, image2D->pSI_rgba, x);
+			break;
+		case 23: error_ = get_slice_<RGBAImageTypeUI, RGBAImage2DTypeUI>(axis, v->pUI_rgba, image2D, image2D->pUI_rgba, x);
+			break;
+		case 24: error_ = get_slice_<RGBAImageTypeUC, RGBAImage2DTypeUC>(axis, v->pUC_rgba, image2D, image2D->pUC_rgba, x);
+			break;
+		case 25: error_ = get_slice_<RGBAImageTypeF, RGBAImage2DTypeF>(axis, v->pF_rgba, image2D, image2D->pF_rgba, x);
+			break;
+		case 26: error_ = get_slice_<RGBAImageTypeD, RGBAImage2DTypeD>(axis, v->pD_rgba, image2D, image2D->pD_rgba, x);
+			break;
+		default: return false;
+		}
+		//
+		if (error_.isEmpty())
+		{
+			image2D->image_type = v->image_type;
+		}
+	}
+	return true;
+}
+
 void GraphicsWidget::set_slice_2D(
 	ImageVariant * v,
 	short fit,
@@ -2099,6 +2546,7 @@ void GraphicsWidget::set_slice_2D(
 	if (!v) return;
 	int x = 0;
 	QString error_;
+	bool stand_in = false;
 	//
 	mutex.lock();
 	//
@@ -2106,82 +2554,6 @@ void GraphicsWidget::set_slice_2D(
 	//
 	if (!image_container.image2D) goto quit__;
 	//
-	image_container.image2D->image_type=-1;
-	image_container.image2D->orientation_string = QString("");
-	image_container.image2D->laterality = QString("");
-	image_container.image2D->body_part  = QString("");
-	image_container.image2D->idimx=0;
-	image_container.image2D->idimy=0;
-	if (image_container.image2D->pSS.IsNotNull())
-		image_container.image2D->pSS->DisconnectPipeline();
-	image_container.image2D->pSS=NULL;
-	if (image_container.image2D->pUS.IsNotNull())
-		image_container.image2D->pUS->DisconnectPipeline();
-	image_container.image2D->pUS=NULL;
-	if (image_container.image2D->pSI.IsNotNull())
-		image_container.image2D->pSI->DisconnectPipeline();
-	image_container.image2D->pSI=NULL;
-	if (image_container.image2D->pUI.IsNotNull())
-		image_container.image2D->pUI->DisconnectPipeline();
-	image_container.image2D->pUI=NULL;
-	if (image_container.image2D->pUC.IsNotNull())
-		image_container.image2D->pUC->DisconnectPipeline();
-	image_container.image2D->pUC=NULL;
-	if (image_container.image2D->pF.IsNotNull())
-		image_container.image2D->pF->DisconnectPipeline();
-	image_container.image2D->pF=NULL;
-	if (image_container.image2D->pD.IsNotNull())
-		image_container.image2D->pD->DisconnectPipeline();
-	image_container.image2D->pD=NULL;
-	if (image_container.image2D->pSLL.IsNotNull())
-		image_container.image2D->pSLL->DisconnectPipeline();
-	image_container.image2D->pSLL=NULL;
-	if (image_container.image2D->pULL.IsNotNull())
-		image_container.image2D->pULL->DisconnectPipeline();
-	image_container.image2D->pULL=NULL;
-	if (image_container.image2D->pSS_rgb.IsNotNull())
-		image_container.image2D->pSS_rgb->DisconnectPipeline();
-	image_container.image2D->pSS_rgb=NULL;
-	if (image_container.image2D->pUS_rgb.IsNotNull())
-		image_container.image2D->pUS_rgb->DisconnectPipeline();
-	image_container.image2D->pUS_rgb=NULL;
-	if (image_container.image2D->pSI_rgb.IsNotNull())
-		image_container.image2D->pSI_rgb->DisconnectPipeline();
-	image_container.image2D->pSI_rgb=NULL;
-	if (image_container.image2D->pUI_rgb.IsNotNull())
-		image_container.image2D->pUI_rgb->DisconnectPipeline();
-	image_container.image2D->pUI_rgb=NULL;
-	if (image_container.image2D->pUC_rgb.IsNotNull())
-		image_container.image2D->pUC_rgb ->DisconnectPipeline();
-	image_container.image2D->pUC_rgb=NULL;
-	if (image_container.image2D->pF_rgb.IsNotNull())
-		image_container.image2D->pF_rgb->DisconnectPipeline();
-	image_container.image2D->pF_rgb=NULL;
-	if (image_container.image2D->pD_rgb.IsNotNull())
-		image_container.image2D->pD_rgb->DisconnectPipeline();
-	image_container.image2D->pD_rgb=NULL;
-	if (image_container.image2D->pSS_rgba.IsNotNull())
-		image_container.image2D->pSS_rgba->DisconnectPipeline();
-	image_container.image2D->pSS_rgba=NULL;
-	if (image_container.image2D->pUS_rgba.IsNotNull())
-		image_container.image2D->pUS_rgba->DisconnectPipeline();
-	image_container.image2D->pUS_rgba=NULL;
-	if (image_container.image2D->pSI_rgba.IsNotNull())
-		image_container.image2D->pSI_rgba->DisconnectPipeline();
-	image_container.image2D->pSI_rgba=NULL;
-	if (image_container.image2D->pUI_rgba.IsNotNull())
-		image_container.image2D->pUI_rgba->DisconnectPipeline();
-	image_container.image2D->pUI_rgba=NULL;
-	if (image_container.image2D->pUC_rgba.IsNotNull())
-		image_container.image2D->pUC_rgba->DisconnectPipeline();
-	image_container.image2D->pUC_rgba=NULL;
-	if (image_container.image2D->pF_rgba.IsNotNull())
-		image_container.image2D->pF_rgba->DisconnectPipeline();
-	image_container.image2D->pF_rgba=NULL;
-	if (image_container.image2D->pD_rgba.IsNotNull())
-		image_container.image2D->pD_rgba->DisconnectPipeline();
-	image_container.image2D->pD_rgba=NULL;
-	//
 	switch(axis)
 	{
 	case   0: x = image_container.image3D->di->selected_x_slice; break;
@@ -2190,62 +2562,18 @@ void GraphicsWidget::set_slice_2D(
 	default : { clear_(false); goto quit__; }
 	}
 	//
-	switch(v->image_type)
+	if (!take_cine_slice(v, x))
 	{
-	case 0: error_ = get_slice_<ImageTypeSS, Image2DTypeSS>(axis, v->pSS, image_container.image2D, image_container.image2D->pSS, x);
-		break;
-	case 1: error_ = get_slice_<ImageTypeUS, Image2DTypeUS>(axis, v->pUS, image_container.image2D, image_container.image2D->pUS, x);
-		break;
-	case 2: error_ = get_slice_<ImageTypeSI, Image2DTypeSI>(axis, v->pSI, image_container.image2D, image_container.image2D->pSI, x);
-		break;
-	case 3: error_ = get_slice_<ImageTypeUI, Image2DTypeUI>(axis, v->pUI, image_container.image2D, image_container.image2D->pUI, x);
-		break;
-	case 4: error_ = get_slice_<ImageTypeUC, Image2DTypeUC>(axis, v->pUC, image_container.image2D, image_container.image2D->pUC, x);
-		break;
-	case 5: error_ = get_slice_<ImageTypeF, Image2DTypeF>(axis, v->pF, image_container.image2D, image_container.image2D->pF, x);
-		break;
-	case 6: error_ = get_slice_<ImageTypeD, Image2DTypeD>(axis, v->pD, image_container.image2D, image_container.image2D->pD, x);
-		break;
-	case 7: error_ = get_slice_<ImageTypeSLL, Image2DTypeSLL>(axis, v->pSLL, image_container.image2D, image_container.image2D->pSLL, x);
-		break;
-	case 8: error_ = get_slice_<ImageTypeULL, Image2DTypeULL>(axis, v->pULL, image_container.image2D, image_container.image2D->pULL, x);
-		break;
-	case 10: error_ = get_slice_<RGBImageTypeSS, RGBImage2DTypeSS>(axis, v->pSS_rgb, image_container.image2D, image_container.image2D->pSS_rgb, x);
-		break;
-	case 11: error_ = get_slice_<RGBImageTypeUS, RGBImage2DTypeUS>(axis, v->pUS_rgb, image_container.image2D, image_container.image2D->pUS_rgb, x);
-		break;
-	case 12: error_ = get_slice_<RGBImageTypeSI, RGBImage2DTypeSI>(axis, v->pSI_rgb, image_container.image2D, image_container.image2D->pSI_rgb, x);
-		break;
-	case 13: error_ = get_slice_<RGBImageTypeUI, RGBImage2DTypeUI>(axis, v->pUI_rgb, image_container.image2D, image_container.image2D->pUI_rgb, x);
-		break;
-	case 14: error_ = get_slice_<RGBImageTypeUC, RGBImage2DTypeUC>(axis, v->pUC_rgb, image_container.image2D, image_container.image2D->pUC_rgb, x);
-		break;
-	case 15: error_ = get_slice_<RGBImageTypeF, RGBImage2DTypeF>(axis, v->pF_rgb, image_container.image2D, image_container.image2D->pF_rgb, x);
-		break;
-	case 16: error_ = get_slice_<RGBImageTypeD, RGBImage2DTypeD>(axis, v->pD_rgb, image_container.image2D, image_container.image2D->pD_rgb, x);
-		break;
-	case 20: error_ = get_slice_<RGBAImageTypeSS, RGBAImage2DTypeSS>(axis, v->pSS_rgba, image_container.image2D, image_container.image2D->pSS_rgba, x);
-		break;
-	case 21: error_ = get_slice_<RGBAImageTypeUS, RGBAImage2DTypeUS>(axis, v->pUS_rgba, image_container.image2D, image_container.image2D->pUS_rgba, x);
-		break;
-	case 22: error_ = get_slice_<RGBAImageTypeSI, RGBAImage2DTypeSI>(axis, v->pSI_rgba, image_container.image2D, image_container.image2D->pSI_rgba, x);
-		break;
-	case 23: error_ = get_slice_<RGBAImageTypeUI, RGBAImage2DTypeUI>(axis, v->pUI_rgba, image_container.image2D, image_container.image2D->pUI_rgba, x);
-		break;
-	case 24: error_ = get_slice_<RGBAImageTypeUC, RGBAImage2DTypeUC>(axis, v->pUC_rgba, image_container.image2D, image_container.image2D->pUC_rgba, x);
-		break;
-	case 25: error_ = get_slice_<RGBAImageTypeF, RGBAImage2DTypeF>(axis, v->pF_rgba, image_container.image2D, image_container.image2D->pF_rgba, x);
-		break;
-	case 26: error_ = get_slice_<RGBAImageTypeD, RGBAImage2DTypeD>(axis, v->pD_rgba, image_container.image2D, image_container.image2D->pD_rgba, x);
-		break;
-	default: { clear_(false); goto quit__; }
-	}
-	//
-	if (error_.isEmpty())
-	{
-		image_container.image2D->image_type = v->image_type;
+		reset_image2D(image_container.image2D);
+		if (!extract_slice_2D(
+				v, axis, x, image_container.image2D, error_,
+				&stand_in))
+		{
+			clear_(false);
+			goto quit__;
+		}
+		if (!error_.isEmpty()) goto quit__;
 	}
-	else { goto quit__; }
 	//
 	switch(axis)
 	{
@@ -2313,6 +2641,18 @@ void GraphicsWidget::set_slice_2D(
 	}
 quit__:
 	mutex.unlock();
+	if (stand_in)
+	{
+		pr_usregs = alw_usregs;
+		QTimer::singleShot(20, this, SLOT(update_pr_slice_()));
+	}
+}
+
+// The displayed slice was not ready, see set_slice_2D.
+void GraphicsWidget::update_pr_slice_()
+{
+	ImageVariant * v = image_container.image3D;
+	if (v && v->pr_slices) set_slice_2D(v, 0, pr_usregs);
 }
 
 void GraphicsWidget::set_axis(int a)
@@ -2365,8 +2705,59 @@ bool GraphicsWidget::get_bb() const
 	return bb;
 }
 
+// Monotonic time for the cine schedule, ms
+static long long cine_time_ms()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(4,7,0)
+	static QElapsedTimer t;
+	if (!t.isValid()) t.start();
+	return t.elapsed();
+#else
+	struct timeval tp;
+	gettimeofday(&tp, NULL);
+	return (long long)tp.tv_sec * 1000L + tp.tv_usec / 1000;
+#endif
+}
+
+class CinePrefetchThread_ : public QThread
+{
+public:
+	CinePrefetchThread_(
+		const ImageVariant * v_,
+		ImageVariant2D * out_,
+		short axis_,
+		int idx_)
+		:
+		ok(false),
+		v(v_),
+		out(out_),
+		axis(axis_),
+		idx(idx_) {}
+	~CinePrefetchThread_() {}
+	void run()
+	{
+		QString error_;
+		reset_image2D(out);
+		ok = (extract_slice_2D(v, axis, idx, out, error_) &&
+			error_.isEmpty());
+	}
+	bool ok;
+
+private:
+	const ImageVariant * v;
+	ImageVariant2D * out;
+	short axis;
+	int idx;
+};
+
 void GraphicsWidget::start_animation()
 {
+	cine_start = cine_time_ms();
+	cine_next_due = 0.0;
+	cine_fps_start = cine_start;
+	cine_fps_frames = 0;
+	cine_fps = 0.0;
+	cine_dropped = 0;
 	animate_();
 }
 
@@ -2374,104 +2765,179 @@ void GraphicsWidget::stop_animation()
 {
 	run__ = false;
 	anim2D_timer->stop();
+	stop_cine_prefetch();
+}
+
+double GraphicsWidget::get_cine_fps() const
+{
+	return cine_fps;
 }
 
+unsigned int GraphicsWidget::get_cine_dropped() const
+{
+	return cine_dropped;
+}
+
+int GraphicsWidget::get_cine_slices() const
+{
+	if (!image_container.image3D) return 0;
+	switch(axis)
+	{
+	case 0: return image_container.image3D->di->idimx;
+	case 1: return image_container.image3D->di->idimy;
+	case 2: return image_container.image3D->di->idimz;
+	default: break;
+	}
+	return 0;
+}
+
+// Display time of the slice, ms, 'defined' is true if
+// the time is from the data set.
+double GraphicsWidget::get_cine_frame_time(int k, bool * defined) const
+{
+	double t = frametime_2D;
+	*defined = false;
+	if (axis == 2 &&
+		image_container.image3D->frame_times.size() > (unsigned int)k)
+	{
+		t = image_container.image3D->frame_times.at(k);
+		if (frame_time_unit == 1) t *= 1000;
+		*defined = true;
+	}
+	return (t < 1.0) ? 1.0 : t;
+}
+
+// Swaps in the slice extracted ahead, if it is the requested one.
+bool GraphicsWidget::take_cine_slice(const ImageVariant * v, int k)
+{
+	if (!run__ || !cine_thread) return false;
+	if (cine_next_image != v || cine_next_slice != k) return false;
+	cine_thread->wait();
+	const bool ok = static_cast<CinePrefetchThread_*>(cine_thread)->ok;
+	delete cine_thread;
+	cine_thread = NULL;
+	cine_next_image = NULL;
+	cine_next_slice = -1;
+	if (!ok) return false;
+	ImageVariant2D * tmp0 = image_container.image2D;
+	image_container.image2D = cine_next;
+	cine_next = tmp0;
+	return true;
+}
+
+void GraphicsWidget::start_cine_prefetch(int k)
+{
+	stop_cine_prefetch();
+	if (!image_container.image3D || !cine_next) return;
+	cine_next_image = image_container.image3D;
+	cine_next_slice = k;
+	cine_thread = new CinePrefetchThread_(
+		cine_next_image, cine_next, axis, k);
+	cine_thread->start();
+}
+
+void GraphicsWidget::stop_cine_prefetch()
+{
+	if (!cine_thread) return;
+	cine_thread->wait();
+	delete cine_thread;
+	cine_thread = NULL;
+	cine_next_image = NULL;
+	cine_next_slice = -1;
+}
+
+// Frame k is due at the sum of the display times of the frames
+// before it, counted from the start. A frame which display time
+// has passed already is dropped, the schedule does not drift.
+// Next slice is extracted in a thread while waiting.
 void GraphicsWidget::animate_()
 {
 	int k = 0;
 	if (!run__) return;
-	double requested_time = frametime_2D;
-	bool time_defined = false;
 	if (!image_container.image3D) return;
-#if QT_VERSION >= QT_VERSION_CHECK(4,7,0)
-	const qint64 t0 = QDateTime::currentMSecsSinceEpoch();
-#else
-	struct timeval tp0;
-	gettimeofday(&tp0, NULL);
-	const long long t0 =
-		(long long) tp0.tv_sec * 1000L + tp0.tv_usec / 1000;
-#endif
+	ImageVariant * v = image_container.image3D;
+	const int n = get_cine_slices();
+	if (n < 1) return;
+	switch(axis)
+	{
+	case 0: k = v->di->selected_x_slice; break;
+	case 1: k = v->di->selected_y_slice; break;
+	case 2: k = v->di->selected_z_slice; break;
+	default: return;
+	}
+	k = (k >= n-1 || k < 0) ? 0 : k+1;
+	bool time_defined = false;
+	double frame_time = get_cine_frame_time(k, &time_defined);
+	const long long t0 = cine_time_ms() - cine_start;
+	bool dropped = false;
+	for (int j = 0; j < n-1; j++)
+	{
+		if (cine_next_due + frame_time > t0) break;
+		cine_next_due += frame_time;
+		cine_dropped++;
+		dropped = true;
+		k = (k >= n-1) ? 0 : k+1;
+		frame_time = get_cine_frame_time(k, &time_defined);
+	}
+	// more than one loop behind, e.g. the window was blocked
+	if (cine_next_due + frame_time <= t0) cine_next_due = t0;
 	switch(axis)
 	{
 	case 0:
-		{
-			k = image_container.image3D->di->selected_x_slice;
-			if (k >= image_container.image3D->di->idimx-1 || k < 0)
-				k = 0;
-			else
-				k+=1;
-			image_container.image3D->di->selected_x_slice = k;
-		}
+		v->di->selected_x_slice = k;
 		break;
 	case 1:
-		{
-			k = image_container.image3D->di->selected_y_slice;
-			if (k >= image_container.image3D->di->idimy-1 || k < 0)
-				k = 0;
-			else
-				k+=1;
-			image_container.image3D->di->selected_y_slice = k;
-		}
+		v->di->selected_y_slice = k;
 		break;
 	case 2:
 		{
-			k = image_container.image3D->di->selected_z_slice;
-			if (k >= image_container.image3D->di->idimz-1 || k < 0)
-				k = 0;
-			else
-				k+=1;
-			if (image_container.image3D->di->lock_2Dview)
+			if (v->di->lock_2Dview)
 			{
-				image_container.image3D->di->from_slice = k;
-				if (image_container.image3D->di->lock_single)
+				v->di->from_slice = k;
+				if (v->di->lock_single)
 				{
-					image_container.image3D->di->to_slice = k;
+					v->di->to_slice = k;
 				}
 				else
 				{
-					image_container.image3D->di->to_slice =
-						image_container.image3D->di->idimz-1;
+					v->di->to_slice = v->di->idimz-1;
 				}
 			}
-			if (
-				image_container.image3D->frame_times.size() >
-					(unsigned int)k)
-			{
-				requested_time =
-					image_container.image3D->frame_times.at(k);
-				if (frame_time_unit == 1) requested_time*=1000;
-				time_defined = true;
-			}
-			image_container.image3D->di->selected_z_slice = k;
+			v->di->selected_z_slice = k;
 		}
 		break;
 	default: return;
 	}
-	if (!((axis==2) && (image_container.image3D->di->idimz==1)))
+	if (!((axis==2) && (v->di->idimz==1)))
 	{
-		set_slice_2D(image_container.image3D, 0, false);
+		set_slice_2D(v, 0, false);
 		aliza->update_slice_from_animation(
-			const_cast<const ImageVariant*>(image_container.image3D));
+			const_cast<const ImageVariant*>(v));
+		start_cine_prefetch((k >= n-1) ? 0 : k+1);
 	}
-#if QT_VERSION >= QT_VERSION_CHECK(4,7,0)
-	const qint64 t1 = QDateTime::currentMSecsSinceEpoch();
-#else
-	struct timeval tp1;
-	gettimeofday(&tp1, NULL);
-	const long long t1 =
-		(long long)tp1.tv_sec * 1000L + (long long)tp1.tv_usec / 1000;
-#endif
-	const long int t = static_cast<int>(requested_time-(t1-t0));
-	if (t <= 0)
+	cine_next_due += frame_time;
+	cine_fps_frames++;
+	const long long t1 = cine_time_ms();
+	if (t1 - cine_fps_start >= 1000)
+	{
+		cine_fps =
+			(1000.0 * cine_fps_frames) / (double)(t1 - cine_fps_start);
+		cine_fps_frames = 0;
+		cine_fps_start = t1;
+		toolbox2D->set_cine_info(cine_fps, cine_dropped);
+	}
+	const long long t =
+		static_cast<long long>(cine_next_due) - (t1 - cine_start);
+	if (dropped || t <= 0)
 	{
 		// can not run at required speed
-		anim2D_timer->start(2);
+		anim2D_timer->start((t > 2) ? static_cast<int>(t) : 2);
 		if (!toolbox2D->is_red())
 			toolbox2D->set_indicator_red();
 	}
 	else
 	{
-		anim2D_timer->start(t);
+		anim2D_timer->start(static_cast<int>(t));
 		if (time_defined)
 		{
 			if (!toolbox2D->is_green())
@@ -2482,7 +2948,7 @@ void GraphicsWidget::animate_()
 			if (!toolbox2D->is_blue())
 				toolbox2D->set_indicator_blue();
 		}
-	}	
+	}
 }
 
 void GraphicsWidget::set_top_label_text(const QString & s)
@@ -48,6 +48,8 @@ public:
 	int  get_axis() const { return axis; }
 	void start_animation();
 	void stop_animation();
+	double get_cine_fps() const;
+	unsigned int get_cine_dropped() const;
 	GraphicsView * graphicsview;
 	ToolBox2D    * toolbox2D;
 	SliderWidget * slider_m;
@@ -117,12 +119,18 @@ public slots:
 private slots:
 	void update_image__();
 	void animate_();
+	void update_pr_slice_();
 signals:
 	void slice_changed(int);
 protected:
 	void closeEvent(QCloseEvent*);
 	void leaveEvent(QEvent*);
 private:
+	int  get_cine_slices() const;
+	double get_cine_frame_time(int, bool*) const;
+	bool take_cine_slice(const ImageVariant*, int);
+	void start_cine_prefetch(int);
+	void stop_cine_prefetch();
 	short  axis;
 	bool   main;
 	bool   multi;
@@ -136,6 +144,18 @@ private:
 	int    frametime_2D;
 	double contours_width;
 	QTimer    * anim2D_timer;
+	// cine, next slice is extracted ahead in 'cine_thread'
+	QThread * cine_thread;
+	ImageVariant2D * cine_next;
+	const ImageVariant * cine_next_image;
+	int       cine_next_slice;
+	long long cine_start;
+	double    cine_next_due;
+	long long cine_fps_start;
+	unsigned int cine_fps_frames;
+	double    cine_fps;
+	unsigned int cine_dropped;
+	bool      pr_usregs;
 	QLabel    * top_label;
 	QLabel    * left_label;
 	QLabel    * measure_label;
@@ -32,7 +32,8 @@ template<typename T> QString calculate_histogramm(
 	long long bins_size =
 		static_cast<long long>(round(v->di->rmax-v->di->rmin)) + 1;
 	if (bins_size > 2048) bins_size = 2048; // TODO
-	if (bins_size < 256 && (v->image_type==5||v->image_type==6))
+	if (bins_size < 256 &&
+		(v->image_type==5||v->image_type==6||!v->slice_rescale.empty()))
 		bins_size = 256;
 	if (bins_size <= 0)
 	{
@@ -52,30 +53,71 @@ template<typename T> QString calculate_histogramm(
 		return QString("!bins");
 	}
 	//
-	typename UpdateQtCommand::Pointer update_qt_command =
-		UpdateQtCommand::New();
-	try
-	{
-		histogram_generator->SetInput(image);
-		histogram_generator->SetNumberOfBins(bins_size);
-		histogram_generator->SetAutoHistogramMinimumMaximum(false);
-		histogram_generator->SetHistogramMax(v->di->rmax);
-		histogram_generator->SetHistogramMin(v->di->rmin);
-		histogram_generator->AddObserver(
-			itk::ProgressEvent(), update_qt_command);
-		histogram_generator->Compute();
-	}
-	catch (itk::ExceptionObject & ex)
+	if (!v->slice_rescale.empty())
 	{
-		*ok = false;
-		return QString(ex.GetDescription());
+		// stored pixels with per-slice rescale
+		for (int x = 0; x < bins_size; x++) bins[x] = 0;
+		const typename T::SizeType size =
+			image->GetLargestPossibleRegion().GetSize();
+		const size_t slice_size = size[0] * size[1];
+		const typename T::PixelType * p = image->GetBufferPointer();
+		const double range = v->di->rmax - v->di->rmin;
+		const double bin_scale = (range > 0) ? bins_size / range : 0.0;
+		for (size_t z = 0; z < size[2]; z++)
+		{
+			double intercept = 0.0, slope = 1.0;
+			if (z < static_cast<size_t>(v->slice_rescale.size()))
+			{
+				intercept = v->slice_rescale.at(z).first;
+				slope     = v->slice_rescale.at(z).second;
+			}
+			const typename T::PixelType * s = p + z * slice_size;
+			for (size_t j = 0; j < slice_size; j++)
+			{
+				const double f = static_cast<double>(s[j]) * slope + intercept;
+				long long b = static_cast<long long>(
+					(f - v->di->rmin) * bin_scale);
+				if (b < 0) continue;
+				if (b >= bins_size)
+				{
+					if (f > v->di->rmax) continue;
+					b = bins_size - 1;
+				}
+				bins[b]++;
+			}
+		}
+		for (int x = 0; x < bins_size; x++)
+		{
+			if (bins[x] > tmp0) tmp0 = bins[x];
+		}
 	}
-	//
-	const HistogramType * h = histogram_generator->GetOutput();
-	for (int x = 0; x < bins_size; x++)
+	else
 	{
-		bins[x] = h->GetFrequency(x, 0);
-		if (bins[x] > tmp0) tmp0 = bins[x];
+		typename UpdateQtCommand::Pointer update_qt_command =
+			UpdateQtCommand::New();
+		try
+		{
+			histogram_generator->SetInput(image);
+			histogram_generator->SetNumberOfBins(bins_size);
+			histogram_generator->SetAutoHistogramMinimumMaximum(false);
+			histogram_generator->SetHistogramMax(v->di->rmax);
+			histogram_generator->SetHistogramMin(v->di->rmin);
+			histogram_generator->AddObserver(
+				itk::ProgressEvent(), update_qt_command);
+			histogram_generator->Compute();
+		}
+		catch (itk::ExceptionObject & ex)
+		{
+			*ok = false;
+			return QString(ex.GetDescription());
+		}
+		//
+		const HistogramType * h = histogram_generator->GetOutput();
+		for (int x = 0; x < bins_size; x++)
+		{
+			bins[x] = h->GetFrequency(x, 0);
+			if (bins[x] > tmp0) tmp0 = bins[x];
+		}
 	}
 	const double tmp2 = tmp0 > 2 ? log((double)tmp0) : 0.30102;
 	//
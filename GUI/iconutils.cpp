@@ -1,4 +1,6 @@
 #include "structures.h"
+#include "commonutils.h"
+#include "prconfigutils.h"
 #include "itkExtractImageFilter.h"
 #include "itkIntensityWindowingImageFilter.h"
 #include <QPainter>
@@ -31,56 +33,32 @@ void IconUtils::update_icon(ImageVariant * v, const int isize)
 	painter.end();
 }
 
-template<typename Tin, typename Tout> void extract_icon(
-	const typename Tin::Pointer & image, ImageVariant * ivariant,
-	const int isize=96)
+template<typename Tout> void icon_from_slice(
+	const typename Tout::Pointer & tmp0, ImageVariant * ivariant,
+	const int z, const int isize)
 {
-	if (!ivariant) return;
-	if (image.IsNull()) return;
-	//
-	typedef  itk::ExtractImageFilter<Tin, Tout> FilterType;
 	typedef  itk::IntensityWindowingImageFilter<Tout, Image2DTypeUC>
 		IntensityWindowingImageFilterType;
-	typename Tout::Pointer tmp0;
 	typename Image2DTypeUC::Pointer tmp1;
 	unsigned int size_x, size_y;
 	double   spacing_x, spacing_y;
-	typename FilterType::Pointer filter = FilterType::New();
-	typename Tin::RegionType inRegion = image->GetLargestPossibleRegion();
-	typename Tin::SizeType size = inRegion.GetSize();
-	typename Tin::IndexType index = inRegion.GetIndex();
-	index[2] = size[2]/2;
-	typename Tin::SizeType out_size;
-	out_size[0] = size[0];
-	out_size[1] = size[1];
-	out_size[2] = 0;
-	typename Tin::RegionType outRegion;
-	outRegion.SetSize(out_size);
-	outRegion.SetIndex(index);
-	try
+	//
+	// window is in rescaled units, map it to the stored pixels
+	double window_width  = ivariant->di->us_window_width;
+	double window_center = ivariant->di->us_window_center;
+	double intercept, slope;
+	if (CommonUtils::get_slice_rescale(
+			ivariant, z, &intercept, &slope) && slope > 0.0)
 	{
-		filter->SetInput(image);
-		filter->SetExtractionRegion(outRegion);
-		filter->SetDirectionCollapseToIdentity();
-		filter->Update();
-		tmp0 = filter->GetOutput();
+		window_width  = window_width / slope;
+		window_center = (window_center - intercept) / slope;
 	}
-	catch (itk::ExceptionObject & ex)
-	{
-		std::cout << ex.GetDescription() << std::endl;
-		return;
-	}
-	if (tmp0.IsNull()) return;
-	else tmp0->DisconnectPipeline();
-	//
 	typename IntensityWindowingImageFilterType::Pointer intensity_filter =
 		IntensityWindowingImageFilterType::New();
 	try
 	{
 		intensity_filter->SetInput(tmp0);
-		intensity_filter->SetWindowLevel(
-			ivariant->di->us_window_width,
-			ivariant->di->us_window_center);
+		intensity_filter->SetWindowLevel(window_width, window_center);
 		intensity_filter->Update();
 		tmp1 = intensity_filter->GetOutput();
 	}
@@ -248,6 +226,45 @@ template<typename Tin, typename Tout> void extract_icon(
 	IconUtils::update_icon(ivariant, isize);
 }
 
+template<typename Tin, typename Tout> void extract_icon(
+	const typename Tin::Pointer & image, ImageVariant * ivariant,
+	const int isize=96)
+{
+	if (!ivariant) return;
+	if (image.IsNull()) return;
+	//
+	typedef  itk::ExtractImageFilter<Tin, Tout> FilterType;
+	typename Tout::Pointer tmp0;
+	typename FilterType::Pointer filter = FilterType::New();
+	typename Tin::RegionType inRegion = image->GetLargestPossibleRegion();
+	typename Tin::SizeType size = inRegion.GetSize();
+	typename Tin::IndexType index = inRegion.GetIndex();
+	index[2] = size[2]/2;
+	typename Tin::SizeType out_size;
+	out_size[0] = size[0];
+	out_size[1] = size[1];
+	out_size[2] = 0;
+	typename Tin::RegionType outRegion;
+	outRegion.SetSize(out_size);
+	outRegion.SetIndex(index);
+	try
+	{
+		filter->SetInput(image);
+		filter->SetExtractionRegion(outRegion);
+		filter->SetDirectionCollapseToIdentity();
+		filter->Update();
+		tmp0 = filter->GetOutput();
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		std::cout << ex.GetDescription() << std::endl;
+		return;
+	}
+	if (tmp0.IsNull()) return;
+	else tmp0->DisconnectPipeline();
+	icon_from_slice<Tout>(tmp0, ivariant, index[2], isize);
+}
+
 template<typename Tin, typename Tout> void extract_icon_rgb(
 	const typename Tin::Pointer & image, ImageVariant * ivariant,
 	const int isize=96)
@@ -857,6 +874,17 @@ template<typename Tin, typename Tout> void extract_icon_rgba(
 void IconUtils::icon(ImageVariant * ivariant)
 {
 	if (!ivariant) return;
+	if (ivariant->pr_slices)
+	{
+		ImageVariant2D tmp0;
+		const int z = ivariant->di->idimz / 2;
+		if (!ivariant->pr_slices->get_slice(z, &tmp0).isEmpty()) return;
+		if (tmp0.image_type == 4)
+			icon_from_slice<Image2DTypeUC>(tmp0.pUC, ivariant, z, 96);
+		else
+			icon_from_slice<Image2DTypeF>(tmp0.pF, ivariant, z, 96);
+		return;
+	}
 	switch(ivariant->image_type)
 	{
 	case 0:
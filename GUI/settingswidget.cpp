@@ -11,6 +11,7 @@
 #include <QFont>
 #include "commonutils.h"
 #include "dicomutils.h"
+#include "memorybudget.h"
 
 SettingsWidget::SettingsWidget(float si, QWidget * p, Qt::WindowFlags f) : QWidget(p, f)
 {
@@ -36,6 +37,8 @@ SettingsWidget::SettingsWidget(float si, QWidget * p, Qt::WindowFlags f) : QWidg
 	styleComboBox->setCurrentIndex(saved_idx);
 	connect(reload_pushButton,SIGNAL(clicked()),this,SLOT(set_default()));
 	connect(pt_doubleSpinBox,SIGNAL(valueChanged(double)),this,SLOT(update_font_pt(double)));
+	connect(threads_spinBox,SIGNAL(valueChanged(int)),this,SLOT(update_max_threads(int)));
+	connect(memory_spinBox,SIGNAL(valueChanged(int)),this,SLOT(update_memory_budget(int)));
 }
 
 SettingsWidget::~SettingsWidget()
@@ -118,6 +121,8 @@ void SettingsWidget::set_default()
 	srscale_checkBox->blockSignals(false);
 	srchapters_checkBox->setChecked(true);
 	srskipimage_checkBox->setChecked(false);
+	threads_spinBox->setValue(0);
+	memory_spinBox->setValue(0);
 	//
 	pt_doubleSpinBox->setEnabled(false);
 	disconnect(
@@ -165,6 +170,18 @@ void SettingsWidget::update_font_pt(double x)
 	QApplication::processEvents();
 }
 
+void SettingsWidget::update_max_threads(int x)
+{
+	CommonUtils::set_max_threads(x);
+}
+
+// MB, 0 - automatic
+void SettingsWidget::update_memory_budget(int x)
+{
+	MemoryBudget::set_budget(
+		(x > 0) ? static_cast<quint64>(x) * 1024 * 1024 : 0);
+}
+
 bool SettingsWidget::get_level_for_PET() const
 {
 	return !pet_no_level_checkBox->isChecked();
@@ -192,6 +209,8 @@ void SettingsWidget::readSettings()
 	const int tmp5  = settings.value(QString("sr_info2"),        0).toInt();
 	const int tmp6  = settings.value(QString("sr_chapters"),     1).toInt();
 	const int tmp7  = settings.value(QString("sr_skip_images"),  0).toInt();
+	const int tmp8  = settings.value(QString("max_threads"),     0).toInt();
+	const int tmp9  = settings.value(QString("memory_budget"),   0).toInt();
 	settings.endGroup();
 	settings.beginGroup(QString("StyleDialog"));
 	saved_idx = settings.value(QString("saved_idx"), 0).toInt();
@@ -220,6 +239,10 @@ void SettingsWidget::readSettings()
 	srinfo_checkBox->setChecked((tmp5 == 1));
 	srchapters_checkBox->setChecked((tmp6 == 1));
 	srskipimage_checkBox->setChecked((tmp7 == 1));
+	threads_spinBox->setValue((tmp8 > 0) ? tmp8 : 0);
+	CommonUtils::set_max_threads(threads_spinBox->value());
+	memory_spinBox->setValue((tmp9 > 0) ? tmp9 : 0);
+	update_memory_budget(memory_spinBox->value());
 }
 
 void SettingsWidget::writeSettings(QSettings & s)
@@ -234,6 +257,8 @@ void SettingsWidget::writeSettings(QSettings & s)
 	s.setValue(QString("sr_i_width"),    QVariant(srwidth_spinBox->value()));
 	s.setValue(QString("sr_chapters"),   QVariant((int)(srchapters_checkBox->isChecked()?1:0)));
 	s.setValue(QString("sr_skip_images"),QVariant((int)(srskipimage_checkBox->isChecked()?1:0)));
+	s.setValue(QString("max_threads"),   QVariant(threads_spinBox->value()));
+	s.setValue(QString("memory_budget"), QVariant(memory_spinBox->value()));
 	s.endGroup();
 	s.beginGroup(QString("StyleDialog"));
 	s.setValue(QString("saved_idx"), QVariant(styleComboBox->currentIndex()));
@@ -43,6 +43,8 @@ private slots:
 
 public slots:
 	void update_font_pt(double);
+	void update_max_threads(int);
+	void update_memory_budget(int);
 	void force_no_gl3();
 
 
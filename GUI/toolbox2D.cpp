@@ -1,4 +1,5 @@
 #include "toolbox2D.h"
+#include <QVariant>
 
 ToolBox2D::ToolBox2D(float si, QWidget * p, Qt::WindowFlags f) : QWidget(p, f)
 {
@@ -95,6 +96,13 @@ bool ToolBox2D::is_blue() const
 	return label_is_blue;
 }
 
+void ToolBox2D::set_cine_info(double fps, unsigned int dropped)
+{
+	anim_label->setToolTip(
+		QString("FPS ") + QString::number(fps, 'f', 1) +
+		QString(", dropped ") + QVariant(dropped).toString());
+}
+
 void ToolBox2D::set_lut_function(int x)
 {
 	comboBox->setCurrentIndex(x);
@@ -16,6 +16,7 @@ public:
 	bool is_red() const;
 	bool is_green() const;
 	bool is_blue() const;
+	void set_cine_info(double, unsigned int);
 	void set_lut_function(int);
 	void connect_sliders();
 	void disconnect_sliders();
@@ -12,10 +12,15 @@
 #include <QTableWidgetItem>
 #include <QMessageBox>
 #include <QFileInfo>
-#include <QMap>
 #include <QVector>
+#include <QSet>
 #include <QDir>
 #include <QApplication>
+#include <QFile>
+#include <QThread>
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QtEndian>
 #ifdef USE_WORKSTATION_MODE
 #include <QSqlDatabase>
 #include <QSqlQuery>
@@ -27,12 +32,15 @@
 #include "mdcmScanner.h"
 #include "mdcmAttribute.h"
 #include "mdcmMediaStorage.h"
-#include "mdcmExplicitDataElement.h"
 #include "mdcmFileMetaInformation.h"
 #include "codecutils.h"
 #include "dicomutils.h"
+#include "commonutils.h"
 #include <vector>
 #include <string>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 const mdcm::Tag tOffsetOfTheFirstDirectoryRecordOfTheRootDirectoryEntity(0x0004,0x1200);
 const mdcm::Tag tDirectoryRecordSequence                    (0x0004,0x1220);
@@ -55,36 +63,397 @@ const mdcm::Tag tColumns                                    (0x0028,0x0011);
 const mdcm::Tag tBitsAllocated                              (0x0028,0x0100);
 const mdcm::Tag tPixelRepresentation                        (0x0028,0x0103);
 
-mdcm::VL BrowserWidget2::compute_offset0(const mdcm::DataSet & ds)
+static bool hash_file(const QString & f, QByteArray & result)
 {
-	mdcm::VL len = 0;
-	mdcm::DataSet::ConstIterator it = ds.Begin();
-	for(; it != ds.End() && it->GetTag() != tDirectoryRecordSequence; ++it)
-	{
-		const mdcm::DataElement &de = *it;
-		len += de.GetLength<mdcm::ExplicitDataElement>();
-	}
-	// Tag length: 2 bytes (group number) + 2 bytes (element number)
-	len += 4;
-	// http://dicom.nema.org/medical/dicom/current/output/html/part05.html#table_7.1-1
-	// http://dicom.nema.org/medical/dicom/current/output/html/part05.html#table_7.1-2
-	// VL field (for Explicit) has same size as VR field
-	// in particular case (0x0004,0x1220 SQ) it is 4 bytes (VR field) + 4 bytes (VL field)
-	len += it->GetVR().GetLength();
-	len += it->GetVR().GetLength();
-	return len;
+	QFile file(f);
+	if (!file.open(QIODevice::ReadOnly)) return false;
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	QByteArray buf;
+	buf.resize(1048576);
+	while (true)
+	{
+		const qint64 n = file.read(buf.data(), buf.size());
+		if (n < 0) return false;
+		if (n == 0) break;
+		hash.addData(buf.constData(), static_cast<int>(n));
+	}
+	result = hash.result();
+	return true;
 }
 
-void BrowserWidget2::compute_offsets(const mdcm::SequenceOfItems * sq, mdcm::VL start, std::vector<unsigned int> & offsets)
+static bool copy_one_file(
+	const QString & src,
+	const QString & dst,
+	const bool verify)
 {
-	const unsigned int n = sq->GetNumberOfItems();
-	offsets.resize(n);
-	offsets[0] = static_cast<unsigned int>(start);
-	for(unsigned int i = 1; i < n; i++)
+	QFile in(src);
+	if (!in.open(QIODevice::ReadOnly|QIODevice::Unbuffered)) return false;
+	QFile out(dst);
+	// existing files are not overwritten, failed open means exists
+#if QT_VERSION >= QT_VERSION_CHECK(5,11,0)
+	if (!out.open(QIODevice::WriteOnly|QIODevice::NewOnly|QIODevice::Unbuffered))
+		return false;
+#else
+	if (out.exists()) return false;
+	if (!out.open(QIODevice::WriteOnly|QIODevice::Unbuffered)) return false;
+#endif
+	bool ok = true;
+	bool done = false;
+	QCryptographicHash hash(QCryptographicHash::Md5);
+#ifdef __linux__
+	if (!verify)
+	{
+		// in-kernel copy, falls back to read/write if not supported
+		const qint64 size = in.size();
+		off_t offset = 0;
+		while (offset < size)
+		{
+			const ssize_t r = sendfile(
+				out.handle(), in.handle(), &offset, size - offset);
+			if (r <= 0) break;
+		}
+		if (offset == size) done = true;
+		else if (offset > 0) ok = false;
+	}
+#endif
+	if (ok && !done)
 	{
-		const mdcm::Item & item = sq->GetItem(i);
-		offsets[i] = offsets[i-1] + static_cast<unsigned int>(item.GetLength<mdcm::ExplicitDataElement>());
+		QByteArray buf;
+		buf.resize(1048576);
+		while (true)
+		{
+			const qint64 n = in.read(buf.data(), buf.size());
+			if (n < 0) { ok = false; break; }
+			if (n == 0) break;
+			if (verify) hash.addData(buf.constData(), static_cast<int>(n));
+			if (out.write(buf.constData(), n) != n) { ok = false; break; }
+		}
+	}
+	out.close();
+	if (out.error() != QFile::NoError) ok = false;
+	if (ok)
+	{
+		out.setPermissions(in.permissions());
 	}
+	in.close();
+	if (ok && verify)
+	{
+		QByteArray tmp0;
+		if (!hash_file(dst, tmp0) || tmp0 != hash.result()) ok = false;
+	}
+	if (!ok) QFile::remove(dst);
+	return ok;
+}
+
+class CopyFilesThread_ : public QThread
+{
+public:
+	CopyFilesThread_(
+		const QStringList & src_,
+		const QStringList & dst_,
+		QAtomicInt * next_,
+		QAtomicInt * done_,
+		QAtomicInt * stop_,
+		const bool verify_)
+		:
+		src(src_),
+		dst(dst_),
+		next(next_),
+		done(done_),
+		stop(stop_),
+		verify(verify_)
+	{
+	}
+	~CopyFilesThread_()
+	{
+	}
+	void run()
+	{
+		while (stop->fetchAndAddOrdered(0) == 0)
+		{
+			const int i = next->fetchAndAddOrdered(1);
+			if (i >= src.size()) break;
+			if (!copy_one_file(src.at(i), dst.at(i), verify))
+				failed.push_back(src.at(i));
+			done->fetchAndAddOrdered(1);
+		}
+	}
+	QStringList failed;
+private:
+	const QStringList & src;
+	const QStringList & dst;
+	QAtomicInt * next;
+	QAtomicInt * done;
+	QAtomicInt * stop;
+	const bool verify;
+};
+
+// Streaming reader of the Directory Record Sequence, little or big
+// endian, explicit or implicit VR. Values are read only for the
+// attributes below, everything else is skipped.
+static const mdcm::Tag record_tags[] =
+{
+	tOffsetOfTheNextDirectoryRecord,
+	tOffsetOfReferencedLowerLevelDirectoryEntity,
+	tDirectoryRecordType,
+	tReferencedFileID,
+	tSpecificCharacterSet,
+	tStudyDate,
+	tSeriesDate,
+	tModality,
+	tStudyDescription,
+	tSeriesDescription,
+	tPatientsName,
+	tPatientsBirthDate
+};
+
+static const int record_tags_size =
+	static_cast<int>(sizeof(record_tags) / sizeof(record_tags[0]));
+
+static bool read_u16(QFile & f, bool big, unsigned short * v)
+{
+	uchar b[2];
+	if (f.read(reinterpret_cast<char*>(b), 2) != 2) return false;
+	*v = big ? qFromBigEndian<quint16>(b) : qFromLittleEndian<quint16>(b);
+	return true;
+}
+
+static bool read_u32(QFile & f, bool big, unsigned int * v)
+{
+	uchar b[4];
+	if (f.read(reinterpret_cast<char*>(b), 4) != 4) return false;
+	*v = big ? qFromBigEndian<quint32>(b) : qFromLittleEndian<quint32>(b);
+	return true;
+}
+
+static bool skip_bytes(QFile & f, unsigned int len)
+{
+	const qint64 p = f.pos() + len;
+	if (p > f.size()) return false;
+	return f.seek(p);
+}
+
+// 'un' is set for UN with undefined length, the value is
+// a sequence encoded as implicit VR little endian.
+static bool read_element_header(
+	QFile & f, bool explicit_vr, bool big,
+	unsigned short * g, unsigned short * e, unsigned int * len, bool * un)
+{
+	*un = false;
+	if (!read_u16(f, big, g) || !read_u16(f, big, e)) return false;
+	if (!explicit_vr || *g == 0xfffe) return read_u32(f, big, len);
+	char vr[2];
+	if (f.read(vr, 2) != 2) return false;
+	const mdcm::VR::VRType t = mdcm::VR::GetVRTypeFromFile(vr);
+	if (t == mdcm::VR::INVALID) return false;
+	if (mdcm::VR::GetLength(t) == 4)
+	{
+		unsigned short reserved;
+		if (!read_u16(f, big, &reserved) || !read_u32(f, big, len)) return false;
+		*un = (t == mdcm::VR::UN && *len == 0xffffffff);
+		return true;
+	}
+	unsigned short len16;
+	if (!read_u16(f, big, &len16)) return false;
+	*len = len16;
+	return true;
+}
+
+static bool skip_undefined_item(QFile&, bool, bool, int);
+
+// Items of a sequence or fragments with undefined length,
+// up to and including the Sequence Delimitation Item.
+static bool skip_undefined_value(QFile & f, bool explicit_vr, bool big, int depth)
+{
+	if (depth > 32) return false;
+	while (true)
+	{
+		unsigned short g, e;
+		unsigned int len;
+		if (!read_u16(f, big, &g) || !read_u16(f, big, &e) ||
+			!read_u32(f, big, &len) || g != 0xfffe)
+		{
+			return false;
+		}
+		if (e == 0xe0dd) return true;
+		if (e != 0xe000) return false;
+		if (len == 0xffffffff)
+		{
+			if (!skip_undefined_item(f, explicit_vr, big, depth + 1)) return false;
+		}
+		else if (!skip_bytes(f, len))
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+static bool skip_undefined_item(QFile & f, bool explicit_vr, bool big, int depth)
+{
+	while (true)
+	{
+		unsigned short g, e;
+		unsigned int len;
+		bool un;
+		if (!read_element_header(f, explicit_vr, big, &g, &e, &len, &un)) return false;
+		if (g == 0xfffe && e == 0xe00d) return true;
+		if (len == 0xffffffff)
+		{
+			if (!skip_undefined_value(f, (un ? false : explicit_vr), (un ? false : big), depth))
+				return false;
+		}
+		else if (!skip_bytes(f, len))
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+static unsigned int value_to_u32(const QByteArray & ba, bool big, bool * ok)
+{
+	if (ba.size() != 4)
+	{
+		*ok = false;
+		return 0;
+	}
+	*ok = true;
+	const uchar * p = reinterpret_cast<const uchar*>(ba.constData());
+	return big ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+}
+
+static QString value_to_date(const QByteArray & ba)
+{
+	const QDate qd = QDate::fromString(
+		QString::fromLatin1(ba.constData(), ba.size()).trimmed(),
+		QString("yyyyMMdd"));
+	return qd.toString(QString("d MMM yyyy")) + QString("\n");
+}
+
+static QString value_to_text(const QByteArray & ba, const QByteArray & charset)
+{
+	QByteArray tmp0(ba);
+	return CodecUtils::toUTF8(&tmp0, charset.constData()).trimmed().remove(QChar('\0'));
+}
+
+// Reads the items of the sequence, 'sq_len' is the length of the value
+// of Directory Record Sequence, the file is positioned at the value.
+// Returns an error message or empty string.
+static QString read_records(
+	QFile & f, bool explicit_vr, bool big,
+	unsigned int sq_len,
+	RecordsDICOMDIR & r,
+	bool * not_patient_study_series_model)
+{
+	const qint64 sq_end = (sq_len == 0xffffffff) ? -1 : f.pos() + sq_len;
+	QByteArray v[record_tags_size];
+	while (sq_end < 0 || f.pos() < sq_end)
+	{
+		const qint64 item_pos = f.pos();
+		unsigned short g, e;
+		unsigned int len;
+		if (!read_u16(f, big, &g) || !read_u16(f, big, &e) ||
+			!read_u32(f, big, &len) || g != 0xfffe)
+		{
+			return QString("Can not read DICOMDIR file.");
+		}
+		if (e == 0xe0dd) break;
+		if (e != 0xe000) return QString("Can not read DICOMDIR file.");
+		const qint64 item_end = (len == 0xffffffff) ? -1 : f.pos() + len;
+		for (int k = 0; k < record_tags_size; k++) v[k].clear();
+		while (item_end < 0 || f.pos() < item_end)
+		{
+			bool un;
+			if (!read_element_header(f, explicit_vr, big, &g, &e, &len, &un))
+				return QString("Can not read DICOMDIR file.");
+			if (g == 0xfffe && e == 0xe00d) break;
+			if (len == 0xffffffff)
+			{
+				if (!skip_undefined_value(f, (un ? false : explicit_vr), (un ? false : big), 0))
+					return QString("Can not read DICOMDIR file.");
+				continue;
+			}
+			const mdcm::Tag t(g, e);
+			int k = 0;
+			for (; k < record_tags_size; k++)
+			{
+				if (record_tags[k] == t) break;
+			}
+			if (k < record_tags_size)
+			{
+				if (static_cast<qint64>(len) > f.size() - f.pos())
+					return QString("Can not read DICOMDIR file.");
+				v[k] = f.read(len);
+				if (v[k].size() != static_cast<int>(len))
+					return QString("Can not read DICOMDIR file.");
+			}
+			else if (!skip_bytes(f, len))
+			{
+				return QString("Can not read DICOMDIR file.");
+			}
+		}
+		//
+		EntryDICOMDIR ed;
+		bool ok = true;
+		if (!v[0].isEmpty())
+		{
+			ed.offsetOfTheNextDirectoryRecord = value_to_u32(v[0], big, &ok);
+			if (!ok) return QString("Error reading \"Offset of the Next Directory Record\".");
+		}
+		if (!v[1].isEmpty())
+		{
+			ed.offsetOfReferencedLowerLevelDirectoryEntity = value_to_u32(v[1], big, &ok);
+			if (!ok) return QString("Error reading \"Offset of Referenced Lower Level Directory Entity\".");
+		}
+		if (v[2].isEmpty()) continue;
+		const QString directory_record_type =
+			QString::fromLatin1(v[2].constData(), v[2].size()).toUpper().trimmed().remove(QChar('\0'));
+		const QByteArray & charset = v[4];
+		if (directory_record_type == QString("PATIENT"))
+		{
+			ed.type = 1;
+			if (!v[10].isEmpty()) ed.text[0] = value_to_text(v[10], charset);
+			if (!v[11].isEmpty()) ed.text[1] = value_to_date(v[11]);
+		}
+		else if (directory_record_type == QString("STUDY"))
+		{
+			ed.type = 2;
+			if (!v[8].isEmpty()) ed.text[0] = value_to_text(v[8], charset);
+			if (!v[5].isEmpty()) ed.text[1] = value_to_date(v[5]);
+		}
+		else if (directory_record_type == QString("SERIES"))
+		{
+			ed.type = 3;
+			if (!v[7].isEmpty()) ed.text[0] = QString::fromLatin1(v[7].constData(), v[7].size()).trimmed();
+			if (!v[9].isEmpty()) ed.text[1] = value_to_text(v[9], charset);
+			if (!v[6].isEmpty()) ed.text[2] = value_to_date(v[6]);
+		}
+		else
+		{
+			if (ed.offsetOfReferencedLowerLevelDirectoryEntity != 0) *not_patient_study_series_model = true;
+			if (directory_record_type == QString("IMAGE") ||
+				directory_record_type == QString("RT STRUCTURE SET") ||
+				directory_record_type == QString("SPECTROSCOPY"))
+			{
+				ed.eye = 1;
+			}
+			else if (
+				directory_record_type == QString("PRESENTATION") ||
+				directory_record_type == QString("SR DOCUMENT"))
+			{
+				ed.eye = 2;
+			}
+			if (!v[3].isEmpty())
+			{
+				const QStringList l2 = value_to_text(v[3], charset).split(QString("\\"));
+				ed.text[0] = l2.join(QString(QDir::separator()));
+			}
+		}
+		r.index.insert(static_cast<unsigned int>(item_pos), r.entries.size());
+		r.entries.push_back(ed);
+	}
+	return QString("");
 }
 
 BrowserWidget2::BrowserWidget2(float si, QWidget * p) : QWidget(p)
@@ -550,7 +919,6 @@ void BrowserWidget2::copy_files()
 		saved_copy_dir,
 		(QFileDialog::ShowDirsOnly));
 	if (dirname.isEmpty()) return;
-	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 	saved_copy_dir = dirname;
 	QList<QStringList> files;
 	for (unsigned int x = 0; x < rows.size(); x++)
@@ -563,6 +931,12 @@ void BrowserWidget2::copy_files()
 		if ((item->files.empty())) continue;
 		files << item->files;
 	}
+	QStringList src;
+	QStringList dst;
+	// files with the same name would be copied to the same destination
+	// by different threads, only the first one is copied
+	QSet<QString> dst_set;
+	QStringList duplicated;
 	for (int x = 0; x < files.size(); x++)
 	{
 		count2++;
@@ -586,18 +960,99 @@ void BrowserWidget2::copy_files()
 			const QString f =
 				QDir::toNativeSeparators(files.at(x).at(y));
 			QFileInfo fi(f);
-			if (fi.exists())
+			const QString f2 = QDir::toNativeSeparators(
+				dir1 +
+				QDir::separator() +
+				fi.fileName());
+			if (dst_set.contains(f2))
 			{
-				const QString f1 = QDir::toNativeSeparators(
-					dir1 +
-					QDir::separator() +
-					fi.fileName());
-				QFile::copy(f, f1);
-				qApp->processEvents();
+				duplicated.push_back(f);
+				continue;
 			}
+			dst_set.insert(f2);
+			src.push_back(f);
+			dst.push_back(f2);
 		}
 	}
-	QApplication::restoreOverrideCursor();
+	dst_set.clear();
+	if (src.empty()) return;
+	//
+	const bool verify = verify_checkBox->isChecked();
+	QAtomicInt next(0);
+	QAtomicInt done(0);
+	QAtomicInt stop(0);
+	// I/O bound, a few parallel copies are enough
+	int num_threads = CommonUtils::get_max_threads();
+	if (num_threads > 4) num_threads = 4;
+	if (num_threads > src.size()) num_threads = src.size();
+	if (num_threads < 1) num_threads = 1;
+	QProgressDialog * pd =
+		new QProgressDialog(
+			QString("Copying files"),tr("Stop"),0,src.size());
+	pd->setWindowModality(Qt::ApplicationModal);
+	pd->setWindowFlags(
+		pd->windowFlags()^Qt::WindowContextHelpButtonHint);
+	pd->show();
+	std::vector<CopyFilesThread_*> threads;
+	for (int x = 0; x < num_threads; x++)
+	{
+		CopyFilesThread_ * t =
+			new CopyFilesThread_(src, dst, &next, &done, &stop, verify);
+		threads.push_back(t);
+		t->start();
+	}
+	while (true)
+	{
+		unsigned int b = 0;
+		CopyFilesThread_ * running = NULL;
+		for (unsigned int x = 0; x < threads.size(); x++)
+		{
+			if (threads.at(x)->isFinished()) b++;
+			else running = threads[x];
+		}
+		pd->setValue(done.fetchAndAddOrdered(0));
+		qApp->processEvents();
+		if (pd->wasCanceled()) stop.fetchAndAddOrdered(1);
+		if (b == threads.size()) break;
+		if (running) running->wait(20);
+	}
+	QStringList failed;
+	for (unsigned int x = 0; x < threads.size(); x++)
+	{
+		failed << threads.at(x)->failed;
+		delete threads[x];
+	}
+	threads.clear();
+	const int copied = done.fetchAndAddOrdered(0) - failed.size();
+	failed << duplicated;
+	const bool canceled = (stop.fetchAndAddOrdered(0) != 0);
+	pd->close();
+	qApp->processEvents();
+	delete pd;
+	if (!failed.empty() || canceled)
+	{
+		QString s =
+			QVariant(copied).toString() + QString(" of ") +
+			QVariant(src.size() + duplicated.size()).toString() +
+			QString(" files copied");
+		if (canceled) s += QString(", stopped");
+		if (!failed.empty())
+		{
+			s += QString("\n") +
+				QVariant(failed.size()).toString() +
+				(verify
+					? QString(" failed or not verified:\n")
+					: QString(" failed:\n"));
+			for (int x = 0; x < failed.size() && x < 10; x++)
+				s += failed.at(x) + QString("\n");
+			if (failed.size() > 10) s += QString("...");
+		}
+		QMessageBox mbox;
+		mbox.setWindowModality(Qt::ApplicationModal);
+		mbox.setIcon(QMessageBox::Warning);
+		mbox.setText(s);
+		mbox.exec();
+	}
 }
 
 void BrowserWidget2::open_DICOMDIR()
@@ -653,9 +1108,13 @@ const QString BrowserWidget2::read_DICOMDIR(const QString & f)
 	tableWidget->clearContents();
 	tableWidget->setRowCount(0);
 	//
+	// Only the elements before Directory Record Sequence are read
+	// into the data set, records are parsed from the file one by one.
 	mdcm::Reader reader;
 	reader.SetFileName(f.toLocal8Bit().constData());
-	if(!reader.Read())
+	std::set<mdcm::Tag> skip;
+	skip.insert(tDirectoryRecordSequence);
+	if(!reader.ReadUpToTag(tDirectoryRecordSequence, skip))
 	{
 		QApplication::restoreOverrideCursor();
 		return QString("Can not read DICOMDIR file.");
@@ -672,28 +1131,11 @@ const QString BrowserWidget2::read_DICOMDIR(const QString & f)
 	QFileInfo fi0(f);
 	const QString dir_ = fi0.absolutePath();
 	//
-	QMap<unsigned int, EntryDICOMDIR> m;
-	const mdcm::FileMetaInformation & header = file.GetHeader();
 	const mdcm::DataSet & ds = file.GetDataSet();
-	//
-	if (!ds.FindDataElement(tDirectoryRecordSequence))
-	{
-		QApplication::restoreOverrideCursor();
-		return QString("Can not find Directory Record Sequence.");
-	}
-	const mdcm::DataElement & eDirectoryRecordSequence =
-		ds.GetDataElement(tDirectoryRecordSequence);
-	mdcm::SmartPointer<mdcm::SequenceOfItems> sqDirectoryRecordSequence =
-		eDirectoryRecordSequence.GetValueAsSQ();
-	if(!(sqDirectoryRecordSequence && sqDirectoryRecordSequence->GetNumberOfItems()>0))
-	{
-		QApplication::restoreOverrideCursor();
-		return QString("Directory Record Sequence is empty.");
-	}
-	// header.GetFullLength() includes Preamble(128) + Prefix (4)
-	const mdcm::VL start = header.GetFullLength() + compute_offset0(ds);
-	std::vector<unsigned int> offsets;
-	compute_offsets(sqDirectoryRecordSequence,start,offsets);
+	const bool big =
+		(file.GetHeader().GetDataSetTransferSyntax() ==
+			mdcm::TransferSyntax::ExplicitVRBigEndian);
+	const qint64 value_pos = static_cast<qint64>(reader.GetStreamCurrentPosition());
 	//
 	bool not_patient_study_series_model = false;
 	bool ok_first_root_off = false;
@@ -707,201 +1149,52 @@ const QString BrowserWidget2::read_DICOMDIR(const QString & f)
 				&first_root_off);
 	}
 	//
-	std::set<mdcm::DataElement>::const_iterator it = ds.GetDES().begin();
-	while(it != ds.GetDES().end())
+	RecordsDICOMDIR m;
 	{
-		if (it->GetTag() == tDirectoryRecordSequence)
+		QFile qf(f);
+		if (!qf.open(QIODevice::ReadOnly))
+		{
+			QApplication::restoreOverrideCursor();
+			return QString("Can not read DICOMDIR file.");
+		}
+		// The stream is positioned after the value length, explicit VR SQ
+		// has 12 bytes header, implicit VR - 8 bytes.
+		bool explicit_vr = false;
+		bool found = false;
+		unsigned int sq_len = 0;
+		for (int x = 0; x < 2 && !found; x++)
 		{
-			const mdcm::DataElement & de = *it;
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqi = de.GetValueAsSQ();
-			for (unsigned int i = 0; i < sqi->GetNumberOfItems(); i++)
+			explicit_vr = (x == 0);
+			const qint64 header_pos = value_pos - (explicit_vr ? 12 : 8);
+			if (header_pos < 0 || !qf.seek(header_pos)) continue;
+			unsigned short g, e;
+			bool un;
+			if (read_element_header(qf, explicit_vr, big, &g, &e, &sq_len, &un) &&
+				mdcm::Tag(g, e) == tDirectoryRecordSequence &&
+				qf.pos() == value_pos)
 			{
-				const mdcm::Item    & item = sqi->GetItem(i+1);
-				const mdcm::DataSet & nds  = item.GetNestedDataSet();
-
-				EntryDICOMDIR ed;
-				if (nds.FindDataElement(tOffsetOfTheNextDirectoryRecord))
-				{
-					unsigned int off1 = 0;
-					const bool ok_off1 = DicomUtils::get_ul_value(nds,tOffsetOfTheNextDirectoryRecord,&off1);
-					if (ok_off1)
-					{
-						ed.offsetOfTheNextDirectoryRecord = off1;
-					}
-					else
-					{
-						QApplication::restoreOverrideCursor();
-						return QString("Error reading \"Offset of the Next Directory Record\".");
-					}
-				}
-				if (nds.FindDataElement(tOffsetOfReferencedLowerLevelDirectoryEntity))
-				{
-					unsigned int off2 = 0;
-					const bool ok_off2 = DicomUtils::get_ul_value(nds,tOffsetOfReferencedLowerLevelDirectoryEntity,&off2);
-					if (ok_off2)
-					{
-						ed.offsetOfReferencedLowerLevelDirectoryEntity = off2;
-					}
-					else
-					{
-						QApplication::restoreOverrideCursor();
-						return QString("Error reading \"Offset of Referenced Lower Level Directory Entity\".");
-					}
-				}
-				if (nds.FindDataElement(tDirectoryRecordType))
-				{
-					const mdcm::DataElement & e = nds.GetDataElement(tDirectoryRecordType);
-					if (!e.IsEmpty() && !e.IsUndefinedLength() && e.GetByteValue())
-					{
-						const QString directory_record_type =
- 							QString::fromLatin1(
-								e.GetByteValue()->GetPointer(),
-								e.GetByteValue()->GetLength()).toUpper().trimmed().remove(QChar('\0'));
-						ed.directoryRecordType = directory_record_type;
-						if (directory_record_type == QString("PATIENT"))
-						{
-							QString charset = QString("");
-							if (nds.FindDataElement(tSpecificCharacterSet))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tSpecificCharacterSet);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-									charset = QString::fromLatin1(e1.GetByteValue()->GetPointer(),e1.GetByteValue()->GetLength());
-							}
-							if (nds.FindDataElement(tPatientsName))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tPatientsName);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									QByteArray ba(e1.GetByteValue()->GetPointer(), e1.GetByteValue()->GetLength());
-									const QString tmp0 = CodecUtils::toUTF8(&ba, charset.toLatin1().constData());
-									ed.patient = tmp0.trimmed().remove(QChar('\0'));
-								}
-							}
-							if (nds.FindDataElement(tPatientsBirthDate))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tPatientsBirthDate);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									const QString birthdate_s =
-										QString::fromLatin1(e1.GetByteValue()->GetPointer(),
-															e1.GetByteValue()->GetLength()).trimmed();
-									const QDate qd = QDate::fromString(birthdate_s, QString("yyyyMMdd"));
-									ed.birthdate = qd.toString(QString("d MMM yyyy")) + QString("\n");
-								}
-							}
-						}
-						else if (directory_record_type == QString("STUDY"))
-						{
-							QString charset = QString("");
-							if (nds.FindDataElement(tSpecificCharacterSet))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tSpecificCharacterSet);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-									charset = QString::fromLatin1(e1.GetByteValue()->GetPointer(),e1.GetByteValue()->GetLength());
-							}
-							if (nds.FindDataElement(tStudyDate))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tStudyDate);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									const QString date_s =
-										QString::fromLatin1(e1.GetByteValue()->GetPointer(),
-															e1.GetByteValue()->GetLength()).trimmed();
-									const QDate qd = QDate::fromString(date_s, QString("yyyyMMdd"));
-									ed.study_date = qd.toString(QString("d MMM yyyy")) + QString("\n");
-								}
-							}
-							if (nds.FindDataElement(tStudyDescription))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tStudyDescription);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									QByteArray ba(e1.GetByteValue()->GetPointer(), e1.GetByteValue()->GetLength());
-									const QString tmp0 = CodecUtils::toUTF8(&ba, charset.toLatin1().constData());
-									ed.study_desc = tmp0.trimmed().remove(QChar('\0'));
-								}
-							}
-						}
-						else if (directory_record_type == QString("SERIES"))
-						{
-							QString charset = QString("");
-							if (nds.FindDataElement(tSpecificCharacterSet))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tSpecificCharacterSet);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-									charset = QString::fromLatin1(e1.GetByteValue()->GetPointer(),e1.GetByteValue()->GetLength());
-							}
-							if (nds.FindDataElement(tModality))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tModality);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									const QString tmp0 =
-										QString::fromLatin1(e1.GetByteValue()->GetPointer(),e1.GetByteValue()->GetLength());
-									ed.modality = tmp0.trimmed();
-								}
-							}
-
-							if (nds.FindDataElement(tSeriesDate))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tSeriesDate);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									const QString date_s =
-										QString::fromLatin1(e1.GetByteValue()->GetPointer(),
-															e1.GetByteValue()->GetLength()).trimmed();
-									const QDate qd = QDate::fromString(date_s, QString("yyyyMMdd"));
-									ed.series_date = qd.toString(QString("d MMM yyyy")) + QString("\n");
-								}
-							}
-
-							if (nds.FindDataElement(tSeriesDescription))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tSeriesDescription);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									QByteArray ba(e1.GetByteValue()->GetPointer(), e1.GetByteValue()->GetLength());
-									const QString tmp0 = CodecUtils::toUTF8(&ba, charset.toLatin1().constData());
-									ed.series_desc = tmp0.trimmed().remove(QChar('\0'));
-								}
-							}
-						}
-						else
-						{
-							if (ed.offsetOfReferencedLowerLevelDirectoryEntity!=0) not_patient_study_series_model = true;
-							QString charset = QString("");
-							if (nds.FindDataElement(tSpecificCharacterSet))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tSpecificCharacterSet);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-									charset = QString::fromLatin1(e1.GetByteValue()->GetPointer(),e1.GetByteValue()->GetLength());
-							}
-							if (nds.FindDataElement(tReferencedFileID))
-							{
-								const mdcm::DataElement & e1 = nds.GetDataElement(tReferencedFileID);
-								if (!e1.IsEmpty() && !e1.IsUndefinedLength() && e1.GetByteValue())
-								{
-									QByteArray ba(e1.GetByteValue()->GetPointer(), e1.GetByteValue()->GetLength());
-									const QString tmp0 = CodecUtils::toUTF8(&ba, charset.toLatin1().constData());
-									const QStringList l2 = tmp0.trimmed().split(QString("\\"));
-									const int l2size = l2.size();
-									QString fpath("");
-									for (int x = 0; x < l2size; x++)
-									{
-										fpath.append(l2.at(x));
-										if (x!=l2size-1) fpath.append(QDir::separator());
-									}
-									ed.file = fpath;
-								}
-							}
-						}
-						m.insert(offsets[i], ed);
-					}
-				}
+				found = true;
 			}
 		}
-		++it;
-    }
+		if (!found)
+		{
+			QApplication::restoreOverrideCursor();
+			return QString("Can not find Directory Record Sequence.");
+		}
+		const QString error =
+			read_records(qf, explicit_vr, big, sq_len, m, &not_patient_study_series_model);
+		qf.close();
+		if (!error.isEmpty())
+		{
+			QApplication::restoreOverrideCursor();
+			return error;
+		}
+	}
+	if (m.entries.empty())
+	{
+		QApplication::restoreOverrideCursor();
+		return QString("Directory Record Sequence is empty.");
+	}
 	//
 	QString warning("");
 	//
@@ -916,32 +1209,26 @@ const QString BrowserWidget2::read_DICOMDIR(const QString & f)
 	}
 	else
 	{
-		QMapIterator<unsigned int,EntryDICOMDIR> mi(m);
-		while (mi.hasNext())
+		for (int x = 0; x < m.entries.size(); x++)
 		{
-			mi.next();
-			while (mi.value().directoryRecordType==QString("PATIENT"))
+			const EntryDICOMDIR & e = m.entries.at(x);
+			if (e.type != 1) continue;
+			unsigned int offset_next = add_study(
+				m,
+				e.offsetOfReferencedLowerLevelDirectoryEntity,
+				series,
+				e.text[0],
+				e.text[1],
+				&not_patient_study_series_model);
+			while (offset_next > 0)
 			{
-				const EntryDICOMDIR & e = mi.value();
-				unsigned int offset_next = add_study(
+				offset_next = add_study(
 					m,
-					e.offsetOfReferencedLowerLevelDirectoryEntity,
+					offset_next,
 					series,
-					e.patient,
-					e.birthdate,
+					e.text[0],
+					e.text[1],
 					&not_patient_study_series_model);
-				while (offset_next > 0)
-				{
-					offset_next = add_study(
-						m,
-						offset_next,
-						series,
-						e.patient,
-						e.birthdate,
-						&not_patient_study_series_model);
-				}
-				if (mi.hasNext()) { mi.next(); }
-				else { break; }
 			}
 		}
 	}
@@ -973,32 +1260,33 @@ const QString BrowserWidget2::read_DICOMDIR(const QString & f)
 		if (break__) break;
 	}
 	//
+	tableWidget->setUpdatesEnabled(false);
+	tableWidget->setRowCount(series.size());
 	for (int x = 0; x < series.size(); x++)
 	{
-		const int idx = tableWidget->rowCount();
-		QString ids(""); ids.sprintf("%010d", idx);
+		QString ids(""); ids.sprintf("%010d", x);
 		TableWidgetItem * i = new TableWidgetItem(ids);
 		for (int z = 0; z < series.at(x).files.size(); z++)
 			i->files.push_back(QDir::toNativeSeparators(dir_ + QDir::separator() + series.at(x).files.at(z)));
-		tableWidget->setRowCount(idx+1);
-		tableWidget->setItem(idx,0,static_cast<QTableWidgetItem*>(i));
+		tableWidget->setItem(x,0,static_cast<QTableWidgetItem*>(i));
 		if (series.at(x).eye)
 		{
-			tableWidget->setItem(idx,1,new QTableWidgetItem(eye_icon,QString("")));
+			tableWidget->setItem(x,1,new QTableWidgetItem(eye_icon,QString("")));
 		}
 		else if (series.at(x).eye2)
 		{
-			tableWidget->setItem(idx,1,new QTableWidgetItem(eye2_icon,QString("")));
+			tableWidget->setItem(x,1,new QTableWidgetItem(eye2_icon,QString("")));
 		}
-		tableWidget->setItem(idx,2,new QTableWidgetItem(series.at(x).modality));
-		tableWidget->setItem(idx,3,new QTableWidgetItem(series.at(x).patient));
-		tableWidget->setItem(idx,4,new QTableWidgetItem(series.at(x).birthdate));
-		tableWidget->setItem(idx,5,new QTableWidgetItem(series.at(x).study));
-		tableWidget->setItem(idx,6,new QTableWidgetItem(series.at(x).study_date));
-		tableWidget->setItem(idx,7,new QTableWidgetItem(series.at(x).series));
-		tableWidget->setItem(idx,8,new QTableWidgetItem(series.at(x).series_date));
-		tableWidget->setItem(idx,9,new QTableWidgetItem(QVariant(i->files.size()).toString()));
-	}
+		tableWidget->setItem(x,2,new QTableWidgetItem(series.at(x).modality));
+		tableWidget->setItem(x,3,new QTableWidgetItem(series.at(x).patient));
+		tableWidget->setItem(x,4,new QTableWidgetItem(series.at(x).birthdate));
+		tableWidget->setItem(x,5,new QTableWidgetItem(series.at(x).study));
+		tableWidget->setItem(x,6,new QTableWidgetItem(series.at(x).study_date));
+		tableWidget->setItem(x,7,new QTableWidgetItem(series.at(x).series));
+		tableWidget->setItem(x,8,new QTableWidgetItem(series.at(x).series_date));
+		tableWidget->setItem(x,9,new QTableWidgetItem(QVariant(i->files.size()).toString()));
+	}
+	tableWidget->setUpdatesEnabled(true);
 	//
 	QApplication::restoreOverrideCursor();
 	//
@@ -1006,21 +1294,21 @@ const QString BrowserWidget2::read_DICOMDIR(const QString & f)
 }
 
 unsigned int BrowserWidget2::add_roots(
-	const QMap<unsigned int, EntryDICOMDIR> & m,
+	const RecordsDICOMDIR & m,
 	unsigned int offset,
 	QList<SeriesDICOMDIR> & l,
 	bool * warn)
 {
-	if (!m.contains(offset)) return 0;
-	const EntryDICOMDIR & e = m.value(offset);
-	if (e.directoryRecordType == QString("PATIENT"))
+	const EntryDICOMDIR * e = m.find(offset);
+	if (!e) return 0;
+	if (e->type == 1)
 	{
 		unsigned int offset_next = add_study(
 			m,
-			e.offsetOfReferencedLowerLevelDirectoryEntity,
+			e->offsetOfReferencedLowerLevelDirectoryEntity,
 			l,
-			e.patient,
-			e.birthdate,
+			e->text[0],
+			e->text[1],
 			warn);
 		while (offset_next > 0)
 		{
@@ -1028,8 +1316,8 @@ unsigned int BrowserWidget2::add_roots(
 				m,
 				offset_next,
 				l,
-				e.patient,
-				e.birthdate,
+				e->text[0],
+				e->text[1],
 				warn);
 		}
 	}
@@ -1037,26 +1325,26 @@ unsigned int BrowserWidget2::add_roots(
 	{
 		*warn = true;
 	}
-	return e.offsetOfTheNextDirectoryRecord;
+	return e->offsetOfTheNextDirectoryRecord;
 }
 
 unsigned int BrowserWidget2::add_study(
-	const QMap<unsigned int, EntryDICOMDIR> & m,
+	const RecordsDICOMDIR & m,
 	unsigned int offset,
 	QList<SeriesDICOMDIR> & l,
 	const QString & patient,
 	const QString & birthdate,
 	bool * warn)
 {
-	if (!m.contains(offset)) return 0;
-	const EntryDICOMDIR & e = m.value(offset);
-	if (e.directoryRecordType == QString("STUDY"))
+	const EntryDICOMDIR * e = m.find(offset);
+	if (!e) return 0;
+	if (e->type == 2)
 	{
-		const QString study_desc = e.study_desc;
-		const QString study_date = e.study_date;
+		const QString & study_desc = e->text[0];
+		const QString & study_date = e->text[1];
 		unsigned int offset_next = add_series(
 			m,
-			e.offsetOfReferencedLowerLevelDirectoryEntity,
+			e->offsetOfReferencedLowerLevelDirectoryEntity,
 			l,
 			patient,
 			birthdate,
@@ -1072,11 +1360,11 @@ unsigned int BrowserWidget2::add_study(
 	{
 		*warn = true;
 	}
-	return e.offsetOfTheNextDirectoryRecord;
+	return e->offsetOfTheNextDirectoryRecord;
 }
 
 unsigned int BrowserWidget2::add_series(
-	const QMap<unsigned int, EntryDICOMDIR> & m,
+	const RecordsDICOMDIR & m,
 	unsigned int offset,
 	QList<SeriesDICOMDIR> & l,
 	const QString & patient,
@@ -1085,21 +1373,21 @@ unsigned int BrowserWidget2::add_series(
 	const QString & study_date,
 	bool * warn)
 {
-	if (!m.contains(offset)) return 0;
-	const EntryDICOMDIR & e = m.value(offset);
-	if (e.directoryRecordType == QString("SERIES"))
+	const EntryDICOMDIR * e = m.find(offset);
+	if (!e) return 0;
+	if (e->type == 3)
 	{
 		SeriesDICOMDIR s;
 		s.patient     = patient;
 		s.birthdate   = birthdate;
 		s.study       = study_desc;
 		s.study_date  = study_date;
-		s.modality    = e.modality;
-		s.series      = e.series_desc;
-		s.series_date = e.series_date;
+		s.modality    = e->text[0];
+		s.series      = e->text[1];
+		s.series_date = e->text[2];
 		unsigned int offset_next = add_file(
 			m,
-			e.offsetOfReferencedLowerLevelDirectoryEntity,
+			e->offsetOfReferencedLowerLevelDirectoryEntity,
 			s);
 		while (offset_next > 0)
 		{
@@ -1111,30 +1399,26 @@ unsigned int BrowserWidget2::add_series(
 	{
 		*warn = true;
 	}
-	return e.offsetOfTheNextDirectoryRecord;
+	return e->offsetOfTheNextDirectoryRecord;
 }
 
 unsigned int BrowserWidget2::add_file(
-	const QMap<unsigned int, EntryDICOMDIR> & m,
+	const RecordsDICOMDIR & m,
 	unsigned int offset,
 	SeriesDICOMDIR & s)
 {
-	if (!m.contains(offset)) return 0;
-	const EntryDICOMDIR & e = m.value(offset);
-	if (e.directoryRecordType==QString("IMAGE") ||
-		e.directoryRecordType==QString("RT STRUCTURE SET") ||
-		e.directoryRecordType==QString("SPECTROSCOPY"))
+	const EntryDICOMDIR * e = m.find(offset);
+	if (!e) return 0;
+	if (e->eye == 1)
 	{
 		s.eye = true;
 	}
-	else if(
-		e.directoryRecordType==QString("PRESENTATION") ||
-		e.directoryRecordType==QString("SR DOCUMENT"))
+	else if (e->eye == 2)
 	{
 		s.eye2 = true;
 	}
-	s.files.push_back(e.file);
-	return e.offsetOfTheNextDirectoryRecord;
+	s.files.push_back((e->type == 0) ? e->text[0] : QString(""));
+	return e->offsetOfTheNextDirectoryRecord;
 }
 
 void BrowserWidget2::read_tags_(
@@ -1487,19 +1771,10 @@ void BrowserWidget2::open_CTK_db()
 	QList<SeriesDICOMDIR> series;
 	QSqlDatabase db;
 	QString dbfile;
-	QSqlQuery p0Query;
-	QSqlQuery p1Query;
-	QSqlQuery p2Query;
-	QSqlQuery sQuery;
-	QString p0;
-	QString p1;
-	QString p2;
-	QString ss;
-	QSet<int> ids;
-	QSet<int>::const_iterator it0;
-	size_t ids_count = 0;
-	QStringList ctk_studies;
-	QStringList ctk_series;
+	QSqlQuery query;
+	QString q;
+	QStringList where;
+	int rows = 0;
 	if (ctk_from.isEmpty() || ctk_to.isEmpty())
 	{
 		QDate d1 = QDate::currentDate();
@@ -1543,178 +1818,115 @@ void BrowserWidget2::open_CTK_db()
 		warning = db.lastError().text();
 		goto quit__;
 	}
-	p0 = QString("select UID from Patients");
-	if (!ctk_pname.isEmpty()||!ctk_pid.isEmpty())
+	// One query for series, studies, patients and files, rows
+	// of a series are adjacent, values are bound.
+	q = QString(
+		"select Series.SeriesInstanceUID,Series.Modality,Series.SeriesDate,"
+		"Series.SeriesDescription,Studies.StudyDate,Studies.StudyDescription,"
+		"Patients.PatientsName,Patients.PatientsBirthDate,Images.Filename"
+		" from Series"
+		" join Studies on Studies.StudyInstanceUID = Series.StudyInstanceUID"
+		" left join Patients on Patients.UID = Studies.PatientsUID"
+		" left join Images on Images.SeriesInstanceUID = Series.SeriesInstanceUID");
+	if (!ctk_pname.isEmpty() && !ctk_pid.isEmpty())
 	{
-		p0 += QString(" where ");
-		if (!ctk_pname.isEmpty())
-		{
-			p0 += QString("PatientsName like '%") + ctk_pname + QString("%'");
-		}
-		if (!ctk_pid.isEmpty()) 
-		{
-			if (!ctk_pname.isEmpty())
-			{
-				p0 += " or ";
-			}
-			p0 += QString("PatientID like '%") + ctk_pid + QString("%'");
-		}
+		where << QString("(Patients.PatientsName like ? or Patients.PatientID like ?)");
 	}
-	p0Query = QSqlQuery(p0, db);
-	while(p0Query.next())
+	else if (!ctk_pname.isEmpty())
 	{
-		ids << p0Query.value(0).toInt();
+		where << QString("Patients.PatientsName like ?");
 	}
-	p0Query.clear();
-	if (ctk_pname.isEmpty() && ctk_pid.isEmpty())
+	else if (!ctk_pid.isEmpty())
 	{
-		p1 = QString("select StudyInstanceUID from Studies");
-		if (ctk_apply_range)
-		{
-			p1.append(QString(" where StudyDate between ") + ctk_from +
-			QString(" and ") + ctk_to);
-		}
+		where << QString("Patients.PatientID like ?");
 	}
-	else
+	if (ctk_apply_range)
 	{
-		p1 = QString("select StudyInstanceUID from Studies where PatientsUID in (");
-		it0 = ids.constBegin();
-		while (it0 != ids.constEnd())
-		{
-			p1.append(QVariant(*it0).toString());
-			ids_count++;
-			if (ids_count < (size_t)ids.size()) p1.append(QString(","));
-			++it0;
-		}
-		p1.append(QString(")"));
-		if (ctk_apply_range)
-		{
-			p1.append(QString("and StudyDate between ") + ctk_from +
-			QString(" and ") + ctk_to);
-		}
+		where << QString("Studies.StudyDate between ? and ?");
 	}
-	p1Query = QSqlQuery(p1, db);
-	while(p1Query.next())
+	if (!where.empty())
 	{
-		ctk_studies.push_back(p1Query.value(0).toString());
+		q.append(QString(" where ") + where.join(QString(" and ")));
 	}
-	p1Query.clear();
-	p2 = QString("select SeriesInstanceUID from Series where StudyInstanceUID in (");
-	for (int x = 0; x < ctk_studies.size(); x++)
+	q.append(QString(" order by Series.SeriesInstanceUID"));
+	query = QSqlQuery(db);
+	query.setForwardOnly(true);
+	if (!query.prepare(q))
 	{
-		p2.append(QString("\"") + ctk_studies.at(x) + QString("\""));
-		if (x < ctk_studies.size() - 1) p2.append(QString(","));
+		warning = query.lastError().text();
+		db.close();
+		goto quit__;
 	}
-	p2.append(QString(")"));
-	p2Query = QSqlQuery(p2, db);
-	while(p2Query.next())
+	if (!ctk_pname.isEmpty())
 	{
-		ctk_series.push_back(p2Query.value(0).toString());
+		query.addBindValue(QString("%") + ctk_pname + QString("%"));
 	}
-	p2Query.clear();
-	for (int x = 0; x < ctk_series.size(); x++)
+	if (!ctk_pid.isEmpty())
 	{
-		SeriesDICOMDIR series0;
-		series0.UID = ctk_series.at(x);
-		QString sid;
-		QString p0id;
-		{
-			const QString s =
-				QString(
-					"select Modality,SeriesDate,SeriesDescription,StudyInstanceUID"
-					" from Series where SeriesInstanceUID = \"") +
-				ctk_series.at(x) + QString("\"");
-			QSqlQuery m = QSqlQuery(s, db);
-			if (m.next())
-			{
-				series0.modality = m.value(0).toString().trimmed();
-				const QDate tmp1 =
-					QDate::fromString(
-						m.value(1).toString(),
-						QString("yyyy-MM-dd"));
-				series0.series = m.value(2).toString().trimmed();
-				sid = m.value(3).toString();
-				series0.series_date = tmp1.toString(QString("d MMM yyyy"));
-
-			}
-			m.clear();
-		}
-		if (!sid.isEmpty())
-		{
-			const QString s =
-				QString(
-					"select PatientsUID,StudyDate,StudyDescription"
-					" from Studies where StudyInstanceUID = \"") +
-				sid + QString("\"");
-			QSqlQuery m = QSqlQuery(s, db);
-			if (m.next())
-			{
-				p0id = m.value(0).toString().trimmed();
-				const QDate tmp1 =
-					QDate::fromString(
-						m.value(1).toString(),
-						QString("yyyyMMdd"));
-				series0.study_date = tmp1.toString(QString("d MMM yyyy"));
-				series0.study = m.value(2).toString().trimmed(); 
-			}
-			m.clear();
-		}
+		query.addBindValue(QString("%") + ctk_pid + QString("%"));
+	}
+	if (ctk_apply_range)
+	{
+		query.addBindValue(ctk_from);
+		query.addBindValue(ctk_to);
+	}
+	if (!query.exec())
+	{
+		warning = query.lastError().text();
+		db.close();
+		goto quit__;
+	}
+	while (query.next())
+	{
+		const QString uid = query.value(0).toString();
+		if (series.empty() || series.last().UID != uid)
 		{
-			const QString s =
-				QString(
-					"select PatientsName,PatientsBirthDate"
-					" from Patients where UID = ") + p0id;
-			QSqlQuery m = QSqlQuery(s, db);
-			if (m.next())
-			{
-				series0.patient = m.value(0).toString().trimmed();
-				const QDate tmp1 =
-					QDate::fromString(
-						m.value(1).toString(),
-						QString("yyyy-MM-dd"));
-				series0.birthdate = tmp1.toString(QString("d MMM yyyy"));
-			}
-			m.clear();
+			SeriesDICOMDIR series0;
+			series0.UID = uid;
+			series0.modality = query.value(1).toString().trimmed();
+			series0.series_date =
+				QDate::fromString(
+					query.value(2).toString(),
+					QString("yyyy-MM-dd")).toString(QString("d MMM yyyy"));
+			series0.series = query.value(3).toString().trimmed();
+			series0.study_date =
+				QDate::fromString(
+					query.value(4).toString(),
+					QString("yyyyMMdd")).toString(QString("d MMM yyyy"));
+			series0.study = query.value(5).toString().trimmed();
+			series0.patient = query.value(6).toString().trimmed();
+			series0.birthdate =
+				QDate::fromString(
+					query.value(7).toString(),
+					QString("yyyy-MM-dd")).toString(QString("d MMM yyyy"));
+			series.push_back(series0);
 		}
+		if (!query.value(8).isNull())
 		{
-			const QString s =
-				QString(
-					"select Filename"
-					" from Images where SeriesInstanceUID = \"") +
-				series0.UID + QString("\"");
-			QSqlQuery m = QSqlQuery(s, db);
-			while (m.next())
-			{
-				series0.files.push_back(
-					QDir::toNativeSeparators(
-						m.value(0).toString().trimmed()));
-			}
-			m.clear();
+			series.last().files.push_back(
+				QDir::toNativeSeparators(
+					query.value(8).toString().trimmed()));
 		}
-		series.push_back(series0);
 	}
+	query.clear();
 	directory_lineEdit->setText(dbfile);
 	if (series.empty())
 	{
 		db.close();
 		goto quit__;
 	}
+	// rows are added at once, the view is updated at the end
+	tableWidget->setUpdatesEnabled(false);
+	rows = tableWidget->rowCount();
+	tableWidget->setRowCount(rows + series.size());
 	for (int x = 0; x < series.size(); x++)
 	{
-		const int idx = tableWidget->rowCount();
+		const int idx = rows + x;
 		QString ids("");
 		ids.sprintf("%010d", idx);
 		TableWidgetItem * i = new TableWidgetItem(ids);
-		for (int z = 0; z < series.at(x).files.size(); z++)
-			i->files.push_back(series.at(x).files.at(z));
-		tableWidget->setRowCount(idx+1);
+		i->files = series.at(x).files;
 		tableWidget->setItem(idx,0,static_cast<QTableWidgetItem*>(i));
-#if 0
-		if (series.at(x).eye)
-			tableWidget->setItem(idx,1,new QTableWidgetItem(eye_icon,QString("")));
-		else if (series.at(x).eye2)
-			tableWidget->setItem(idx,1,new QTableWidgetItem(eye2_icon,QString("")));
-#endif
 		tableWidget->setItem(idx,2,new QTableWidgetItem(series.at(x).modality));
 		tableWidget->setItem(idx,3,new QTableWidgetItem(series.at(x).patient));
 		tableWidget->setItem(idx,4,new QTableWidgetItem(series.at(x).birthdate));
@@ -1724,6 +1936,7 @@ void BrowserWidget2::open_CTK_db()
 		tableWidget->setItem(idx,8,new QTableWidgetItem(series.at(x).series_date));
 		tableWidget->setItem(idx,9,new QTableWidgetItem(QVariant(i->files.size()).toString()));
 	}
+	tableWidget->setUpdatesEnabled(true);
 	db.close();
 quit__:
 	QApplication::restoreOverrideCursor();
@@ -13,6 +13,8 @@
 #include <QCloseEvent>
 #include <QIcon>
 #include <QSettings>
+#include <QHash>
+#include <QVector>
 #include <set>
 #include "mdcmTag.h"
 #include "mdcmVL.h"
@@ -45,19 +47,38 @@ class EntryDICOMDIR
 public:
 	EntryDICOMDIR() :
 		offsetOfTheNextDirectoryRecord(0),
-		offsetOfReferencedLowerLevelDirectoryEntity(0) {}
+		offsetOfReferencedLowerLevelDirectoryEntity(0),
+		type(0),
+		eye(0) {}
 	~EntryDICOMDIR() {}
 	unsigned int offsetOfTheNextDirectoryRecord;
 	unsigned int offsetOfReferencedLowerLevelDirectoryEntity;
-	QString directoryRecordType;
-	QString modality;
-	QString patient;
-	QString birthdate;
-	QString study_date;
-	QString study_desc;
-	QString series_date;
-	QString series_desc;
-	QString file;
+	// 1 - patient, 2 - study, 3 - series, 0 - other
+	short type;
+	// other: 1 - image, 2 - presentation or SR
+	short eye;
+	// patient: name, birth date
+	// study:   description, date
+	// series:  modality, description, date
+	// other:   referenced file
+	QString text[3];
+};
+
+// Directory records in file order, found by the offset of the item.
+class RecordsDICOMDIR
+{
+public:
+	RecordsDICOMDIR() {}
+	~RecordsDICOMDIR() {}
+	const EntryDICOMDIR * find(unsigned int offset) const
+	{
+		const QHash<unsigned int, int>::const_iterator it =
+			index.constFind(offset);
+		if (it == index.constEnd()) return NULL;
+		return &entries.at(it.value());
+	}
+	QVector<EntryDICOMDIR> entries;
+	QHash<unsigned int, int> index;
 };
 
 class SeriesDICOMDIR
@@ -127,26 +148,21 @@ private:
 	QIcon eye2_icon;
 	std::set<mdcm::Tag> selected_tags;
 	std::set<mdcm::Tag> selected_tags_short;
-	mdcm::VL compute_offset0(const mdcm::DataSet&);
-	void compute_offsets(
-		const mdcm::SequenceOfItems*,
-		mdcm::VL,
-		std::vector<unsigned int> &);
 	void process_directory(const QString&, QProgressDialog*);
 	unsigned int add_roots(
-		const QMap<unsigned int, EntryDICOMDIR> &,
+		const RecordsDICOMDIR&,
 		unsigned int,
 		QList<SeriesDICOMDIR> &,
 		bool*);
 	unsigned int add_study(
-		const QMap<unsigned int, EntryDICOMDIR> &,
+		const RecordsDICOMDIR&,
 		unsigned int,
 		QList<SeriesDICOMDIR> &,
 		const QString&,
 		const QString&,
 		bool*);
 	unsigned int add_series(
-		const QMap<unsigned int, EntryDICOMDIR> &,
+		const RecordsDICOMDIR&,
 		unsigned int,
 		QList<SeriesDICOMDIR> &,
 		const QString&,
@@ -155,7 +171,7 @@ private:
 		const QString&,
 		bool*);
 	unsigned int add_file(
-		const QMap<unsigned int, EntryDICOMDIR> &,
+		const RecordsDICOMDIR&,
 		unsigned int,
 		SeriesDICOMDIR&);
 	void read_tags_(
@@ -44,27 +44,6 @@
 #include "dicomutils.h"
 #include "commonutils.h"
 
-template <typename T, long long TVR>
-void get_bin_values(
-	const mdcm::DataElement & v,
-	std::vector<T> & result)
-{
-	if (v.IsEmpty() ||
-		v.IsUndefinedLength())
-		return;
-	const mdcm::ByteValue * bv = v.GetByteValue();
-	if (!bv) return;
-	if ((bv->GetLength() < sizeof(T)) ||
-		((bv->GetLength() % sizeof(T)) != 0))
-		return;
-	mdcm::Element<TVR, mdcm::VM::VM1_n> e;
-	e.SetFromDataElement(v);
-	for (unsigned long x = 0; x < e.GetLength(); x++)
-	{
-		result.push_back(static_cast<T>(e.GetValue(x)));
-	}
-}
-
 static void get_series_files(
 	const QString & f,
 	const QString & uid,
@@ -126,6 +105,8 @@ const QString foot = QString("</body></html>");
 SQtree::SQtree(QWidget * p, bool t) : QWidget(p), skip_settings_pos(t)
 {
 	setupUi(this);
+	model = new SQtreeModel(this);
+	treeView->setModel(model);
 	setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 	textEdit->hide();
 	horizontalSlider->hide();
@@ -135,13 +116,13 @@ SQtree::SQtree(QWidget * p, bool t) : QWidget(p), skip_settings_pos(t)
 	copyAct      = new QAction(QString("Copy selected text"),   this);
 	expandAct    = new QAction(QString("Expand child items"),   this);
 	collapseAct  = new QAction(QString("Collapse child items"), this);
-	treeWidget->addAction(copyAct);
-	treeWidget->addAction(expandAct);
-	treeWidget->addAction(collapseAct);
-	treeWidget->setColumnWidth(0, 200);
-	treeWidget->setColumnWidth(1, 300);
-	treeWidget->setColumnWidth(2,  60);
-	treeWidget->setRootIsDecorated(true);
+	treeView->addAction(copyAct);
+	treeView->addAction(expandAct);
+	treeView->addAction(collapseAct);
+	treeView->setColumnWidth(0, 200);
+	treeView->setColumnWidth(1, 300);
+	treeView->setColumnWidth(2,  60);
+	treeView->setRootIsDecorated(true);
 	connect(copyAct,         SIGNAL(triggered()),      this,SLOT(copy_to_clipboard()));
 	connect(collapseAct,     SIGNAL(triggered()),      this,SLOT(collapse_item()));
 	connect(expandAct,       SIGNAL(triggered()),      this,SLOT(expand_item()));
@@ -154,651 +135,44 @@ SQtree::~SQtree()
 {
 }
 
-void SQtree::process_element(
-	const mdcm::DataSet & ds,
-	const mdcm::DataElement & e,
-	const mdcm::Dicts & d,
-	QTreeWidgetItem * wi,
-	const char * charset,
-	const bool duplicated)
+void SQtree::closeEvent(QCloseEvent * e)
 {
-	const mdcm::Tag & tag = e.GetTag();
-	QString tname("");
-	bool invalid_vr          = false;
-	bool unknown_vr          = false;
-	bool private_tag         = false;
-	bool private_creator_tag = false;
-	bool illegal_tag         = false;
-	bool skipped             = false;
-	bool hdr                 = false;
-	if (tag.GetGroup() == 0x0002) hdr = true;
-	mdcm::VR vr = e.GetVR();
-	if (vr == mdcm::VR::INVALID) invalid_vr = true;
-	if (vr == mdcm::VR::UN)      unknown_vr = true;
-	if (tag.IsIllegal())
-	{
-		illegal_tag = true;
-		tname = QString("Illegal Tag");
-	}
-	else if (tag.IsPrivateCreator())
-	{
-		private_creator_tag = true;
-		tname = QString("Private Creator");
-		if (invalid_vr||unknown_vr)
-		{
-			const mdcm::DictEntry & entry =
-				d.GetDictEntry(tag,(const char *)NULL);
-			vr = entry.GetVR();
-		}
-	}
-	else if (tag.IsPrivate())
-	{
-		private_tag = true;
-		const mdcm::PrivateDict & pdict = d.GetPrivateDict();
-		const mdcm::Tag private_creator_t = tag.GetPrivateCreator();
-		if(ds.FindDataElement(private_creator_t))
-		{
-			const mdcm::DataElement & private_creator_e =
-				ds.GetDataElement(private_creator_t);
-			if (!private_creator_e.IsEmpty() &&
-				!private_creator_e.IsUndefinedLength() &&
-				private_creator_e.GetByteValue())
-			{
-				const QString private_creator
-					= QString::fromLatin1(
-						private_creator_e.GetByteValue()->GetPointer(),
-						private_creator_e.GetByteValue()->GetLength());
-				const mdcm::PrivateTag ptag(
-					tag.GetGroup(),
-					tag.GetElement(),
-					private_creator.toLatin1().constData());
-				const mdcm::DictEntry & pentry =
-					pdict.GetDictEntry(ptag); 
-				tname = QString(pentry.GetName()).trimmed();
-				if (invalid_vr||unknown_vr) vr = pentry.GetVR();
-			}
-		}
-	}
-	else
-	{
-		const mdcm::DictEntry & entry =
-			d.GetDictEntry(tag,(const char *)NULL);
-		tname = QString(entry.GetName());
-		if (invalid_vr||unknown_vr) vr = entry.GetVR();
-	}
-	const QBrush brush0(QColor::fromRgbF(0.0,0.0,0.5));
-	const QBrush brush2(QColor::fromRgbF(0.3,0.0,0.3));
-	const QBrush brush4(QColor::fromRgbF(0.5,0.5,0.5));
-	const QBrush brush5(QColor::fromRgbF(0.4,0.4,0.7));
-	const QBrush brush6(QColor::fromRgbF(0.5,0.0,0.0));
-	const QBrush brush7(QColor::fromRgbF(0.5,0.5,0.5));
-	QString length_s("");
-	if (vr == mdcm::VR::SQ)
-	{
-		mdcm::SmartPointer<mdcm::SequenceOfItems> sqi =
-			e.GetValueAsSQ();
-		if (!(sqi && sqi->GetNumberOfItems()>0))
-		{
-			QStringList l2;
-			l2 << QString(tag.PrintAsPipeSeparatedString().c_str())
-				<< tname
-				<< QString("SQ")
-				<< QString("")
-				<< QString("[0]");
-			QTreeWidgetItem * ci = new QTreeWidgetItem(l2);
-			ci->setForeground(4, brush2); // binary
-			if (private_tag) ci->setForeground(1, brush0);
-			if (invalid_vr)  ci->setBackground(2, brush5);
-			if (unknown_vr)  ci->setBackground(2, brush4);
-			if (illegal_tag) ci->setForeground(1, brush6);
-			if (hdr)         ci->setBackground(0, brush7); // impos.
-			if (hdr)         ci->setBackground(1, brush7); // impos.
-			if (duplicated)  ci->setForeground(0, brush6);
-			wi->addChild(ci);
-			return;
-		}
-		QStringList l;
-		l << QString(tag.PrintAsPipeSeparatedString().c_str())
-			<< tname
-			<< QString("SQ")
-			<< QString("")
-			<< QString(" [")+
-				QVariant(static_cast<unsigned int>(
-					sqi->GetNumberOfItems())).toString() +
-					QString("]");
-		QTreeWidgetItem * ci = new QTreeWidgetItem(l);
-		ci->setForeground(4, brush2); // binary
-		if (invalid_vr)  ci->setBackground(2, brush5);
-		if (private_tag) ci->setForeground(1, brush0);
-		if (unknown_vr)  ci->setBackground(2, brush4);
-		if (illegal_tag) ci->setForeground(1, brush6);
-		if (hdr)         ci->setBackground(0, brush7); // impos.
-		if (hdr)         ci->setBackground(1, brush7); // impos.
-		if (duplicated)  ci->setForeground(0, brush6);
-		wi->addChild(ci);
-		for (unsigned int i = 0; i < sqi->GetNumberOfItems(); ++i)
-		{
-			QStringList l1;
-			l1 << QString("Item")
-				<< QVariant((int)(i+1)).toString()
-				<< QString("")
-				<< QString("")
-				<< QString("");
-			const mdcm::Item    & item = sqi->GetItem(i+1);
-			const mdcm::DataSet & nds  = item.GetNestedDataSet();
-			QTreeWidgetItem * cin = new QTreeWidgetItem(l1);
-			cin->setForeground(0, brush2);
-			cin->setForeground(1, brush2);
-			if (duplicated) cin->setForeground(0, brush6);
-			ci->addChild(cin);
-			mdcm::DataElement tmp_tag;
-			size_t ce = 0;
-			for (mdcm::DataSet::ConstIterator it = nds.Begin();
-				it!=nds.End();
-				++it)
-			{
-				bool duplicated_ = false;
-				const mdcm::DataElement & elem = *it;
-				if (ce > 0 && tmp_tag == elem.GetTag()) duplicated_ = true;
-				process_element(nds, elem, d, cin, charset, duplicated_);
-				tmp_tag = elem.GetTag();
-				ce++;
-			}
-		}
-	}
-	else
+	e->accept();
+}
+
+bool SQtree::get_file(const QString & f, SQtreeFile & r)
+{
+	const QFileInfo fi(f);
+	const QDateTime modified = fi.lastModified();
+	for (int x = 0; x < files_cache.size(); x++)
 	{
-		QString str_("");
-		QString entry_qs("");
-		QString keyword_qs = tname;
-		std::string entry_s = tag.PrintAsPipeSeparatedString();
-		bool bin_label = false;
-		if (!entry_s.empty()) entry_qs = QString(entry_s.c_str());
-		if (e.IsEmpty())
-		{
-			QStringList l;
-			l << entry_qs
-				<< keyword_qs
-				<< QString(mdcm::VR::GetVRString(vr))
-				<< QString("")
-				<< QString("empty");
-			QTreeWidgetItem * ii = new QTreeWidgetItem(l);
-			ii->setForeground(4, brush2); // binary
-			if (invalid_vr)  ii->setBackground(2, brush5);
-			if (unknown_vr)  ii->setBackground(2, brush4);
-			if (hdr)         ii->setBackground(0, brush7);
-			if (hdr)         ii->setBackground(1, brush7);
-			if (private_tag) ii->setForeground(1, brush0);
-			if (illegal_tag) ii->setForeground(1, brush6);
-			if (duplicated)  ii->setForeground(0, brush6);
-			wi->addChild(ii);
-		}
-		else if (e.IsUndefinedLength())
-		{
-			QStringList l;
-			l << entry_qs
-				<< keyword_qs
-				<< QString(mdcm::VR::GetVRString(vr))
-				<< QString("")
-				<< QString("undefined length");
-			QTreeWidgetItem * ii = new QTreeWidgetItem(l);
-			ii->setForeground(4, brush2); // binary
-			if (invalid_vr)  ii->setBackground(2, brush5);
-			if (unknown_vr)  ii->setBackground(2, brush4);
-			if (hdr)         ii->setBackground(0, brush7);
-			if (hdr)         ii->setBackground(1, brush7);
-			if (private_tag) ii->setForeground(1, brush0);
-			if (illegal_tag) ii->setForeground(1, brush6);
-			if (duplicated)  ii->setForeground(0, brush6);
-			wi->addChild(ii);
-		}
-		else
+		if (files_cache.at(x).name == f &&
+			files_cache.at(x).modified == modified)
 		{
-			const mdcm::ByteValue * bv = e.GetByteValue();
-			if (bv)
-			{
-				const qlonglong length =
-					static_cast<qlonglong>(bv->GetLength());
-				QString tmp1;
-				if (length > 1024*1024)
-				{
-					tmp1.sprintf(
-						"%.2f",
-						length / (1024.0*1024.0));
-					length_s = tmp1 + QString(" MB");
-				}
-				else if (length > 1024)
-				{
-					tmp1.sprintf(
-						"%.2f",
-						bv->GetLength()/1024.0);
-					length_s = tmp1 + QString(" KB");
-				}
-				else
-				{
-					length_s = QVariant(length).toString() +
-						QString(" B");
-				}
-				if (mdcm::VR::IsBinary(vr) || mdcm::VR::IsBinary2(vr))
-				{
-					bin_label = true;
-					if (vr == mdcm::VR::US)
-					{
-						std::vector<unsigned short> values;
-						get_bin_values<unsigned short, mdcm::VR::US>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(
-									(int)values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::SS)
-					{
-						std::vector<signed short> values;
-						get_bin_values<signed short, mdcm::VR::SS>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(
-									(int)values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::FL)
-					{
-						std::vector<float> values;
-						get_bin_values<float, mdcm::VR::FL>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::FD)
-					{
-						std::vector<double> values;
-						get_bin_values<double, mdcm::VR::FD>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::UL)
-					{
-						std::vector<unsigned int> values;
-						get_bin_values<unsigned int, mdcm::VR::UL>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::SL)
-					{
-						std::vector<signed int> values;
-						get_bin_values<signed int, mdcm::VR::SL>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::SV)
-					{
-						std::vector<signed long long> values;
-						get_bin_values<signed long long, mdcm::VR::SV>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::UV)
-					{
-						std::vector<unsigned long long> values;
-						get_bin_values<unsigned long long, mdcm::VR::UV>(
-							e, values);
-						for (unsigned long j = 0; j < values.size(); j++)
-						{
-							str_.append(
-								QVariant(values[j]).toString() +
-								QString(" "));
-						}
-					}
-					else if (vr == mdcm::VR::AT)
-					{
-						unsigned short group, element;
-						char group_[2]; char element_[2];
-						char * buffer = new char[4];
-						if (length==4)
-						{
-							const bool ok0 =
-								bv->GetBuffer(buffer,4);
-							if (ok0)
-							{
-								group_[0] = buffer[0];
-								group_[1] = buffer[1];
-								memcpy(&group,group_,2);
-								element_[0] = buffer[2];
-								element_[1] = buffer[3];
-								memcpy(&element,element_,2);
-								QString tmp3;
-								tmp3.sprintf("%04x",group);
-								QString tmp4;
-								tmp4.sprintf("%04x",element);
-								str_ = tmp3 + QString("|") + tmp4;
-							}
-						}
-						delete [] buffer;
-					}
-					else if (vr == mdcm::VR::OB)
-					{
-						str_ = QString("binary (OB)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::OW)
-					{
-						str_ = QString("binary (OW)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::OL)
-					{
-						str_ = QString("binary (OL)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::OD)
-					{
-						str_ = QString("binary (OD)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::OF)
-					{
-						str_ = QString("binary (OF)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::OV)
-					{
-						str_ = QString("binary (OV)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::UN)
-					{
-						str_ = QString("binary (UN)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::OB_OW)
-					{
-						str_ = QString("binary (OB or OW)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::US_SS)
-					{
-						str_ = QString("binary (US or SS)");
-						skipped = true;
-					}
-					else if (vr == mdcm::VR::US_SS_OW)
-					{
-						str_ = QString("binary (US or SS or OW)");
-						skipped = true;
-					}
-					else
-					{
-						str_ = QString("binary (unknown)");
-						skipped = true;
-					}
-					QStringList l;
-					l << entry_qs
-						<< keyword_qs
-						<< QString(mdcm::VR::GetVRString(vr))
-						<< length_s
-						<< str_;
-					QTreeWidgetItem * ii =  new QTreeWidgetItem(l);
-					if (invalid_vr)  ii->setBackground(2, brush5);
-					if (unknown_vr)  ii->setBackground(2, brush4);
-					if (bin_label)   ii->setForeground(4, brush2);
-					if (skipped)     ii->setForeground(4, brush2);
-					if (hdr)         ii->setBackground(0, brush7);
-					if (hdr)         ii->setBackground(1, brush7);
-					if (private_tag) ii->setForeground(1, brush0);
-					if (private_creator_tag) ii->setForeground(4, brush0);
-					if (illegal_tag) ii->setForeground(1, brush6);
-					if (duplicated)  ii->setForeground(0, brush6);
-					wi->addChild(ii);
-				}
-				else if (vr == mdcm::VR::INVALID || vr >= mdcm::VR::VR_END)
-				{
-					QStringList l;
-					l << entry_qs
-						<< keyword_qs
-						<< QString(mdcm::VR::GetVRString(vr)).
-							remove(QChar('\0'))
-						<< length_s
-						<< QString("unknown");
-					QTreeWidgetItem * ii =  new QTreeWidgetItem(l);
-					if (invalid_vr)  ii->setBackground(2, brush5);
-					if (unknown_vr)  ii->setBackground(2, brush4);
-					if (hdr)         ii->setBackground(0, brush7);
-					if (hdr)         ii->setBackground(1, brush7);
-					if (private_tag) ii->setForeground(1, brush0);
-					ii->setForeground(4, brush2);
-					if (private_creator_tag) ii->setForeground(4, brush0);
-					if (illegal_tag) ii->setForeground(1, brush6);
-					if (duplicated)  ii->setForeground(0, brush6);
-					wi->addChild(ii);
-				}
-				else if (vr == mdcm::VR::UI)
-				{
-					QString tmp0 = QString::fromLatin1(
-						bv->GetPointer(),
-						bv->GetLength());
-					mdcm::UIDs uid;
-					uid.SetFromUID(tmp0.toLatin1().constData());
-					const QString tmp1 =
-						QString::fromLatin1(uid.GetName());
-					QStringList l;
-					l << entry_qs
-						<< keyword_qs
-						<< QString(mdcm::VR::GetVRString(vr)).
-							remove(QChar('\0'))
-						<< length_s
-						<< ((tmp1.isEmpty())
-							? tmp0.remove(QChar('\0')) : tmp1);
-					QTreeWidgetItem * ii =  new QTreeWidgetItem(l);
-					if (!tmp1.isEmpty()) ii->setForeground(4, brush2);
-					if (invalid_vr)      ii->setBackground(2, brush5);
-					if (unknown_vr)      ii->setBackground(2, brush4);
-					if (hdr)             ii->setBackground(0, brush7);
-					if (hdr)             ii->setBackground(1, brush7);
-					if (private_tag)     ii->setForeground(1, brush0);
-					if (illegal_tag)     ii->setForeground(1, brush6);
-					if (duplicated)      ii->setForeground(0, brush6);
-					wi->addChild(ii);
-				}
-				else // ASCII
-				{
-					bool date_time = false;
-					QStringList l;
-					QString tmp0;
-					if (vr == mdcm::VR::DA)
-					{
-						const QString date_s = QString::fromLatin1(
-							bv->GetPointer(),
-							bv->GetLength()).trimmed();
-						const QDate date_ =
-							QDate::fromString(
-								date_s, QString("yyyyMMdd"));
-						tmp0 = date_.toString(
-							QString("d MMM yyyy"));
-						date_time = true;
-					}
-					else if (vr == mdcm::VR::TM)
-					{
-						const QString time0_s = QString::fromLatin1(
-							bv->GetPointer(),
-							bv->GetLength()).
-								trimmed().remove(QChar('\0'));
-						if (!time0_s.isEmpty())
-						{
-							const int point_idx =
-								time0_s.indexOf(QString("."));
-							if (point_idx == 6||point_idx == -1)
-							{
-								const QString time1_s =
-									time0_s.left(6);
-								const QDateTime time_ =
-									QDateTime::fromString(
-										time1_s,
-										QString("HHmmss"));
-								tmp0 = time_.toString(
-									QString("HH:mm:ss"));
-								if (point_idx == 6)
-								{
-									tmp0.append(QString(".") +
-										time0_s.right(
-											time0_s.length()-7));
-								}
-								date_time = true;
-							}
-							else
-							{
-								tmp0 = time0_s;
-							}
-						}
-					}
-					else if (vr == mdcm::VR::DT)
-					{
-						const QString time0_s = QString::fromLatin1(
-							bv->GetPointer(),
-							bv->GetLength()).
-								trimmed().remove(QChar('\0'));
-						if (!time0_s.isEmpty())
-						{
-							const int point_idx =
-								time0_s.indexOf(QString("."));
-							if (point_idx == 14||point_idx == -1)
-							{
-								const QString time1_s =
-									time0_s.left(14);
-								const QDateTime time_ =
-									QDateTime::fromString(
-										time1_s,
-										QString("yyyyMMddHHmmss"));
-								tmp0 = time_.toString(
-									QString("d MMM yyyy HH:mm:ss"));
-								if (point_idx == 14)
-								{
-									tmp0.append(QString(".") +
-										time0_s.right(
-											time0_s.length()-15));
-								}
-								date_time = true;
-							}
-							else
-							{
-								tmp0 = time0_s;
-							}
-						}
-					}
-					else
-					{
-						if (
-							vr==mdcm::VR::LO ||
-							vr==mdcm::VR::LT ||
-							vr==mdcm::VR::PN ||
-							vr==mdcm::VR::SH ||
-							vr==mdcm::VR::ST ||
-							vr==mdcm::VR::UT)
-						{
-							QByteArray ba(
-								bv->GetPointer(),
-								bv->GetLength());
-							tmp0 = CodecUtils::toUTF8(&ba, charset);
-							ba.clear();
-						}
-						else
-						{
-							if (tag == mdcm::Tag(0x3006,0x0050))
-							{
-								tmp0 = QString(
-									"<skipped, save to file>");
-								skipped = true;
-							}
-							else
-							{
-								tmp0 = QString::fromLatin1(
-									bv->GetPointer(),
-									bv->GetLength());
-							}
-						}
-						tmp0 = tmp0.remove(QChar('\0'));
-					}
-					if (tmp0.length() > 1024)
-					{
-						tmp0.truncate(16);
-						tmp0.append(QString("<skipped, save to file>"));
-						skipped = true;
-					}
-					l << entry_qs
-						<< keyword_qs
-						<< QString(mdcm::VR::GetVRString(vr)).
-								remove(QChar('\0'))
-						<< length_s
-						<< tmp0;
-					QTreeWidgetItem * ii =  new QTreeWidgetItem(l);
-					if (invalid_vr)  ii->setBackground(2, brush5);
-					if (unknown_vr)  ii->setBackground(2, brush4);
-					if (hdr)         ii->setBackground(0, brush7);
-					if (hdr)         ii->setBackground(1, brush7);
-					if (private_tag) ii->setForeground(1, brush0);
-					if (date_time)   ii->setForeground(4, brush2);
-					if (skipped)     ii->setForeground(4, brush2);
-					if (private_creator_tag) ii->setForeground(4, brush0);
-					if (illegal_tag) ii->setForeground(1, brush6);
-					if (duplicated)  ii->setForeground(0, brush6);
-					wi->addChild(ii);
-				}
-			}
-			else
-			{
-				QStringList l;
-				l << entry_qs
-					<< keyword_qs
-					<< QString(mdcm::VR::GetVRString(vr))
-					<< QString("")
-					<< QString("NULL");
-				QTreeWidgetItem * ii = new QTreeWidgetItem(l);
-				ii->setForeground(4, brush2);
-				if (invalid_vr)  ii->setBackground(2, brush5);
-				if (unknown_vr)  ii->setBackground(2, brush4);
-				if (hdr)         ii->setBackground(0, brush7);
-				if (hdr)         ii->setBackground(1, brush7);
-				if (private_tag) ii->setForeground(1, brush0);
-				if (illegal_tag) ii->setForeground(1, brush6);
-				if (duplicated)  ii->setForeground(0, brush6);
-				wi->addChild(ii);
-			}
+			r = files_cache.at(x);
+			if (x > 0) files_cache.move(x, 0);
+			return true;
 		}
 	}
-}
-
-void SQtree::closeEvent(QCloseEvent * e)
-{
-	e->accept();
+	mdcm::SmartPointer<mdcm::File> file = new mdcm::File;
+	mdcm::Reader reader;
+	reader.SetFile(*file);
+	reader.SetFileName(f.toLocal8Bit().constData());
+	// Pixel data are not shown, stop reading before them,
+	// with enhanced multi-frame objects they are most of the file.
+	std::set<mdcm::Tag> skip;
+	skip.insert(mdcm::Tag(0x7fe0,0x0008));
+	skip.insert(mdcm::Tag(0x7fe0,0x0009));
+	skip.insert(mdcm::Tag(0x7fe0,0x0010));
+	if (!reader.ReadUpToTag(mdcm::Tag(0x7fe0,0x0010), skip)) return false;
+	const size_t pos = reader.GetStreamCurrentPosition();
+	r.name = f;
+	r.modified = modified;
+	r.file = file;
+	r.pixel_data_skipped = (pos < static_cast<size_t>(fi.size()));
+	files_cache.prepend(r);
+	while (files_cache.size() > 16) files_cache.removeLast();
+	return true;
 }
 
 void SQtree::read_file(const QString & f)
@@ -809,36 +183,43 @@ void SQtree::read_file(const QString & f)
 	saved_dir =
 		QDir::toNativeSeparators(fi.absoluteDir().absolutePath());
 	lineEdit->setText(QDir::toNativeSeparators(f));
-	QStringList l;
-	l << QString("") << QString("") <<
-		QString("") << QString("") << QString("");
-	QTreeWidgetItem * i = new QTreeWidgetItem(l);
-	treeWidget->addTopLevelItem(i);
+	SQtreeFile sf;
+	if (!get_file(f, sf))
 	{
-		mdcm::Reader reader;
-		const mdcm::File & file = reader.GetFile();
-		bool ok = false;
-		reader.SetFileName(f.toLocal8Bit().constData());
-		ok = reader.Read();
-		if (!ok)
+		ms_lineEdit->setText(
+			QString("Error: file is not DICOM or broken."));
+		QApplication::restoreOverrideCursor();
+		return;
+	}
+	const mdcm::DataSet & ds = sf.file->GetDataSet();
+	const mdcm::FileMetaInformation & header = sf.file->GetHeader();
+	//
+	QString tmp1("");
+	QString ms0_ = QString::fromStdString(
+		header.GetMediaStorageAsString());
+	if (!ms0_.isEmpty())
+	{
+		mdcm::UIDs uid;
+		uid.SetFromUID(ms0_.toLatin1().constData());
+		const QString ms1_ = QString::fromLatin1(uid.GetName());
+		if (!ms1_.isEmpty())
 		{
-			ms_lineEdit->setText(
-				QString("Error: file is not DICOM or broken."));
-			QApplication::restoreOverrideCursor();
-			return;
+			tmp1 = ms1_;
 		}
-		mdcm::Global & g = mdcm::Global::GetInstance();
-		const mdcm::Dicts & dicts = g.GetDicts();
-		const mdcm::DataSet & ds = file.GetDataSet();
-		const mdcm::FileMetaInformation & header = file.GetHeader();
-		//
-		QString tmp1("");
-		QString ms0_ = QString::fromStdString(
-			header.GetMediaStorageAsString());
-		if (!ms0_.isEmpty())
+		else
+		{
+			const QString ms2_ = QString::fromLatin1(uid.GetString());
+			tmp1 = ms2_;
+		}
+	}
+	else
+	{
+		QString tmp0;
+		if (DicomUtils::get_string_value(
+				ds, mdcm::Tag(0x0008, 0x0016), tmp0))
 		{
 			mdcm::UIDs uid;
-			uid.SetFromUID(ms0_.toLatin1().constData());
+			uid.SetFromUID(tmp0.toLatin1().constData());
 			const QString ms1_ = QString::fromLatin1(uid.GetName());
 			if (!ms1_.isEmpty())
 			{
@@ -850,77 +231,22 @@ void SQtree::read_file(const QString & f)
 				tmp1 = ms2_;
 			}
 		}
-		else
-		{
-			QString tmp0;
-			if (DicomUtils::get_string_value(
-					ds, mdcm::Tag(0x0008, 0x0016), tmp0))
-			{
-				mdcm::UIDs uid;
-				uid.SetFromUID(tmp0.toLatin1().constData());
-				const QString ms1_ = QString::fromLatin1(uid.GetName());
-				if (!ms1_.isEmpty())
-				{
-					tmp1 = ms1_;
-				}
-				else
-				{
-					const QString ms2_ = QString::fromLatin1(uid.GetString());
-					tmp1 = ms2_;
-				}
-			}
-		}
-		ms_lineEdit->setText(tmp1);
-		//
-		const mdcm::TransferSyntax & ts =
-			header.GetDataSetTransferSyntax();
-		mdcm::UIDs uid;
-		uid.SetFromUID(ts.GetString());
-		const QString ts_string = QString::fromLatin1(uid.GetName());
-		ts_lineEdit->setText(ts_string);
-		//
-		for (
-			mdcm::FileMetaInformation::ConstIterator it = header.Begin();
-			it!=header.End();
-			++it)
-		{
-			const mdcm::DataElement & elem = *it;
-			process_element(ds /* unused */, elem, dicts, i, "");
-		}
-		QString charset("");
-		if (ds.FindDataElement(mdcm::Tag(0x0008,0x0005)))
-		{
-			const mdcm::DataElement & ce_ =
-				ds.GetDataElement(mdcm::Tag(0x0008,0x0005));
-			if (!ce_.IsEmpty() &&
-				!ce_.IsUndefinedLength() &&
-				ce_.GetByteValue())
-			{
-				charset = QString::fromLatin1(
-					ce_.GetByteValue()->GetPointer(),
-					ce_.GetByteValue()->GetLength());
-			}
-		}
-		dump_csa(ds);
-		mdcm::Tag tmp_tag;
-		size_t ce = 0;
-		for (mdcm::DataSet::ConstIterator it = ds.Begin();
-			it!=ds.End();
-			++it)
-		{
-			bool duplicated = false;
-			const mdcm::DataElement & elem = *it;
-			if (ce > 0 && tmp_tag == elem.GetTag()) duplicated = true;
-			process_element(
-				ds, elem, dicts, i, charset.toLatin1().constData(), duplicated);
-			tmp_tag = elem.GetTag();
-			ce++;
-		}
 	}
-	treeWidget->expandToDepth(0);
+	ms_lineEdit->setText(tmp1);
+	//
+	const mdcm::TransferSyntax & ts =
+		header.GetDataSetTransferSyntax();
+	mdcm::UIDs uid;
+	uid.SetFromUID(ts.GetString());
+	const QString ts_string = QString::fromLatin1(uid.GetName());
+	ts_lineEdit->setText(ts_string);
+	//
+	dump_csa(ds);
+	// Rows are created and formatted by the model when shown
+	model->set_file(sf);
+	treeView->expandToDepth(0);
 	QApplication::restoreOverrideCursor();
 }
-
 void SQtree::dump_csa(const mdcm::DataSet & ds)
 {
 	mdcm::CSAHeader csa1, csa2;
@@ -968,12 +294,11 @@ void SQtree::dump_csa(const mdcm::DataSet & ds)
 
 void SQtree::copy_to_clipboard()
 {
-	const QTreeWidgetItem * item =
-		treeWidget->currentItem();
-	if (item && QApplication::clipboard())
+	const QModelIndex index = treeView->currentIndex();
+	if (index.isValid() && QApplication::clipboard())
 	{
 		QApplication::clipboard()->setText(
-			item->text(treeWidget->currentColumn()));
+			index.data().toString());
 	}
 }
 
@@ -984,9 +309,9 @@ void SQtree::collapse_item()
 	if (!lock) return;
 #endif
 	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-	treeWidget->blockSignals(true);
-	collapse_children(treeWidget->currentIndex());
-	treeWidget->blockSignals(false);
+	treeView->blockSignals(true);
+	collapse_children(treeView->currentIndex());
+	treeView->blockSignals(false);
 	QApplication::restoreOverrideCursor();
 #if (defined SQTREE_LOCK_TREE && SQTREE_LOCK_TREE==1)
 	mutex.unlock();
@@ -1001,10 +326,10 @@ void SQtree::expand_item()
 	if (!lock) return;
 #endif
 	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-	treeWidget->blockSignals(true);
+	treeView->blockSignals(true);
 	expanded_items = 0;
-	expand_children(treeWidget->currentIndex());
-	treeWidget->blockSignals(false);
+	expand_children(treeView->currentIndex());
+	treeView->blockSignals(false);
 	QApplication::restoreOverrideCursor();
 #if (defined SQTREE_LOCK_TREE && SQTREE_LOCK_TREE==1)
 	mutex.unlock();
@@ -1014,21 +339,22 @@ void SQtree::expand_item()
 void SQtree::expand_children(const QModelIndex & index)
 {
 	if (!index.isValid()) return;
+	if (model->canFetchMore(index)) model->fetchMore(index);
 	for (int i = 0; i < index.model()->rowCount(index); i++)
 	{
 		expanded_items++;
 	if (expanded_items > 65000) break;
 	    expand_children(index.child(i, 0));
 	}
-	if (!treeWidget->isExpanded(index))
-		treeWidget->expand(index);
+	if (!treeView->isExpanded(index))
+		treeView->expand(index);
 }
 
 void SQtree::collapse_children(const QModelIndex & index)
 {
 	if (!index.isValid()) return;
-	if (treeWidget->isExpanded(index))
-		treeWidget->collapse(index);
+	if (treeView->isExpanded(index))
+		treeView->collapse(index);
 	for (int i = 0; i < index.model()->rowCount(index); i++)
 	{
 	    collapse_children(index.child(i, 0));
@@ -1090,7 +416,7 @@ void SQtree::clear_tree()
 	lineEdit->clear();
 	ms_lineEdit->clear();
 	ts_lineEdit->clear();
-	treeWidget->clear();
+	model->clear_file();
 	if (textEdit->document())
 		textEdit->document()->clear();
 	textEdit->clear();
@@ -3,9 +3,8 @@
 
 #include "ui_sqtree.h"
 #include <QWidget>
-#include <QTreeWidget>
-#include <QTreeWidgetItem>
 #include <QStringList>
+#include <QList>
 #include <QMutex>
 #include <QCloseEvent>
 #include <QDropEvent>
@@ -17,6 +16,7 @@
 #include <mdcmDataSet.h>
 #include <mdcmDataElement.h>
 #include <mdcmDicts.h>
+#include "sqtreemodel.h"
 
 #define SQTREE_LOCK_TREE 1
 
@@ -47,13 +47,7 @@ protected:
 	void dragLeaveEvent(QDragLeaveEvent*);
 
 private:
-	void process_element(
-		const mdcm::DataSet&,
-		const mdcm::DataElement&,
-		const mdcm::Dicts&,
-		QTreeWidgetItem*,
-		const char*,
-		const bool=false);
+	bool get_file(const QString&, SQtreeFile&);
 	void dump_csa(const mdcm::DataSet&);
 	void expand_children(const QModelIndex&);
 	void collapse_children(const QModelIndex&);
@@ -65,6 +59,10 @@ private:
 	QAction * expandAct;
 	bool skip_settings_pos;
 	QStringList list_of_files;
+	SQtreeModel * model;
+	// recently parsed files, scrolling a series back and forth
+	// does not read them again
+	QList<SQtreeFile> files_cache;
 #if (defined SQTREE_LOCK_TREE && SQTREE_LOCK_TREE==1)
 	QMutex mutex;
 #endif
@@ -0,0 +1,660 @@
+#include "sqtreemodel.h"
+#include <mdcmGlobal.h>
+#include <mdcmDicts.h>
+#include <mdcmPrivateTag.h>
+#include <mdcmElement.h>
+#include <mdcmByteValue.h>
+#include <mdcmItem.h>
+#include <mdcmVR.h>
+#include <mdcmVM.h>
+#include <mdcmUIDs.h>
+#include <QBrush>
+#include <QDate>
+#include <QDateTime>
+#include <QStringList>
+#include <cstring>
+#include "codecutils.h"
+
+template <typename T, typename TQ, long long TVR>
+void append_bin_values(
+	const mdcm::DataElement & v,
+	QString & s)
+{
+	if (v.IsEmpty() ||
+		v.IsUndefinedLength())
+		return;
+	const mdcm::ByteValue * bv = v.GetByteValue();
+	if (!bv) return;
+	if ((bv->GetLength() < sizeof(T)) ||
+		((bv->GetLength() % sizeof(T)) != 0))
+		return;
+	mdcm::Element<TVR, mdcm::VM::VM1_n> e;
+	e.SetFromDataElement(v);
+	for (unsigned long x = 0; x < e.GetLength(); x++)
+	{
+		s.append(
+			QVariant(static_cast<TQ>(e.GetValue(x))).toString() +
+			QString(" "));
+	}
+}
+
+static const QColor color0 = QColor::fromRgbF(0.0,0.0,0.5);
+static const QColor color2 = QColor::fromRgbF(0.3,0.0,0.3);
+static const QColor color4 = QColor::fromRgbF(0.5,0.5,0.5);
+static const QColor color5 = QColor::fromRgbF(0.4,0.4,0.7);
+static const QColor color6 = QColor::fromRgbF(0.5,0.0,0.0);
+static const QColor color7 = QColor::fromRgbF(0.5,0.5,0.5);
+
+static QString format_length(const qlonglong length)
+{
+	QString tmp1;
+	if (length > 1024*1024)
+	{
+		tmp1.sprintf("%.2f", length / (1024.0*1024.0));
+		return tmp1 + QString(" MB");
+	}
+	else if (length > 1024)
+	{
+		tmp1.sprintf("%.2f", length / 1024.0);
+		return tmp1 + QString(" KB");
+	}
+	return QVariant(length).toString() + QString(" B");
+}
+
+static QString format_ascii(
+	const mdcm::Tag & tag,
+	const mdcm::VR & vr,
+	const mdcm::ByteValue * bv,
+	const char * charset,
+	bool & date_time,
+	bool & skipped)
+{
+	QString tmp0;
+	if (vr == mdcm::VR::DA)
+	{
+		const QString date_s = QString::fromLatin1(
+			bv->GetPointer(),
+			bv->GetLength()).trimmed();
+		const QDate date_ =
+			QDate::fromString(date_s, QString("yyyyMMdd"));
+		tmp0 = date_.toString(QString("d MMM yyyy"));
+		date_time = true;
+	}
+	else if (vr == mdcm::VR::TM)
+	{
+		const QString time0_s = QString::fromLatin1(
+			bv->GetPointer(),
+			bv->GetLength()).trimmed().remove(QChar('\0'));
+		if (!time0_s.isEmpty())
+		{
+			const int point_idx = time0_s.indexOf(QString("."));
+			if (point_idx == 6||point_idx == -1)
+			{
+				const QString time1_s = time0_s.left(6);
+				const QDateTime time_ =
+					QDateTime::fromString(time1_s, QString("HHmmss"));
+				tmp0 = time_.toString(QString("HH:mm:ss"));
+				if (point_idx == 6)
+				{
+					tmp0.append(QString(".") +
+						time0_s.right(time0_s.length()-7));
+				}
+				date_time = true;
+			}
+			else
+			{
+				tmp0 = time0_s;
+			}
+		}
+	}
+	else if (vr == mdcm::VR::DT)
+	{
+		const QString time0_s = QString::fromLatin1(
+			bv->GetPointer(),
+			bv->GetLength()).trimmed().remove(QChar('\0'));
+		if (!time0_s.isEmpty())
+		{
+			const int point_idx = time0_s.indexOf(QString("."));
+			if (point_idx == 14||point_idx == -1)
+			{
+				const QString time1_s = time0_s.left(14);
+				const QDateTime time_ =
+					QDateTime::fromString(
+						time1_s, QString("yyyyMMddHHmmss"));
+				tmp0 = time_.toString(QString("d MMM yyyy HH:mm:ss"));
+				if (point_idx == 14)
+				{
+					tmp0.append(QString(".") +
+						time0_s.right(time0_s.length()-15));
+				}
+				date_time = true;
+			}
+			else
+			{
+				tmp0 = time0_s;
+			}
+		}
+	}
+	else
+	{
+		if (
+			vr==mdcm::VR::LO ||
+			vr==mdcm::VR::LT ||
+			vr==mdcm::VR::PN ||
+			vr==mdcm::VR::SH ||
+			vr==mdcm::VR::ST ||
+			vr==mdcm::VR::UT)
+		{
+			QByteArray ba(bv->GetPointer(), bv->GetLength());
+			tmp0 = CodecUtils::toUTF8(&ba, charset);
+			ba.clear();
+		}
+		else
+		{
+			if (tag == mdcm::Tag(0x3006,0x0050))
+			{
+				tmp0 = QString("<skipped, save to file>");
+				skipped = true;
+			}
+			else
+			{
+				tmp0 = QString::fromLatin1(
+					bv->GetPointer(),
+					bv->GetLength());
+			}
+		}
+		tmp0 = tmp0.remove(QChar('\0'));
+	}
+	if (tmp0.length() > 1024)
+	{
+		tmp0.truncate(16);
+		tmp0.append(QString("<skipped, save to file>"));
+		skipped = true;
+	}
+	return tmp0;
+}
+
+static QString format_binary(
+	const mdcm::DataElement & e,
+	const mdcm::VR & vr,
+	const mdcm::ByteValue * bv)
+{
+	QString str_("");
+	if (vr == mdcm::VR::US)
+	{
+		append_bin_values<unsigned short, int, mdcm::VR::US>(e, str_);
+	}
+	else if (vr == mdcm::VR::SS)
+	{
+		append_bin_values<signed short, int, mdcm::VR::SS>(e, str_);
+	}
+	else if (vr == mdcm::VR::FL)
+	{
+		append_bin_values<float, float, mdcm::VR::FL>(e, str_);
+	}
+	else if (vr == mdcm::VR::FD)
+	{
+		append_bin_values<double, double, mdcm::VR::FD>(e, str_);
+	}
+	else if (vr == mdcm::VR::UL)
+	{
+		append_bin_values<unsigned int, unsigned int, mdcm::VR::UL>(e, str_);
+	}
+	else if (vr == mdcm::VR::SL)
+	{
+		append_bin_values<signed int, signed int, mdcm::VR::SL>(e, str_);
+	}
+	else if (vr == mdcm::VR::SV)
+	{
+		append_bin_values<signed long long, qlonglong, mdcm::VR::SV>(e, str_);
+	}
+	else if (vr == mdcm::VR::UV)
+	{
+		append_bin_values<unsigned long long, qulonglong, mdcm::VR::UV>(e, str_);
+	}
+	else if (vr == mdcm::VR::AT)
+	{
+		if (bv->GetLength() == 4)
+		{
+			char buffer[4];
+			if (bv->GetBuffer(buffer, 4))
+			{
+				unsigned short group, element;
+				memcpy(&group,   &buffer[0], 2);
+				memcpy(&element, &buffer[2], 2);
+				QString tmp3;
+				tmp3.sprintf("%04x",group);
+				QString tmp4;
+				tmp4.sprintf("%04x",element);
+				str_ = tmp3 + QString("|") + tmp4;
+			}
+		}
+	}
+	else if (vr == mdcm::VR::OB)       str_ = QString("binary (OB)");
+	else if (vr == mdcm::VR::OW)       str_ = QString("binary (OW)");
+	else if (vr == mdcm::VR::OL)       str_ = QString("binary (OL)");
+	else if (vr == mdcm::VR::OD)       str_ = QString("binary (OD)");
+	else if (vr == mdcm::VR::OF)       str_ = QString("binary (OF)");
+	else if (vr == mdcm::VR::OV)       str_ = QString("binary (OV)");
+	else if (vr == mdcm::VR::UN)       str_ = QString("binary (UN)");
+	else if (vr == mdcm::VR::OB_OW)    str_ = QString("binary (OB or OW)");
+	else if (vr == mdcm::VR::US_SS)    str_ = QString("binary (US or SS)");
+	else if (vr == mdcm::VR::US_SS_OW) str_ = QString("binary (US or SS or OW)");
+	else                               str_ = QString("binary (unknown)");
+	return str_;
+}
+
+static void format_element(
+	const mdcm::DataSet & ds,
+	const mdcm::DataElement & e,
+	const mdcm::Dicts & d,
+	const char * charset,
+	SQtreeNode * n)
+{
+	const mdcm::Tag & tag = e.GetTag();
+	QString tname("");
+	bool invalid_vr          = false;
+	bool unknown_vr          = false;
+	bool private_tag         = false;
+	bool private_creator_tag = false;
+	bool illegal_tag         = false;
+	bool hdr                 = false;
+	if (tag.GetGroup() == 0x0002) hdr = true;
+	mdcm::VR vr = e.GetVR();
+	if (vr == mdcm::VR::INVALID) invalid_vr = true;
+	if (vr == mdcm::VR::UN)      unknown_vr = true;
+	if (tag.IsIllegal())
+	{
+		illegal_tag = true;
+		tname = QString("Illegal Tag");
+	}
+	else if (tag.IsPrivateCreator())
+	{
+		private_creator_tag = true;
+		tname = QString("Private Creator");
+		if (invalid_vr||unknown_vr)
+		{
+			const mdcm::DictEntry & entry =
+				d.GetDictEntry(tag,(const char *)NULL);
+			vr = entry.GetVR();
+		}
+	}
+	else if (tag.IsPrivate())
+	{
+		private_tag = true;
+		const mdcm::PrivateDict & pdict = d.GetPrivateDict();
+		const mdcm::Tag private_creator_t = tag.GetPrivateCreator();
+		if(ds.FindDataElement(private_creator_t))
+		{
+			const mdcm::DataElement & private_creator_e =
+				ds.GetDataElement(private_creator_t);
+			if (!private_creator_e.IsEmpty() &&
+				!private_creator_e.IsUndefinedLength() &&
+				private_creator_e.GetByteValue())
+			{
+				const QString private_creator
+					= QString::fromLatin1(
+						private_creator_e.GetByteValue()->GetPointer(),
+						private_creator_e.GetByteValue()->GetLength());
+				const mdcm::PrivateTag ptag(
+					tag.GetGroup(),
+					tag.GetElement(),
+					private_creator.toLatin1().constData());
+				const mdcm::DictEntry & pentry =
+					pdict.GetDictEntry(ptag);
+				tname = QString(pentry.GetName()).trimmed();
+				if (invalid_vr||unknown_vr) vr = pentry.GetVR();
+			}
+		}
+	}
+	else
+	{
+		const mdcm::DictEntry & entry =
+			d.GetDictEntry(tag,(const char *)NULL);
+		tname = QString(entry.GetName());
+		if (invalid_vr||unknown_vr) vr = entry.GetVR();
+	}
+	n->text[0] = QString(tag.PrintAsPipeSeparatedString().c_str());
+	n->text[1] = tname;
+	n->text[2] = QString(mdcm::VR::GetVRString(vr)).remove(QChar('\0'));
+	if (vr == mdcm::VR::SQ)
+	{
+		// Only the item count is needed here, items are
+		// created when the row is expanded.
+		n->sq = e.GetValueAsSQ();
+		const unsigned int items =
+			(n->sq) ? static_cast<unsigned int>(n->sq->GetNumberOfItems()) : 0;
+		n->text[2] = QString("SQ");
+		n->text[4] = (items > 0)
+			? QString(" [") + QVariant(items).toString() + QString("]")
+			: QString("[0]");
+		n->fg[4] = color2;
+	}
+	else if (e.IsEmpty())
+	{
+		n->text[4] = QString("empty");
+		n->fg[4] = color2;
+	}
+	else if (e.IsUndefinedLength())
+	{
+		n->text[4] = QString("undefined length");
+		n->fg[4] = color2;
+	}
+	else
+	{
+		const mdcm::ByteValue * bv = e.GetByteValue();
+		if (!bv)
+		{
+			n->text[4] = QString("NULL");
+			n->fg[4] = color2;
+		}
+		else
+		{
+			n->text[3] =
+				format_length(static_cast<qlonglong>(bv->GetLength()));
+			if (mdcm::VR::IsBinary(vr) || mdcm::VR::IsBinary2(vr))
+			{
+				n->text[4] = format_binary(e, vr, bv);
+				n->fg[4] = private_creator_tag ? color0 : color2;
+			}
+			else if (vr == mdcm::VR::INVALID || vr >= mdcm::VR::VR_END)
+			{
+				n->text[4] = QString("unknown");
+				n->fg[4] = private_creator_tag ? color0 : color2;
+			}
+			else if (vr == mdcm::VR::UI)
+			{
+				QString tmp0 = QString::fromLatin1(
+					bv->GetPointer(),
+					bv->GetLength());
+				mdcm::UIDs uid;
+				uid.SetFromUID(tmp0.toLatin1().constData());
+				const QString tmp1 = QString::fromLatin1(uid.GetName());
+				if (tmp1.isEmpty())
+				{
+					n->text[4] = tmp0.remove(QChar('\0'));
+				}
+				else
+				{
+					n->text[4] = tmp1;
+					n->fg[4] = color2;
+				}
+			}
+			else // ASCII
+			{
+				bool date_time = false;
+				bool skipped   = false;
+				n->text[4] = format_ascii(
+					tag, vr, bv, charset, date_time, skipped);
+				if (date_time||skipped)   n->fg[4] = color2;
+				if (private_creator_tag)  n->fg[4] = color0;
+			}
+		}
+	}
+	if (invalid_vr)    n->bg[2] = color5;
+	if (unknown_vr)    n->bg[2] = color4;
+	if (hdr)           n->bg[0] = color7;
+	if (hdr)           n->bg[1] = color7;
+	if (private_tag)   n->fg[1] = color0;
+	if (illegal_tag)   n->fg[1] = color6;
+	if (n->duplicated) n->fg[0] = color6;
+}
+
+static int count_children(const SQtreeNode * n)
+{
+	if (n->item > 0)
+	{
+		return (n->ds) ? static_cast<int>(n->ds->Size()) : 0;
+	}
+	if (n->sq)
+	{
+		return static_cast<int>(n->sq->GetNumberOfItems());
+	}
+	return 0;
+}
+
+SQtreeModel::SQtreeModel(QObject * p) : QAbstractItemModel(p)
+{
+	root = new SQtreeNode(NULL, 0);
+	root->fetched   = true;
+	root->formatted = true;
+}
+
+SQtreeModel::~SQtreeModel()
+{
+	delete root;
+}
+
+void SQtreeModel::set_file(const SQtreeFile & f)
+{
+	beginResetModel();
+	delete root;
+	root = new SQtreeNode(NULL, 0);
+	root->fetched   = true;
+	root->formatted = true;
+	current = f;
+	charset.clear();
+	if (!current.file)
+	{
+		endResetModel();
+		return;
+	}
+	const mdcm::FileMetaInformation & header = current.file->GetHeader();
+	const mdcm::DataSet & ds = current.file->GetDataSet();
+	if (ds.FindDataElement(mdcm::Tag(0x0008,0x0005)))
+	{
+		const mdcm::DataElement & ce_ =
+			ds.GetDataElement(mdcm::Tag(0x0008,0x0005));
+		if (!ce_.IsEmpty() &&
+			!ce_.IsUndefinedLength() &&
+			ce_.GetByteValue())
+		{
+			charset = QByteArray(
+				ce_.GetByteValue()->GetPointer(),
+				ce_.GetByteValue()->GetLength());
+		}
+	}
+	SQtreeNode * top = new SQtreeNode(root, 0);
+	top->fetched   = true;
+	top->formatted = true;
+	root->children.push_back(top);
+	add_children(top, header);
+	add_children(top, ds);
+	if (current.pixel_data_skipped)
+	{
+		SQtreeNode * n = new SQtreeNode(top, top->children.size());
+		n->fetched   = true;
+		n->formatted = true;
+		n->text[0] = QString("7fe0|0010");
+		n->text[1] = QString("Pixel Data");
+		n->text[4] = QString("<skipped>");
+		n->fg[4] = color2;
+		top->children.push_back(n);
+	}
+	endResetModel();
+}
+
+void SQtreeModel::clear_file()
+{
+	set_file(SQtreeFile());
+}
+
+SQtreeNode * SQtreeModel::node_from_index(const QModelIndex & i) const
+{
+	if (!i.isValid()) return root;
+	return static_cast<SQtreeNode*>(i.internalPointer());
+}
+
+void SQtreeModel::add_children(
+	SQtreeNode * n, const mdcm::DataSet & ds) const
+{
+	mdcm::Tag tmp_tag;
+	size_t ce = 0;
+	for (mdcm::DataSet::ConstIterator it = ds.Begin();
+		it!=ds.End();
+		++it)
+	{
+		const mdcm::DataElement & elem = *it;
+		SQtreeNode * c = new SQtreeNode(n, n->children.size());
+		c->ds = &ds;
+		c->de = &elem;
+		if (ce > 0 && tmp_tag == elem.GetTag()) c->duplicated = true;
+		n->children.push_back(c);
+		tmp_tag = elem.GetTag();
+		ce++;
+	}
+}
+
+void SQtreeModel::populate(SQtreeNode * n) const
+{
+	if (n->item > 0)
+	{
+		if (n->ds) add_children(n, *(n->ds));
+	}
+	else if (n->sq)
+	{
+		const unsigned int items =
+			static_cast<unsigned int>(n->sq->GetNumberOfItems());
+		for (unsigned int i = 0; i < items; ++i)
+		{
+			const mdcm::Item & item = n->sq->GetItem(i+1);
+			SQtreeNode * c = new SQtreeNode(n, i);
+			c->ds = &(item.GetNestedDataSet());
+			c->item = i + 1;
+			c->duplicated = n->duplicated;
+			n->children.push_back(c);
+		}
+	}
+	n->fetched = true;
+}
+
+void SQtreeModel::format_node(SQtreeNode * n) const
+{
+	if (n->formatted) return;
+	n->formatted = true;
+	if (n->item > 0)
+	{
+		n->text[0] = QString("Item");
+		n->text[1] = QVariant(static_cast<int>(n->item)).toString();
+		n->fg[0] = n->duplicated ? color6 : color2;
+		n->fg[1] = color2;
+	}
+	else if (n->de && n->ds)
+	{
+		mdcm::Global & g = mdcm::Global::GetInstance();
+		const mdcm::Dicts & dicts = g.GetDicts();
+		const bool hdr = (n->de->GetTag().GetGroup() == 0x0002);
+		format_element(
+			*(n->ds), *(n->de), dicts,
+			(hdr ? "" : charset.constData()),
+			n);
+	}
+}
+
+QModelIndex SQtreeModel::index(
+	int row, int column, const QModelIndex & p) const
+{
+	if (!hasIndex(row, column, p)) return QModelIndex();
+	SQtreeNode * n = node_from_index(p);
+	if (row >= n->children.size()) return QModelIndex();
+	return createIndex(row, column, n->children.at(row));
+}
+
+QModelIndex SQtreeModel::parent(const QModelIndex & i) const
+{
+	if (!i.isValid()) return QModelIndex();
+	SQtreeNode * n = static_cast<SQtreeNode*>(i.internalPointer());
+	SQtreeNode * p = n->parent;
+	if (!p || p == root) return QModelIndex();
+	return createIndex(p->row, 0, p);
+}
+
+int SQtreeModel::rowCount(const QModelIndex & p) const
+{
+	if (p.column() > 0) return 0;
+	return node_from_index(p)->children.size();
+}
+
+int SQtreeModel::columnCount(const QModelIndex &) const
+{
+	return 5;
+}
+
+QVariant SQtreeModel::data(const QModelIndex & i, int role) const
+{
+	if (!i.isValid()) return QVariant();
+	const int c = i.column();
+	if (c < 0 || c > 4) return QVariant();
+	SQtreeNode * n = static_cast<SQtreeNode*>(i.internalPointer());
+	format_node(n);
+	switch (role)
+	{
+	case Qt::DisplayRole:
+		return QVariant(n->text[c]);
+	case Qt::ForegroundRole:
+		if (n->fg[c].isValid()) return QVariant(QBrush(n->fg[c]));
+		break;
+	case Qt::BackgroundRole:
+		if (n->bg[c].isValid()) return QVariant(QBrush(n->bg[c]));
+		break;
+	default:
+		break;
+	}
+	return QVariant();
+}
+
+QVariant SQtreeModel::headerData(
+	int section, Qt::Orientation o, int role) const
+{
+	if (o != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+	switch (section)
+	{
+	case 0: return QVariant(QString("Tag"));
+	case 1: return QVariant(QString("Description"));
+	case 2: return QVariant(QString("VR"));
+	case 3: return QVariant(QString("Size"));
+	case 4: return QVariant(QString("Value"));
+	default: break;
+	}
+	return QVariant();
+}
+
+Qt::ItemFlags SQtreeModel::flags(const QModelIndex & i) const
+{
+	if (!i.isValid()) return Qt::NoItemFlags;
+	return Qt::ItemIsEnabled|Qt::ItemIsSelectable;
+}
+
+bool SQtreeModel::hasChildren(const QModelIndex & p) const
+{
+	if (p.column() > 0) return false;
+	SQtreeNode * n = node_from_index(p);
+	if (n->fetched) return !n->children.empty();
+	format_node(n);
+	return (count_children(n) > 0);
+}
+
+bool SQtreeModel::canFetchMore(const QModelIndex & p) const
+{
+	if (p.column() > 0) return false;
+	SQtreeNode * n = node_from_index(p);
+	if (n->fetched) return false;
+	format_node(n);
+	return (count_children(n) > 0);
+}
+
+void SQtreeModel::fetchMore(const QModelIndex & p)
+{
+	SQtreeNode * n = node_from_index(p);
+	if (n->fetched) return;
+	format_node(n);
+	const int count = count_children(n);
+	if (count < 1)
+	{
+		n->fetched = true;
+		return;
+	}
+	beginInsertRows(p, 0, count - 1);
+	populate(n);
+	endInsertRows();
+}
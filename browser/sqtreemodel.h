@@ -0,0 +1,90 @@
+#ifndef SQTREEMODEL__H__
+#define SQTREEMODEL__H__
+
+#include <QAbstractItemModel>
+#include <QModelIndex>
+#include <QVariant>
+#include <QString>
+#include <QDateTime>
+#include <QColor>
+#include <QList>
+#include <QByteArray>
+#include <QtAlgorithms>
+#include <mdcmFile.h>
+#include <mdcmDataSet.h>
+#include <mdcmDataElement.h>
+#include <mdcmSequenceOfItems.h>
+#include <mdcmSmartPointer.h>
+
+class SQtreeFile
+{
+public:
+	SQtreeFile() : pixel_data_skipped(false) {}
+	QString name;
+	QDateTime modified;
+	mdcm::SmartPointer<mdcm::File> file;
+	bool pixel_data_skipped;
+};
+
+class SQtreeNode
+{
+public:
+	SQtreeNode(SQtreeNode * p, int r)
+		:
+		parent(p),
+		row(r),
+		ds(NULL),
+		de(NULL),
+		item(0),
+		duplicated(false),
+		fetched(false),
+		formatted(false) {}
+	~SQtreeNode() { qDeleteAll(children); }
+	SQtreeNode * parent;
+	int row;
+	// data set of the element or nested data set of the item
+	const mdcm::DataSet * ds;
+	const mdcm::DataElement * de;
+	// keeps nested data sets alive, SQ may be parsed from UN on request
+	mdcm::SmartPointer<mdcm::SequenceOfItems> sq;
+	unsigned int item;
+	bool duplicated;
+	bool fetched;
+	bool formatted;
+	QString text[5];
+	QColor fg[5];
+	QColor bg[5];
+	QList<SQtreeNode*> children;
+};
+
+class SQtreeModel : public QAbstractItemModel
+{
+Q_OBJECT
+
+public:
+	SQtreeModel(QObject * = NULL);
+	~SQtreeModel();
+	void set_file(const SQtreeFile&);
+	void clear_file();
+	QModelIndex index(int, int, const QModelIndex & = QModelIndex()) const;
+	QModelIndex parent(const QModelIndex&) const;
+	int rowCount(const QModelIndex & = QModelIndex()) const;
+	int columnCount(const QModelIndex & = QModelIndex()) const;
+	QVariant data(const QModelIndex&, int = Qt::DisplayRole) const;
+	QVariant headerData(int, Qt::Orientation, int = Qt::DisplayRole) const;
+	Qt::ItemFlags flags(const QModelIndex&) const;
+	bool hasChildren(const QModelIndex & = QModelIndex()) const;
+	bool canFetchMore(const QModelIndex&) const;
+	void fetchMore(const QModelIndex&);
+
+private:
+	SQtreeNode * node_from_index(const QModelIndex&) const;
+	void format_node(SQtreeNode*) const;
+	void add_children(SQtreeNode*, const mdcm::DataSet&) const;
+	void populate(SQtreeNode*) const;
+	SQtreeNode * root;
+	SQtreeFile current;
+	QByteArray charset;
+};
+
+#endif // SQTREEMODEL__H__
@@ -0,0 +1,125 @@
+#include "ybrtorgb.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Compares convert_ybr_full_to_rgb_ and convert_ybr_full_to_rgb_mt
+// with the former per-pixel code of process_dicom_rgb_image, byte
+// for byte. All 2^24 8-bit (Y, Cb, Cr) values, and odd sizes split
+// unevenly over threads, 8 and 16 bits.
+
+namespace
+{
+
+// former per-pixel code, unchanged
+template<typename T> void convert_reference(
+	const T * p__, T * out, const size_t n)
+{
+	size_t j = 0;
+	for (size_t k = 0; k < n; k++)
+	{
+		const double Y  = static_cast<double>(p__[j  ]);
+		const double Cb = static_cast<double>(p__[j+1]);
+		const double Cr = static_cast<double>(p__[j+2]);
+		int R = static_cast<int>((Y + 1.402*(Cr-128)) + 0.5);
+		int G = static_cast<int>((Y - (0.114*1.772*(Cb-128) + 0.299*1.402*(Cr-128))/0.587) + 0.5);
+		int B = static_cast<int>((Y + 1.772*(Cb-128)) + 0.5);
+		if (R < 0) { R = 0; }; if (R > 255) { R = 255; }
+		if (G < 0) { G = 0; }; if (G > 255) { G = 255; }
+		if (B < 0) { B = 0; }; if (B > 255) { B = 255; }
+		out[j  ] = static_cast<T>(R);
+		out[j+1] = static_cast<T>(G);
+		out[j+2] = static_cast<T>(B);
+		j+=3;
+	}
+}
+
+unsigned int seed = 1;
+
+unsigned short random16()
+{
+	seed = seed * 1103515245u + 12345u;
+	return (unsigned short)(seed >> 16);
+}
+
+template<typename T> int compare(
+	const T * in, const size_t n, const int max_threads, const char * s)
+{
+	T * out0 = new T[3 * n];
+	T * out1 = new T[3 * n];
+	T * out2 = new T[3 * n];
+	convert_reference<T>(in, out0, n);
+	convert_ybr_full_to_rgb_<T>(in, out1, n);
+	convert_ybr_full_to_rgb_mt<T>(in, out2, n, max_threads);
+	int r = 0;
+	if (memcmp(out0, out1, 3 * n * sizeof(T)) != 0)
+	{
+		fprintf(stderr, "%s: convert_ybr_full_to_rgb_ differs, n=%u\n",
+			s, (unsigned int)n);
+		r = 1;
+	}
+	if (memcmp(out0, out2, 3 * n * sizeof(T)) != 0)
+	{
+		fprintf(stderr,
+			"%s: convert_ybr_full_to_rgb_mt differs, n=%u threads=%d\n",
+			s, (unsigned int)n, max_threads);
+		r = 1;
+	}
+	delete [] out0;
+	delete [] out1;
+	delete [] out2;
+	return r;
+}
+
+int test_cube()
+{
+	const size_t n = 256 * 256 * 256;
+	unsigned char * in = new unsigned char[3 * n];
+	for (size_t k = 0; k < n; k++)
+	{
+		in[3*k  ] = static_cast<unsigned char>(k >> 16);
+		in[3*k+1] = static_cast<unsigned char>(k >> 8);
+		in[3*k+2] = static_cast<unsigned char>(k);
+	}
+	// 2^24 / 7 and 2^24 / 3 are not integers
+	int r = 0;
+	r += compare<unsigned char>(in, n, 1, "cube");
+	r += compare<unsigned char>(in, n, 3, "cube");
+	r += compare<unsigned char>(in, n, 7, "cube");
+	delete [] in;
+	return r;
+}
+
+template<typename T> int test_sizes(const T mask, const char * s)
+{
+	// below and above 2 blocks of 65536 pixels, odd remainders
+	const size_t sizes[] =
+	{
+		1, 3, 511 * 257, 131071, 131072, 131073,
+		3 * 65536 + 1, 5 * 65536 + 4093, 7 * 65536 + 6
+	};
+	const int threads[] = { 1, 2, 3, 4, 5, 8 };
+	int r = 0;
+	for (size_t x = 0; x < sizeof(sizes) / sizeof(sizes[0]); x++)
+	{
+		const size_t n = sizes[x];
+		T * in = new T[3 * n];
+		for (size_t k = 0; k < 3 * n; k++)
+			in[k] = static_cast<T>(random16() & mask);
+		for (size_t y = 0; y < sizeof(threads) / sizeof(threads[0]); y++)
+			r += compare<T>(in, n, threads[y], s);
+		delete [] in;
+	}
+	return r;
+}
+
+}
+
+int main(int, char *[])
+{
+	int r = 0;
+	r += test_cube();
+	r += test_sizes<unsigned char>(0xff, "8 bits");
+	r += test_sizes<unsigned short>(0xffff, "16 bits");
+	return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
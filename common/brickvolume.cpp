@@ -0,0 +1,365 @@
+#include "brickvolume.h"
+#include <QTemporaryFile>
+#include <QDir>
+#include <QMutexLocker>
+#if QT_VERSION >= QT_VERSION_CHECK(5,4,0)
+#include <QStorageInfo>
+#endif
+#include <cstring>
+#include <iostream>
+
+BrickVolume::BrickVolume()
+	:
+	file(NULL),
+	dimx(0), dimy(0), dimz(0),
+	pixel_size(0),
+	brick_size(0),
+	nbx(0), nby(0), nbz(0),
+	brick_bytes(0),
+	max_mapped(8),
+	slab(NULL),
+	slab_z(0)
+{
+}
+
+BrickVolume::~BrickVolume()
+{
+	unmap_all();
+	if (file)
+	{
+		file->close();
+		delete file;
+		file = NULL;
+	}
+}
+
+// Creates the cache file, 'dir' is the directory for the file,
+// default is the system temporary directory.
+bool BrickVolume::create(
+	unsigned int x, unsigned int y, unsigned int z,
+	unsigned int psize,
+	const QString & dir,
+	unsigned int bsize)
+{
+	if (file) return false;
+	if (x < 1 || y < 1 || z < 1 || psize < 1 || bsize < 1) return false;
+	dimx = x;
+	dimy = y;
+	dimz = z;
+	pixel_size = psize;
+	brick_size = bsize;
+	nbx = (dimx + brick_size - 1) / brick_size;
+	nby = (dimy + brick_size - 1) / brick_size;
+	nbz = (dimz + brick_size - 1) / brick_size;
+	brick_bytes =
+		static_cast<quint64>(brick_size) * brick_size * brick_size * pixel_size;
+	const quint64 size =
+		static_cast<quint64>(nbx) * nby * nbz * brick_bytes;
+	const QString d = dir.isEmpty() ? QDir::tempPath() : dir;
+#if QT_VERSION >= QT_VERSION_CHECK(5,4,0)
+	// writing to a mapped page of a sparse file on a full disk
+	// is a crash, not an error
+	{
+		const QStorageInfo si(d);
+		if (si.isValid() &&
+			static_cast<quint64>(si.bytesAvailable()) < size)
+		{
+			std::cout << "BrickVolume: not enough space in "
+				<< d.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+	}
+#endif
+	file = new QTemporaryFile(
+		d + QString("/alizams_XXXXXX.bricks"));
+	if (!file->open() || !file->resize(static_cast<qint64>(size)))
+	{
+		delete file;
+		file = NULL;
+		return false;
+	}
+	set_max_mapped_bytes(256ULL * 1024 * 1024);
+	slice_min.fill(0.0, dimz);
+	slice_max.fill(0.0, dimz);
+	return true;
+}
+
+void BrickVolume::set_max_mapped_bytes(quint64 bytes)
+{
+	QMutexLocker locker(&mutex);
+	if (brick_bytes < 1) return;
+	const quint64 n = bytes / brick_bytes;
+	max_mapped = (n < 8) ? 8 : ((n > 65536) ? 65536 : static_cast<int>(n));
+}
+
+unsigned char * BrickVolume::get_brick(quint64 id)
+{
+	QHash<quint64, unsigned char*>::const_iterator it = mapped.constFind(id);
+	if (it != mapped.constEnd())
+	{
+		lru.splice(lru.begin(), lru, lru_pos.value(id));
+		return it.value();
+	}
+	while (mapped.size() >= max_mapped && !lru.empty())
+	{
+		const quint64 k = lru.back();
+		lru.pop_back();
+		lru_pos.remove(k);
+		file->unmap(mapped.take(k));
+	}
+	unsigned char * p = file->map(
+		static_cast<qint64>(id * brick_bytes),
+		static_cast<qint64>(brick_bytes));
+	if (!p) return NULL;
+	mapped.insert(id, p);
+	lru.push_front(id);
+	lru_pos.insert(id, lru.begin());
+	return p;
+}
+
+void BrickVolume::unmap_all()
+{
+	if (!file) return;
+	if (slab)
+	{
+		file->unmap(slab);
+		slab = NULL;
+	}
+	QHash<quint64, unsigned char*>::const_iterator it = mapped.constBegin();
+	while (it != mapped.constEnd())
+	{
+		file->unmap(it.value());
+		++it;
+	}
+	mapped.clear();
+	lru.clear();
+	lru_pos.clear();
+}
+
+// Slices have to be written in increasing z order, one slab of
+// bricks is mapped at a time. The input is one z slice.
+bool BrickVolume::write_slice(unsigned int z, const char * in)
+{
+	QMutexLocker locker(&mutex);
+	if (!file || !in || z >= dimz) return false;
+	const unsigned int bz = z / brick_size;
+	const unsigned int zl = z % brick_size;
+	const quint64 slab_bytes =
+		static_cast<quint64>(nbx) * nby * brick_bytes;
+	if (slab && slab_z != bz)
+	{
+		file->unmap(slab);
+		slab = NULL;
+	}
+	if (!slab)
+	{
+		slab = file->map(
+			static_cast<qint64>(bz * slab_bytes),
+			static_cast<qint64>(slab_bytes));
+		slab_z = bz;
+	}
+	const size_t row = static_cast<size_t>(brick_size) * pixel_size;
+	for (unsigned int by = 0; by < nby; by++)
+	{
+		const unsigned int y0 = by * brick_size;
+		const unsigned int h =
+			(dimy - y0 < brick_size) ? dimy - y0 : brick_size;
+		for (unsigned int bx = 0; bx < nbx; bx++)
+		{
+			const unsigned int x0 = bx * brick_size;
+			const unsigned int w =
+				(dimx - x0 < brick_size) ? dimx - x0 : brick_size;
+			const quint64 k = static_cast<quint64>(by) * nbx + bx;
+			// a slab may not fit in the address space
+			unsigned char * b = slab
+				? slab + k * brick_bytes
+				: get_brick(static_cast<quint64>(bz) * nbx * nby + k);
+			if (!b) return false;
+			b += static_cast<size_t>(zl) * brick_size * row;
+			for (unsigned int yl = 0; yl < h; yl++)
+			{
+				memcpy(
+					b + yl * row,
+					in + (static_cast<size_t>(y0 + yl) * dimx + x0) * pixel_size,
+					static_cast<size_t>(w) * pixel_size);
+			}
+		}
+	}
+	return true;
+}
+
+void BrickVolume::finish_writing()
+{
+	QMutexLocker locker(&mutex);
+	if (file && slab)
+	{
+		file->unmap(slab);
+		slab = NULL;
+	}
+}
+
+// Axis 0 - x, output is y by z, axis 1 - y, output is x by z,
+// axis 2 - z, output is x by y (same as ExtractImageFilter).
+bool BrickVolume::read_slice(short axis, unsigned int idx, char * out)
+{
+	QMutexLocker locker(&mutex);
+	if (!file || !out) return false;
+	const size_t row = static_cast<size_t>(brick_size) * pixel_size;
+	const size_t plane = row * brick_size;
+	switch (axis)
+	{
+	case 0:
+		{
+			if (idx >= dimx) return false;
+			const unsigned int bx = idx / brick_size;
+			const size_t xl = (idx % brick_size) * pixel_size;
+			for (unsigned int bz = 0; bz < nbz; bz++)
+			{
+				const unsigned int z0 = bz * brick_size;
+				const unsigned int d =
+					(dimz - z0 < brick_size) ? dimz - z0 : brick_size;
+				for (unsigned int by = 0; by < nby; by++)
+				{
+					const unsigned int y0 = by * brick_size;
+					const unsigned int h =
+						(dimy - y0 < brick_size) ? dimy - y0 : brick_size;
+					const unsigned char * b = get_brick(
+						(static_cast<quint64>(bz) * nby + by) * nbx + bx);
+					if (!b) return false;
+					for (unsigned int zl = 0; zl < d; zl++)
+					{
+						char * o = out +
+							(static_cast<size_t>(z0 + zl) * dimy + y0) * pixel_size;
+						const unsigned char * s = b + zl * plane + xl;
+						for (unsigned int yl = 0; yl < h; yl++)
+						{
+							memcpy(o, s, pixel_size);
+							o += pixel_size;
+							s += row;
+						}
+					}
+				}
+			}
+		}
+		break;
+	case 1:
+		{
+			if (idx >= dimy) return false;
+			const unsigned int by = idx / brick_size;
+			const size_t yl = (idx % brick_size) * row;
+			for (unsigned int bz = 0; bz < nbz; bz++)
+			{
+				const unsigned int z0 = bz * brick_size;
+				const unsigned int d =
+					(dimz - z0 < brick_size) ? dimz - z0 : brick_size;
+				for (unsigned int bx = 0; bx < nbx; bx++)
+				{
+					const unsigned int x0 = bx * brick_size;
+					const unsigned int w =
+						(dimx - x0 < brick_size) ? dimx - x0 : brick_size;
+					const unsigned char * b = get_brick(
+						(static_cast<quint64>(bz) * nby + by) * nbx + bx);
+					if (!b) return false;
+					for (unsigned int zl = 0; zl < d; zl++)
+					{
+						memcpy(
+							out + (static_cast<size_t>(z0 + zl) * dimx + x0) * pixel_size,
+							b + zl * plane + yl,
+							static_cast<size_t>(w) * pixel_size);
+					}
+				}
+			}
+		}
+		break;
+	case 2:
+		{
+			if (idx >= dimz) return false;
+			const unsigned int bz = idx / brick_size;
+			const size_t zl = (idx % brick_size) * plane;
+			for (unsigned int by = 0; by < nby; by++)
+			{
+				const unsigned int y0 = by * brick_size;
+				const unsigned int h =
+					(dimy - y0 < brick_size) ? dimy - y0 : brick_size;
+				for (unsigned int bx = 0; bx < nbx; bx++)
+				{
+					const unsigned int x0 = bx * brick_size;
+					const unsigned int w =
+						(dimx - x0 < brick_size) ? dimx - x0 : brick_size;
+					const unsigned char * b = get_brick(
+						(static_cast<quint64>(bz) * nby + by) * nbx + bx);
+					if (!b) return false;
+					for (unsigned int yl = 0; yl < h; yl++)
+					{
+						memcpy(
+							out + (static_cast<size_t>(y0 + yl) * dimx + x0) * pixel_size,
+							b + zl + yl * row,
+							static_cast<size_t>(w) * pixel_size);
+					}
+				}
+			}
+		}
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+bool BrickVolume::read_voxel(
+	unsigned int x, unsigned int y, unsigned int z, char * out)
+{
+	QMutexLocker locker(&mutex);
+	if (!file || !out) return false;
+	if (x >= dimx || y >= dimy || z >= dimz) return false;
+	const unsigned char * b = get_brick(
+		(static_cast<quint64>(z / brick_size) * nby + y / brick_size) * nbx +
+			x / brick_size);
+	if (!b) return false;
+	const size_t k =
+		((static_cast<size_t>(z % brick_size) * brick_size + y % brick_size) *
+			brick_size + x % brick_size) * pixel_size;
+	memcpy(out, b + k, pixel_size);
+	return true;
+}
+
+void BrickVolume::set_slice_min_max(unsigned int z, double vmin, double vmax)
+{
+	if (z >= static_cast<unsigned int>(slice_min.size())) return;
+	slice_min[z] = vmin;
+	slice_max[z] = vmax;
+}
+
+bool BrickVolume::get_slice_min_max(
+	unsigned int z, double * vmin, double * vmax) const
+{
+	if (z >= static_cast<unsigned int>(slice_min.size())) return false;
+	*vmin = slice_min.at(z);
+	*vmax = slice_max.at(z);
+	return true;
+}
+
+unsigned int BrickVolume::get_dimx() const
+{
+	return dimx;
+}
+
+unsigned int BrickVolume::get_dimy() const
+{
+	return dimy;
+}
+
+unsigned int BrickVolume::get_dimz() const
+{
+	return dimz;
+}
+
+unsigned int BrickVolume::get_pixel_size() const
+{
+	return pixel_size;
+}
+
+quint64 BrickVolume::get_file_size() const
+{
+	return static_cast<quint64>(nbx) * nby * nbz * brick_bytes;
+}
@@ -0,0 +1,66 @@
+#ifndef BRICKVOLUME__H
+#define BRICKVOLUME__H
+
+#include <QtGlobal>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <list>
+
+class QTemporaryFile;
+
+// Scalar volume stored in cubic bricks in a cache file, only a limited
+// number of bricks is memory mapped at a time, the least recently used
+// are unmapped first. While loading z slices are written in order,
+// slices along any axis and single voxels can be read back.
+// Pixels are raw values, x is the fastest index.
+class BrickVolume
+{
+public:
+	BrickVolume();
+	~BrickVolume();
+	bool create(
+		unsigned int, unsigned int, unsigned int,
+		unsigned int,
+		const QString & = QString(),
+		unsigned int = 64);
+	bool write_slice(unsigned int, const char*);
+	void finish_writing();
+	bool read_slice(short, unsigned int, char*);
+	bool read_voxel(unsigned int, unsigned int, unsigned int, char*);
+	void set_max_mapped_bytes(quint64);
+	void set_slice_min_max(unsigned int, double, double);
+	bool get_slice_min_max(unsigned int, double*, double*) const;
+	unsigned int get_dimx() const;
+	unsigned int get_dimy() const;
+	unsigned int get_dimz() const;
+	unsigned int get_pixel_size() const;
+	quint64 get_file_size() const;
+
+private:
+	unsigned char * get_brick(quint64);
+	void unmap_all();
+	QTemporaryFile * file;
+	unsigned int dimx;
+	unsigned int dimy;
+	unsigned int dimz;
+	unsigned int pixel_size;
+	unsigned int brick_size;
+	unsigned int nbx;
+	unsigned int nby;
+	unsigned int nbz;
+	quint64 brick_bytes;
+	int max_mapped;
+	// slab of bricks in z being written
+	unsigned char * slab;
+	unsigned int slab_z;
+	QHash<quint64, unsigned char*> mapped;
+	std::list<quint64> lru;
+	QHash<quint64, std::list<quint64>::iterator> lru_pos;
+	QVector<double> slice_min;
+	QVector<double> slice_max;
+	QMutex mutex;
+};
+
+#endif // BRICKVOLUME__H
@@ -18,6 +18,14 @@
 #include "itkImageSliceIteratorWithIndex.h"
 #include "itkResampleImageFilter.h"
 #include "itkIdentityTransform.h"
+#include "itkContinuousIndex.h"
+#if ITK_VERSION_MAJOR >= 5
+#include "itkMultiThreaderBase.h"
+#else
+#include "itkMultiThreader.h"
+#endif
+#include "mdcmJPEG2000Codec.h"
+#include "mdcmSplitMosaicFilter.h"
 #include <vnl/vnl_vector_fixed.h>
 #include <QSet>
 #include <QApplication>
@@ -26,12 +34,20 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QDateTime>
+#include <QAtomicInt>
+#include <QThread>
 #include "settingswidget.h"
 #include "iconutils.h"
 #include "updateqtcommand.h"
+#include "brickvolume.h"
+#include "ybrtorgb.h"
+#include "prconfigutils.h"
 #include <iostream>
 #include <list>
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
 #include "dicomutils.h"
 #include "colorspace/colorspace.h"
 #if (defined  __FreeBSD__)
@@ -49,38 +65,61 @@ typedef itk::Image<RGBPixelUC,4> RGBImage4DTypeUC;
 typedef itk::Image<RGBPixelF, 4> RGBImage4DTypeF;
 typedef itk::Image<RGBPixelD, 4> RGBImage4DTypeD;
 static QString screenshot_dir("");
+static QAtomicInt max_threads(0);
 static QString save_dir("");
 static QString open_dir("");
 
-template<typename T> void calculate_min_max(
+template<typename T> void calculate_rescaled_min_max(
 	const typename T::Pointer & image,
-	ImageVariant * iv)
+	const QList< QPair<double, double> > & rescale_values,
+	double * vmin,
+	double * vmax)
 {
-	if (image.IsNull()) return;
-	typedef  itk::MinimumMaximumImageCalculator<T> MinMaxCalculator;
-	typename MinMaxCalculator::Pointer min_max_calculator =
-		MinMaxCalculator::New();
-	typename UpdateQtCommand::Pointer update_qt_command =
-		UpdateQtCommand::New();
-	double cubemin = 0.0, cubemax = 0.0;
-	try
+	const typename T::SizeType size =
+		image->GetLargestPossibleRegion().GetSize();
+	const size_t slice_size = size[0] * size[1];
+	if (slice_size < 1) return;
+	const typename T::PixelType * p = image->GetBufferPointer();
+	bool first = true;
+	for (size_t z = 0; z < size[2]; z++)
 	{
-		min_max_calculator->AddObserver(
-			itk::ProgressEvent(), update_qt_command);
-		min_max_calculator->SetImage(image);
-		min_max_calculator->SetRegion(image->GetLargestPossibleRegion());
-		min_max_calculator->Compute();
-		cubemin =
-			static_cast<double>(min_max_calculator->GetMinimum());
-		cubemax =
-			static_cast<double>(min_max_calculator->GetMaximum());
+		const typename T::PixelType * s = p + z * slice_size;
+		typename T::PixelType smin = s[0];
+		typename T::PixelType smax = s[0];
+		for (size_t j = 1; j < slice_size; j++)
+		{
+			if (s[j] < smin) smin = s[j];
+			if (s[j] > smax) smax = s[j];
+		}
+		double intercept = 0.0, slope = 1.0;
+		if (z < static_cast<size_t>(rescale_values.size()))
+		{
+			intercept = rescale_values.at(z).first;
+			slope     = rescale_values.at(z).second;
+		}
+		double a = static_cast<double>(smin) * slope + intercept;
+		double b = static_cast<double>(smax) * slope + intercept;
+		if (a > b) { const double tmp0 = a; a = b; b = tmp0; }
+		if (first || a < *vmin) *vmin = a;
+		if (first || b > *vmax) *vmax = b;
+		first = false;
 	}
-	catch (itk::ExceptionObject & ex)
+}
+
+// Value range and default window, 'cubemin' and 'cubemax' are
+// rescaled values if the image has a per-slice rescale table.
+static void set_min_max_window(
+	ImageVariant * iv,
+	double cubemin,
+	double cubemax)
+{
+	const bool rescaled = !iv->slice_rescale.empty();
+	if (iv->di->maxwindow && rescaled)
 	{
-		std::cout << ex << std::endl;
-		return;
+		iv->di->rmin = iv->di->vmin = cubemin;
+		iv->di->rmax = iv->di->vmax = cubemax;
 	}
-	if (iv->di->maxwindow)
+	else if (iv->di->maxwindow)
 	{
 		switch (iv->image_type)
 		{
@@ -161,7 +200,7 @@ template<typename T> void calculate_min_max(
 			(iv->di->default_us_window_center > iv->di->vmax ||
 				iv->di->default_us_window_center < iv->di->vmin)))
 	{
-		if (iv->image_type == 4)
+		if (iv->image_type == 4 && !rescaled)
 		{
 			iv->di->default_us_window_center = iv->di->us_window_center = 128.0;
 			iv->di->default_us_window_width  = iv->di->us_window_width  = 255.0;
@@ -185,6 +224,42 @@ template<typename T> void calculate_min_max(
 	else iv->di->disable_int_level = false;
 }
 
+template<typename T> void calculate_min_max(
+	const typename T::Pointer & image,
+	ImageVariant * iv)
+{
+	if (image.IsNull()) return;
+	typedef  itk::MinimumMaximumImageCalculator<T> MinMaxCalculator;
+	typename MinMaxCalculator::Pointer min_max_calculator =
+		MinMaxCalculator::New();
+	typename UpdateQtCommand::Pointer update_qt_command =
+		UpdateQtCommand::New();
+	double cubemin = 0.0, cubemax = 0.0;
+	try
+	{
+		min_max_calculator->AddObserver(
+			itk::ProgressEvent(), update_qt_command);
+		min_max_calculator->SetImage(image);
+		min_max_calculator->SetRegion(image->GetLargestPossibleRegion());
+		min_max_calculator->Compute();
+		cubemin =
+			static_cast<double>(min_max_calculator->GetMinimum());
+		cubemax =
+			static_cast<double>(min_max_calculator->GetMaximum());
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		std::cout << ex << std::endl;
+		return;
+	}
+	if (!iv->slice_rescale.empty())
+	{
+		calculate_rescaled_min_max<T>(
+			image, iv->slice_rescale, &cubemin, &cubemax);
+	}
+	set_min_max_window(iv, cubemin, cubemax);
+}
+
 template <typename T> void calculate_rgb_minmax_(
 	const typename T::Pointer image,
 	ImageVariant * ivariant)
@@ -345,6 +420,294 @@ template<typename T> QString get_orientation(
 	return f;
 }
 
+// 2x2 box filter in x and y, slices [z0, z1), odd sizes repeat
+// the last column or row.
+template<typename T> void downsample_xy_(
+	const typename T::PixelType * in,
+	typename T::PixelType * out,
+	const unsigned int sx, const unsigned int sy,
+	const unsigned int ox, const unsigned int oy,
+	const unsigned int z0, const unsigned int z1)
+{
+	typedef typename T::PixelType PixelType;
+	const bool is_integer = std::numeric_limits<PixelType>::is_integer;
+	const size_t in_slice  = static_cast<size_t>(sx) * sy;
+	const size_t out_slice = static_cast<size_t>(ox) * oy;
+	for (unsigned int z = z0; z < z1; z++)
+	{
+		const PixelType * s = in  + z * in_slice;
+		PixelType * d       = out + z * out_slice;
+		for (unsigned int y = 0; y < oy; y++)
+		{
+			const unsigned int y0 = 2 * y;
+			const unsigned int y1 = (y0 + 1 < sy) ? y0 + 1 : y0;
+			const PixelType * r0 = s + static_cast<size_t>(y0) * sx;
+			const PixelType * r1 = s + static_cast<size_t>(y1) * sx;
+			for (unsigned int x = 0; x < ox; x++)
+			{
+				const unsigned int x0 = 2 * x;
+				const unsigned int x1 = (x0 + 1 < sx) ? x0 + 1 : x0;
+				const double v = 0.25 * (
+					static_cast<double>(r0[x0]) +
+					static_cast<double>(r0[x1]) +
+					static_cast<double>(r1[x0]) +
+					static_cast<double>(r1[x1]));
+				*d++ = is_integer
+					? static_cast<PixelType>(floor(v + 0.5))
+					: static_cast<PixelType>(v);
+			}
+		}
+	}
+}
+
+template<typename T> class DownsampleThread_ : public QThread
+{
+public:
+	DownsampleThread_(
+		const typename T::PixelType * in_,
+		typename T::PixelType * out_,
+		const unsigned int sx_, const unsigned int sy_,
+		const unsigned int ox_, const unsigned int oy_,
+		const unsigned int z0_, const unsigned int z1_)
+		:
+		in(in_), out(out_),
+		sx(sx_), sy(sy_),
+		ox(ox_), oy(oy_),
+		z0(z0_), z1(z1_)
+	{
+	}
+	~DownsampleThread_()
+	{
+	}
+	void run()
+	{
+		downsample_xy_<T>(in, out, sx, sy, ox, oy, z0, z1);
+	}
+private:
+	const typename T::PixelType * in;
+	typename T::PixelType * out;
+	const unsigned int sx, sy, ox, oy, z0, z1;
+};
+
+template<typename T> void downsample_xy_mt(
+	const typename T::PixelType * in,
+	typename T::PixelType * out,
+	const unsigned int sx, const unsigned int sy,
+	const unsigned int ox, const unsigned int oy,
+	const unsigned int sz)
+{
+	int num_threads = get_max_threads();
+	if (num_threads < 1) num_threads = 1;
+	if (sz < static_cast<unsigned int>(num_threads))
+		num_threads = static_cast<int>(sz);
+	if (num_threads <= 1)
+	{
+		downsample_xy_<T>(in, out, sx, sy, ox, oy, 0, sz);
+		return;
+	}
+	const unsigned int block = sz / num_threads;
+	std::vector<QThread*> threads;
+	for (int i = 0; i < num_threads; i++)
+	{
+		const unsigned int z0 = i * block;
+		const unsigned int z1 = (i == num_threads - 1) ? sz : z0 + block;
+		DownsampleThread_<T> * t__ = new DownsampleThread_<T>(
+			in, out, sx, sy, ox, oy, z0, z1);
+		threads.push_back(static_cast<QThread*>(t__));
+		t__->start();
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i]->wait();
+		delete threads[i];
+	}
+}
+
+// Builds the pyramid of the image, nothing is done if the pyramid
+// is already built from the same, unmodified image.
+template<typename T> void build_pyramid_(
+	ImageVariant * ivariant,
+	const typename T::Pointer & image)
+{
+	if (!ivariant || image.IsNull()) return;
+	if (ivariant->pyramid_source ==
+			static_cast<const void*>(image.GetPointer()) &&
+		ivariant->pyramid_mtime == image->GetMTime()) return;
+	ivariant->pyramid.clear();
+	ivariant->pyramid_source = NULL;
+	ivariant->pyramid_mtime = 0;
+	const typename T::RegionType r0 = image->GetLargestPossibleRegion();
+	if (r0 != image->GetBufferedRegion()) return;
+	const int max_levels = 6;
+	typename T::Pointer src = image;
+	for (int level = 1; level <= max_levels; level++)
+	{
+		const typename T::SizeType ssize =
+			src->GetLargestPossibleRegion().GetSize();
+		if (ssize[0] < 32 || ssize[1] < 32) break;
+		typename T::SizeType osize;
+		osize[0] = (ssize[0] + 1) / 2;
+		osize[1] = (ssize[1] + 1) / 2;
+		osize[2] = ssize[2];
+		typename T::IndexType start;
+		start.Fill(0);
+		typename T::RegionType region;
+		region.SetIndex(start);
+		region.SetSize(osize);
+		const double fx = static_cast<double>(ssize[0]) / osize[0];
+		const double fy = static_cast<double>(ssize[1]) / osize[1];
+		typename T::SpacingType spacing = src->GetSpacing();
+		spacing[0] *= fx;
+		spacing[1] *= fy;
+		// centre of the first 2x2 block
+		itk::ContinuousIndex<itk::SpacePrecisionType, 3> cindex;
+		cindex[0] = 0.5 * (fx - 1.0);
+		cindex[1] = 0.5 * (fy - 1.0);
+		cindex[2] = 0.0;
+		typename T::PointType origin;
+		src->TransformContinuousIndexToPhysicalPoint(cindex, origin);
+		typename T::Pointer out;
+		try
+		{
+			out = T::New();
+			out->SetRegions(region);
+			out->Allocate();
+			out->SetOrigin(origin);
+			out->SetSpacing(spacing);
+			out->SetDirection(src->GetDirection());
+		}
+		catch (itk::ExceptionObject & ex)
+		{
+			std::cout << ex << std::endl;
+			break;
+		}
+		catch (std::bad_alloc&)
+		{
+			break;
+		}
+		downsample_xy_mt<T>(
+			src->GetBufferPointer(),
+			out->GetBufferPointer(),
+			ssize[0], ssize[1],
+			osize[0], osize[1],
+			osize[2]);
+		ivariant->pyramid.push_back(
+			itk::ImageBase<3>::Pointer(out.GetPointer()));
+		src = out;
+	}
+	ivariant->pyramid_source = image.GetPointer();
+	ivariant->pyramid_mtime  = image->GetMTime();
+}
+
+template<typename T> typename T::Pointer get_pyramid_level_(
+	const ImageVariant * ivariant,
+	const int level)
+{
+	typename T::Pointer p;
+	if (!ivariant || level < 1 || level > ivariant->pyramid.size())
+		return p;
+	p = dynamic_cast<T*>(ivariant->pyramid.at(level - 1).GetPointer());
+	return p;
+}
+
+// Window to texture values, slices [z0, z1) of the texture,
+// 'in' is contiguous, x fastest.
+template<typename T> void quantize_tex3d_(
+	const typename T::PixelType * in,
+	float * float_buf,
+	unsigned short * short_buf,
+	GLubyte * ub_buf,
+	const short texture_type,
+	const size_t slice_size,
+	const unsigned int z0, const unsigned int z1,
+	const unsigned int size_z, const unsigned int original_size_z,
+	const double rmin, const double max_minus_min,
+	const QList< QPair<double, double> > & rescale_values)
+{
+	const bool rescaled = !rescale_values.empty();
+	for (unsigned int z = z0; z < z1; z++)
+	{
+		double intercept = 0.0, slope = 1.0;
+		if (rescaled)
+		{
+			// nearest stored slice if the texture is resized in z
+			const int zs = static_cast<int>(
+				(z * (double)original_size_z) / size_z);
+			if (zs < rescale_values.size())
+			{
+				intercept = rescale_values.at(zs).first;
+				slope     = rescale_values.at(zs).second;
+			}
+		}
+		const size_t first = z * slice_size;
+		const size_t last  = first + slice_size;
+		for (size_t j = first; j < last; j++)
+		{
+			const double f = rescaled
+				? static_cast<double>(in[j]) * slope + intercept
+				: static_cast<double>(in[j]);
+			// GL_R16F
+			if (texture_type == 0)
+				float_buf[j] = static_cast<float>((f+(-rmin))/max_minus_min);
+			// GL_R16
+			else if(texture_type == 1)
+				short_buf[j] = static_cast<unsigned short>(
+					(double)USHRT_MAX*((f+(-rmin))/max_minus_min));
+			// GL_R8
+			else if(texture_type == 2)
+				ub_buf[j] = static_cast<GLubyte>(
+					(double)UCHAR_MAX*((f+(-rmin))/max_minus_min));
+		}
+	}
+}
+
+template<typename T> class QuantizeTex3DThread_ : public QThread
+{
+public:
+	QuantizeTex3DThread_(
+		const typename T::PixelType * in_,
+		float * float_buf_,
+		unsigned short * short_buf_,
+		GLubyte * ub_buf_,
+		const short texture_type_,
+		const size_t slice_size_,
+		const unsigned int z0_, const unsigned int z1_,
+		const unsigned int size_z_, const unsigned int original_size_z_,
+		const double rmin_, const double max_minus_min_,
+		const QList< QPair<double, double> > & rescale_values_)
+		:
+		in(in_),
+		float_buf(float_buf_), short_buf(short_buf_), ub_buf(ub_buf_),
+		texture_type(texture_type_),
+		slice_size(slice_size_),
+		z0(z0_), z1(z1_),
+		size_z(size_z_), original_size_z(original_size_z_),
+		rmin(rmin_), max_minus_min(max_minus_min_),
+		rescale_values(rescale_values_)
+	{
+	}
+	~QuantizeTex3DThread_()
+	{
+	}
+	void run()
+	{
+		quantize_tex3d_<T>(
+			in, float_buf, short_buf, ub_buf, texture_type,
+			slice_size, z0, z1, size_z, original_size_z,
+			rmin, max_minus_min, rescale_values);
+	}
+private:
+	const typename T::PixelType * in;
+	float * float_buf;
+	unsigned short * short_buf;
+	GLubyte * ub_buf;
+	const short texture_type;
+	const size_t slice_size;
+	const unsigned int z0, z1, size_z, original_size_z;
+	const double rmin, max_minus_min;
+	const QList< QPair<double, double> > rescale_values;
+};
+
 template<typename T> int generate_tex3d(
 	ImageVariant * ivariant,
 	const typename T::Pointer & image,
@@ -361,7 +724,6 @@ template<typename T> int generate_tex3d(
 	typedef itk::NearestNeighborInterpolateImageFunction<T,double> InterpolatorType;
 	typedef itk::IdentityTransform<double,3> IdentityTransformType;
 	typedef itk::ResampleImageFilter<T,T> ScaleFilter;
-	typedef itk::ImageSliceConstIteratorWithIndex<T> SliceConstIteratorType;
 	std::string tt;
 	int error__ = 0;
 	GLuint glerror__ = 0;
@@ -370,6 +732,7 @@ template<typename T> int generate_tex3d(
 	unsigned short * short_buf = NULL;
 	GLubyte * ub_buf = NULL;
 	typename T::Pointer out_image;
+	typename T::Pointer in_image = image;
 	bool scale = true;
 	short texture_type = -1;
 	const typename T::RegionType r__ =
@@ -389,7 +752,10 @@ template<typename T> int generate_tex3d(
 			texture_type = 1; // GL_R16
 			break;
 		case 4:
-			texture_type = 2; // GL_R8
+			if (ivariant->slice_rescale.empty())
+				texture_type = 2; // GL_R8
+			else
+				texture_type = 1; // GL_R16
 			break;
 		case 5:
 		case 6:
@@ -437,6 +803,36 @@ template<typename T> int generate_tex3d(
 		size[2]==original_size[2]) scale = false;
 	//
 	if (scale)
+	{
+		// Start from the smallest pyramid level which is not smaller
+		// than the texture, with the halving on memory errors it is
+		// often the texture itself.
+		build_pyramid_<T>(ivariant, image);
+		const int level =
+			CommonUtils::select_pyramid_level(ivariant, size[0], size[1]);
+		if (level > 0)
+		{
+			const typename T::Pointer tmp0 =
+				get_pyramid_level_<T>(ivariant, level);
+			if (tmp0.IsNotNull())
+			{
+				const typename T::SizeType tmp0_size =
+					tmp0->GetLargestPossibleRegion().GetSize();
+				if (tmp0_size[0] == size[0] &&
+					tmp0_size[1] == size[1] &&
+					tmp0_size[2] == size[2])
+				{
+					out_image = tmp0;
+					scale = false;
+				}
+				else
+				{
+					in_image = tmp0;
+				}
+			}
+		}
+	}
+	if (scale)
 	{
 		typename ScaleFilter::Pointer scaleFilter = ScaleFilter::New();
 		typename T::SizeType size_;
@@ -449,7 +845,7 @@ template<typename T> int generate_tex3d(
 		spacing_[2] = spacing[2];
 		try
 		{
-			scaleFilter->SetInput(image);
+			scaleFilter->SetInput(in_image);
 			scaleFilter->SetSize(size_);
 			scaleFilter->SetOutputSpacing(spacing_);
 			scaleFilter->SetOutputOrigin(image->GetOrigin());
@@ -466,7 +862,7 @@ template<typename T> int generate_tex3d(
 		}
 		if (out_image.IsNotNull()) out_image->DisconnectPipeline();
 	}
-	else { out_image = image; }
+	else if (out_image.IsNull()) { out_image = image; }
 	//
 	if (out_image.IsNotNull())
 	{
@@ -523,41 +919,52 @@ template<typename T> int generate_tex3d(
 	if (pb) pb->setValue(-1);
 	qApp->processEvents();
 	//
+	if (out_image->GetBufferedRegion() !=
+		out_image->GetLargestPossibleRegion())
+	{
+		if (float_buf) delete [] float_buf;
+		if (short_buf) delete [] short_buf;
+		if (ub_buf)    delete [] ub_buf;
+		return 1;
+	}
 	{
-		SliceConstIteratorType inIterator(
-			out_image,
-			out_image->GetLargestPossibleRegion());
-		inIterator.SetFirstDirection(0);  // X axis
-		inIterator.SetSecondDirection(1); // Y axis
-		inIterator.GoToBegin();
-		int j = 0;
 		const double max_minus_min =
 			(rmax-rmin > 0) ? rmax-rmin : 1e-9;
-		while(!inIterator.IsAtEnd())
+		const size_t slice_size =
+			static_cast<size_t>(size[0]) * size[1];
+		const typename T::PixelType * in = out_image->GetBufferPointer();
+		int num_threads = get_max_threads();
+		if (num_threads < 1) num_threads = 1;
+		if (size[2] < static_cast<unsigned int>(num_threads))
+			num_threads = static_cast<int>(size[2]);
+		if (num_threads <= 1)
+		{
+			quantize_tex3d_<T>(
+				in, float_buf, short_buf, ub_buf, texture_type,
+				slice_size, 0, size[2], size[2], original_size[2],
+				rmin, max_minus_min, ivariant->slice_rescale);
+		}
+		else
 		{
-			while (!inIterator.IsAtEndOfSlice())
+			const unsigned int block = size[2] / num_threads;
+			std::vector<QThread*> threads;
+			for (int i = 0; i < num_threads; i++)
 			{
-				while (!inIterator.IsAtEndOfLine())
-				{
-					const typename T::PixelType v = inIterator.Get();
-					const double f = static_cast<const double>(v);
-					// GL_R16F
-					if (texture_type == 0)
-						float_buf[j] = static_cast<float>((f+(-rmin))/max_minus_min);
-					// GL_R16
-					else if(texture_type == 1)
-						short_buf[j] = static_cast<unsigned short>(
-							(double)USHRT_MAX*((f+(-rmin))/max_minus_min));
-					// GL_R8
-					else if(texture_type == 2)
-						ub_buf[j] = static_cast<GLubyte>(
-							(double)UCHAR_MAX*((f+(-rmin))/max_minus_min));
-					j+=1;
-					++inIterator;
-				}
-				inIterator.NextLine();
+				const unsigned int z0 = i * block;
+				const unsigned int z1 =
+					(i == num_threads - 1) ? size[2] : z0 + block;
+				QuantizeTex3DThread_<T> * t__ = new QuantizeTex3DThread_<T>(
+					in, float_buf, short_buf, ub_buf, texture_type,
+					slice_size, z0, z1, size[2], original_size[2],
+					rmin, max_minus_min, ivariant->slice_rescale);
+				threads.push_back(static_cast<QThread*>(t__));
+				t__->start();
+			}
+			for (size_t i = 0; i < threads.size(); i++)
+			{
+				threads[i]->wait();
+				delete threads[i];
 			}
-			inIterator.NextSlice();
 		}
 	}
 	//
@@ -1229,39 +1636,264 @@ template<typename T> QString process_dicom_monochrome_image(
 	return QString("");
 }
 
-template<typename T> QString process_dicom_rgb_image(
+// Image without a buffer, the geometry is 'image' and
+// the range is known.
+static bool reload_geometry(
+	ImageVariant * ivariant,
+	const itk::ImageBase<3>::Pointer & image,
+	double cubemin,
+	double cubemax,
+	bool disable_gen_slices)
+{
+	typedef itk::ImageBase<3> GeometryType;
+	if (image.IsNull()) return false;
+	const bool generate_slices =
+		(!disable_gen_slices &&
+			!ivariant->di->slices_generated);
+	get_dimensions<GeometryType>(image,
+		&(ivariant->di->idimx),
+		&(ivariant->di->idimy),
+		&(ivariant->di->idimz),
+		&(ivariant->di->ix_spacing),
+		&(ivariant->di->iy_spacing),
+		&(ivariant->di->iz_spacing),
+		&(ivariant->di->ix_origin),
+		&(ivariant->di->iy_origin),
+		&(ivariant->di->iz_origin));
+	ivariant->di->close(generate_slices);
+	// there is no buffer for a 3D texture
+	ivariant->di->skip_texture = true;
+	if (generate_slices)
+	{
+		read_geometry_from_image<GeometryType>(ivariant,image);
+		calc_center_from_image<GeometryType>(ivariant,image);
+	}
+	set_min_max_window(ivariant, cubemin, cubemax);
+	if (ivariant->equi)
+	{
+		ivariant->orientation_string = get_orientation<GeometryType>(
+			image, &ivariant->orientation);
+	}
+	else
+	{
+		ivariant->orientation = 0;
+		ivariant->orientation_string = QString("");
+	}
+	if (ivariant->equi &&
+		ivariant->orientation > 0 &&
+		!ivariant->orientation_string.isEmpty())
+	{
+		ivariant->di->origin[0] = ivariant->di->ix_origin;
+		ivariant->di->origin[1] = ivariant->di->iy_origin;
+		ivariant->di->origin[2] = ivariant->di->iz_origin;
+		ivariant->di->origin_ok = true;
+	}
+	return true;
+}
+
+static bool reload_bricked_image(
+	ImageVariant * ivariant,
+	bool disable_gen_slices=false)
+{
+	if (!ivariant || !ivariant->bricks) return false;
+	// range from per-slice values stored while loading
+	double cubemin = 0.0, cubemax = 0.0;
+	for (unsigned int z = 0; z < ivariant->bricks->get_dimz(); z++)
+	{
+		double a = 0.0, b = 0.0;
+		ivariant->bricks->get_slice_min_max(z, &a, &b);
+		double intercept = 0.0, slope = 1.0;
+		if (CommonUtils::get_slice_rescale(ivariant, z, &intercept, &slope))
+		{
+			a = a * slope + intercept;
+			b = b * slope + intercept;
+			if (a > b) { const double tmp0 = a; a = b; b = tmp0; }
+		}
+		if (z == 0 || a < cubemin) cubemin = a;
+		if (z == 0 || b > cubemax) cubemax = b;
+	}
+	return reload_geometry(
+		ivariant, ivariant->bricks_geometry,
+		cubemin, cubemax, disable_gen_slices);
+}
+
+// Image type of the bricks cache for a scalar pixel format,
+// false if the format is not supported.
+static bool get_bricks_image_type(
+	const mdcm::PixelFormat & pixelformat,
+	short * image_type)
+{
+	if (pixelformat.GetSamplesPerPixel() != 1) return false;
+	switch (pixelformat)
+	{
+	case mdcm::PixelFormat::INT12:
+	case mdcm::PixelFormat::INT16:
+		*image_type = 0;
+		return true;
+	case mdcm::PixelFormat::UINT12:
+	case mdcm::PixelFormat::UINT16:
+		*image_type = 1;
+		return true;
+	case mdcm::PixelFormat::INT32:
+		*image_type = 2;
+		return true;
+	case mdcm::PixelFormat::UINT32:
+		*image_type = 3;
+		return true;
+	case mdcm::PixelFormat::INT8:
+	case mdcm::PixelFormat::UINT8:
+		*image_type = 4;
+		return true;
+	case mdcm::PixelFormat::FLOAT32:
+		*image_type = 5;
+		return true;
+	case mdcm::PixelFormat::FLOAT64:
+		*image_type = 6;
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+static unsigned int get_bricks_pixel_size(short image_type)
+{
+	switch (image_type)
+	{
+	case 0: return sizeof(signed short);
+	case 1: return sizeof(unsigned short);
+	case 2: return sizeof(signed int);
+	case 3: return sizeof(unsigned int);
+	case 4: return sizeof(unsigned char);
+	case 5: return sizeof(float);
+	case 6: return sizeof(double);
+	default: break;
+	}
+	return 0;
+}
+
+template<typename TPixel> bool write_bricks_slice_(
+	BrickVolume * bricks,
+	unsigned int z,
+	const char * s)
+{
+	const size_t slice_size =
+		static_cast<size_t>(bricks->get_dimx()) * bricks->get_dimy();
+	const TPixel * p = reinterpret_cast<const TPixel*>(s);
+	TPixel smin = p[0];
+	TPixel smax = p[0];
+	for (size_t j = 1; j < slice_size; j++)
+	{
+		if (p[j] < smin) smin = p[j];
+		if (p[j] > smax) smax = p[j];
+	}
+	bricks->set_slice_min_max(
+		z, static_cast<double>(smin), static_cast<double>(smax));
+	return bricks->write_slice(z, s);
+}
+
+// Out-of-core variant of process_dicom_monochrome_image,
+// 'data' are slices or one buffer with all slices.
+// Loaders which read slice by slice should use create_bricks,
+// write_bricks_slice and gen_bricked_image directly to release
+// each slice as soon as it is decoded.
+static QString process_dicom_bricked_image(
 	bool * ok,
 	ImageVariant * ivariant,
-	typename T::Pointer & image,
-	char * buffer,
+	std::vector<char*> & data,
+	bool delete_data,
+	const mdcm::PixelFormat & pixelformat,
 	itk::Matrix<itk::SpacePrecisionType,3,3> & direction,
 	unsigned int dimx, unsigned int dimy, unsigned int dimz,
 	double origin_x, double origin_y, double origin_z,
 	double spacing_x, double spacing_y, double spacing_z,
-	short image_type,
-	bool ybr, bool gen_vertices,
+	bool gen_vertices,
 	QProgressDialog * pb)
 {
-	if (!buffer)
-	{
-		*ok = false;
-		return QString(
-			"process_dicom_rgb_image : buffer==NULL");
-	}
-	typename T::RegionType region;
-	typename T::SizeType size;
-	typename T::IndexType start;
-	typename T::PointType origin;
-	typename T::SpacingType spacing;
-	typedef itk::ImageSliceIteratorWithIndex<T> SliceIterator;
+	*ok = false;
 	if (pb)
 	{
-		pb->setLabelText(QString("Loading data... please wait"));
+		pb->setLabelText(QString("Loading data to cache... please wait"));
 		pb->setValue(-1);
 	}
 	qApp->processEvents();
-	start.Fill(0);
-	size[0] = dimx;
+	BrickVolume * bricks =
+		CommonUtils::create_bricks(pixelformat, dimx, dimy, dimz);
+	if (!bricks)
+		return QString("Could not create cache file in ") + QDir::tempPath();
+	const size_t slice_bytes =
+		static_cast<size_t>(dimx) * dimy * bricks->get_pixel_size();
+	const bool one_buffer = (data.size() == 1);
+	for (unsigned int z = 0; z < dimz; z++)
+	{
+		const char * s = one_buffer
+			? data.at(0) + z * slice_bytes
+			: data.at(z);
+		if (!s)
+		{
+			delete bricks;
+			return QString(
+				QString("!data.at(") +
+				QVariant((int)z).toString() +
+				QString(")"));
+		}
+		if (!CommonUtils::write_bricks_slice(bricks, pixelformat, z, s))
+		{
+			delete bricks;
+			return QString("Could not write cache file");
+		}
+		if (delete_data && !one_buffer)
+		{
+			delete [] data[z];
+			data[z] = NULL;
+		}
+		if (z % 16 == 0) qApp->processEvents();
+	}
+	// all frames of the buffer are in the cache now
+	if (delete_data && one_buffer)
+	{
+		delete [] data[0];
+		data[0] = NULL;
+	}
+	return CommonUtils::gen_bricked_image(
+		ok, bricks, pixelformat, ivariant, direction,
+		origin_x, origin_y, origin_z,
+		spacing_x, spacing_y, spacing_z,
+		gen_vertices);
+}
+
+template<typename T> QString process_dicom_rgb_image(
+	bool * ok,
+	ImageVariant * ivariant,
+	typename T::Pointer & image,
+	char * buffer,
+	itk::Matrix<itk::SpacePrecisionType,3,3> & direction,
+	unsigned int dimx, unsigned int dimy, unsigned int dimz,
+	double origin_x, double origin_y, double origin_z,
+	double spacing_x, double spacing_y, double spacing_z,
+	short image_type,
+	bool ybr, bool gen_vertices,
+	QProgressDialog * pb)
+{
+	if (!buffer)
+	{
+		*ok = false;
+		return QString(
+			"process_dicom_rgb_image : buffer==NULL");
+	}
+	typename T::RegionType region;
+	typename T::SizeType size;
+	typename T::IndexType start;
+	typename T::PointType origin;
+	typename T::SpacingType spacing;
+	if (pb)
+	{
+		pb->setLabelText(QString("Loading data... please wait"));
+		pb->setValue(-1);
+	}
+	qApp->processEvents();
+	start.Fill(0);
+	size[0] = dimx;
 	size[1] = dimy;
 	size[2] = dimz;
 	region.SetIndex(start);
@@ -1298,50 +1930,24 @@ template<typename T> QString process_dicom_rgb_image(
 		return QString(ex.GetDescription());
 	}
 	//
-	const typename T::PixelType::ValueType * p__ =
-		reinterpret_cast<typename T::PixelType::ValueType*>(buffer);
+	typedef typename T::PixelType::ValueType ValueType;
+	const ValueType * p__ = reinterpret_cast<ValueType*>(buffer);
 	ivariant->image_type = image_type;
 	//
-	SliceIterator it(image, image->GetLargestPossibleRegion());
-	it.SetFirstDirection(0);
-	it.SetSecondDirection(1);
-	it.GoToBegin();
-	int j = 0;
-	while(!it.IsAtEnd())
+	// RGBPixel is 3 packed values, the buffer is filled directly in
+	// the same x, y, z order as the decoded frames.
+	ValueType * out__ =
+		reinterpret_cast<ValueType*>(image->GetBufferPointer());
+	const size_t n__ =
+		static_cast<size_t>(dimx) * static_cast<size_t>(dimy) * static_cast<size_t>(dimz);
+	if (ybr)
 	{
-		while (!it.IsAtEndOfSlice())
-		{
-			while (!it.IsAtEndOfLine())
-			{
-				typename T::PixelType p;
-				if (ybr)
-				{
-					const double Y  = static_cast<double>(p__[j  ]);
-					const double Cb = static_cast<double>(p__[j+1]);
-					const double Cr = static_cast<double>(p__[j+2]);
-					int R = static_cast<int>((Y + 1.402*(Cr-128)) + 0.5);
-					int G = static_cast<int>((Y - (0.114*1.772*(Cb-128) + 0.299*1.402*(Cr-128))/0.587) + 0.5);
-					int B = static_cast<int>((Y + 1.772*(Cb-128)) + 0.5);
-					if (R < 0) { R = 0; }; if (R > 255) { R = 255; }
-					if (G < 0) { G = 0; }; if (G > 255) { G = 255; }
-					if (B < 0) { B = 0; }; if (B > 255) { B = 255; }
-					p[0]=static_cast<typename T::PixelType::ValueType>(R);
-					p[1]=static_cast<typename T::PixelType::ValueType>(G);
-					p[2]=static_cast<typename T::PixelType::ValueType>(B);
-				}
-				else
-				{
-					p[0]=static_cast<typename T::PixelType::ValueType>(p__[j  ]);
-					p[1]=static_cast<typename T::PixelType::ValueType>(p__[j+1]);
-					p[2]=static_cast<typename T::PixelType::ValueType>(p__[j+2]);
-				}
-				it.Set(p);
-				j+=3;
-				++it;
-			}
-			it.NextLine();
-		}
-		it.NextSlice();
+		convert_ybr_full_to_rgb_mt<ValueType>(
+			p__, out__, n__, get_max_threads());
+	}
+	else
+	{
+		memcpy(out__, p__, 3 * n__ * sizeof(ValueType));
 	}
 	*ok = reload_rgb_image<T>(
 		image, ivariant, !gen_vertices);
@@ -1534,21 +2140,23 @@ QString apply_per_slice_rescale_(
 	const int size_z = size[2];
 	if (size_z != rescale_values.size())
 		return QString("size_z != rescale_values.size()");
+	// 'image' and 'out_image' may be the same pointer (float input)
+	const typename Tin::Pointer in_image = image;
 	try
 	{
 		out_image = Tout::New();
 		out_image->SetRegions(
 			static_cast<typename Tout::RegionType>(
-				image->GetLargestPossibleRegion()));
+				in_image->GetLargestPossibleRegion()));
 		out_image->SetOrigin(
 			static_cast<typename Tout::PointType>(
-				image->GetOrigin()));
+				in_image->GetOrigin()));
 		out_image->SetSpacing(
 			static_cast<typename Tout::SpacingType>(
-				image->GetSpacing()));
+				in_image->GetSpacing()));
 		out_image->SetDirection(
 			static_cast<typename Tout::DirectionType>(
-				image->GetDirection()));
+				in_image->GetDirection()));
 		out_image->Allocate();
 	}
 	catch (itk::ExceptionObject & ex)
@@ -1568,7 +2176,7 @@ QString apply_per_slice_rescale_(
 		typename Tin::RegionType region;
 		region.SetIndex(index);
 		region.SetSize(size_);
-		itk::ImageRegionConstIterator<Tin> it0(image, region);
+		itk::ImageRegionConstIterator<Tin> it0(in_image, region);
 		it0.GoToBegin();
 		itk::ImageRegionIterator<Tout> it1(out_image, region);
 		it1.GoToBegin();
@@ -1584,8 +2192,12 @@ QString apply_per_slice_rescale_(
 			++it1;
 		}
 	}
-	image->DisconnectPipeline();
-	image = NULL;
+	if (static_cast<const void*>(image.GetPointer()) !=
+		static_cast<const void*>(out_image.GetPointer()))
+	{
+		image->DisconnectPipeline();
+		image = NULL;
+	}
 	return QString("");
 }
 
@@ -2331,6 +2943,14 @@ bool CommonUtils::reload_monochrome(
 	unsigned int size_y_)
 {
 	if (!ivariant) return false;
+	if (ivariant->bricks) return reload_bricked_image(ivariant);
+	if (ivariant->pr_slices)
+	{
+		return reload_geometry(
+			ivariant, ivariant->pr_slices->geometry,
+			ivariant->pr_slices->vmin, ivariant->pr_slices->vmax,
+			false);
+	}
 	bool ok = false;
 	if (ivariant->image_type==0)
 	{
@@ -2522,17 +3142,7 @@ void CommonUtils::copy_imagevariant_overlays(
 		const SliceOverlays & source_overlays = it.value();
 		for (int x = 0; x < source_overlays.size(); x++)
 		{
-			const SliceOverlay source_overlay =
-				source_overlays.at(x);
-			SliceOverlay overlay;
-			overlay.dimx = source_overlay.dimx;
-			overlay.dimy = source_overlay.dimy;
-			overlay.x = source_overlay.x;
-			overlay.y = source_overlay.y;
-			for (size_t j = 0; j < source_overlay.data.size(); j++)
-			{
-				overlay.data.push_back(source_overlay.data.at(j));
-			}
+			const SliceOverlay & overlay = source_overlays.at(x);
 			if (!dest->image_overlays.all_overlays.contains(source_key))
 			{
 				dest->image_overlays.all_overlays[source_key] =
@@ -2564,6 +3174,21 @@ void CommonUtils::reset_bb(ImageVariant * ivariant)
 void CommonUtils::get_dimensions_(ImageVariant * ivariant)
 {
 	if (!ivariant) return;
+	if (ivariant->pr_slices)
+	{
+		get_dimensions<itk::ImageBase<3> >(
+			ivariant->pr_slices->geometry,
+			&ivariant->di->idimx,
+			&ivariant->di->idimy,
+			&ivariant->di->idimz,
+			&ivariant->di->ix_spacing,
+			&ivariant->di->iy_spacing,
+			&ivariant->di->iz_spacing,
+			&ivariant->di->ix_origin,
+			&ivariant->di->iy_origin,
+			&ivariant->di->iz_origin);
+		return;
+	}
 	switch(ivariant->image_type)
 	{
 	case 0:
@@ -2991,6 +3616,17 @@ QString CommonUtils::gen_itk_image(bool * ok,
 	// monochrome
 	if (pixelformat.GetSamplesPerPixel()==1)
 	{
+		// The volume would not fit in memory twice (slices and image),
+		// keep it out-of-core in a bricks cache file.
+		if (use_bricks(pixelformat, dimx, dimy, dimz))
+		{
+			return process_dicom_bricked_image(
+				ok, ivariant, data, delete_data, pixelformat, direction,
+				dimx, dimy, dimz,
+				origin_x, origin_y, origin_z,
+				spacing_x, spacing_y, spacing_z,
+				geometry_from_image, pb);
+		}
 		switch (pixelformat)
 		{
 		case mdcm::PixelFormat::INT12:
@@ -3005,7 +3641,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3015,19 +3651,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 2; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 2;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3061,7 +3687,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3071,19 +3697,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 2; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 2;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3116,7 +3732,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3126,19 +3742,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 4; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 4;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3171,7 +3777,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3181,19 +3787,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 4; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 4;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3226,7 +3822,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3236,19 +3832,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 8; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 8;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3281,7 +3867,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3291,19 +3877,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 8; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 8;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3338,7 +3914,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3348,19 +3924,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 1; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3396,7 +3962,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3406,19 +3972,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 4; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 4;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3451,7 +4007,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 					}
 					catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 					if (!p__) return QString("p__ == NULL");
-					long inc = 0;
+					size_t inc = 0;
 					for (unsigned int z_ = 0; z_ < dimz; z_++)
 					{
 						if (!data.at(z_))
@@ -3461,19 +4017,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 								QVariant((int)z_).toString() +
 								QString(")"));
 						}
-						long inc_xy = 0;
-						for (unsigned int y_ = 0; y_ < dimy; y_++)
-						{
-							for (unsigned int x_ = 0; x_ < dimx; x_++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 8; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
+						const size_t slice_size = static_cast<size_t>(dimx) * dimy * 8;
+						memcpy(p__ + inc, data.at(z_), slice_size);
+						inc += slice_size;
 						if (delete_data)
 						{
 							delete [] data[z_];
@@ -3515,7 +4061,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 				}
 				catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 				if (!p__) return QString("p__ == NULL");
-				long inc = 0;
+				size_t inc = 0;
 				for (unsigned int z_ = 0; z_ < dimz; z_++)
 				{
 					if (!data.at(z_))
@@ -3525,22 +4071,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 							QVariant((int)z_).toString() +
 							QString(")"));
 					}
-					long inc_xy = 0;
-					for (unsigned int y_ = 0; y_ < dimy; y_++)
-					{
-						for (unsigned int x_ = 0; x_ < dimx; x_++)
-						{
-							for (unsigned int rgb__ = 0; rgb__ < 3; rgb__++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 1; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
-					}
+					const size_t slice_size = static_cast<size_t>(dimx) * dimy * 3;
+					memcpy(p__ + inc, data.at(z_), slice_size);
+					inc += slice_size;
 					if (delete_data)
 					{
 						delete [] data[z_];
@@ -3572,7 +4105,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 				}
 				catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 				if (!p__) return QString("p__ == NULL");
-				long inc = 0;
+				size_t inc = 0;
 				for (unsigned int z_ = 0; z_ < dimz; z_++)
 				{
 					if (!data.at(z_))
@@ -3582,22 +4115,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 							QVariant((int)z_).toString() +
 							QString(")"));
 					}
-					long inc_xy = 0;
-					for (unsigned int y_ = 0; y_ < dimy; y_++)
-					{
-						for (unsigned int x_ = 0; x_ < dimx; x_++)
-						{
-							for (unsigned int rgb__ = 0; rgb__ < 3; rgb__++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 2; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
-					}
+					const size_t slice_size = static_cast<size_t>(dimx) * dimy * 3 * 2;
+					memcpy(p__ + inc, data.at(z_), slice_size);
+					inc += slice_size;
 					if (delete_data)
 					{
 						delete [] data[z_];
@@ -3629,7 +4149,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 				}
 				catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 				if (!p__) return QString("p__ == NULL");
-				long inc = 0;
+				size_t inc = 0;
 				for (unsigned int z_ = 0; z_ < dimz; z_++)
 				{
 					if (!data.at(z_))
@@ -3639,22 +4159,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 							QVariant((int)z_).toString() +
 							QString(")"));
 					}
-					long inc_xy = 0;
-					for (unsigned int y_ = 0; y_ < dimy; y_++)
-					{
-						for (unsigned int x_ = 0; x_ < dimx; x_++)
-						{
-							for (unsigned int rgb__ = 0; rgb__ < 3; rgb__++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 2; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
-					}
+					const size_t slice_size = static_cast<size_t>(dimx) * dimy * 3 * 2;
+					memcpy(p__ + inc, data.at(z_), slice_size);
+					inc += slice_size;
 					if (delete_data)
 					{
 						delete [] data[z_];
@@ -3684,7 +4191,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 				}
 				catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 				if (!p__) return QString("p__ == NULL");
-				long inc = 0;
+				size_t inc = 0;
 				for (unsigned int z_ = 0; z_ < dimz; z_++)
 				{
 					if (!data.at(z_))
@@ -3694,22 +4201,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 							QVariant((int)z_).toString() +
 							QString(")"));
 					}
-					long inc_xy = 0;
-					for (unsigned int y_ = 0; y_ < dimy; y_++)
-					{
-						for (unsigned int x_ = 0; x_ < dimx; x_++)
-						{
-							for (unsigned int rgb__ = 0; rgb__ < 3; rgb__++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 4; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
-					}
+					const size_t slice_size = static_cast<size_t>(dimx) * dimy * 3 * 4;
+					memcpy(p__ + inc, data.at(z_), slice_size);
+					inc += slice_size;
 					if (delete_data)
 					{
 						delete [] data[z_];
@@ -3759,7 +4253,7 @@ QString CommonUtils::gen_itk_image(bool * ok,
 				}
 				catch (std::bad_alloc&) { return QString("std::bad_alloc"); }
 				if (!p__) return QString("p__ == NULL");
-				long inc = 0;
+				size_t inc = 0;
 				for (unsigned int z_ = 0; z_ < dimz; z_++)
 				{
 					if (!data.at(z_))
@@ -3769,22 +4263,9 @@ QString CommonUtils::gen_itk_image(bool * ok,
 							QVariant((int)z_).toString() +
 							QString(")"));
 					}
-					long inc_xy = 0;
-					for (unsigned int y_ = 0; y_ < dimy; y_++)
-					{
-						for (unsigned int x_ = 0; x_ < dimx; x_++)
-						{
-							for (unsigned int rgba__ = 0; rgba__ < 4; rgba__++)
-							{
-								for (unsigned int ss_ = 0; ss_ < 1; ss_++)
-								{
-									p__[inc] = data.at(z_)[inc_xy];
-									inc++;
-									inc_xy++;
-								}
-							}
-						}
-					}
+					const size_t slice_size = static_cast<size_t>(dimx) * dimy * 4;
+					memcpy(p__ + inc, data.at(z_), slice_size);
+					inc += slice_size;
 					if (delete_data)
 					{
 						delete [] data[z_];
@@ -3969,7 +4450,7 @@ void CommonUtils::set_open_dir(const QString & s)
 	open_dir = QDir::toNativeSeparators(s);
 }
 
-QString CommonUtils::apply_per_slice_rescale(
+static QString convert_per_slice_rescale(
 	ImageVariant * ivariant,
 	const QList< QPair<double, double> > & rescale_values)
 {
@@ -4046,7 +4527,6 @@ QString CommonUtils::apply_per_slice_rescale(
 			s = apply_per_slice_rescale_<ImageTypeD,ImageTypeD>(
 				ivariant->pD, ivariant->pD, rescale_values);
 		else
-		if (float64)
 			s = apply_per_slice_rescale_<ImageTypeD,ImageTypeF>(
 				ivariant->pD, ivariant->pF, rescale_values);
 		break;
@@ -4100,6 +4580,64 @@ QString CommonUtils::apply_per_slice_rescale(
 	return s;
 }
 
+QString CommonUtils::apply_per_slice_rescale(
+	ImageVariant * ivariant,
+	const QList< QPair<double, double> > & rescale_values)
+{
+	if (!ivariant) return QString("!ivariant");
+	// out-of-core pixels are never converted
+	if (ivariant->bricks)
+	{
+		ivariant->slice_rescale = rescale_values;
+		return QString("");
+	}
+	switch(ivariant->image_type)
+	{
+	case 0:
+	case 1:
+	case 2:
+	case 3:
+	case 4:
+	case 7:
+	case 8:
+		// Keep the stored integer pixels, the table is applied
+		// when values are read, see get_slice_rescale().
+		ivariant->slice_rescale = rescale_values;
+		return QString("");
+	default:
+		break;
+	}
+	return convert_per_slice_rescale(ivariant, rescale_values);
+}
+
+QString CommonUtils::materialize_slice_rescale(
+	ImageVariant * ivariant)
+{
+	if (!ivariant) return QString("!ivariant");
+	if (ivariant->slice_rescale.empty()) return QString("");
+	if (ivariant->bricks)
+		return QString("Not supported for out-of-core image");
+	const QList< QPair<double, double> > rescale_values =
+		ivariant->slice_rescale;
+	ivariant->slice_rescale.clear();
+	return convert_per_slice_rescale(ivariant, rescale_values);
+}
+
+bool CommonUtils::get_slice_rescale(
+	const ImageVariant * ivariant,
+	const int z,
+	double * intercept,
+	double * slope)
+{
+	*intercept = 0.0;
+	*slope = 1.0;
+	if (!ivariant) return false;
+	if (z < 0 || z >= ivariant->slice_rescale.size()) return false;
+	*intercept = ivariant->slice_rescale.at(z).first;
+	*slope     = ivariant->slice_rescale.at(z).second;
+	return true;
+}
+
 template<typename T> double get_value(
 	const typename T::Pointer & image,
 	const int x,
@@ -4123,6 +4661,56 @@ template<typename T> double get_value(
 	return r;
 }
 
+template<typename TPixel> double get_bricked_value_(
+	BrickVolume * bricks,
+	const int x,
+	const int y,
+	const int z)
+{
+	if (x < 0 || y < 0 || z < 0) return 0;
+	TPixel v = 0;
+	if (!bricks->read_voxel(x, y, z, reinterpret_cast<char*>(&v)))
+		return 0;
+	return static_cast<double>(v);
+}
+
+static bool get_bricked_value(
+	const ImageVariant * ivariant,
+	const int x,
+	const int y,
+	const int z,
+	double * d)
+{
+	BrickVolume * bricks = ivariant->bricks;
+	switch (ivariant->image_type)
+	{
+	case 0:
+		*d = get_bricked_value_<signed short>(bricks, x, y, z);
+		break;
+	case 1:
+		*d = get_bricked_value_<unsigned short>(bricks, x, y, z);
+		break;
+	case 2:
+		*d = get_bricked_value_<signed int>(bricks, x, y, z);
+		break;
+	case 3:
+		*d = get_bricked_value_<unsigned int>(bricks, x, y, z);
+		break;
+	case 4:
+		*d = get_bricked_value_<unsigned char>(bricks, x, y, z);
+		break;
+	case 5:
+		*d = get_bricked_value_<float>(bricks, x, y, z);
+		break;
+	case 6:
+		*d = get_bricked_value_<double>(bricks, x, y, z);
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
 void CommonUtils::get_pixel_values(
 	const QList<ImageVariant*> & images,
 	const int x,
@@ -4135,43 +4723,313 @@ void CommonUtils::get_pixel_values(
 		if (!images.at(i)) continue;
 		const short image_type = images.at(i)->image_type;
 		double d = 0;
-		switch (image_type)
+		if (images.at(i)->bricks)
 		{
-		case 0:
-			d = get_value<ImageTypeSS>(images.at(i)->pSS, x, y, z);
-			break;
-		case 1:
-			d = get_value<ImageTypeUS>(images.at(i)->pUS, x, y, z);
-			break;
-		case 2:
-			d = get_value<ImageTypeSI>(images.at(i)->pSI, x, y, z);
-			break;
-		case 3:
-			d = get_value<ImageTypeUI>(images.at(i)->pUI, x, y, z);
-			break;
-		case 4:
-			d = get_value<ImageTypeUC>(images.at(i)->pUC, x, y, z);
-			break;
-		case 5:
-			d = get_value<ImageTypeF>(images.at(i)->pF, x, y, z);
-			break;
-		case 6:
-			d = get_value<ImageTypeD>(images.at(i)->pD, x, y, z);
-			break;
-		case 7:
-			d = get_value<ImageTypeSLL>(images.at(i)->pSLL, x, y, z);
-			break;
-		case 8:
-			d = get_value<ImageTypeULL>(images.at(i)->pULL, x, y, z);
-			break;
-		default:
-			values.clear();
-			return;
+			if (!get_bricked_value(images.at(i), x, y, z, &d))
+			{
+				values.clear();
+				return;
+			}
 		}
+		else if (images.at(i)->pr_slices)
+		{
+			if (!images.at(i)->pr_slices->get_value(x, y, z, &d))
+			{
+				values.clear();
+				return;
+			}
+		}
+		else
+		{
+			switch (image_type)
+			{
+			case 0:
+				d = get_value<ImageTypeSS>(images.at(i)->pSS, x, y, z);
+				break;
+			case 1:
+				d = get_value<ImageTypeUS>(images.at(i)->pUS, x, y, z);
+				break;
+			case 2:
+				d = get_value<ImageTypeSI>(images.at(i)->pSI, x, y, z);
+				break;
+			case 3:
+				d = get_value<ImageTypeUI>(images.at(i)->pUI, x, y, z);
+				break;
+			case 4:
+				d = get_value<ImageTypeUC>(images.at(i)->pUC, x, y, z);
+				break;
+			case 5:
+				d = get_value<ImageTypeF>(images.at(i)->pF, x, y, z);
+				break;
+			case 6:
+				d = get_value<ImageTypeD>(images.at(i)->pD, x, y, z);
+				break;
+			case 7:
+				d = get_value<ImageTypeSLL>(images.at(i)->pSLL, x, y, z);
+				break;
+			case 8:
+				d = get_value<ImageTypeULL>(images.at(i)->pULL, x, y, z);
+				break;
+			default:
+				values.clear();
+				return;
+			}
+		}
+		double intercept, slope;
+		if (get_slice_rescale(images.at(i), z, &intercept, &slope))
+			d = d * slope + intercept;
 		values.push_back(d);
 	}
 }
 
+// Returns 0 if unknown
+unsigned long long CommonUtils::get_physical_memory()
+{
+	unsigned long long r = 0;
+#if (defined __FreeBSD__)
+	unsigned long long tmp0 = 0;
+	size_t len = sizeof(tmp0);
+	if (sysctlbyname("hw.physmem", &tmp0, &len, NULL, 0) == 0) r = tmp0;
+#elif (defined __linux__)
+	struct sysinfo info;
+	if (sysinfo(&info) == 0)
+		r = static_cast<unsigned long long>(info.totalram) * info.mem_unit;
+#endif
+	return r;
+}
+
+// Scalar volumes larger than half of the physical memory are kept
+// out-of-core, see BrickVolume. False if the size of the memory
+// is unknown.
+bool CommonUtils::use_bricks(
+	const mdcm::PixelFormat & pixelformat,
+	unsigned int dimx, unsigned int dimy, unsigned int dimz)
+{
+	short image_type = -1;
+	if (dimz < 2 || !get_bricks_image_type(pixelformat, &image_type))
+		return false;
+	const unsigned long long physical_memory = get_physical_memory();
+	return (physical_memory > 0 &&
+		static_cast<unsigned long long>(dimx) * dimy * dimz *
+			pixelformat.GetPixelSize() > physical_memory / 2);
+}
+
+// Returns NULL on error. Slices have to be written in order
+// with write_bricks_slice.
+BrickVolume * CommonUtils::create_bricks(
+	const mdcm::PixelFormat & pixelformat,
+	unsigned int dimx, unsigned int dimy, unsigned int dimz)
+{
+	short image_type = -1;
+	if (!get_bricks_image_type(pixelformat, &image_type)) return NULL;
+	BrickVolume * bricks = new BrickVolume();
+	if (!bricks->create(
+		dimx, dimy, dimz, get_bricks_pixel_size(image_type)))
+	{
+		delete bricks;
+		return NULL;
+	}
+	return bricks;
+}
+
+// Writes one z slice and records its min/max,
+// the slice can be released after.
+bool CommonUtils::write_bricks_slice(
+	BrickVolume * bricks,
+	const mdcm::PixelFormat & pixelformat,
+	unsigned int z,
+	const char * s)
+{
+	if (!bricks || !s) return false;
+	short image_type = -1;
+	if (!get_bricks_image_type(pixelformat, &image_type)) return false;
+	switch (image_type)
+	{
+	case 0: return write_bricks_slice_<signed short>(bricks, z, s);
+	case 1: return write_bricks_slice_<unsigned short>(bricks, z, s);
+	case 2: return write_bricks_slice_<signed int>(bricks, z, s);
+	case 3: return write_bricks_slice_<unsigned int>(bricks, z, s);
+	case 4: return write_bricks_slice_<unsigned char>(bricks, z, s);
+	case 5: return write_bricks_slice_<float>(bricks, z, s);
+	case 6: return write_bricks_slice_<double>(bricks, z, s);
+	default: break;
+	}
+	return false;
+}
+
+// Finishes the cache and sets up 'ivariant', takes the ownership
+// of 'bricks', it is deleted on error.
+QString CommonUtils::gen_bricked_image(
+	bool * ok,
+	BrickVolume * bricks,
+	const mdcm::PixelFormat & pixelformat,
+	ImageVariant * ivariant,
+	itk::Matrix<itk::SpacePrecisionType,3,3> & direction,
+	double origin_x, double origin_y, double origin_z,
+	double spacing_x, double spacing_y, double spacing_z,
+	bool gen_vertices)
+{
+	*ok = false;
+	if (!bricks) return QString("bricks == NULL");
+	short image_type = -1;
+	if (!get_bricks_image_type(pixelformat, &image_type))
+	{
+		delete bricks;
+		return QString("Unsupported pixel format");
+	}
+	typedef itk::ImageBase<3> GeometryType;
+	GeometryType::RegionType region;
+	GeometryType::SizeType size;
+	GeometryType::IndexType start;
+	GeometryType::PointType origin;
+	GeometryType::SpacingType spacing;
+	start.Fill(0);
+	size[0] = bricks->get_dimx();
+	size[1] = bricks->get_dimy();
+	size[2] = bricks->get_dimz();
+	region.SetIndex(start);
+	region.SetSize(size);
+	origin[0] = origin_x;
+	origin[1] = origin_y;
+	origin[2] = origin_z;
+	spacing[0] = spacing_x;
+	spacing[1] = spacing_y;
+	spacing[2] = spacing_z;
+	const bool bad_direction = (
+		direction[0][0]>-0.000001 && direction[0][0]<0.000001 &&
+		direction[1][0]>-0.000001 && direction[1][0]<0.000001 &&
+		direction[2][0]>-0.000001 && direction[2][0]<0.000001 &&
+		direction[0][1]>-0.000001 && direction[0][1]<0.000001 &&
+		direction[1][1]>-0.000001 && direction[1][1]<0.000001 &&
+		direction[2][1]>-0.000001 && direction[2][1]<0.000001 &&
+		direction[0][2]>-0.000001 && direction[0][2]<0.000001 &&
+		direction[1][2]>-0.000001 && direction[1][2]<0.000001 &&
+		direction[2][2]>-0.000001 && direction[2][2]<0.000001)
+			? true : false;
+	GeometryType::Pointer image;
+	try
+	{
+		image = GeometryType::New();
+		image->SetRegions(region);
+		image->SetOrigin(origin);
+		image->SetSpacing(spacing);
+		if (!bad_direction) image->SetDirection(direction);
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		delete bricks;
+		return QString(ex.GetDescription());
+	}
+	bricks->finish_writing();
+	const unsigned short bits_allocated = pixelformat.GetBitsAllocated();
+	const unsigned short bits_stored    = pixelformat.GetBitsStored();
+	const unsigned short high_bit       = pixelformat.GetHighBit();
+	if (bits_allocated > 0) ivariant->di->bits_allocated = bits_allocated;
+	if (bits_stored > 0)    ivariant->di->bits_stored    = bits_stored;
+	if (high_bit > 0)       ivariant->di->high_bit       = high_bit;
+	if (image_type == 4) ivariant->di->maxwindow = true;
+	ivariant->image_type = image_type;
+	ivariant->bricks = bricks;
+	ivariant->bricks_geometry = image;
+	*ok = reload_bricked_image(ivariant, !gen_vertices);
+	if (bad_direction)
+	{
+		ivariant->equi = false;
+		ivariant->orientation_string = QString("");
+		ivariant->orientation = 0;
+		for (unsigned int x = 0; x < ivariant->di->image_slices.size(); x++)
+			 ivariant->di->image_slices[x]->slice_orientation_string =
+				QString("");
+	}
+	return QString("");
+}
+
+// One budget for the app's workers, ITK filters and the JPEG 2000
+// decoder, 0 - number of processors. ITK uses the thread pool, the
+// pool is created with the first filter and can only grow later.
+void CommonUtils::set_max_threads(int x)
+{
+	int n = QThread::idealThreadCount();
+	if (n < 1) n = 1;
+	if (x > 0 && x < n) n = x;
+	max_threads.fetchAndStoreOrdered(n);
+#if ITK_VERSION_MAJOR >= 5
+	itk::MultiThreaderBase::SetGlobalDefaultThreader(
+		itk::MultiThreaderBase::ThreaderTypeFromString(std::string("POOL")));
+	itk::MultiThreaderBase::SetGlobalMaximumNumberOfThreads(n);
+	itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(n);
+#else
+	itk::MultiThreader::SetGlobalMaximumNumberOfThreads(n);
+	itk::MultiThreader::SetGlobalDefaultNumberOfThreads(n);
+#endif
+	mdcm::JPEG2000Codec::SetMaxNumberOfThreads(n);
+	mdcm::SplitMosaicFilter::SetMaxNumberOfThreads(n);
+}
+
+int CommonUtils::get_max_threads()
+{
+	const int n = max_threads.fetchAndAddOrdered(0);
+	if (n > 0) return n;
+	const int x = QThread::idealThreadCount();
+	return (x < 1) ? 1 : x;
+}
+
+void CommonUtils::build_pyramid(ImageVariant * ivariant)
+{
+	if (!ivariant) return;
+	switch(ivariant->image_type)
+	{
+	case 0:
+		build_pyramid_<ImageTypeSS>(ivariant, ivariant->pSS);
+		break;
+	case 1:
+		build_pyramid_<ImageTypeUS>(ivariant, ivariant->pUS);
+		break;
+	case 2:
+		build_pyramid_<ImageTypeSI>(ivariant, ivariant->pSI);
+		break;
+	case 3:
+		build_pyramid_<ImageTypeUI>(ivariant, ivariant->pUI);
+		break;
+	case 4:
+		build_pyramid_<ImageTypeUC>(ivariant, ivariant->pUC);
+		break;
+	case 5:
+		build_pyramid_<ImageTypeF>(ivariant, ivariant->pF);
+		break;
+	case 6:
+		build_pyramid_<ImageTypeD>(ivariant, ivariant->pD);
+		break;
+	case 7:
+		build_pyramid_<ImageTypeSLL>(ivariant, ivariant->pSLL);
+		break;
+	case 8:
+		build_pyramid_<ImageTypeULL>(ivariant, ivariant->pULL);
+		break;
+	default:
+		break;
+	}
+}
+
+// Returns the smallest level with x and y sizes not smaller than
+// requested, 0 is the image itself.
+int CommonUtils::select_pyramid_level(
+	const ImageVariant * ivariant,
+	unsigned int x, unsigned int y)
+{
+	if (!ivariant) return 0;
+	int level = 0;
+	for (int k = 0; k < ivariant->pyramid.size(); k++)
+	{
+		if (ivariant->pyramid.at(k).IsNull()) break;
+		const itk::ImageBase<3>::SizeType s =
+			ivariant->pyramid.at(k)->GetLargestPossibleRegion().GetSize();
+		if (s[0] < x || s[1] < y) break;
+		level = k + 1;
+	}
+	return level;
+}
+
 double CommonUtils::calculate_max_delta(const ImageVariant * v)
 {
 	if (!v) return 1000.0;
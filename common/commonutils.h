@@ -23,6 +23,7 @@ class GLWidget;
 class ShaderObj;
 class ImageSlice;
 class SpectroscopySlice;
+class BrickVolume;
 class CommonUtils
 {
 public:
@@ -108,6 +109,9 @@ public:
 	static QString apply_per_slice_rescale(
 		ImageVariant*,
 		const QList< QPair<double, double> > &);
+	static QString materialize_slice_rescale(ImageVariant*);
+	static bool get_slice_rescale(
+		const ImageVariant*, const int, double*, double*);
 	static void get_pixel_values(
 		const QList<ImageVariant*> &,
 		int,
@@ -115,6 +119,32 @@ public:
 		int,
 		QList<double> &);
 	static double calculate_max_delta(const ImageVariant*);
+	static unsigned long long get_physical_memory();
+	static bool use_bricks(
+		const mdcm::PixelFormat&,
+		unsigned int, unsigned int, unsigned int);
+	static BrickVolume * create_bricks(
+		const mdcm::PixelFormat&,
+		unsigned int, unsigned int, unsigned int);
+	static bool write_bricks_slice(
+		BrickVolume*,
+		const mdcm::PixelFormat&,
+		unsigned int,
+		const char*);
+	static QString gen_bricked_image(
+		bool*,
+		BrickVolume*,
+		const mdcm::PixelFormat&,
+		ImageVariant*,
+		itk::Matrix<itk::SpacePrecisionType,3,3> &,
+		double, double, double,
+		double, double, double,
+		bool);
+	static void set_max_threads(int);
+	static int get_max_threads();
+	static void build_pyramid(ImageVariant*);
+	static int select_pyramid_level(
+		const ImageVariant*, unsigned int, unsigned int);
 	static void random_RGB(float*, float*, float*);
 };
 
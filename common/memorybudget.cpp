@@ -0,0 +1,306 @@
+#include "memorybudget.h"
+#include "structures.h"
+#include "commonutils.h"
+#include <QTemporaryFile>
+#include <QDir>
+#include <QMap>
+#include <QPair>
+#if QT_VERSION >= QT_VERSION_CHECK(5,4,0)
+#include <QStorageInfo>
+#endif
+#include <new>
+#include <iostream>
+
+static quint64 budget = 0;
+static quint64 view_clock = 0;
+
+enum
+{
+	BufferBytes   = 0,
+	PyramidBytes  = 1,
+	SpillBuffer   = 2,
+	RestoreBuffer = 3
+};
+
+static bool write_buffer(QFile * f, const char * p, quint64 size)
+{
+	const quint64 chunk = 64ULL * 1024 * 1024;
+	quint64 j = 0;
+	while (j < size)
+	{
+		const qint64 n = static_cast<qint64>(
+			(size - j < chunk) ? size - j : chunk);
+		const qint64 w = f->write(p + j, n);
+		if (w < 1) return false;
+		j += static_cast<quint64>(w);
+	}
+	return f->flush();
+}
+
+static bool read_buffer(QFile * f, char * p, quint64 size)
+{
+	if (!f->seek(0)) return false;
+	const quint64 chunk = 64ULL * 1024 * 1024;
+	quint64 j = 0;
+	while (j < size)
+	{
+		const qint64 n = static_cast<qint64>(
+			(size - j < chunk) ? size - j : chunk);
+		const qint64 r = f->read(p + j, n);
+		if (r < 1) return false;
+		j += static_cast<quint64>(r);
+	}
+	return true;
+}
+
+// Returns the number of bytes counted, written or read.
+template<typename T> quint64 process_(
+	const typename T::Pointer & image,
+	const ImageVariant * ivariant,
+	short op,
+	QFile * f)
+{
+	if (image.IsNull()) return 0;
+	typedef typename T::PixelType PixelType;
+	typename T::PixelContainer * c = image->GetPixelContainer();
+	if (!c) return 0;
+	const quint64 size =
+		static_cast<quint64>(c->Size()) * sizeof(PixelType);
+	switch (op)
+	{
+	case BufferBytes:
+		return size;
+	case PyramidBytes:
+		{
+			quint64 r = 0;
+			for (int x = 0; x < ivariant->pyramid.size(); x++)
+			{
+				const T * l =
+					dynamic_cast<const T*>(ivariant->pyramid.at(x).GetPointer());
+				if (l && l->GetPixelContainer())
+				{
+					r += static_cast<quint64>(
+						l->GetPixelContainer()->Size()) * sizeof(PixelType);
+				}
+			}
+			return r;
+		}
+	case SpillBuffer:
+		{
+			// the buffer may be shared with other images or with
+			// a running filter, imported buffers are not owned
+			if (size < 1 || !image->GetBufferPointer()) return 0;
+			if (image->GetReferenceCount() > 1) return 0;
+			if (!c->GetContainerManageMemory()) return 0;
+			if (!write_buffer(
+				f,
+				reinterpret_cast<const char*>(image->GetBufferPointer()),
+				size))
+			{
+				return 0;
+			}
+			c->Initialize();
+			return size;
+		}
+	case RestoreBuffer:
+		{
+			const quint64 fsize = static_cast<quint64>(f->size());
+			try
+			{
+				image->Allocate();
+			}
+			catch (itk::ExceptionObject & ex)
+			{
+				std::cout << ex << std::endl;
+				return 0;
+			}
+			catch (std::bad_alloc&)
+			{
+				return 0;
+			}
+			const quint64 asize =
+				static_cast<quint64>(c->Size()) * sizeof(PixelType);
+			if (asize != fsize ||
+				!read_buffer(
+					f,
+					reinterpret_cast<char*>(image->GetBufferPointer()),
+					asize))
+			{
+				c->Initialize();
+				return 0;
+			}
+			return asize;
+		}
+	default:
+		break;
+	}
+	return 0;
+}
+
+static quint64 process(ImageVariant * v, short op, QFile * f)
+{
+	switch (v->image_type)
+	{
+	case  0: return process_<ImageTypeSS>(v->pSS, v, op, f);
+	case  1: return process_<ImageTypeUS>(v->pUS, v, op, f);
+	case  2: return process_<ImageTypeSI>(v->pSI, v, op, f);
+	case  3: return process_<ImageTypeUI>(v->pUI, v, op, f);
+	case  4: return process_<ImageTypeUC>(v->pUC, v, op, f);
+	case  5: return process_<ImageTypeF>(v->pF, v, op, f);
+	case  6: return process_<ImageTypeD>(v->pD, v, op, f);
+	case  7: return process_<ImageTypeSLL>(v->pSLL, v, op, f);
+	case  8: return process_<ImageTypeULL>(v->pULL, v, op, f);
+	case 10: return process_<RGBImageTypeSS>(v->pSS_rgb, v, op, f);
+	case 11: return process_<RGBImageTypeUS>(v->pUS_rgb, v, op, f);
+	case 12: return process_<RGBImageTypeSI>(v->pSI_rgb, v, op, f);
+	case 13: return process_<RGBImageTypeUI>(v->pUI_rgb, v, op, f);
+	case 14: return process_<RGBImageTypeUC>(v->pUC_rgb, v, op, f);
+	case 15: return process_<RGBImageTypeF>(v->pF_rgb, v, op, f);
+	case 16: return process_<RGBImageTypeD>(v->pD_rgb, v, op, f);
+	case 20: return process_<RGBAImageTypeSS>(v->pSS_rgba, v, op, f);
+	case 21: return process_<RGBAImageTypeUS>(v->pUS_rgba, v, op, f);
+	case 22: return process_<RGBAImageTypeSI>(v->pSI_rgba, v, op, f);
+	case 23: return process_<RGBAImageTypeUI>(v->pUI_rgba, v, op, f);
+	case 24: return process_<RGBAImageTypeUC>(v->pUC_rgba, v, op, f);
+	case 25: return process_<RGBAImageTypeF>(v->pF_rgba, v, op, f);
+	case 26: return process_<RGBAImageTypeD>(v->pD_rgba, v, op, f);
+	default: break;
+	}
+	return 0;
+}
+
+static quint64 pixmap_bytes(const QPixmap & p)
+{
+	if (p.isNull()) return 0;
+	return static_cast<quint64>(p.width()) * p.height() * p.depth() / 8;
+}
+
+// Bytes, 0 - automatic, 3/4 of the physical memory,
+// no eviction if the size of the memory is unknown.
+void MemoryBudget::set_budget(quint64 x)
+{
+	budget = x;
+}
+
+quint64 MemoryBudget::get_budget()
+{
+	if (budget > 0) return budget;
+	const unsigned long long m = CommonUtils::get_physical_memory();
+	return static_cast<quint64>(m / 4 * 3);
+}
+
+// Pixel buffer, pyramid, overlays, icon and histogram. Textures
+// are not counted, out-of-core images are in the bricks file.
+quint64 MemoryBudget::image_bytes(const ImageVariant * v)
+{
+	if (!v) return 0;
+	ImageVariant * v_ = const_cast<ImageVariant*>(v);
+	quint64 r = process(v_, BufferBytes, NULL);
+	r += process(v_, PyramidBytes, NULL);
+	QMap<int, SliceOverlays>::const_iterator it =
+		v->image_overlays.all_overlays.constBegin();
+	while (it != v->image_overlays.all_overlays.constEnd())
+	{
+		for (int x = 0; x < it.value().size(); x++)
+		{
+			r += static_cast<quint64>(it.value().at(x).data.size());
+		}
+		++it;
+	}
+	r += pixmap_bytes(v->icon);
+	r += pixmap_bytes(v->histogram);
+	return r;
+}
+
+void MemoryBudget::touch(ImageVariant * v)
+{
+	if (!v) return;
+	v->last_viewed = ++view_clock;
+}
+
+// Writes the pixel buffer to a temporary file and releases it,
+// the pyramid is dropped, it is built again when required.
+bool MemoryBudget::spill(ImageVariant * v)
+{
+	if (!v || v->spill || v->bricks) return false;
+	const quint64 size = process(v, BufferBytes, NULL);
+	if (size < 1) return false;
+	const QString d = QDir::tempPath();
+#if QT_VERSION >= QT_VERSION_CHECK(5,4,0)
+	{
+		const QStorageInfo si(d);
+		if (si.isValid() &&
+			static_cast<quint64>(si.bytesAvailable()) < size)
+		{
+			std::cout << "MemoryBudget: not enough space in "
+				<< d.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+	}
+#endif
+	QTemporaryFile * f =
+		new QTemporaryFile(d + QString("/alizams_XXXXXX.spill"));
+	if (!f->open() || process(v, SpillBuffer, f) != size)
+	{
+		delete f;
+		return false;
+	}
+	v->spill = f;
+	v->pyramid.clear();
+	v->pyramid_source = NULL;
+	v->pyramid_mtime = 0;
+	return true;
+}
+
+// Returns false only if the image was spilled and can not be
+// restored, e.g. not enough memory, the file is kept.
+bool MemoryBudget::restore(ImageVariant * v)
+{
+	if (!v) return false;
+	if (!v->spill) return true;
+	const quint64 size = static_cast<quint64>(v->spill->size());
+	if (process(v, RestoreBuffer, v->spill) != size)
+	{
+		std::cout << "MemoryBudget: failed to restore image "
+			<< v->id << std::endl;
+		return false;
+	}
+	delete v->spill;
+	v->spill = NULL;
+	return true;
+}
+
+// Spills the least recently viewed images until the total is not
+// above the budget. Images in 'keep', grouped images and out-of-core
+// images are not evicted.
+void MemoryBudget::enforce(
+	const QList<ImageVariant*> & images,
+	const QList<ImageVariant*> & keep)
+{
+	const quint64 b = get_budget();
+	if (b < 1) return;
+	quint64 total = 0;
+	QMap<QPair<quint64, int>, ImageVariant*> candidates;
+	for (int x = 0; x < images.size(); x++)
+	{
+		ImageVariant * v = images.at(x);
+		if (!v) continue;
+		total += image_bytes(v);
+		if (v->group_id >= 0 || v->bricks || v->spill) continue;
+		if (keep.contains(v)) continue;
+		candidates.insert(qMakePair(v->last_viewed, v->id), v);
+	}
+	QMap<QPair<quint64, int>, ImageVariant*>::const_iterator it =
+		candidates.constBegin();
+	while (total > b && it != candidates.constEnd())
+	{
+		ImageVariant * v = it.value();
+		const quint64 before = image_bytes(v);
+		if (spill(v))
+		{
+			const quint64 after = image_bytes(v);
+			if (before > after) total -= before - after;
+		}
+		++it;
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef MEMORYBUDGET__H
+#define MEMORYBUDGET__H
+
+#include <QtGlobal>
+#include <QList>
+
+class ImageVariant;
+
+// Accounting of the memory of loaded images and eviction of the
+// least recently viewed pixel buffers to temporary files, when the
+// total is above the budget. Evicted images are restored on access.
+class MemoryBudget
+{
+public:
+	static void set_budget(quint64);
+	static quint64 get_budget();
+	static quint64 image_bytes(const ImageVariant*);
+	static void touch(ImageVariant*);
+	static bool spill(ImageVariant*);
+	static bool restore(ImageVariant*);
+	static void enforce(
+		const QList<ImageVariant*>&,
+		const QList<ImageVariant*>&);
+};
+
+#endif // MEMORYBUDGET__H
@@ -5,6 +5,9 @@
 #include "CG/glwidget-qt4.h"
 #endif
 #include "commonutils.h"
+#include "brickvolume.h"
+#include "prconfigutils.h"
+#include <QTemporaryFile>
 #include <climits>
 
 DisplayInterface::DisplayInterface(
@@ -273,12 +276,34 @@ ImageVariant::ImageVariant(
 	orientation_string = QString("");
 	iod_supported = false;
 	rescale_disabled = false;
+	pyramid_source = NULL;
+	pyramid_mtime = 0;
+	bricks = NULL;
+	pr_slices = NULL;
+	spill = NULL;
+	last_viewed = 0;
 	modified = false;
 	ybr = false;
 }
 
 ImageVariant::~ImageVariant()
 {
+	pyramid.clear();
+	if (bricks)
+	{
+		delete bricks;
+		bricks = NULL;
+	}
+	if (pr_slices)
+	{
+		delete pr_slices;
+		pr_slices = NULL;
+	}
+	if (spill)
+	{
+		delete spill;
+		spill = NULL;
+	}
 	// highly likely not required
 	if(pSS.IsNotNull())     {pSS->DisconnectPipeline();     };pSS     =NULL;
 	if(pUS.IsNotNull())     {pUS->DisconnectPipeline();     };pUS     =NULL;
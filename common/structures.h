@@ -14,12 +14,14 @@
 #include "itkImageRegionConstIterator.h"
 #include "mdcmTag.h"
 #include <QString>
+#include <QByteArray>
 #include <QStringList>
 #include <QVector>
 #include <QMap>
 #include <QMultiMap>
 #include <QVariant>
 #include <QList>
+#include <QPair>
 #include <QThread>
 #include <QPixmap>
 #include <QPainterPath>
@@ -32,6 +34,9 @@
 
 class GLWidget;
 class qMeshData;
+class BrickVolume;
+class PrSlices;
+class QTemporaryFile;
 
 typedef itk::Image<signed short,       3> ImageTypeSS;
 typedef itk::Image<unsigned short,     3> ImageTypeUS;
@@ -151,53 +156,85 @@ typedef struct
 
 typedef std::vector<DimIndexValue> DimIndexValues;
 
-class FrameGroup
+// Per-frame functional groups, one column per attribute,
+// row is the frame number. Multi-valued attributes are stored
+// with fixed stride (3 for positions, 6 for orientations,
+// 2 for pixel spacing), strings are kept only where required.
+class FrameGroupValues
 {
 public:
-	FrameGroup() :
-		stack_id_ok(false),
-		in_stack_pos_num_ok(false),
-		temp_pos_idx_ok(false),
-		vol_orient_ok(false),
-		vol_pos_ok(false),
-		temp_pos_off_ok(false),
-		us_temp_pos_unknown_ok(false),
-		rescale_ok(false) {}
-	~FrameGroup() {}
-	unsigned int id;
-	unsigned int stack_id;
-	unsigned int in_stack_pos_num;
-	unsigned int temp_pos_idx;
-	double vol_pos[3];
-	double vol_orient[6];
-	double temp_pos_off;
-	double us_temp_pos_unknown;
-	double rescale_intercept;
-	double rescale_slope;
-	QString pat_pos;
-	QString pat_orient;
-	QString pix_spacing;
-	QString slice_thick;
-	QString window_center;
-	QString window_width;
-	QString lut_function;
-	QString data_type;
-	QString frame_body_part;
-	QString frame_laterality;
-	QString rescale_type;
-	QString frame_acquisition_datetime;
-	QString frame_reference_datetime;
-	bool stack_id_ok;
-	bool in_stack_pos_num_ok;
-	bool temp_pos_idx_ok;
-	bool vol_orient_ok;
-	bool vol_pos_ok;
-	bool temp_pos_off_ok;
-	bool us_temp_pos_unknown_ok;
-	bool rescale_ok;
-};
+	FrameGroupValues() : count(0) {}
+	~FrameGroupValues() {}
+	size_t size() const { return count; }
+	bool empty() const { return (count == 0); }
+	void resize(size_t n)
+	{
+		count = n;
+		stack_id.resize(n, 0);
+		in_stack_pos_num.resize(n, 0);
+		temp_pos_off.resize(n, 0.0);
+		vol_pos.resize(3*n, 0.0);
+		vol_orient.resize(6*n, 0.0);
+		pat_pos.resize(3*n, 0.0);
+		pat_orient.resize(6*n, 0.0);
+		pix_spacing.resize(2*n, 0.0);
+		slice_thick.resize(n, 0.0);
+		window_center.resize(n, 0.0);
+		window_width.resize(n, 0.0);
+		lut_function.resize(n, 0);
+		rescale_intercept.resize(n, 0.0);
+		rescale_slope.resize(n, 1.0);
+		stack_id_ok.resize(n, 0);
+		in_stack_pos_num_ok.resize(n, 0);
+		temp_pos_off_ok.resize(n, 0);
+		vol_pos_ok.resize(n, 0);
+		vol_orient_ok.resize(n, 0);
+		pat_pos_ok.resize(n, 0);
+		pat_orient_ok.resize(n, 0);
+		pix_spacing_ok.resize(n, 0);
+		slice_thick_ok.resize(n, 0);
+		window_ok.resize(n, 0);
+		rescale_ok.resize(n, 0);
+		frame_laterality.resize(n);
+		frame_body_part.resize(n);
+		rescale_type.resize(n);
+		frame_acquisition_datetime.resize(n);
+		frame_reference_datetime.resize(n);
+	}
+	std::vector<unsigned int> stack_id;
+	std::vector<unsigned int> in_stack_pos_num;
+	std::vector<double> temp_pos_off;
+	std::vector<double> vol_pos;
+	std::vector<double> vol_orient;
+	std::vector<double> pat_pos;
+	std::vector<double> pat_orient;
+	std::vector<double> pix_spacing;
+	std::vector<double> slice_thick;
+	std::vector<double> window_center; // 1st value only
+	std::vector<double> window_width;  // 1st value only
+	std::vector<short>  lut_function;  // 0 - LINEAR, 1 - LINEAR_EXACT, 2 - SIGMOID
+	std::vector<double> rescale_intercept;
+	std::vector<double> rescale_slope;
+	std::vector<unsigned char> stack_id_ok;
+	std::vector<unsigned char> in_stack_pos_num_ok;
+	std::vector<unsigned char> temp_pos_off_ok;
+	std::vector<unsigned char> vol_pos_ok;
+	std::vector<unsigned char> vol_orient_ok;
+	std::vector<unsigned char> pat_pos_ok;
+	std::vector<unsigned char> pat_orient_ok;
+	std::vector<unsigned char> pix_spacing_ok;
+	std::vector<unsigned char> slice_thick_ok;
+	std::vector<unsigned char> window_ok;
+	std::vector<unsigned char> rescale_ok;
+	std::vector<QString> frame_laterality;
+	std::vector<QString> frame_body_part;
+	std::vector<QString> rescale_type;
+	std::vector<QString> frame_acquisition_datetime;
+	std::vector<QString> frame_reference_datetime;
 
-typedef std::vector<FrameGroup> FrameGroupValues;
+private:
+	size_t count;
+};
 
 class Contour
 {
@@ -370,34 +407,16 @@ public:
 		:
 		dimx(0), dimy(0),
 		x(0), y(0) {}
-	SliceOverlay(const SliceOverlay & j)
-		:
-		dimx(j.dimx), dimy(j.dimy),
-		x(j.x), y(j.y)
-	{
-		for (size_t k = 0; k < j.data.size(); k++)
-		{
-			data.push_back(j.data.at(k));
-		}
-	}
 	~SliceOverlay() {}
 	int dimx;
 	int dimy;
 	int x;
 	int y;
-	std::vector<char> data;
-	SliceOverlay & operator=(const SliceOverlay & j)
-	{
-		dimx = j.dimx;
-		dimy = j.dimy;
-		x = j.x;
-		y = j.y;
-		for (size_t k = 0; k < j.data.size(); k++)
-		{
-			data.push_back(j.data.at(k));
-		}
-		return *this;
-	}
+	// One bit per pixel, least significant bit first, every row
+	// starts on a byte boundary. QByteArray is implicitly shared,
+	// copies of the overlay do not copy the bits.
+	QByteArray data;
+	int stride() const { return (dimx + 7) / 8; }
 };
 typedef QList<SliceOverlay> SliceOverlays;
 
@@ -850,6 +869,28 @@ public:
 	QPixmap icon;
 	QPixmap histogram;
 	bool rescale_disabled;
+	// Per-slice (intercept, slope) of the stored integer pixels,
+	// empty if the pixel data are already the rescaled values.
+	QList< QPair<double, double> > slice_rescale;
+	// Downsampled copies of the scalar image, x and y are halved
+	// per level, level 0 is the image itself and is not stored.
+	// See CommonUtils::build_pyramid.
+	QList<itk::ImageBase<3>::Pointer> pyramid;
+	const void * pyramid_source;
+	itk::ModifiedTimeType pyramid_mtime;
+	// Out-of-core scalar image, pixels are in the bricks cache
+	// file and pSS...pULL are NULL, the geometry has no buffer.
+	// See CommonUtils::gen_itk_image.
+	BrickVolume * bricks;
+	itk::ImageBase<3>::Pointer bricks_geometry;
+	// Presentation state applied lazily to the displayed slice, the
+	// pixel pointers are NULL. See PrConfigUtils::make_pr_monochrome.
+	PrSlices * pr_slices;
+	// Pixel buffer written out to free memory, the image keeps its
+	// regions and has no buffer until it is restored.
+	// See MemoryBudget::spill.
+	QTemporaryFile * spill;
+	quint64 last_viewed;
 	bool modified;
 	bool ybr;
 	//
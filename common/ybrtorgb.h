@@ -0,0 +1,87 @@
+#ifndef YBRTORGB__H
+#define YBRTORGB__H
+
+#include <QThread>
+#include <vector>
+#include <cstddef>
+
+// YBR_FULL to RGB, same arithmetic as the former per-pixel code,
+// 'in' and 'out' are interleaved, 3 values per pixel.
+// YBR_FULL_422 arrives here already upsampled by the codec.
+template<typename T> void convert_ybr_full_to_rgb_(
+	const T * in, T * out, const size_t n)
+{
+	for (size_t k = 0; k < n; k++)
+	{
+		const size_t j = 3*k;
+		const double Y  = static_cast<double>(in[j  ]);
+		const double Cb = static_cast<double>(in[j+1]);
+		const double Cr = static_cast<double>(in[j+2]);
+		int R = static_cast<int>((Y + 1.402*(Cr-128)) + 0.5);
+		int G = static_cast<int>((Y - (0.114*1.772*(Cb-128) + 0.299*1.402*(Cr-128))/0.587) + 0.5);
+		int B = static_cast<int>((Y + 1.772*(Cb-128)) + 0.5);
+		R = (R < 0) ? 0 : ((R > 255) ? 255 : R);
+		G = (G < 0) ? 0 : ((G > 255) ? 255 : G);
+		B = (B < 0) ? 0 : ((B > 255) ? 255 : B);
+		out[j  ] = static_cast<T>(R);
+		out[j+1] = static_cast<T>(G);
+		out[j+2] = static_cast<T>(B);
+	}
+}
+
+template<typename T> class ConvertYBRThread_ : public QThread
+{
+public:
+	ConvertYBRThread_(const T * in_, T * out_, const size_t n_)
+		: in(in_), out(out_), n(n_)
+	{
+	}
+	~ConvertYBRThread_()
+	{
+	}
+	void run()
+	{
+		convert_ybr_full_to_rgb_<T>(in, out, n);
+	}
+private:
+	const T * in;
+	T * out;
+	const size_t n;
+};
+
+// Blocks of at least 65536 pixels, at most 'max_threads' threads,
+// the last block takes the remainder.
+template<typename T> void convert_ybr_full_to_rgb_mt(
+	const T * in, T * out, const size_t n, const int max_threads)
+{
+	const size_t min_block = 65536;
+	int num_threads = max_threads;
+	if (num_threads < 1) num_threads = 1;
+	if (n < min_block * 2) num_threads = 1;
+	else if (n / min_block < static_cast<size_t>(num_threads))
+		num_threads = static_cast<int>(n / min_block);
+	if (num_threads == 1)
+	{
+		convert_ybr_full_to_rgb_<T>(in, out, n);
+		return;
+	}
+	const size_t block = n / num_threads;
+	std::vector<QThread*> threads;
+	for (int i = 0; i < num_threads; i++)
+	{
+		const size_t first = i * block;
+		const size_t count =
+			(i == num_threads - 1) ? n - first : block;
+		ConvertYBRThread_<T> * t__ = new ConvertYBRThread_<T>(
+			in + 3 * first, out + 3 * first, count);
+		threads.push_back(static_cast<QThread*>(t__));
+		t__->start();
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i]->wait();
+		delete threads[i];
+	}
+}
+
+#endif
@@ -43,6 +43,7 @@
 #include "mdcmImageHelper.h"
 #include "mdcmOverlay.h"
 #include "mdcmSplitMosaicFilter.h"
+#include "mdcmElscintCodec.h"
 #include "mdcmDataElement.h"
 #include "mdcmScanner.h"
 #include "mdcmCSAHeader.h"
@@ -60,11 +61,16 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
 #include <QDate>
 #include <QTime>
 #include "settingswidget.h"
 #include "iconutils.h"
 #include "updateqtcommand.h"
+#include "brickvolume.h"
 #include "findrefdialog.h"
 #include "srwidget.h"
 #include <iostream>
@@ -81,13 +87,31 @@ typedef Vectormath::Scalar::Matrix4 sMatrix4;
 
 namespace mdcm
 {
+// IPP and IOP of a file, parsed once before sorting
+class SortKey2
+{
+public:
+	SortKey2() : valid(false), dist(0.0)
+	{
+		for (int i = 0; i < 3; ++i) { ipp[i] = 0.0; normal[i] = 0.0; }
+		for (int i = 0; i < 6; ++i) iop[i] = 0.0;
+	}
+	QString filename;
+	bool valid;
+	double ipp[3];
+	double iop[6];
+	double normal[3];
+	// IPP projected on the normal
+	double dist;
+};
+
 class Sorter2
 {
 public:
 	Sorter2();
 	virtual ~Sorter2();
 	const std::vector<QString> & GetFilenames() const;
-	typedef bool (*SortFunction)(DataSet const &, DataSet const &);
+	typedef bool (*SortFunction)(SortKey2 const &, SortKey2 const &);
 	void SetSortFunction(SortFunction);
 	virtual bool StableSort(std::vector<QString> const &);
 protected:
@@ -99,9 +123,9 @@ namespace {
 class SortFunctor2
 {
 public:
-	bool operator() (File const *file1, File const *file2)
+	bool operator() (SortKey2 const *k1, SortKey2 const *k2)
 	{
-		return (SortFunc)(file1->GetDataSet(), file2->GetDataSet());
+		return (SortFunc)(*k1, *k2);
 	}
 	Sorter2::SortFunction SortFunc;
 	SortFunctor2()
@@ -117,14 +141,28 @@ public:
 		SortFunc = sf;
 	}
 };
-}
 
-class FileWithQString : public File
+void set_sort_key(DataSet const & ds, SortKey2 & k)
 {
-public:
-	FileWithQString(File & f) : File(f), filename(QString("")) {}
-	QString filename;
-};
+	k.valid = false;
+	const Tag t1(0x0020,0x0032);
+	const Tag t2(0x0020,0x0037);
+	if (!ds.FindDataElement(t1)||!ds.FindDataElement(t2))
+		return;
+	Attribute<0x0020,0x0032> ipp; ipp.Set(ds);
+	Attribute<0x0020,0x0037> iop; iop.Set(ds);
+	if (ipp.GetNumberOfValues()<3||iop.GetNumberOfValues()<6)
+		return;
+	for (int i = 0; i < 3; ++i) k.ipp[i] = ipp[i];
+	for (int i = 0; i < 6; ++i) k.iop[i] = iop[i];
+	k.normal[0] = k.iop[1]*k.iop[5] - k.iop[2]*k.iop[4];
+	k.normal[1] = k.iop[2]*k.iop[3] - k.iop[0]*k.iop[5];
+	k.normal[2] = k.iop[0]*k.iop[4] - k.iop[1]*k.iop[3];
+	k.dist = 0.0;
+	for (int i = 0; i < 3; ++i) k.dist += k.normal[i]*k.ipp[i];
+	k.valid = true;
+}
+}
 
 Sorter2::Sorter2() { SortFunc = 0; }
 
@@ -151,34 +189,26 @@ bool Sorter2::StableSort(
 	std::set<mdcm::Tag> tags;
 	tags.insert(mdcm::Tag(0x0020,0x0032));
 	tags.insert(mdcm::Tag(0x0020,0x0037));
-	std::vector< SmartPointer<FileWithQString> > filelist;
-	filelist.resize(filenames.size());
-	std::vector< SmartPointer<FileWithQString> >::iterator it2 =
-		filelist.begin();
-	for(
-		std::vector<QString>::const_iterator it =
-			filenames.begin();
-		it != filenames.end() && it2 != filelist.end();
-		++it, ++it2)
+	// the keys are parsed once per file, not in each comparison
+	std::vector<SortKey2> keys(filenames.size());
+	std::vector<SortKey2*> sorted(filenames.size());
+	for (size_t x = 0; x < filenames.size(); ++x)
 	{
 		Reader reader;
-		reader.SetFileName(it->toLocal8Bit().constData());
-		SmartPointer<FileWithQString> & f = *it2;
-		if (reader.ReadSelectedTags(tags))
-		{
-			f = new FileWithQString(reader.GetFile());
-			f->filename = *it;
-		}
-		else { return false; }
+		reader.SetFileName(filenames.at(x).toLocal8Bit().constData());
+		if (!reader.ReadSelectedTags(tags)) return false;
+		keys[x].filename = filenames.at(x);
+		set_sort_key(reader.GetFile().GetDataSet(), keys[x]);
+		sorted[x] = &keys[x];
 	}
 	SortFunctor2 sf;
 	sf = Sorter2::SortFunc;
-	std::stable_sort(filelist.begin(), filelist.end(), sf);
+	std::stable_sort(sorted.begin(), sorted.end(), sf);
 	Filenames.clear();
-	for(it2 = filelist.begin(); it2 != filelist.end(); ++it2 )
+	Filenames.reserve(sorted.size());
+	for (size_t x = 0; x < sorted.size(); ++x)
 	{
-		SmartPointer<FileWithQString> const & f = *it2;
-		Filenames.push_back(f->filename);
+		Filenames.push_back(sorted.at(x)->filename);
 	}
 	return true;
 }
@@ -186,41 +216,22 @@ bool Sorter2::StableSort(
 } // mdcm
 
 static bool sort0_(
-	mdcm::DataSet const & ds1,
-	mdcm::DataSet const & ds2)
+	mdcm::SortKey2 const & k1,
+	mdcm::SortKey2 const & k2)
 {
 	// IPP sorting
-	const mdcm::Tag t1(0x0020,0x0032);
-	if(!ds1.FindDataElement(t1)||!ds2.FindDataElement(t1))
-		return false;
-	const mdcm::Tag t2(0x0020,0x0037);
-	if(!ds1.FindDataElement(t2)||!ds2.FindDataElement(t2))
-		return false;
-	mdcm::Attribute<0x0020,0x0032> ipp1; ipp1.Set(ds1);
-	mdcm::Attribute<0x0020,0x0037> iop1; iop1.Set(ds1);
-	mdcm::Attribute<0x0020,0x0032> ipp2; ipp2.Set(ds2);
-	mdcm::Attribute<0x0020,0x0037> iop2; iop2.Set(ds2);
-	if (ipp1.GetNumberOfValues()<3||ipp2.GetNumberOfValues()<3)
-		return false;
-	if (iop1.GetNumberOfValues()<6||iop2.GetNumberOfValues()<6)
+	if (!k1.valid||!k2.valid)
 		return false;
 	const double t = 0.001;
-	if (!(
-		((iop1[0] + t) > iop2[0]) && ((iop1[0] - t) < iop2[0]) &&
-		((iop1[1] + t) > iop2[1]) && ((iop1[1] - t) < iop2[1]) &&
-		((iop1[2] + t) > iop2[2]) && ((iop1[2] - t) < iop2[2]) &&
-		((iop1[3] + t) > iop2[3]) && ((iop1[3] - t) < iop2[3]) &&
-		((iop1[4] + t) > iop2[4]) && ((iop1[4] - t) < iop2[4]) &&
-		((iop1[5] + t) > iop2[5]) && ((iop1[5] - t) < iop2[5])))
-		return false;
-	double normal[3];
-	normal[0] = iop1[1]*iop1[5] - iop1[2]*iop1[4];
-	normal[1] = iop1[2]*iop1[3] - iop1[0]*iop1[5];
-	normal[2] = iop1[0]*iop1[4] - iop1[1]*iop1[3];
-	double dist1 = 0, dist2 = 0;
-	for (int i = 0; i < 3; ++i) dist1 += normal[i]*ipp1[i];
-	for (int i = 0; i < 3; ++i) dist2 += normal[i]*ipp2[i];
-	return (dist1 < dist2);
+	for (int i = 0; i < 6; ++i)
+	{
+		if (!(((k1.iop[i] + t) > k2.iop[i]) && ((k1.iop[i] - t) < k2.iop[i])))
+			return false;
+	}
+	// normal of the first
+	double dist2 = 0;
+	for (int i = 0; i < 3; ++i) dist2 += k1.normal[i]*k2.ipp[i];
+	return (k1.dist < dist2);
 }
 
 static QString generate_string_0(
@@ -2785,6 +2796,58 @@ bool DicomUtils::read_dimension_index_values(
 	return false;
 }
 
+// Nested DataSet of a sequence with exactly one item, sq keeps
+// the sequence alive (it may be parsed from a byte value).
+static const mdcm::DataSet * get_single_item_ds_(
+	const mdcm::DataSet & ds,
+	const mdcm::Tag & t,
+	mdcm::SmartPointer<mdcm::SequenceOfItems> & sq)
+{
+	if (!ds.FindDataElement(t)) return NULL;
+	sq = ds.GetDataElement(t).GetValueAsSQ();
+	if (!(sq && sq->GetNumberOfItems()==1)) return NULL;
+	return &(sq->GetItem(1).GetNestedDataSet());
+}
+
+// Parse DS/IS values directly from the byte value, stores up to n
+// values, returns number of values or 0 on error.
+static unsigned int get_ds_array_(
+	const mdcm::DataSet & ds,
+	const mdcm::Tag & t,
+	double * r,
+	const unsigned int n)
+{
+	if (!ds.FindDataElement(t)) return 0;
+	const mdcm::DataElement & e = ds.GetDataElement(t);
+	if (e.IsEmpty() || e.IsUndefinedLength()) return 0;
+	const mdcm::ByteValue * bv = e.GetByteValue();
+	if (!bv) return 0;
+	const char * p = bv->GetPointer();
+	const unsigned int len = bv->GetLength();
+	unsigned int j = 0;
+	unsigned int k = 0;
+	for (unsigned int i = 0; i <= len; i++)
+	{
+		const bool end = (i == len || p[i] == '\0');
+		if (end || p[i] == '\\')
+		{
+			const QByteArray tmp0 =
+				QByteArray(p + k, i - k).trimmed();
+			if (!tmp0.isEmpty())
+			{
+				bool ok = false;
+				const double tmp1 = tmp0.toDouble(&ok);
+				if (!ok) return 0;
+				if (j < n) r[j] = tmp1;
+				j++;
+			}
+			if (end) break;
+			k = i + 1;
+		}
+	}
+	return j;
+}
+
 bool DicomUtils::read_group_sq(
 	const mdcm::DataSet & ds,
 	const mdcm::Tag & t,
@@ -2802,7 +2865,6 @@ bool DicomUtils::read_group_sq(
 	const mdcm::Tag tTemporalPositionSequence(0x0020,0x9310);
 	const mdcm::Tag tPlanePositionVolumeSequence(0x0020,0x930e);
 	const mdcm::Tag tPlaneOrientationVolumeSequence(0x0020,0x930f);
-	const mdcm::Tag tImageDataTypeSequence(0x0018,0x9807);
 	const mdcm::Tag tFrameAnatomySequence(0x0020,0x9071);
 	const mdcm::Tag tAnatomicRegionSequence(0x0008,0x2218);
 	const mdcm::Tag tCodeMeaning(0x0008,0x0104);
@@ -2810,7 +2872,6 @@ bool DicomUtils::read_group_sq(
 	const mdcm::Tag tDimensionIndexValues(0x0020,0x9157);
 	const mdcm::Tag tStackID(0x0020,0x9056);
 	const mdcm::Tag tInStackPositionNumber(0x0020,0x9057);
-	const mdcm::Tag tTemporalPositionIndex(0x0020,0x9128);
 	const mdcm::Tag tImagePositionPatient(0x0020,0x0032);
 	const mdcm::Tag tImageOrientationPatient(0x0020,0x0037);
 	const mdcm::Tag tPixelSpacing(0x0028,0x0030);               // Pixel Spacing
@@ -2824,7 +2885,6 @@ bool DicomUtils::read_group_sq(
 	const mdcm::Tag tTemporalPositionTimeOffset(0x0020,0x930d);
 	const mdcm::Tag tImagePositionVolume(0x0020,0x9301);
 	const mdcm::Tag tImageOrientationVolume(0x0020,0x9302);
-	const mdcm::Tag tDataType(0x0018,0x9808);
 	const mdcm::Tag tPixelValueTransformationSequence(0x0028,0x9145);
 	const mdcm::Tag tRescaleIntercept(0x0028,0x1052);
 	const mdcm::Tag tRescaleSlope(0x0028,0x1053);
@@ -2851,440 +2911,234 @@ bool DicomUtils::read_group_sq(
 		deGroup.GetValueAsSQ();
 	if (!(sqGroup && sqGroup->GetNumberOfItems()>0))
 		return false;
-	for (unsigned int x = 0; x < sqGroup->GetNumberOfItems(); x++)
-	{
-		FrameGroup fg;
-		fg.id = x;
-		fg.stack_id_ok = false;
-		fg.in_stack_pos_num_ok = false;
-		fg.temp_pos_idx_ok = false;
-		fg.vol_orient_ok = false;
-		fg.vol_pos_ok = false;
-		fg.temp_pos_off_ok = false;
-		fg.us_temp_pos_unknown_ok = false;
+	const unsigned int count = sqGroup->GetNumberOfItems();
+	values.resize(count);
+	dim_idx_values.reserve(dim_idx_values.size() + count);
+	mdcm::SmartPointer<mdcm::SequenceOfItems> sq1;
+	mdcm::SmartPointer<mdcm::SequenceOfItems> sq2;
+	for (unsigned int x = 0; x < count; x++)
+	{
 		const mdcm::Item & item = sqGroup->GetItem(x+1);
 		const mdcm::DataSet & nestedds = item.GetNestedDataSet();
-		if (nestedds.FindDataElement(tFrameContentSequence))
-		{
-			const mdcm::DataElement & deFrameContentSequence =
-				nestedds.GetDataElement(tFrameContentSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems>
-				sqFrameContentSequence =
-					deFrameContentSequence.GetValueAsSQ();
-			if (sqFrameContentSequence &&
-				sqFrameContentSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 =
-					sqFrameContentSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 =
-					item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tDimensionIndexValues))
-				{
-					DimIndexValue index_value;
-					index_value.id = x;
-					const bool ok = get_ul_values(
-						nestedds1,
-						tDimensionIndexValues,
-						index_value.idx);
-					if (ok && index_value.idx.size()==sq.size())
-						dim_idx_values.push_back(index_value);
-				}
-				if (nestedds1.FindDataElement(tStackID))
-				{
-					const mdcm::DataElement & deStackID =
-						nestedds1.GetDataElement(tStackID);
-					if (!deStackID.IsEmpty() &&
-						!deStackID.IsUndefinedLength() &&
-						deStackID.GetByteValue())
-						fg.stack_id=
-							QVariant(QString::fromLatin1(
-								deStackID.GetByteValue()->GetPointer(),
-								deStackID.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'))
-								).toInt(&fg.stack_id_ok);
-				}
-				if (nestedds1.FindDataElement(tInStackPositionNumber))
-				{
-					const mdcm::DataElement & deInStackPositionNumber
-						= nestedds1.GetDataElement(tInStackPositionNumber);
-					if (!deInStackPositionNumber.IsEmpty() &&
-						!deInStackPositionNumber.IsUndefinedLength() &&
-						deInStackPositionNumber.GetByteValue())
-						fg.in_stack_pos_num_ok = get_ul_value(
-							nestedds1,
-							tInStackPositionNumber,
-							&fg.in_stack_pos_num);
-				}
-				QString FrameAcquisitionDateTime;
-				if (
-					get_string_value(
-						nestedds1,
-						tFrameAcquisitionDateTime,
-						FrameAcquisitionDateTime))
-				{
-					fg.frame_acquisition_datetime =
-						FrameAcquisitionDateTime;
-				}
-				QString FrameReferenceDateTime;
-				if (
-					get_string_value(
-						nestedds1,
-						tFrameReferenceDateTime,
-						FrameReferenceDateTime))
-				{
-					fg.frame_reference_datetime =
-						FrameReferenceDateTime;
-				}
-			}
-		}
-		if (nestedds.FindDataElement(tPlanePositionSequence))
-		{
-			const mdcm::DataElement & dePlanePositionSequence
-				= nestedds.GetDataElement(tPlanePositionSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqPlanePositionSequence
-				= dePlanePositionSequence.GetValueAsSQ();
-			if (sqPlanePositionSequence && sqPlanePositionSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 = sqPlanePositionSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tImagePositionPatient))
-				{
-					const mdcm::DataElement & deImagePositionPatient
-						= nestedds1.GetDataElement(tImagePositionPatient);
-					if (!deImagePositionPatient.IsEmpty() &&
-						!deImagePositionPatient.IsUndefinedLength() &&
-						deImagePositionPatient.GetByteValue())
-						fg.pat_pos =
-							QString::fromLatin1(
-								deImagePositionPatient.GetByteValue()->GetPointer(),
-								deImagePositionPatient.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-			}
-		}
-		if (nestedds.FindDataElement(tPlaneOrientationSequence))
-		{
-			const mdcm::DataElement & dePlaneOrientationSequence
-				= nestedds.GetDataElement(tPlaneOrientationSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqPlaneOrientationSequence
-				= dePlaneOrientationSequence.GetValueAsSQ();
-			if (sqPlaneOrientationSequence &&
-				sqPlaneOrientationSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 = sqPlaneOrientationSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tImageOrientationPatient))
-				{
-					const mdcm::DataElement & deImageOrientationPatient
-						= nestedds1.GetDataElement(tImageOrientationPatient);
-					if (!deImageOrientationPatient.IsEmpty() &&
-						!deImageOrientationPatient.IsUndefinedLength() &&
-						deImageOrientationPatient.GetByteValue())
-						fg.pat_orient =
-							QString::fromLatin1(
-								deImageOrientationPatient.GetByteValue()->GetPointer(),
-								deImageOrientationPatient.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-			}
-		}
-		if (nestedds.FindDataElement(tPixelMeasuresSequence))
-		{
-			const mdcm::DataElement & dePixelMeasuresSequence
-				= nestedds.GetDataElement(tPixelMeasuresSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqPixelMeasuresSequence
-				= dePixelMeasuresSequence.GetValueAsSQ();
-			if (sqPixelMeasuresSequence && sqPixelMeasuresSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 = sqPixelMeasuresSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tPixelSpacing))
-				{
-					const mdcm::DataElement & dePixelSpacing
-						= nestedds1.GetDataElement(tPixelSpacing);
-					if (!dePixelSpacing.IsEmpty() &&
-						!dePixelSpacing.IsUndefinedLength() &&
-						dePixelSpacing.GetByteValue())
-						fg.pix_spacing =
-							QString::fromLatin1(
-								dePixelSpacing.GetByteValue()->GetPointer(),
-								dePixelSpacing.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				else if (nestedds1.FindDataElement(tImagerPixelSpacing))
-				{
-					const mdcm::DataElement & deImagerPixelSpacing
-						= nestedds1.GetDataElement(tImagerPixelSpacing);
-					if (!deImagerPixelSpacing.IsEmpty() &&
-						!deImagerPixelSpacing.IsUndefinedLength() &&
-						deImagerPixelSpacing.GetByteValue())
-						fg.pix_spacing =
-							QString::fromLatin1(
-								deImagerPixelSpacing.GetByteValue()->GetPointer(),
-								deImagerPixelSpacing.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				else if (nestedds1.FindDataElement(tNominalScannedPixelSpacing))
-				{
-					const mdcm::DataElement & deNominalScannedPixelSpacing
-						= nestedds1.GetDataElement(tNominalScannedPixelSpacing);
-					if (!deNominalScannedPixelSpacing.IsEmpty() &&
-						!deNominalScannedPixelSpacing.IsUndefinedLength() &&
-						deNominalScannedPixelSpacing.GetByteValue())
-						fg.pix_spacing =
-							QString::fromLatin1(
-								deNominalScannedPixelSpacing.GetByteValue()->GetPointer(),
-								deNominalScannedPixelSpacing.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				else if (nestedds1.FindDataElement(tPixelAspectRatio))
-				{
-					const mdcm::DataElement & dePixelAspectRatio
-						= nestedds1.GetDataElement(tPixelAspectRatio);
-					if (!dePixelAspectRatio.IsEmpty() &&
-						!dePixelAspectRatio.IsUndefinedLength() &&
-						dePixelAspectRatio.GetByteValue())
-						fg.pix_spacing =
-							QString::fromLatin1(
-								dePixelAspectRatio.GetByteValue()->GetPointer(),
-								dePixelAspectRatio.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				else { ;; }
-				if (nestedds1.FindDataElement(tSliceThickness))
-				{
-					const mdcm::DataElement & deSliceThickness
-						= nestedds1.GetDataElement(tSliceThickness);
-					if (!deSliceThickness.IsEmpty() &&
-						!deSliceThickness.IsUndefinedLength() &&
-						deSliceThickness.GetByteValue())
-						fg.slice_thick =
-							QString::fromLatin1(
-								deSliceThickness.GetByteValue()->GetPointer(),
-								deSliceThickness.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-			}
-		}
-		if (nestedds.FindDataElement(tFrameAnatomySequence))
-		{
-			const mdcm::DataElement & deFrameAnatomySequence
-				= nestedds.GetDataElement(tFrameAnatomySequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqFrameAnatomySequence
-				= deFrameAnatomySequence.GetValueAsSQ();
-			if (sqFrameAnatomySequence &&
-				sqFrameAnatomySequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 = sqFrameAnatomySequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tFrameLaterality))
-				{
-					const mdcm::DataElement & deFrameLaterality
-						= nestedds1.GetDataElement(tFrameLaterality);
-					if (!deFrameLaterality.IsEmpty() &&
-						!deFrameLaterality.IsUndefinedLength() &&
-						deFrameLaterality.GetByteValue())
-						fg.frame_laterality =
-							QString::fromLatin1(
-								deFrameLaterality.GetByteValue()->GetPointer(),
-								deFrameLaterality.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				if (nestedds1.FindDataElement(tAnatomicRegionSequence))
-				{
-					const mdcm::DataElement & deAnatomicRegionSequence
-						= nestedds1.GetDataElement(tAnatomicRegionSequence);
-					mdcm::SmartPointer<mdcm::SequenceOfItems> sqAnatomicRegionSequence
-						= deAnatomicRegionSequence.GetValueAsSQ();
-					if (sqAnatomicRegionSequence &&
-						sqAnatomicRegionSequence->GetNumberOfItems()==1)
-					{
-						const mdcm::Item & item2 = sqAnatomicRegionSequence->GetItem(1);
-						const mdcm::DataSet & nestedds2 = item2.GetNestedDataSet();
-						if (nestedds2.FindDataElement(tCodeMeaning))
-						{
-							const mdcm::DataElement & deCodeMeaning
-								= nestedds2.GetDataElement(tCodeMeaning);
-							if (!deCodeMeaning.IsEmpty() &&
-								!deCodeMeaning.IsUndefinedLength() &&
-								deCodeMeaning.GetByteValue())
-							{
-								QByteArray baCodeMeaning(
-									deCodeMeaning.GetByteValue()->GetPointer(),
-									deCodeMeaning.GetByteValue()->GetLength());
-								const QString frame_body_part =
-									CodecUtils::toUTF8(
-										&baCodeMeaning,
-										charset.toLatin1().constData());
-								if (!frame_body_part.isEmpty())
-									fg.frame_body_part =
-										frame_body_part.
-											trimmed().
-												remove(QChar('\0'));
-							}
-						}
-					}
+		const mdcm::DataSet * nestedds1 = NULL;
+		nestedds1 = get_single_item_ds_(
+			nestedds, tFrameContentSequence, sq1);
+		if (nestedds1)
+		{
+			if (nestedds1->FindDataElement(tDimensionIndexValues))
+			{
+				DimIndexValue index_value;
+				index_value.id = x;
+				const bool ok = get_ul_values(
+					*nestedds1,
+					tDimensionIndexValues,
+					index_value.idx);
+				if (ok && index_value.idx.size()==sq.size())
+					dim_idx_values.push_back(index_value);
+			}
+			QString StackID;
+			if (get_string_value(*nestedds1, tStackID, StackID))
+			{
+				bool ok = false;
+				values.stack_id[x] =
+					StackID.remove(QChar('\0')).trimmed().toInt(&ok);
+				values.stack_id_ok[x] = ok;
+			}
+			values.in_stack_pos_num_ok[x] = get_ul_value(
+				*nestedds1,
+				tInStackPositionNumber,
+				&values.in_stack_pos_num[x]);
+			QString FrameAcquisitionDateTime;
+			if (
+				get_string_value(
+					*nestedds1,
+					tFrameAcquisitionDateTime,
+					FrameAcquisitionDateTime))
+			{
+				values.frame_acquisition_datetime[x] =
+					FrameAcquisitionDateTime;
+			}
+			QString FrameReferenceDateTime;
+			if (
+				get_string_value(
+					*nestedds1,
+					tFrameReferenceDateTime,
+					FrameReferenceDateTime))
+			{
+				values.frame_reference_datetime[x] =
+					FrameReferenceDateTime;
+			}
+		}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tPlanePositionSequence, sq1);
+		if (nestedds1)
+		{
+			values.pat_pos_ok[x] = (get_ds_array_(
+				*nestedds1,
+				tImagePositionPatient,
+				&values.pat_pos[3*x], 3) == 3);
+		}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tPlaneOrientationSequence, sq1);
+		if (nestedds1)
+		{
+			values.pat_orient_ok[x] = (get_ds_array_(
+				*nestedds1,
+				tImageOrientationPatient,
+				&values.pat_orient[6*x], 6) == 6);
+		}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tPixelMeasuresSequence, sq1);
+		if (nestedds1)
+		{
+			mdcm::Tag tSpacing(0xffff,0xffff);
+			if (nestedds1->FindDataElement(tPixelSpacing))
+				tSpacing = tPixelSpacing;
+			else if (nestedds1->FindDataElement(tImagerPixelSpacing))
+				tSpacing = tImagerPixelSpacing;
+			else if (nestedds1->FindDataElement(tNominalScannedPixelSpacing))
+				tSpacing = tNominalScannedPixelSpacing;
+			else if (nestedds1->FindDataElement(tPixelAspectRatio))
+				tSpacing = tPixelAspectRatio;
+			double * ps = &values.pix_spacing[2*x];
+			const unsigned int tmp0 =
+				get_ds_array_(*nestedds1, tSpacing, ps, 2);
+			if (tmp0 == 1)
+			{
+				ps[1] = ps[0];
+				values.pix_spacing_ok[x] = 1;
+			}
+			else if (tmp0 == 2)
+			{
+				values.pix_spacing_ok[x] = 1;
+			}
+			values.slice_thick_ok[x] = (get_ds_array_(
+				*nestedds1,
+				tSliceThickness,
+				&values.slice_thick[x], 1) > 0);
+		}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tFrameAnatomySequence, sq1);
+		if (nestedds1)
+		{
+			QString FrameLaterality;
+			if (get_string_value(*nestedds1, tFrameLaterality, FrameLaterality))
+				values.frame_laterality[x] =
+					FrameLaterality.remove(QChar('\0'));
+			const mdcm::DataSet * nestedds2 = get_single_item_ds_(
+				*nestedds1, tAnatomicRegionSequence, sq2);
+			if (nestedds2 && nestedds2->FindDataElement(tCodeMeaning))
+			{
+				const mdcm::DataElement & deCodeMeaning =
+					nestedds2->GetDataElement(tCodeMeaning);
+				if (!deCodeMeaning.IsEmpty() &&
+					!deCodeMeaning.IsUndefinedLength() &&
+					deCodeMeaning.GetByteValue())
+				{
+					QByteArray baCodeMeaning(
+						deCodeMeaning.GetByteValue()->GetPointer(),
+						deCodeMeaning.GetByteValue()->GetLength());
+					const QString frame_body_part =
+						CodecUtils::toUTF8(
+							&baCodeMeaning,
+							charset.toLatin1().constData());
+					if (!frame_body_part.isEmpty())
+						values.frame_body_part[x] =
+							frame_body_part.
+								trimmed().
+									remove(QChar('\0'));
 				}
 			}
 		}
-		if (nestedds.FindDataElement(tFrameVOILUTSequence))
-		{
-			const mdcm::DataElement & deFrameVOILUTSequence
-				= nestedds.GetDataElement(tFrameVOILUTSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqFrameVOILUTSequence
-				= deFrameVOILUTSequence.GetValueAsSQ();
-			if (sqFrameVOILUTSequence &&
-				sqFrameVOILUTSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 = sqFrameVOILUTSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tWindowCenter))
-				{
-					const mdcm::DataElement & deWindowCenter
-						= nestedds1.GetDataElement(tWindowCenter);
-					if (!deWindowCenter.IsEmpty() &&
-						!deWindowCenter.IsUndefinedLength() &&
-						deWindowCenter.GetByteValue())
-						fg.window_center =
-							QString::fromLatin1(
-								deWindowCenter.GetByteValue()->GetPointer(),
-								deWindowCenter.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				if (nestedds1.FindDataElement(tWindowWidth))
-				{
-					const mdcm::DataElement & deWindowWidth
-						= nestedds1.GetDataElement(tWindowWidth);
-					if (!deWindowWidth.IsEmpty() &&
-						!deWindowWidth.IsUndefinedLength() &&
-						deWindowWidth.GetByteValue())
-						fg.window_width =
-							QString::fromLatin1(
-								deWindowWidth.GetByteValue()->GetPointer(),
-								deWindowWidth.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-				if (nestedds1.FindDataElement(tLUTFunction))
-				{
-					const mdcm::DataElement & deLUTFunction
-						= nestedds1.GetDataElement(tLUTFunction);
-					if (!deLUTFunction.IsEmpty() &&
-						!deLUTFunction.IsUndefinedLength() &&
-						deLUTFunction.GetByteValue())
-						fg.lut_function =
-							QString::fromLatin1(
-								deLUTFunction.GetByteValue()->GetPointer(),
-								deLUTFunction.GetByteValue()->GetLength()).
-									trimmed().remove(QChar('\0'));
-				}
-			}
-		}
-		if (nestedds.FindDataElement(tTemporalPositionSequence))
-		{
-			const mdcm::DataElement &
-				deTemporalPositionSequence
-					= nestedds.GetDataElement(tTemporalPositionSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems>
-				sqTemporalPositionSequence =
-					deTemporalPositionSequence.GetValueAsSQ();
-			if (sqTemporalPositionSequence &&
-				sqTemporalPositionSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 =
-					sqTemporalPositionSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				if (nestedds1.FindDataElement(tTemporalPositionTimeOffset))
-					fg.temp_pos_off_ok =
-						get_fd_value(
-							nestedds1,
-							tTemporalPositionTimeOffset,
-							&fg.temp_pos_off);
-			}
-		}
-		if (nestedds.FindDataElement(tPlanePositionVolumeSequence))
-		{
-			const mdcm::DataElement & dePlanePositionVolumeSequence
-				= nestedds.GetDataElement(tPlanePositionVolumeSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems>
-				sqPlanePositionVolumeSequence =
-				dePlanePositionVolumeSequence.GetValueAsSQ();
-			if (sqPlanePositionVolumeSequence &&
-				sqPlanePositionVolumeSequence->GetNumberOfItems()==1)
-			{
-				const mdcm::Item & item1 =
-					sqPlanePositionVolumeSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 =
-					item1.GetNestedDataSet();
-				std::vector<double> tmp1;
-				if (get_fd_values(
-						nestedds1,
-						tImagePositionVolume,
-						tmp1))
-				{
-					if (tmp1.size()==3)
-					{
-						fg.vol_pos_ok = true;
-						fg.vol_pos[0]=tmp1.at(0);
-						fg.vol_pos[1]=tmp1.at(1);
-						fg.vol_pos[2]=tmp1.at(2);
-					}
-				}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tFrameVOILUTSequence, sq1);
+		if (nestedds1)
+		{
+			values.window_ok[x] =
+				(get_ds_array_(
+					*nestedds1,
+					tWindowCenter,
+					&values.window_center[x], 1) > 0) &&
+				(get_ds_array_(
+					*nestedds1,
+					tWindowWidth,
+					&values.window_width[x], 1) > 0);
+			QString LUTFunction;
+			if (get_string_value(*nestedds1, tLUTFunction, LUTFunction))
+			{
+				const QString tmp0 =
+					LUTFunction.remove(QChar('\0')).trimmed().toUpper();
+				if (tmp0 == QString("SIGMOID"))
+					values.lut_function[x] = 2;
+				else if (tmp0 == QString("LINEAR_EXACT"))
+					values.lut_function[x] = 1;
 			}
 		}
-		if (nestedds.FindDataElement(tPlaneOrientationVolumeSequence))
+		nestedds1 = get_single_item_ds_(
+			nestedds, tTemporalPositionSequence, sq1);
+		if (nestedds1)
+		{
+			values.temp_pos_off_ok[x] =
+				get_fd_value(
+					*nestedds1,
+					tTemporalPositionTimeOffset,
+					&values.temp_pos_off[x]);
+		}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tPlanePositionVolumeSequence, sq1);
+		if (nestedds1)
 		{
-			const mdcm::DataElement & dePlaneOrientationVolumeSequence
-				= nestedds.GetDataElement(tPlaneOrientationVolumeSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqPlaneOrientationVolumeSequence
-				= dePlaneOrientationVolumeSequence.GetValueAsSQ();
-			if (sqPlaneOrientationVolumeSequence &&
-				sqPlaneOrientationVolumeSequence->GetNumberOfItems()==1)
+			std::vector<double> tmp1;
+			if (get_fd_values(
+					*nestedds1,
+					tImagePositionVolume,
+					tmp1) && tmp1.size()==3)
 			{
-				const mdcm::Item & item1 = sqPlaneOrientationVolumeSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				std::vector<double> tmp1;
-				if (get_fd_values(nestedds1, tImageOrientationVolume, tmp1))
-				{
-					if (tmp1.size()==6)
-					{
-						fg.vol_orient_ok = true;
-						fg.vol_orient[0]=tmp1.at(0);
-						fg.vol_orient[1]=tmp1.at(1);
-						fg.vol_orient[2]=tmp1.at(2);
-						fg.vol_orient[3]=tmp1.at(3);
-						fg.vol_orient[4]=tmp1.at(4);
-						fg.vol_orient[5]=tmp1.at(5);
-					}
-				}
+				for (int k = 0; k < 3; k++)
+					values.vol_pos[3*x+k] = tmp1.at(k);
+				values.vol_pos_ok[x] = 1;
 			}
 		}
-		if (nestedds.FindDataElement(tPixelValueTransformationSequence))
+		nestedds1 = get_single_item_ds_(
+			nestedds, tPlaneOrientationVolumeSequence, sq1);
+		if (nestedds1)
 		{
-			const mdcm::DataElement & dePixelValueTransformationSequence
-				= nestedds.GetDataElement(tPixelValueTransformationSequence);
-			mdcm::SmartPointer<mdcm::SequenceOfItems> sqPixelValueTransformationSequence
-				= dePixelValueTransformationSequence.GetValueAsSQ();
-			if (sqPixelValueTransformationSequence &&
-				sqPixelValueTransformationSequence->GetNumberOfItems()==1)
+			std::vector<double> tmp1;
+			if (get_fd_values(
+					*nestedds1,
+					tImageOrientationVolume,
+					tmp1) && tmp1.size()==6)
 			{
-				const mdcm::Item & item1 = sqPixelValueTransformationSequence->GetItem(1);
-				const mdcm::DataSet & nestedds1 = item1.GetNestedDataSet();
-				std::vector<double> tmp1;
-				std::vector<double> tmp2;
-				if (
-					get_ds_values(nestedds1, tRescaleIntercept, tmp1) &&
-					get_ds_values(nestedds1, tRescaleSlope, tmp2))
-				{
-					fg.rescale_ok        = true;
-					fg.rescale_intercept = tmp1.at(0);
-					fg.rescale_slope     = tmp2.at(0);
-				}
-				QString tmp3;
-				if (get_string_value(nestedds1, tRescaleType, tmp3))
-					fg.rescale_type = tmp3;
+				for (int k = 0; k < 6; k++)
+					values.vol_orient[6*x+k] = tmp1.at(k);
+				values.vol_orient_ok[x] = 1;
+			}
+		}
+		nestedds1 = get_single_item_ds_(
+			nestedds, tPixelValueTransformationSequence, sq1);
+		if (nestedds1)
+		{
+			if (
+				get_ds_array_(
+					*nestedds1,
+					tRescaleIntercept,
+					&values.rescale_intercept[x], 1) > 0 &&
+				get_ds_array_(
+					*nestedds1,
+					tRescaleSlope,
+					&values.rescale_slope[x], 1) > 0)
+			{
+				values.rescale_ok[x] = 1;
 			}
+			else
+			{
+				values.rescale_intercept[x] = 0.0;
+				values.rescale_slope[x]     = 1.0;
+			}
+			QString RescaleType;
+			if (get_string_value(*nestedds1, tRescaleType, RescaleType))
+				values.rescale_type[x] = RescaleType;
 		}
-		values.push_back(fg);
 	}
 	return true;
 }
@@ -4547,128 +4401,114 @@ void DicomUtils::enhanced_process_values(
 	bool laterality_miss  = false;
 	bool body_part_miss   = false;
 	bool rescale_miss     = false;
-	for (unsigned int x = 0; x < values.size(); x++)
+	const size_t count = values.size();
+	for (size_t x = 0; x < count; x++)
 	{
-		if (!values.at(x).vol_pos_ok) vol_pos_miss = true;
-		if (!values.at(x).vol_orient_ok) vol_orient_miss = true;
-		if (values.at(x).pat_pos.isEmpty()) pat_pos_miss = true;
-		if (values.at(x).pat_orient.isEmpty()) pat_orient_miss = true;
-		if (values.at(x).pix_spacing.isEmpty()) pix_spacing_miss = true;
-		if (
-			values.at(x).window_center.isEmpty() ||
-			values.at(x).window_width.isEmpty()) window_miss = true;
-		if (values.at(x).frame_laterality.isEmpty()) laterality_miss = true;
-		if (values.at(x).frame_body_part.isEmpty()) body_part_miss = true;
-		if (!values.at(x).rescale_ok) rescale_miss = true;
+		if (!values.vol_pos_ok[x]) vol_pos_miss = true;
+		if (!values.vol_orient_ok[x]) vol_orient_miss = true;
+		if (!values.pat_pos_ok[x]) pat_pos_miss = true;
+		if (!values.pat_orient_ok[x]) pat_orient_miss = true;
+		if (!values.pix_spacing_ok[x]) pix_spacing_miss = true;
+		if (!values.window_ok[x]) window_miss = true;
+		if (values.frame_laterality[x].isEmpty()) laterality_miss = true;
+		if (values.frame_body_part[x].isEmpty()) body_part_miss = true;
+		if (!values.rescale_ok[x]) rescale_miss = true;
 	}
-	if (vol_pos_miss &&
-		shared_values.size()==1 &&
-		shared_values.at(0).vol_pos_ok)
+	const bool shared = (shared_values.size()==1);
+	if (vol_pos_miss && shared && shared_values.vol_pos_ok[0])
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
+		for (size_t x = 0; x < count; x++)
 		{
-			values[x].vol_pos[0] = shared_values.at(0).vol_pos[0];
-			values[x].vol_pos[1] = shared_values.at(0).vol_pos[1];
-			values[x].vol_pos[2] = shared_values.at(0).vol_pos[2];
-			values[x].vol_pos_ok = true;
+			for (int k = 0; k < 3; k++)
+				values.vol_pos[3*x+k] = shared_values.vol_pos[k];
+			values.vol_pos_ok[x] = 1;
 		}
 	}
-	if (
-		vol_orient_miss &&
-		shared_values.size()==1 &&
-		shared_values.at(0).vol_orient_ok)
+	if (vol_orient_miss && shared && shared_values.vol_orient_ok[0])
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
+		for (size_t x = 0; x < count; x++)
 		{
-			values[x].vol_orient[0] = shared_values.at(0).vol_orient[0];
-			values[x].vol_orient[1] = shared_values.at(0).vol_orient[1];
-			values[x].vol_orient[2] = shared_values.at(0).vol_orient[2];
-			values[x].vol_orient[3] = shared_values.at(0).vol_orient[3];
-			values[x].vol_orient[4] = shared_values.at(0).vol_orient[4];
-			values[x].vol_orient[5] = shared_values.at(0).vol_orient[5];
-			values[x].vol_orient_ok = true;
+			for (int k = 0; k < 6; k++)
+				values.vol_orient[6*x+k] = shared_values.vol_orient[k];
+			values.vol_orient_ok[x] = 1;
 		}
 	}
-	if (
-		pat_pos_miss &&
-		shared_values.size()==1 &&
-		!shared_values.at(0).pat_pos.isEmpty())
+	if (pat_pos_miss && shared && shared_values.pat_pos_ok[0])
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
-			values[x].pat_pos = shared_values.at(0).pat_pos;
+		for (size_t x = 0; x < count; x++)
+		{
+			for (int k = 0; k < 3; k++)
+				values.pat_pos[3*x+k] = shared_values.pat_pos[k];
+			values.pat_pos_ok[x] = 1;
+		}
 	}
-	if (
-		pat_orient_miss &&
-		shared_values.size()==1 &&
-		!shared_values.at(0).pat_orient.isEmpty())
+	if (pat_orient_miss && shared && shared_values.pat_orient_ok[0])
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
-			values[x].pat_orient = shared_values.at(0).pat_orient;
+		for (size_t x = 0; x < count; x++)
+		{
+			for (int k = 0; k < 6; k++)
+				values.pat_orient[6*x+k] = shared_values.pat_orient[k];
+			values.pat_orient_ok[x] = 1;
+		}
 	}
-	if (
-		pix_spacing_miss &&
-		shared_values.size()==1 &&
-		!shared_values.at(0).pix_spacing.isEmpty())
+	if (pix_spacing_miss && shared && shared_values.pix_spacing_ok[0])
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
-			values[x].pix_spacing = shared_values.at(0).pix_spacing;
+		for (size_t x = 0; x < count; x++)
+		{
+			values.pix_spacing[2*x]   = shared_values.pix_spacing[0];
+			values.pix_spacing[2*x+1] = shared_values.pix_spacing[1];
+			values.pix_spacing_ok[x] = 1;
+		}
 	}
-	if (
-		window_miss && shared_values.size()==1 &&
-		!shared_values.at(0).window_center.isEmpty() &&
-		!shared_values.at(0).window_width.isEmpty())
+	if (window_miss && shared && shared_values.window_ok[0])
 	{
-		QString lut_function = QString("LINEAR");
-		if (!shared_values.at(0).lut_function.isEmpty())
-			lut_function = shared_values.at(0).lut_function;
-		for (unsigned int x = 0; x < values.size(); x++)
+		for (size_t x = 0; x < count; x++)
 		{
-			values[x].window_center = shared_values.at(0).window_center;
-			values[x].window_width  = shared_values.at(0).window_width;
-			values[x].lut_function  = lut_function;
+			values.window_center[x] = shared_values.window_center[0];
+			values.window_width[x]  = shared_values.window_width[0];
+			values.lut_function[x]  = shared_values.lut_function[0];
+			values.window_ok[x] = 1;
 		}
 	}
 	if (
 		laterality_miss &&
-		shared_values.size()==1 &&
-		!shared_values.at(0).frame_laterality.isEmpty())
+		shared &&
+		!shared_values.frame_laterality[0].isEmpty())
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
-			values[x].frame_laterality =
-				shared_values.at(0).frame_laterality;
+		for (size_t x = 0; x < count; x++)
+			values.frame_laterality[x] =
+				shared_values.frame_laterality[0];
 	}
 	if (
 		body_part_miss &&
-		shared_values.size()==1 &&
-		!shared_values.at(0).frame_body_part.isEmpty())
+		shared &&
+		!shared_values.frame_body_part[0].isEmpty())
 	{
-		for (unsigned int x = 0; x < values.size(); x++)
-			values[x].frame_body_part =
-				shared_values.at(0).frame_body_part;
+		for (size_t x = 0; x < count; x++)
+			values.frame_body_part[x] =
+				shared_values.frame_body_part[0];
 	}
 	if (rescale_miss)
 	{
 		double  rescale_intercept = 0.0;
 		double  rescale_slope     = 1.0;
 		QString rescale_type("");
-		if (
-			shared_values.size()==1 &&
-			shared_values.at(0).rescale_ok)
+		if (shared && shared_values.rescale_ok[0])
 		{
 			rescale_intercept =
-				shared_values.at(0).rescale_intercept;
+				shared_values.rescale_intercept[0];
 			rescale_slope =
-				shared_values.at(0).rescale_slope;
+				shared_values.rescale_slope[0];
 			rescale_type =
-				shared_values.at(0).rescale_type;
+				shared_values.rescale_type[0];
 		}
-		for (unsigned int x = 0; x < values.size(); x++)
+		for (size_t x = 0; x < count; x++)
 		{
-			values[x].rescale_intercept =
+			values.rescale_intercept[x] =
 				rescale_intercept;
-			values[x].rescale_slope =
+			values.rescale_slope[x] =
 				rescale_slope;
-			values[x].rescale_type =
+			values.rescale_type[x] =
 				rescale_type;
 		}
 	}
@@ -4678,13 +4518,7 @@ void DicomUtils::enhanced_check_rescale(
 	const mdcm::DataSet & ds,
 	FrameGroupValues & v)
 {
-	bool rescale_miss = false;
-	for (unsigned int x = 0; x < v.size(); x++)
-	{
-		if (!v.at(x).rescale_ok) rescale_miss = true;
-		break;
-	}
-	if (!rescale_miss) return;
+	if (v.empty() || v.rescale_ok[0]) return;
 	const mdcm::Tag tRescaleIntercept(0x0028,0x1052);
 	const mdcm::Tag tRescaleSlope(0x0028,0x1053);
 	std::vector<double> tmp0;
@@ -4699,11 +4533,11 @@ void DicomUtils::enhanced_check_rescale(
 		!tmp0.empty() &&
 		!tmp1.empty())
 	{
-		for (unsigned int x = 0; x < v.size(); x++)
+		for (size_t x = 0; x < v.size(); x++)
 		{
-			v.at(x).rescale_intercept = tmp0.at(0);
-			v.at(x).rescale_slope     = tmp1.at(0);
-			v.at(x).rescale_ok = true;
+			v.rescale_intercept[x] = tmp0.at(0);
+			v.rescale_slope[x]     = tmp1.at(0);
+			v.rescale_ok[x] = 1;
 		}
 	}
 }
@@ -4799,130 +4633,100 @@ void DicomUtils::print_sq(const DimIndexSq & sq)
 
 void DicomUtils::print_func_group(const FrameGroupValues & values)
 {
-	for (unsigned int x = 0; x < values.size(); x++)
+	for (size_t x = 0; x < values.size(); x++)
 	{
-		std::cout << "ID=" << values.at(x).id << std::endl;
-		if (values.at(x).stack_id_ok)
+		std::cout << "ID=" << x << std::endl;
+		if (values.stack_id_ok[x])
 		{
 			std::cout
 				<< "stack_id "
-				<< values.at(x).stack_id
+				<< values.stack_id[x]
 				<< std::endl;
 		}
-		if (values.at(x).in_stack_pos_num_ok)
+		if (values.in_stack_pos_num_ok[x])
 		{
 			std::cout
 				<< "in_stack_pos "
-				<< values.at(x).in_stack_pos_num
-				<< std::endl;
-		}
-		if (values.at(x).temp_pos_idx_ok)
-		{
-			std::cout
-				<< "temp_pos_idx "
-				<< values.at(x).temp_pos_idx
-				<< std::endl;
-		}
-		if (!values.at(x).data_type.isEmpty())
-		{
-			std::cout
-				<< "data_type "
-				<< values.at(x).data_type.toStdString()
+				<< values.in_stack_pos_num[x]
 				<< std::endl;
 		}
-		if (values.at(x).vol_pos_ok)
+		if (values.vol_pos_ok[x])
 		{
 			std::cout
 				<< "vol_pos "
-				<< values.at(x).vol_pos[0]
-				<< " " << values.at(x).vol_pos[1]
-				<< " " << values.at(x).vol_pos[2]
+				<< values.vol_pos[3*x]
+				<< " " << values.vol_pos[3*x+1]
+				<< " " << values.vol_pos[3*x+2]
 				<< std::endl;
 		}
-		if (values.at(x).temp_pos_off_ok)
+		if (values.temp_pos_off_ok[x])
 		{
 			std::cout
 				<< "temp_pos_off "
-				<< values.at(x).temp_pos_off
-				<< std::endl;
-		}
-		if (values.at(x).us_temp_pos_unknown_ok)
-		{
-			std::cout
-				<< "us_temp_pos_unknown "
-				<< values.at(x).us_temp_pos_unknown
+				<< values.temp_pos_off[x]
 				<< std::endl;
 		}
-		if (!values.at(x).pat_pos.isEmpty())
+		if (values.pat_pos_ok[x])
 		{
 			std::cout
 				<< "pat_pos "
-				<< values.at(x).pat_pos.toStdString()
+				<< values.pat_pos[3*x]
+				<< " " << values.pat_pos[3*x+1]
+				<< " " << values.pat_pos[3*x+2]
 				<< std::endl;
 		}
-		if (!values.at(x).pat_orient.isEmpty())
+		if (values.pat_orient_ok[x])
 		{
-			std::cout
-				<< "pat_orient "
-				<< values.at(x).pat_orient.toStdString()
-				<< std::endl;
+			std::cout << "pat_orient";
+			for (int k = 0; k < 6; k++)
+				std::cout << " " << values.pat_orient[6*x+k];
+			std::cout << std::endl;
 		}
-		if (!values.at(x).pix_spacing.isEmpty())
+		if (values.pix_spacing_ok[x])
 		{
 			std::cout
 				<< "pix_spacing "
-				<< values.at(x).pix_spacing.toStdString()
+				<< values.pix_spacing[2*x]
+				<< " " << values.pix_spacing[2*x+1]
 				<< std::endl;
 		}
-		if (!values.at(x).slice_thick.isEmpty())
+		if (values.slice_thick_ok[x])
 		{
 			std::cout
 				<< "slice_thick "
-				<< values.at(x).slice_thick.toStdString()
+				<< values.slice_thick[x]
 				<< std::endl;
 		}
-		if (!values.at(x).window_center.isEmpty())
+		if (values.window_ok[x])
 		{
 			std::cout
-				<< "window_center "
-				<< values.at(x).window_center.toStdString()
+				<< "window "
+				<< values.window_center[x]
+				<< " " << values.window_width[x]
+				<< " " << values.lut_function[x]
 				<< std::endl;
 		}
-		if (!values.at(x).window_width.isEmpty())
-		{
-			std::cout
-				<< "window_width "
-				<< values.at(x).window_width.toStdString()
-				<< std::endl;
-		}
-		if (!values.at(x).lut_function.isEmpty())
-		{
-			std::cout
-				<< "lut_function "
-				<< values.at(x).lut_function.toStdString()
-				<< std::endl;
-		}
-		if (!values.at(x).frame_laterality.isEmpty())
+		if (!values.frame_laterality[x].isEmpty())
 		{
 			std::cout
 				<< "frame_laterality "
-				<< values.at(x).frame_laterality.toStdString()
+				<< values.frame_laterality[x].toStdString()
 				<< std::endl;
 		}
-		if (!values.at(x).frame_body_part.isEmpty())
+		if (!values.frame_body_part[x].isEmpty())
 		{
 			std::cout
 				<< "frame_body_part "
-				<< values.at(x).frame_body_part.toStdString()
+				<< values.frame_body_part[x].toStdString()
 				<< std::endl;
 		}
-		if (values.at(x).rescale_ok)
+		if (values.rescale_ok[x])
 		{
 			std::cout
 				<< "rescale "
-				<< " " << values.at(x).rescale_type.toStdString()
-				<< " " << values.at(x).rescale_intercept
-				<< " " << values.at(x).rescale_slope
+				<< " " << values.rescale_type[x].toStdString()
+				<< " " << values.rescale_intercept[x]
+				<< " " << values.rescale_slope[x]
 				<< std::endl;
 		}
 		std::cout << "-----------" << std::endl;
@@ -5057,6 +4861,7 @@ QString DicomUtils::read_enhanced(
 	mdcm::PhotometricInterpretation pi;
 	mdcm::PixelFormat pixelformat;
 	mdcm::Reader reader;
+	reader.SetUseArena(true);
 	reader.SetFileName(f.toLocal8Bit().constData());
 	if (!reader.Read())
 	{
@@ -5226,8 +5031,8 @@ QString DicomUtils::read_enhanced(
 			for (unsigned int x = 0; x < values.size(); x++)
 			{
 				if (!(
-					values.at(x).stack_id_ok &&
-					values.at(x).in_stack_pos_num_ok))
+					values.stack_id_ok[x] &&
+					values.in_stack_pos_num_ok[x]))
 				{
 					tmp12 = true;
 					break;
@@ -5238,9 +5043,9 @@ QString DicomUtils::read_enhanced(
 				for (unsigned int x = 0; x < values.size(); x++)
 				{
 					DimIndexValue tmp13;
-					tmp13.id = values.at(x).id;
-					tmp13.idx.push_back(values.at(x).stack_id);
-					tmp13.idx.push_back(values.at(x).in_stack_pos_num);
+					tmp13.id = x;
+					tmp13.idx.push_back(values.stack_id[x]);
+					tmp13.idx.push_back(values.in_stack_pos_num[x]);
 					idx_values_tmp.push_back(tmp13);
 				}
 				for (unsigned int x = 0; x < idx_values_tmp.size(); x++)
@@ -5368,6 +5173,7 @@ QString DicomUtils::read_enhanced_supp_palette(
 	mdcm::PhotometricInterpretation pi;
 	mdcm::PixelFormat pixelformat;
 	mdcm::Reader reader;
+	reader.SetUseArena(true);
 	reader.SetFileName(f.toLocal8Bit().constData());
 	if (!reader.Read())
 	{
@@ -5540,8 +5346,8 @@ QString DicomUtils::read_enhanced_supp_palette(
 			for (unsigned int x = 0; x < values.size(); x++)
 			{
 				if (!(
-					values.at(x).stack_id_ok &&
-					values.at(x).in_stack_pos_num_ok))
+					values.stack_id_ok[x] &&
+					values.in_stack_pos_num_ok[x]))
 				{
 					tmp12 = true;
 					break;
@@ -5552,9 +5358,9 @@ QString DicomUtils::read_enhanced_supp_palette(
 				for (unsigned int x = 0; x < values.size(); x++)
 				{
 					DimIndexValue tmp13;
-					tmp13.id = values.at(x).id;
-					tmp13.idx.push_back(values.at(x).stack_id);
-					tmp13.idx.push_back(values.at(x).in_stack_pos_num);
+					tmp13.id = x;
+					tmp13.idx.push_back(values.stack_id[x]);
+					tmp13.idx.push_back(values.in_stack_pos_num[x]);
 					idx_values_tmp.push_back(tmp13);
 				}
 				for (unsigned int x = 0; x < idx_values_tmp.size(); x++)
@@ -5886,6 +5692,7 @@ QString DicomUtils::read_series(
 	double spacing_x = 0.0, spacing_y = 0.0, spacing_z = 0.0;
 	const bool clean_unused_bits = wsettings->get_clean_unused_bits();
 	std::vector<char*> data;
+	BrickVolume * bricks = NULL;
 	itk::Matrix<itk::SpacePrecisionType,3,3> direction;
 	mdcm::PixelFormat pixelformat;
 	mdcm::PixelFormat previous_pixelformat;
@@ -5907,7 +5714,10 @@ QString DicomUtils::read_series(
 			images_ipp.at(j).toLocal8Bit().constData());
 		*ok = reader.Read();
 		if (*ok==false)
+		{
+			delete bricks;
 			return (QString("can not read file ")+images_ipp.at(j));
+		}
 		const mdcm::File & file = reader.GetFile();
 		const mdcm::DataSet & ds = file.GetDataSet();
 		if (j==0)
@@ -6097,6 +5907,7 @@ QString DicomUtils::read_series(
 			if (dimz_>1)
 			{
 				*ok = false;
+				delete bricks;
 				ivariant->anatomy.clear();
 				ivariant->image_overlays.all_overlays.clear();
 				return QString("Can not read particular series (1)");
@@ -6108,6 +5919,7 @@ QString DicomUtils::read_series(
 			else
 			{
 				*ok = false;
+				delete bricks;
 				ivariant->anatomy.clear();
 				ivariant->image_overlays.all_overlays.clear();
 				return QString(
@@ -6137,6 +5949,7 @@ QString DicomUtils::read_series(
 		}
 		if (*ok == false)
 		{
+			delete bricks;
 			ivariant->anatomy.clear();
 			ivariant->image_overlays.all_overlays.clear();
 			return buff_error;
@@ -6449,6 +6262,7 @@ QString DicomUtils::read_series(
 					if (data.at(x)) delete [] data[x];
 				}
 				data.clear();
+				delete bricks;
 				ivariant->anatomy.clear();
 				ivariant->image_overlays.all_overlays.clear();
 				return QString(
@@ -6464,6 +6278,55 @@ QString DicomUtils::read_series(
 			}
 		}
 		previous_pixelformat = pixelformat;
+		// Series too large for memory are streamed to the bricks
+		// cache, each slice is released before the next file is read.
+		// Dimensions and the pixel format of the decoded slices are
+		// known after the first file.
+		if (j == 0 && images_ipp.size() > 1 &&
+			CommonUtils::use_bricks(pixelformat, dimx, dimy, dimz))
+		{
+			bricks = CommonUtils::create_bricks(
+				pixelformat, dimx, dimy, dimz);
+			if (!bricks)
+			{
+				*ok = false;
+				for (unsigned int x = 0; x < data.size(); x++)
+				{
+					if (data.at(x)) delete [] data[x];
+				}
+				data.clear();
+				ivariant->anatomy.clear();
+				ivariant->image_overlays.all_overlays.clear();
+				return QString("Could not create cache file in ") +
+					QDir::tempPath();
+			}
+			if (pb)
+			{
+				pb->setLabelText(
+					QString("Loading data to cache... please wait"));
+			}
+		}
+		if (bricks)
+		{
+			if (dimx_ != dimx || dimy_ != dimy ||
+				!CommonUtils::write_bricks_slice(
+					bricks, pixelformat, j, data.at(j)))
+			{
+				*ok = false;
+				for (unsigned int x = 0; x < data.size(); x++)
+				{
+					if (data.at(x)) delete [] data[x];
+				}
+				data.clear();
+				delete bricks;
+				ivariant->anatomy.clear();
+				ivariant->image_overlays.all_overlays.clear();
+				return QString("Could not write cache file");
+			}
+			delete [] data[j];
+			data[j] = NULL;
+			if (j % 16 == 0) QApplication::processEvents();
+		}
 	}
 	//
 	if ((images_ipp.size()>1) && data.size()!=dimz)
@@ -6474,6 +6337,7 @@ QString DicomUtils::read_series(
 			if (data.at(x)) delete [] data[x];
 		}
 		data.clear();
+		delete bricks;
 		ivariant->anatomy.clear();
 		ivariant->image_overlays.all_overlays.clear();
 		return QString("data.size()!=dimz");
@@ -6526,21 +6390,37 @@ QString DicomUtils::read_series(
 		(apply_rescale)
 		? wsettings->get_rescale()
 		: true;
-	QString error = CommonUtils::gen_itk_image(ok,
-		data, true,
-		pixelformat, pi,
-		ivariant, 
-		direction,
-		dimx, dimy, dimz,
-		origin_x, origin_y, origin_z,
-		spacing_x, spacing_y, spacing_z,
-		geometry_from_image,
-		allow_geometry_from_image,
-		wsettings->get_resize(),
-		wsettings->get_size_x(), wsettings->get_size_y(),
-		no_warn_rescale,
-		max_3d_tex_size, gl, pb,
-		false);
+	QString error;
+	if (bricks)
+	{
+		error = CommonUtils::gen_bricked_image(ok,
+			bricks,
+			pixelformat,
+			ivariant,
+			direction,
+			origin_x, origin_y, origin_z,
+			spacing_x, spacing_y, spacing_z,
+			geometry_from_image);
+		bricks = NULL;
+	}
+	else
+	{
+		error = CommonUtils::gen_itk_image(ok,
+			data, true,
+			pixelformat, pi,
+			ivariant, 
+			direction,
+			dimx, dimy, dimz,
+			origin_x, origin_y, origin_z,
+			spacing_x, spacing_y, spacing_z,
+			geometry_from_image,
+			allow_geometry_from_image,
+			wsettings->get_resize(),
+			wsettings->get_size_x(), wsettings->get_size_y(),
+			no_warn_rescale,
+			max_3d_tex_size, gl, pb,
+			false);
+	}
 	for (unsigned int x = 0; x < data.size(); x++)
 	{
 		if (data.at(x))
@@ -6589,197 +6469,6 @@ QString DicomUtils::read_series(
 	return QString("");
 }
 
-#if 1 // no example file
-static void delta_decode_rgb(
-	const unsigned char * data_in,
-	size_t data_size,
-	std::vector<unsigned char> & new_stream,
-	unsigned short pc,
-	size_t w,
-	size_t h)
-{
-	enum
-	{
-		COLORMODE = 0x81,
-		ESCMODE = 0x82,
-		REPEATMODE = 0x83
-	};
-	const size_t plane_size = h * w;
-	const size_t outputlen = 3 * plane_size;
-	new_stream.resize(outputlen);
-	if(data_size == outputlen) return;
-	unsigned char * src  = (unsigned char*)data_in;
-	unsigned char * dest = (unsigned char*)&new_stream[0];
-	union
-	{
-		unsigned char gray;
-	unsigned char rgb[3];
-	} pixel;
-	pixel.rgb[0] = pixel.rgb[1] = pixel.rgb[2] = 0;
-	// Start in grayscale mode
-	bool graymode = true;
-	size_t dx = 1;
-	size_t dy = 3;
-	// Algorithm works with both planar configurations.
-	// It does produce surprising greenish background color for
-	// planar configuration is 0, while the nested Icon SQ display
-	// a nice black background.
-	if (pc)
-	{
-		dx = plane_size;
-		dy = 1;
-	}
-	size_t ps = plane_size;
-	// The following is highly unoptimized as we have nested
-	// if statement in a while loop we need to switch from one
-	// algorithm to ther other (RGB <-> GRAY).
-	while (ps)
-	{
-		// Next byte
-		unsigned char b = *src++;
-		assert( src < data_in + data_size );
-		// Mode selection
-		switch (b)
-		{
-		case ESCMODE:
-			// Used to treat a byte 81/82/83 as a normal byte
-			if (graymode)
-			{
-				pixel.gray += *src++;
-				dest[0*dx] = pixel.gray;
-				dest[1*dx] = pixel.gray;
-				dest[2*dx] = pixel.gray;
-			}
-			else
-			{
-				pixel.rgb[0] += *src++;
-				pixel.rgb[1] += *src++;
-				pixel.rgb[2] += *src++;
-				dest[0*dx] = pixel.rgb[0];
-				dest[1*dx] = pixel.rgb[1];
-				dest[2*dx] = pixel.rgb[2];
-			}
-			dest += dy;
-			ps--;
-			break;
-		case REPEATMODE:
-			// Repeat mode (RLE)
-			b = *src++;
-			ps -= b;
-			if (graymode)
-			{
-				while (b-- > 0)
-				{
-					dest[0*dx] = pixel.gray;
-					dest[1*dx] = pixel.gray;
-					dest[2*dx] = pixel.gray;
-					dest += dy;
-				}
-			}
-			else
-			{
-				while (b-- > 0)
-				{
-					dest[0*dx] = pixel.rgb[0];
-					dest[1*dx] = pixel.rgb[1];
-					dest[2*dx] = pixel.rgb[2];
-					dest += dy;
-				}
-			}
-			break;
-		case COLORMODE:
-			// We are swithing from one mode to the other. The stream
-			// contains an intermixed compression of RGB codec and GRAY
-			// codec. Each one not knowing of the other reset old value to 0.
-			if (graymode)
-			{
-				graymode = false;
-				pixel.rgb[0] = pixel.rgb[1] = pixel.rgb[2] = 0;
-			}
-			else
-			{
-				graymode = true;
-				pixel.gray = 0;
-			}
-			break;
-		default:
-			// This is identical to ESCMODE,
-			// it would be nicer to use fall-through
-			if (graymode)
-			{
-				pixel.gray += b;
-				dest[0*dx] = pixel.gray;
-				dest[1*dx] = pixel.gray;
-				dest[2*dx] = pixel.gray;
-			}
-			else
-			{
-				pixel.rgb[0] += b;
-				pixel.rgb[1] += *src++;
-				pixel.rgb[2] += *src++;
-				dest[0*dx] = pixel.rgb[0];
-				dest[1*dx] = pixel.rgb[1];
-				dest[2*dx] = pixel.rgb[2];
-			}
-			dest += dy;
-			ps--;
-			break;
-		}
-	}
-}
-#endif
-
-static void delta_decode(
-	const char * inbuffer,
-	size_t length,
-	std::vector<unsigned short> & output)
-{
-	// RLE pass
-	std::vector<char> temp;
-	for(size_t i = 0; i < length; i++)
-	{
-		if(inbuffer[i] == (char)0xa5)
-		{
-			int repeat = (int)((unsigned char)inbuffer[i+1] + 1);
-			const char value = inbuffer[i+2];
-			while(repeat > 0)
-			{
-				temp.push_back(value);
-				--repeat;
-			}
-			i += 2;
-		}
-		else
-		{
-			temp.push_back(inbuffer[i]);
-		}
-	}
-	// Delta encoding pass
-	unsigned short delta = 0;
-	for(size_t i = 0; i < temp.size(); ++i)
-	{
-		if(temp[i] == (char)0x5a)
-		{
-			const unsigned char v1 = (unsigned char)temp[i+1];
-			const unsigned char v2 = (unsigned char)temp[i+2];
-			const unsigned short value = (unsigned short)(v2 * 256 + v1);
-			output.push_back(value);
-			delta = value;
-			i += 2;
-		}
-		else
-		{
-			const unsigned short value = (unsigned short)(temp[i] + delta);
-			output.push_back(value);
-			delta = value;
-		}
-	}
-	if (output.size() % 2)
-	{
-		output.resize(output.size() - 1);
-	}
-}
-
 bool DicomUtils::convert_elscint(const QString f, const QString outf)
 {
 	mdcm::Reader reader;
@@ -6788,267 +6477,69 @@ bool DicomUtils::convert_elscint(const QString f, const QString outf)
 	{
 		return false;
 	}
-	const mdcm::DataSet & ds = reader.GetFile().GetDataSet();
-	const mdcm::PrivateTag tcompressiontype(0x07a1,0x11,"ELSCINT1");
-	if(!ds.FindDataElement(tcompressiontype))
+	mdcm::ElscintCodec codec;
+	if (!codec.Decode(reader.GetFile().GetDataSet()))
 	{
 		return false;
 	}
-	const mdcm::DataElement& compressiontype =
-		ds.GetDataElement(tcompressiontype);
-	if (compressiontype.IsEmpty())
+	reader.GetFile().GetHeader().SetDataSetTransferSyntax(
+		mdcm::TransferSyntax::ExplicitVRLittleEndian);
+	mdcm::Writer writer;
+	writer.SetFile(reader.GetFile());
+	writer.SetFileName(outf.toLocal8Bit().constData());
+	if(!writer.Write())
 	{
+		std::cout << "Error: can not write Elscint file "
+		<< outf.toStdString()
+		<< std::endl;
 		return false;
 	}
-	const mdcm::ByteValue * bv = compressiontype.GetByteValue();
-	std::string comprle = "PMSCT_RLE1";
-	std::string comprgb = "PMSCT_RGB1";
-	bool isrle = false;
-	bool isrgb = false;
-	if(strncmp(
-		bv->GetPointer(),
-		comprle.c_str(),
-		comprle.size()) == 0)
-	{
-		isrle = true;
-	}
-	else if(strncmp(
-		bv->GetPointer(),
-		comprgb.c_str(),
-		comprgb.size()) == 0)
-	{
-		isrgb = true;
-	}
-	if(!isrle && !isrgb)
-	{
-		return false;
-	}
-	const mdcm::PrivateTag tprivatepixeldata(0x07a1,0x0a,"ELSCINT1");
-	if(ds.FindDataElement(tprivatepixeldata))
-	{
-		const mdcm::DataElement & compressionpixeldata =
-			ds.GetDataElement(tprivatepixeldata);
-		if (compressionpixeldata.IsEmpty()) return false;
-		const mdcm::ByteValue * bv2 = compressionpixeldata.GetByteValue();
-		mdcm::Tag tpixeldata(0x7fe0, 0x0010);
-		mdcm::DataElement pixeldata;
-		if (isrle)
-		{
-			// Create or replace pixel data element 0x7fe0, 0x0010
-			if(!reader.GetFile().GetDataSet().FindDataElement(tpixeldata))
-			{
-				pixeldata = mdcm::DataElement(tpixeldata, 0, mdcm::VR::OW);
-			}
-			else
-			{
-				pixeldata = reader.GetFile().GetDataSet().GetDataElement(tpixeldata);
-			}
-			pixeldata.SetVR(mdcm::VR::OW);
-			mdcm::VL bv2l = bv2->GetLength();
-			mdcm::Attribute<0x0028,0x0010> at1;
-			at1.SetFromDataSet(ds);
-			mdcm::Attribute<0x0028,0x0011> at2;
-			at2.SetFromDataSet(ds);
-			mdcm::VL at1l =
-				at1.GetValue() * at2.GetValue() * sizeof(unsigned short);
-			if(bv2l == at1l)
-			{
-				std::cout << "Warning: Elscint data seems to be not compressed"
-					<< std::endl;
-				pixeldata.SetByteValue(bv2->GetPointer(), bv2->GetLength());
-			}
-			else
-			{
-				std::vector<unsigned short> buffer;
-				delta_decode(bv2->GetPointer(), bv2->GetLength(), buffer);
-				// TODO check that decompress byte buffer match the expected size
-				pixeldata.SetByteValue(
-					(char*)&buffer[0],
-					(uint32_t)(buffer.size() * sizeof(unsigned short)));
-			}
-		}
-		else if (isrgb)
-		{
-			// Create or replace pixel data element 0x7fe0, 0x0010
-			if(!reader.GetFile().GetDataSet().FindDataElement(tpixeldata))
-			{
-				pixeldata = mdcm::DataElement(tpixeldata, 0, mdcm::VR::OW);
-			}
-			else
-			{
-				pixeldata = reader.GetFile().GetDataSet().GetDataElement(tpixeldata);
-			}
-			pixeldata.SetVR(mdcm::VR::OW);
-			mdcm::Attribute<0x0028,0x0006> at0;
-			at0.SetFromDataSet(ds);
-			mdcm::Attribute<0x0028,0x0010> at1;
-			at1.SetFromDataSet(ds);
-			mdcm::Attribute<0x0028,0x0011> at2;
-			at2.SetFromDataSet(ds);
-			const size_t bv2l = bv2->GetLength();
-			const size_t w = at1.GetValue();
-			const size_t h = at2.GetValue();
-			const size_t outputlen = 3*h*w;
-			if(bv2l == outputlen)
-			{
-				std::cout
-					<< "Warning: Elscint data seems to be not compressed"
-					<< std::endl;
-				pixeldata.SetByteValue(bv2->GetPointer(), bv2->GetLength());
-
-			}
-			else
-			{
-				std::vector<unsigned char> buffer;
-				delta_decode_rgb(
-					(const unsigned char*)bv2->GetPointer(), bv2l, buffer,
-					at0.GetValue(), w, h);
-				pixeldata.SetByteValue((char*)&buffer[0], (uint32_t)buffer.size());
-			}
-		}
-		else
-		{
-			return false;
-		}
-		// Add the pixel data element
-		if(reader.GetFile().GetDataSet().FindDataElement(tpixeldata))
-		{
-			reader.GetFile().GetDataSet().Replace(pixeldata);
-		}
-		else
-		{
-			reader.GetFile().GetDataSet().ReplaceEmpty(pixeldata);
-		}
-		//
-		//
-		//
-		if (ds.FindDataElement(mdcm::Tag(0x07a1,0x0010)))
-		{
-			reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x0010));
-			if (ds.FindDataElement(mdcm::Tag(0x07a1,0x100a)))
-			{
-				reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x100a));
-			}
-			if (ds.FindDataElement(mdcm::Tag(0x07a1,0x1010)))
-			{
-				reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x1010));
-			}
-			if (ds.FindDataElement(mdcm::Tag(0x07a1,0x1011)))
-			{
-				reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x1011));
-			}
-		}
-	}
-	else
-	{
-		const mdcm::Tag tpixeldata(0x7fe0, 0x0010);
-		if (!ds.FindDataElement(tpixeldata)) return false;
-		const mdcm::DataElement & epixeldata =
-			ds.GetDataElement(tpixeldata);
-		if (epixeldata.IsEmpty()) return false;
-		const mdcm::ByteValue * bv2 = epixeldata.GetByteValue();
-		mdcm::DataElement pixeldata;
-		if (isrle)
-		{
-			mdcm::VL bv2l = bv2->GetLength();
-			mdcm::Attribute<0x0028,0x0010> at1;
-			at1.SetFromDataSet(ds);
-			mdcm::Attribute<0x0028,0x0011> at2;
-			at2.SetFromDataSet(ds);
-			mdcm::VL at1l =
-				at1.GetValue() * at2.GetValue() * sizeof(unsigned short);
-			if(bv2l == at1l)
-			{
-				std::cout
-					<< "Warning: Elscint data seems to be not compressed"
-					<< std::endl;
-			}
-			else
-			{
-				pixeldata = reader.GetFile().GetDataSet().GetDataElement(tpixeldata);
-				pixeldata.SetVR(mdcm::VR::OW);
-				std::vector<unsigned short> buffer;
-				delta_decode(bv2->GetPointer(), bv2->GetLength(), buffer);
-				// TODO check that decompress byte buffer match the expected size
-				pixeldata.SetByteValue(
-					(char*)&buffer[0],
-					(uint32_t)(buffer.size() * sizeof(unsigned short)));
-			}
-		}
-		else if (isrgb)
-		{
-			mdcm::Attribute<0x0028,0x0006> at0;
-			at0.SetFromDataSet(ds);
-			mdcm::Attribute<0x0028,0x0010> at1;
-			at1.SetFromDataSet(ds);
-			mdcm::Attribute<0x0028,0x0011> at2;
-			at2.SetFromDataSet(ds);
-			const size_t bv2l = bv2->GetLength();
-			const size_t w = at1.GetValue();
-			const size_t h = at2.GetValue();
-			const size_t outputlen = 3*h*w;
-			if(bv2l == outputlen)
-			{
-				std::cout
-					<< "Warning: Elscint data seems to be not compressed"
-					<< std::endl;
-
-			}
-			else
-			{
-				pixeldata = reader.GetFile().GetDataSet().GetDataElement(tpixeldata);
-				pixeldata.SetVR(mdcm::VR::OW);
-				std::vector<unsigned char> buffer;
-				delta_decode_rgb(
-					(const unsigned char*)bv2->GetPointer(), bv2->GetLength(), buffer,
-					at0.GetValue(), w, h);
-				pixeldata.SetByteValue((char*)&buffer[0], (uint32_t)buffer.size());
-			}
-		}
-		else
-		{
-			return false;
-		}
-		// Add the pixel data element
-		reader.GetFile().GetDataSet().Replace(pixeldata);
-		//
-		//
-		//
-		if (ds.FindDataElement(mdcm::Tag(0x07a1,0x0010)))
-		{
-			reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x0010));
-			if (ds.FindDataElement(mdcm::Tag(0x07a1,0x1010)))
-			{
-				reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x1010));
-			}
-			if (ds.FindDataElement(mdcm::Tag(0x07a1,0x1011)))
-			{
-				reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x07a1,0x1011));
-			}
-		}
-	}
-	if (ds.FindDataElement(mdcm::Tag(0x7fe0,0x0)))
-	{
-		reader.GetFile().GetDataSet().Remove(mdcm::Tag(0x7fe0,0x0));
-	}
-	if (ds.FindDataElement(mdcm::Tag(0xfffc,0xfffc)))
-	{
-		reader.GetFile().GetDataSet().Remove(mdcm::Tag(0xfffc,0xfffc));
-	}
-	//
-	//
-	//
-	reader.GetFile().GetHeader().SetDataSetTransferSyntax(
-		mdcm::TransferSyntax::ExplicitVRLittleEndian);
-	mdcm::Writer writer;
-	writer.SetFile(reader.GetFile());
-	writer.SetFileName(outf.toLocal8Bit().constData());
-	if(!writer.Write())
-	{
-		std::cout << "Error: can not write tmp Elscint file "
-		<< outf.toStdString()
-		<< std::endl;
-		return false;
+	return true;
+}
+
+bool DicomUtils::read_overlay_frame(
+	const mdcm::Overlay & o,
+	const unsigned int frame,
+	SliceOverlay & overlay)
+{
+	const char * src_ = o.GetPackedBuffer();
+	const size_t src_size = o.GetPackedBufferLength();
+	if (!src_ || src_size < 1) return false;
+	const unsigned char * src =
+		reinterpret_cast<const unsigned char*>(src_);
+	overlay.dimx = (int)o.GetColumns();
+	overlay.dimy = (int)o.GetRows();
+	overlay.x    = (int)o.GetOrigin()[0];
+	overlay.y    = (int)o.GetOrigin()[1];
+	if (overlay.dimx < 1 || overlay.dimy < 1) return false;
+	const size_t dimx = overlay.dimx;
+	const size_t dimy = overlay.dimy;
+	const size_t first = (size_t)frame * dimx * dimy;
+	if (first >= src_size * 8) return false;
+	const int stride = overlay.stride();
+	overlay.data = QByteArray(stride * overlay.dimy, '\0');
+	unsigned char * dst =
+		reinterpret_cast<unsigned char*>(overlay.data.data());
+	// Overlay Data is one continuous bit stream, re-pack every row
+	// to start on a byte boundary, missing bits are left 0.
+	for (size_t j = 0; j < dimy; j++)
+	{
+		const size_t b = first + j * dimx;
+		const size_t k0 = b >> 3;
+		const unsigned int s = (unsigned int)(b & 7);
+		unsigned char * row = dst + j * stride;
+		for (int k = 0; k < stride; k++)
+		{
+			const size_t kk = k0 + k;
+			if (kk >= src_size) break;
+			unsigned int v = src[kk] >> s;
+			if (s > 0 && kk + 1 < src_size)
+				v |= (unsigned int)src[kk + 1] << (8 - s);
+			row[k] = (unsigned char)(v & 0xff);
+		}
+		const unsigned int tail = (unsigned int)(dimx & 7);
+		if (tail > 0)
+			row[stride - 1] &= (unsigned char)((1 << tail) - 1);
 	}
 	return true;
 }
@@ -7084,35 +6575,20 @@ QString DicomUtils::read_buffer(
 	}
 	mdcm::ImageHelper::SetCleanUnusedBits(clean_unused_bits);
 	mdcm::ImageReader image_reader;
-	QString elscf("");
+	image_reader.SetFileName(f.toLocal8Bit().constData());
 	if (elscint)
 	{
-		QFileInfo fi(f);
-		elscf = QDir::toNativeSeparators(
-			QDir::tempPath() +
-			QDir::separator() +
-			fi.fileName() + QString("ELSCINT.dcm"));
-		const bool elsc_ok = convert_elscint(f, elscf);
-		if (elsc_ok)
-		{
-			image_reader.SetFileName(elscf.toLocal8Bit().constData());
-		}
-		else
-		{
-			QFile::remove(elscf);
-			return QString("Can not convert ELSCINT file");
-		}
+		image_reader.SetDecodeElscint(true);
 	}
 	else
 	{
-		image_reader.SetFileName(f.toLocal8Bit().constData());
 		image_reader.SetApplySupplementalLUT(supp_palette_color);
 	}
 	if (overlay_idx == -2) image_reader.SetProcessOverlays(false);
 	const bool i_ok = image_reader.Read();
 	if (!i_ok)
 	{
-		if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
+		if (elscint) return QString("Can not convert ELSCINT file");
 		return QString("!image_reader.Read()");
 	}
 	mdcm::Image & image = image_reader.GetImage();
@@ -7170,89 +6646,26 @@ QString DicomUtils::read_buffer(
 					(unsigned int)o.GetNumberOfFrames();
 				const unsigned int FrameOrigin =
 					(unsigned int)o.GetFrameOrigin();
-				const int o_dimx = (int)o.GetColumns();
-				const int o_dimy = (int)o.GetRows();
-				const int o_x    = (int)o.GetOrigin()[0];
-				const int o_y    = (int)o.GetOrigin()[1];
 				if ((NumberOfFrames > 1) && (FrameOrigin > 0) &&
 						(overlay_idx < 0))
 				{
-					const size_t obuffer_size = o.GetUnpackBufferLength();
-					if (obuffer_size%NumberOfFrames != 0) continue;
-					const size_t fbuffer_size =
-						obuffer_size/NumberOfFrames;
-					char * tmp0;
-					try { tmp0 = new char[obuffer_size]; }
-					catch (std::bad_alloc&) { continue; }
-					if (!tmp0) continue;
-					const bool obuffer_ok = o.GetUnpackBuffer(
-						tmp0, obuffer_size);
-					if (!obuffer_ok) continue;
-					int idx = FrameOrigin - 1;
 					for (unsigned int y = 0; y < NumberOfFrames; y++)
 					{
 						SliceOverlay overlay;
-						overlay.dimx = o_dimx;
-						overlay.dimy = o_dimy;
-						overlay.x    = o_x;
-						overlay.y    = o_y;
-						const size_t p = idx*o_dimx*o_dimy;
-						idx++;
-						for (size_t j = 0; j < fbuffer_size; j++)
-						{
-							const size_t jj = p + j;
-							if (!(jj < obuffer_size))
-							{
-								std::cout
-									<< "warning: read_buffer() jj="
-									<< jj << " obuffer_size"
-									<< obuffer_size << std::endl;
-							}
-							overlay.data.push_back(tmp0[jj]);
-						}
-						slice_overlays.insert(idx-1, overlay);
-#if 0
-						std::cout
-							<< "obuffer_size=" << obuffer_size
-							<< " fbuffer_size=" << fbuffer_size
-							<< " idx=" << idx-1
-							<< " p=" << p << std::endl;
-#endif
+						if (!read_overlay_frame(o, y, overlay)) break;
+						slice_overlays.insert(FrameOrigin - 1 + y, overlay);
 					}
-					delete [] tmp0;
 				}
 				else
 				{
 					SliceOverlay overlay;
-					overlay.dimx = o_dimx;
-					overlay.dimy = o_dimy;
-					overlay.x    = o_x;
-					overlay.y    = o_y;
-					const size_t obuffer_size =
-						o.GetUnpackBufferLength();
-					char * tmp0;
-					try { tmp0 = new char[obuffer_size]; }
-					catch (std::bad_alloc&) { continue; }
-					if (!tmp0) continue;
-					const bool obuffer_ok = o.GetUnpackBuffer(
-						tmp0, obuffer_size);
-					if (!obuffer_ok) continue;
-					for (size_t j = 0; j < obuffer_size; j++)
-					{
-						overlay.data.push_back(tmp0[j]);
-					}
-					delete [] tmp0;
+					if (!read_overlay_frame(o, 0, overlay)) continue;
 					slice_overlays.insert(
 						overlay_idx,
 						overlay);
-#if 0
-						std::cout
-							<< "obuffer_size=" << obuffer_size
-							<< " idx=" << overlay_idx << std::endl;
-#endif
 				}
 			}
-			const QList<int> keys = slice_overlays.keys();
+			const QList<int> keys = slice_overlays.uniqueKeys();
 			for (int x = 0; x < keys.size(); x++)
 			{
 				const int idx = keys.at(x);
@@ -7359,14 +6772,12 @@ QString DicomUtils::read_buffer(
 			{
 				if (pixelformat.GetBitsAllocated() < 8)
 				{
-					if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 					return QString(
 						"Bits allocated < 8 and rescale,\n"
 						"not supported.");
 				}
 				if (supp_palette_color)
 				{
-					if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 					return QString(
 						"Re-scale and Suppl. LUT?");
 				}
@@ -7399,7 +6810,6 @@ QString DicomUtils::read_buffer(
 						}
 						else
 						{
-							if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 							return QString("Internal error (re-scale)");
 						}
 					}
@@ -7414,18 +6824,15 @@ QString DicomUtils::read_buffer(
 					}
 					catch(std::bad_alloc&)
 					{
-						if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 						return QString("Buffer allocation error");
 					}
 					if (!in_buffer)
 					{
-						if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 						return QString("Buffer allocation error");
 					}
 					if (!image.GetBuffer(in_buffer))
 					{
 						delete [] in_buffer;
-						if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 						return QString("Buffer is NULL");
 					}
 					rescaled_buffer_size
@@ -7435,7 +6842,6 @@ QString DicomUtils::read_buffer(
 					if (!rescaled_buffer)
 					{
 						if (in_buffer) delete [] in_buffer;
-						if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 						return QString("Buffer is NULL");
 					}
 					const bool ok_rescale = r.Rescale(rescaled_buffer, in_buffer, image.GetBufferLength());
@@ -7485,7 +6891,6 @@ QString DicomUtils::read_buffer(
 				QString(",\n samples per pixel = ") +
 				QVariant((int)samples_per_pix).toString() +
 				QString(",\nnot supported.");
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return tmp_s0;
 		}
 		if (pixelformat.GetBitsAllocated()==1)
@@ -7498,7 +6903,6 @@ QString DicomUtils::read_buffer(
 				QString("Bits allocated = ") +
 				QVariant((int)pixelformat.GetBitsAllocated()).toString() +
 				QString(", not supported.");
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return tmp_s0;
 		}
 	}
@@ -7518,25 +6922,21 @@ QString DicomUtils::read_buffer(
 		}
 		catch(std::bad_alloc&)
 		{
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString("Buffer allocation error");
 		}
 		if (!singlebit_buffer)
 		{
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString("Buffer allocation error");
 		}
 		if (!image.GetBuffer((char*)singlebit_buffer))
 		{
 			delete [] singlebit_buffer;
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString("Buffer is NULL");
 		}
 		not_rescaled_buffer_size=dimx*dimy*dimz;
 		if (not_rescaled_buffer_size != singlebit_buffer_size*8)
 		{
 			delete [] singlebit_buffer;
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString("Wrong buffer size");
 		}
 		try
@@ -7545,12 +6945,10 @@ QString DicomUtils::read_buffer(
 		}
 		catch(std::bad_alloc&)
 		{
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString("Buffer allocation error");
 		}
 		if (!not_rescaled_buffer)
 		{
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString("Buffer allocation error");
 		}
 		size_t j = 0;
@@ -7624,7 +7022,6 @@ QString DicomUtils::read_buffer(
 						QVariant((int)not_rescaled_buffer_size).toString() +
 						QString("\nbut must be\n") +
 						QVariant((int)(3*dimx*dimy*dimz*type_size*samples_per_pix)).toString();
-					if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 					return tmp_s0;
 				}
 			}
@@ -7637,7 +7034,6 @@ QString DicomUtils::read_buffer(
 						QVariant(static_cast<int>(not_rescaled_buffer_size)).toString() +
 						QString("\nbut must be\n") +
 						QVariant(static_cast<int>(dimx*dimy*dimz*type_size*samples_per_pix)).toString();
-					if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 					return tmp_s0;
 				}
 			}
@@ -7647,7 +7043,6 @@ QString DicomUtils::read_buffer(
 			if (!image.GetBuffer(not_rescaled_buffer))
 			{
 				delete [] not_rescaled_buffer;
-				if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 				return QString("Buffer is NULL");
 			}
 			buffer      = not_rescaled_buffer;
@@ -7662,7 +7057,6 @@ QString DicomUtils::read_buffer(
 			{
 				delete [] not_rescaled_buffer;
 			}
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString(
 				"Error (subscript is NULL),\n"
 				"can not apply Supplemental LUT");
@@ -7685,7 +7079,6 @@ QString DicomUtils::read_buffer(
 			}
 			catch(std::bad_alloc&)
 			{
-				if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 				return QString("Buffer allocation error");
 			}
 			if (!supp_rescaled_buffer)
@@ -7697,7 +7090,6 @@ QString DicomUtils::read_buffer(
 				{
 					delete [] not_rescaled_buffer;
 				}
-				if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 				return QString("Buffer is NULL");
 			}
 			buffer = supp_rescaled_buffer;
@@ -7707,7 +7099,6 @@ QString DicomUtils::read_buffer(
 		{
 			(void)supp_rescaled_buffer_size;
 			if (rescaled_buffer) delete [] rescaled_buffer;
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			return QString(
 				"Error (buffer rescaled),\n"
 				"can not apply Supplemental LUT");
@@ -7730,7 +7121,6 @@ QString DicomUtils::read_buffer(
 			if (not_rescaled_buffer)  delete [] not_rescaled_buffer;
 			if (rescaled_buffer)      delete [] rescaled_buffer;
 			if (supp_rescaled_buffer) delete [] supp_rescaled_buffer;
-			if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 			*ok = false;
 			return QString("Memory allocation error");
 		}
@@ -7738,7 +7128,6 @@ QString DicomUtils::read_buffer(
 	if (not_rescaled_buffer)  delete [] not_rescaled_buffer;
 	if (rescaled_buffer)      delete [] rescaled_buffer;
 	if (supp_rescaled_buffer) delete [] supp_rescaled_buffer;
-	if (elscint && !elscf.isEmpty()) QFile::remove(elscf);
 	*ok = true;
 	return QString("");
 }
@@ -7824,12 +7213,12 @@ QString DicomUtils::read_enhanced_common(
 		QString message_("");
 		std::vector<char*>   tmp3;
 		std::vector<double*> tmp4;
-		QStringList tmp5;
+		std::vector<const double*> tmp5;
 		QList< QPair< double, double> > tmp6;
 		bool tmp4_ok = true;
-		QStringList window_centers_l;
-		QStringList window_widths_l;
-		QStringList lut_functions_l;
+		QList<double> window_centers_l;
+		QList<double> window_widths_l;
+		QList<short>  lut_functions_l;
 		QStringList lateralities;
 		QStringList body_parts;
 		QStringList acquisition_datetimes;
@@ -7892,18 +7281,13 @@ QString DicomUtils::read_enhanced_common(
 				if (sop==QString("1.2.840.10008.5.1.4.1.1.6.2")) // US
 				{
 					if (
-						values.at(idx__).vol_pos_ok &&
-						values.at(idx__).vol_orient_ok)
+						values.vol_pos_ok[idx__] &&
+						values.vol_orient_ok[idx__])
 					{
-						ss[0] = values.at(idx__).vol_pos[0];
-						ss[1] = values.at(idx__).vol_pos[1];
-						ss[2] = values.at(idx__).vol_pos[2];
-						ss[3] = values.at(idx__).vol_orient[0];
-						ss[4] = values.at(idx__).vol_orient[1];
-						ss[5] = values.at(idx__).vol_orient[2];
-						ss[6] = values.at(idx__).vol_orient[3];
-						ss[7] = values.at(idx__).vol_orient[4];
-						ss[8] = values.at(idx__).vol_orient[5];
+						for (int k = 0; k < 3; k++)
+							ss[k] = values.vol_pos[3*idx__+k];
+						for (int k = 0; k < 6; k++)
+							ss[3+k] = values.vol_orient[6*idx__+k];
 						tmp4.push_back(ss);
 					}
 					else { tmp4_ok = false; delete [] ss; }
@@ -7912,18 +7296,13 @@ QString DicomUtils::read_enhanced_common(
 				else if (sop==QString("1.2.840.10008.5.1.4.1.1.77.1.6")) // VL Whole Slide Microscopy
 				{
 					if (
-						values.at(idx__).vol_pos_ok &&
-						values.at(idx__).vol_orient_ok)
+						values.vol_pos_ok[idx__] &&
+						values.vol_orient_ok[idx__])
 					{
-						ss[0] = values.at(idx__).vol_pos[0];
-						ss[1] = values.at(idx__).vol_pos[1];
-						ss[2] = values.at(idx__).vol_pos[2];
-						ss[3] = values.at(idx__).vol_orient[0];
-						ss[4] = values.at(idx__).vol_orient[1];
-						ss[5] = values.at(idx__).vol_orient[2];
-						ss[6] = values.at(idx__).vol_orient[3];
-						ss[7] = values.at(idx__).vol_orient[4];
-						ss[8] = values.at(idx__).vol_orient[5];
+						for (int k = 0; k < 3; k++)
+							ss[k] = values.vol_pos[3*idx__+k];
+						for (int k = 0; k < 6; k++)
+							ss[3+k] = values.vol_orient[6*idx__+k];
 						tmp4.push_back(ss);
 					}
 					else { tmp4_ok = false; delete [] ss; }
@@ -7933,61 +7312,40 @@ QString DicomUtils::read_enhanced_common(
 				// with iop/ipp
 				else
 				{
-					if (!values.at(idx__).pat_pos.isEmpty() &&
-						!values.at(idx__).pat_orient.isEmpty())
+					if (values.pat_pos_ok[idx__] &&
+						values.pat_orient_ok[idx__])
 					{
-						double pat_pos[3];
-						double pat_orient[6];
-						const bool ok_p =
-							get_patient_position(
-								values.at(idx__).pat_pos,
-								pat_pos);
-						const bool ok_o =
-							get_patient_orientation(
-								values.at(idx__).pat_orient,
-								pat_orient);
-						if (ok_o && ok_p)
-						{
-							ss[0] = pat_pos[0];
-							ss[1] = pat_pos[1];
-							ss[2] = pat_pos[2];
-							ss[3] = pat_orient[0];
-							ss[4] = pat_orient[1];
-							ss[5] = pat_orient[2];
-							ss[6] = pat_orient[3];
-							ss[7] = pat_orient[4];
-							ss[8] = pat_orient[5];
-							tmp4.push_back(ss);
-						}
-						else { tmp4_ok = false; delete [] ss; }
+						for (int k = 0; k < 3; k++)
+							ss[k] = values.pat_pos[3*idx__+k];
+						for (int k = 0; k < 6; k++)
+							ss[3+k] = values.pat_orient[6*idx__+k];
+						tmp4.push_back(ss);
 					}
 					else { tmp4_ok = false; delete [] ss; }
 				}
 				QPair< double, double> rp;
-				rp.first  = values.at(idx__).rescale_intercept;
-				rp.second = values.at(idx__).rescale_slope;
+				rp.first  = values.rescale_intercept[idx__];
+				rp.second = values.rescale_slope[idx__];
 				tmp6.push_back(rp);
-				if (!values.at(idx__).window_center.isEmpty() &&
-					!values.at(idx__).window_width.isEmpty())
-				{
-					window_centers_l.push_back(values.at(idx__).window_center);
-					window_widths_l.push_back(values.at(idx__).window_width);
-					lut_functions_l.push_back(values.at(idx__).lut_function);
-				}
-				if (!values.at(idx__).pix_spacing.isEmpty())
-				{
-					tmp5.push_back(values.at(idx__).pix_spacing);
-				}
-				else
-				{
-					tmp5.push_back(QString(""));
-				}
-				lateralities.push_back(values.at(idx__).frame_laterality);
-				body_parts.push_back(values.at(idx__).frame_body_part);
+				if (values.window_ok[idx__])
+				{
+					double w = values.window_width[idx__];
+					const short l = values.lut_function[idx__];
+					if (l == 0 && w >= 2) w -= 1;
+					window_centers_l.push_back(values.window_center[idx__]);
+					window_widths_l.push_back(w);
+					lut_functions_l.push_back(l);
+				}
+				tmp5.push_back(
+					values.pix_spacing_ok[idx__]
+					? &values.pix_spacing[2*idx__]
+					: NULL);
+				lateralities.push_back(values.frame_laterality[idx__]);
+				body_parts.push_back(values.frame_body_part[idx__]);
 				acquisition_datetimes.push_back(
-					values.at(idx__).frame_acquisition_datetime.trimmed());
+					values.frame_acquisition_datetime[idx__].trimmed());
 				reference_datetimes.push_back(
-					values.at(idx__).frame_reference_datetime.trimmed());
+					values.frame_reference_datetime[idx__].trimmed());
 				if (image_overlays.all_overlays.contains(idx__))
 				{
 					overlays.all_overlays[it->first] =
@@ -8089,10 +7447,12 @@ QString DicomUtils::read_enhanced_common(
 			double spacing_tmp0[2] = {0.0, 0.0 };
 			double spacing_tmp1[2] = {0.0, 0.0 };
 			bool spacing_ok = false;
-			for (int i = 0; i < tmp5.size(); i++)
+			for (size_t i = 0; i < tmp5.size(); i++)
 			{
-				spacing_ok = get_pixel_spacing(tmp5.at(i), spacing_tmp0);
+				spacing_ok = (tmp5.at(i) != NULL);
 				if (!spacing_ok) break;
+				spacing_tmp0[0] = tmp5.at(i)[0];
+				spacing_tmp0[1] = tmp5.at(i)[1];
 				if (i > 0)
 				{
 					if (!(
@@ -8242,57 +7602,11 @@ QString DicomUtils::read_enhanced_common(
 			double window_center = -999999, window_width = -999999;
 			short lut_function = -1;
 			const size_t tmp1s = window_centers_l.size();
-			const bool tmp1ok =
-				(tmp1s > 0) &&
-				((size_t)window_widths_l.size() == tmp1s) &&
-				((size_t)lut_functions_l.size() == tmp1s);
-			if (tmp1ok)
-			{
-				QList<double> tmp1w;
-				QList<double> tmp1c;
-				QList<short>  tmp1l;
-				for (size_t k = 0; k < tmp1s; k++)
-				{
-					QStringList w__ =
-						window_widths_l.at(k).split(QString("\\"),
-						QString::SkipEmptyParts);
-					QStringList c__ =
-						window_centers_l.at(k).split(QString("\\"),
-						QString::SkipEmptyParts);
-					if (!w__.empty() && !c__.empty())
-					{
-						bool ok_c = false, ok_w = false;
-						const double tmp_w =
-							QVariant(w__.at(0).trimmed().remove(QChar('\0')))
-								.toDouble(&ok_w);
-						const double tmp_c =
-							QVariant(c__.at(0).trimmed().remove(QChar('\0')))
-								.toDouble(&ok_c);
-						if (ok_c && ok_w)
-						{
-							double tmp7890 = tmp_w;
-							short  tmp7891 = -1;
-							const QString tmp7892 =
-								lut_functions_l.at(k).trimmed().toUpper();
-							if (tmp7892 == QString("SIGMOID"))
-							{
-								tmp7891 = 2;
-							}
-							else if (tmp7892 == QString("LINEAR_EXACT"))
-							{
-								tmp7891 = 1;
-							}
-							else
-							{
-								tmp7891 = 0;
-								if (tmp_w >= 2) tmp7890 -= 1;
-							}
-							tmp1c.push_back(tmp_c);
-							tmp1w.push_back(tmp7890);
-							tmp1l.push_back(tmp7891);
-						}
-					}
-				}
+			if (tmp1s > 0)
+			{
+				const QList<double> & tmp1c = window_centers_l;
+				const QList<double> & tmp1w = window_widths_l;
+				const QList<short>  & tmp1l = lut_functions_l;
 				/////////////////////
 				const int tmp1c_size = tmp1c.size();
 				if (tmp1c_size == 1)
@@ -8575,131 +7889,158 @@ QString DicomUtils::read_enhanced_common(
 	return message;
 }
 
-bool DicomUtils::enhanced_process_indices(
-	std::vector< std::map< unsigned int,unsigned int,std::less<unsigned int> > > & tmp0,
-	const DimIndexValues & idx_values, const FrameGroupValues & values,
-	const int dim6th, const int dim5th, const int dim4th, const int dim3rd)
+// Replace values with dense ranks (position in sorted unique values),
+// returns number of unique values.
+static unsigned int dense_ranks_(std::vector<unsigned int> & v)
 {
-	bool error = false;
-	std::list<unsigned int> tmp1_1;
-	std::list<unsigned int> tmp1_2;
-	std::list<unsigned int> tmp1_3;
-	if (dim6th>=0)
+	std::vector<unsigned int> u(v);
+	std::sort(u.begin(), u.end());
+	u.erase(std::unique(u.begin(), u.end()), u.end());
+	for (size_t x = 0; x < v.size(); x++)
 	{
-		for (unsigned int x = 0; x < idx_values.size(); x++)
-			tmp1_1.push_back(idx_values.at(x).idx.at(dim6th));
-		tmp1_1.sort();
-		tmp1_1.unique();
+		v[x] = static_cast<unsigned int>(
+			std::lower_bound(u.begin(), u.end(), v[x]) - u.begin());
 	}
-	else
+	return static_cast<unsigned int>(u.size());
+}
+
+static unsigned int bits_for_(unsigned int n)
+{
+	unsigned int b = 0;
+	while (b < 32 && (1ULL << b) < n) b++;
+	return b;
+}
+
+// Stable LSD radix sort of (key, frame) pairs, 8 bits per pass,
+// only the lower 'bits' bits of the key are considered.
+static void radix_sort_(
+	std::vector< std::pair<unsigned long long, unsigned int> > & a,
+	const unsigned int bits)
+{
+	std::vector< std::pair<unsigned long long, unsigned int> > b(a.size());
+	for (unsigned int shift = 0; shift < bits; shift += 8)
+	{
+		size_t c[257];
+		for (int k = 0; k < 257; k++) c[k] = 0;
+		for (size_t x = 0; x < a.size(); x++)
+			c[((a[x].first >> shift) & 0xff) + 1]++;
+		for (int k = 0; k < 256; k++) c[k + 1] += c[k];
+		for (size_t x = 0; x < a.size(); x++)
+			b[c[(a[x].first >> shift) & 0xff]++] = a[x];
+		a.swap(b);
+	}
+}
+
+namespace
+{
+class RanksLess
+{
+public:
+	RanksLess(const std::vector<unsigned int> * r) : ranks(r) {}
+	bool operator() (unsigned int i, unsigned int j) const
 	{
-		tmp1_1.push_back(1);
+		for (int k = 0; k < 4; k++)
+		{
+			if (ranks[k][i] != ranks[k][j])
+				return (ranks[k][i] < ranks[k][j]);
+		}
+		return false;
 	}
-	if (dim5th>=0)
+private:
+	const std::vector<unsigned int> * ranks;
+};
+}
+
+bool DicomUtils::enhanced_process_indices(
+	std::vector< std::map< unsigned int,unsigned int,std::less<unsigned int> > > & tmp0,
+	const DimIndexValues & idx_values, const FrameGroupValues & values,
+	const int dim6th, const int dim5th, const int dim4th, const int dim3rd)
+{
+	if (idx_values.empty())
 	{
-		for (unsigned int x = 0; x < idx_values.size(); x++)
-			tmp1_2.push_back(idx_values.at(x).idx.at(dim5th));
-		tmp1_2.sort();
-		tmp1_2.unique();
+		std::map< unsigned int,unsigned int,std::less<unsigned int> > tmp2;
+		for (unsigned int x = 0; x < values.size(); x++)
+			tmp2[x] = x;
+		tmp0.push_back(tmp2);
+		return true;
 	}
-	else
+	// Dimension index values are replaced by dense ranks and packed
+	// into one 64 bit key (6th, 5th, 4th, 3rd dimension from high
+	// to low bits), frames are ordered by sorting the keys, groups
+	// are consecutive runs with equal 6th/5th/4th dimension.
+	const size_t n = idx_values.size();
+	const int dims[4] = { dim6th, dim5th, dim4th, dim3rd };
+	std::vector<unsigned int> ranks[4];
+	std::vector<unsigned int> pos3(n);
+	unsigned int bits[4];
+	unsigned int total_bits = 0;
+	for (int k = 0; k < 4; k++)
 	{
-		tmp1_2.push_back(1);
+		ranks[k].resize(n, 0);
+		for (size_t x = 0; x < n; x++)
+		{
+			if (dims[k] >= 0)
+			{
+				if (dims[k] >= (int)idx_values[x].idx.size()) return false;
+				ranks[k][x] = idx_values[x].idx[dims[k]];
+			}
+			else if (k == 3)
+			{
+				ranks[k][x] = idx_values[x].id;
+			}
+		}
+		if (k == 3) pos3 = ranks[3];
+		bits[k] = bits_for_(dense_ranks_(ranks[k]));
+		total_bits += bits[k];
 	}
-	if (dim4th>=0)
+	std::vector<unsigned int> perm(n);
+	if (total_bits <= 64)
 	{
-		for (unsigned int x = 0; x < idx_values.size(); x++)
-			tmp1_3.push_back(idx_values.at(x).idx.at(dim4th));
-		tmp1_3.sort();
-		tmp1_3.unique();
+		std::vector< std::pair<unsigned long long, unsigned int> > keys(n);
+		for (size_t x = 0; x < n; x++)
+		{
+			unsigned long long key = 0;
+			for (int k = 0; k < 4; k++)
+			{
+				if (bits[k] > 0) key = (key << bits[k]) | ranks[k][x];
+			}
+			keys[x].first  = key;
+			keys[x].second = static_cast<unsigned int>(x);
+		}
+		radix_sort_(keys, total_bits);
+		for (size_t x = 0; x < n; x++) perm[x] = keys[x].second;
 	}
 	else
 	{
-		tmp1_3.push_back(1);
+		for (size_t x = 0; x < n; x++) perm[x] = static_cast<unsigned int>(x);
+		std::stable_sort(perm.begin(), perm.end(), RanksLess(ranks));
 	}
-	if (!idx_values.empty())
+	std::map< unsigned int,unsigned int,std::less<unsigned int> > tmp2;
+	for (size_t i = 0; i < n; i++)
 	{
-		for (
-			std::list<unsigned int>::const_iterator it1 = tmp1_1.begin();
-			it1 != tmp1_1.end();
-			it1++)
-		{
-			for (
-				std::list<unsigned int>::const_iterator it2 = tmp1_2.begin();
-				it2 != tmp1_2.end();
-				it2++)
-			{
-				for (
-					std::list<unsigned int>::const_iterator it3 = tmp1_3.begin();
-					it3 != tmp1_3.end();
-					it3++)
-				{
-					std::map< unsigned int,unsigned int,std::less<unsigned int> > tmp2;
-					std::list<unsigned int> tmp2_test;
-					for (unsigned int x = 0; x < idx_values.size(); x++)
-					{
-						const int idx1 =
-							dim6th >= 0 && dim6th < (int)idx_values.at(x).idx.size()
-							? idx_values.at(x).idx.at(dim6th)
-							: -1;
-						const int idx2 =
-							dim5th >= 0 && dim5th < (int)idx_values.at(x).idx.size()
-							? idx_values.at(x).idx.at(dim5th)
-							: -1;
-						const int idx3 =
-							dim4th >= 0 && dim4th < (int)idx_values.at(x).idx.size()
-							? idx_values.at(x).idx.at(dim4th)
-							: -1;
-						const int idx4 =
-							dim3rd >= 0 && dim3rd < (int)idx_values.at(x).idx.size()
-							? idx_values.at(x).idx.at(dim3rd)
-							: -1;
-						if (
-							(idx1<0 || idx1==(int)*it1) &&
-							(idx2<0 || idx2==(int)*it2) &&
-							(idx3<0 || idx3==(int)*it3))
-						{
-							if (idx4<0)
-							{
-								tmp2[idx_values.at(x).id] = idx_values.at(x).id;
-								tmp2_test.push_back(idx_values.at(x).id);
-							}
-							else
-							{
-								const unsigned int tmp2_pos =
-									idx_values.at(x).idx.at(dim3rd);
-								tmp2[idx_values.at(x).id] = tmp2_pos;
-								tmp2_test.push_back(tmp2_pos);
-							}
-						}
-					}
-					const size_t tmp2_test_size0 = tmp2_test.size();
-					if (tmp2_test_size0 > 0)
-					{
-						tmp2_test.sort();
-						tmp2_test.unique();
-						const size_t tmp2_test_size1 = tmp2_test.size();
-						if (tmp2_test_size0!=tmp2_test_size1)
-						{
-							error = true;
-						}
-						if (!error) tmp0.push_back(tmp2);
-						else break;
-					}
-				}
-				if (error) break;
+		const unsigned int x = perm[i];
+		if (i > 0)
+		{
+			const unsigned int p = perm[i - 1];
+			const bool same_group =
+				ranks[0][x] == ranks[0][p] &&
+				ranks[1][x] == ranks[1][p] &&
+				ranks[2][x] == ranks[2][p];
+			if (same_group)
+			{
+				// position in 3rd dimension must be unique
+				if (ranks[3][x] == ranks[3][p]) return false;
+			}
+			else
+			{
+				tmp0.push_back(tmp2);
+				tmp2.clear();
 			}
-			if (error) break;
 		}
+		tmp2[idx_values[x].id] = pos3[x];
 	}
-	else
-	{
-		std::map< unsigned int,unsigned int,std::less<unsigned int> > tmp2;
-		for (unsigned int x = 0; x < values.size(); x++)
-			tmp2[x] = x;
-		tmp0.push_back(tmp2);
-	}
-	return !error;
+	if (!tmp2.empty()) tmp0.push_back(tmp2);
+	return true;
 }
 
 QString DicomUtils::read_enhanced_3d_6d(
@@ -10133,6 +9474,151 @@ typedef struct
 	QString file;
 } MixedDicomSeriesInfo;
 
+// Classification and file order of a series from a previous load,
+// reopening unchanged files skips the classification pass, interleaving
+// checks and sorting, only pixel data are read again.
+class LoadPlan
+{
+public:
+	LoadPlan()
+		:
+		ultrasound(false),
+		multiframe(false),
+		mixed(false),
+		multiseries(false),
+		mosaic(false),
+		uihgrid(false),
+		elscint(false) {}
+	QString series_uid;
+	QStringList images;
+	// sorted files for every read_series call
+	QList<QStringList> series;
+	bool ultrasound;
+	bool multiframe;
+	bool mixed;
+	bool multiseries;
+	bool mosaic;
+	bool uihgrid;
+	bool elscint;
+};
+
+static QHash<QByteArray, LoadPlan> load_plans;
+static QList<QByteArray> load_plans_order;
+static QMutex load_plans_mutex;
+static const int max_load_plans = 32;
+
+// Key is file paths, sizes and modification times and the settings
+// affecting classification, empty if a file is missing.
+static QByteArray load_plan_key(
+	const QStringList & filenames,
+	bool mosaic_setting,
+	short load_type)
+{
+	if (filenames.empty()) return QByteArray();
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	const qint64 tmp0[2] =
+	{
+		static_cast<qint64>(mosaic_setting ? 1 : 0),
+		static_cast<qint64>(load_type)
+	};
+	hash.addData(
+		reinterpret_cast<const char*>(tmp0), static_cast<int>(sizeof(tmp0)));
+	for (int x = 0; x < filenames.size(); x++)
+	{
+		const QFileInfo fi(filenames.at(x));
+		if (!fi.isFile()) return QByteArray();
+		const QByteArray f = fi.absoluteFilePath().toUtf8();
+		const qint64 tmp1[3] =
+		{
+			static_cast<qint64>(f.size()),
+			fi.size(),
+			fi.lastModified().toMSecsSinceEpoch()
+		};
+		hash.addData(
+			reinterpret_cast<const char*>(tmp1), static_cast<int>(sizeof(tmp1)));
+		hash.addData(f);
+	}
+	return hash.result();
+}
+
+static QString read_series_uid(const QString & f)
+{
+	const mdcm::Tag tSeriesInstanceUID(0x0020,0x000e);
+	std::set<mdcm::Tag> tags;
+	tags.insert(tSeriesInstanceUID);
+	mdcm::Reader reader;
+	reader.SetFileName(f.toLocal8Bit().constData());
+	if (!reader.ReadSelectedTags(tags)) return QString();
+	QString s;
+	DicomUtils::get_string_value(
+		reader.GetFile().GetDataSet(), tSeriesInstanceUID, s);
+	return s.remove(QChar('\0'));
+}
+
+static bool get_load_plan(const QByteArray & key, LoadPlan & plan)
+{
+	if (key.isEmpty()) return false;
+	{
+		QMutexLocker locker(&load_plans_mutex);
+		QHash<QByteArray, LoadPlan>::const_iterator it =
+			load_plans.constFind(key);
+		if (it == load_plans.constEnd()) return false;
+		plan = it.value();
+	}
+	// files may be replaced within the resolution of the time stamp
+	if (plan.images.empty() ||
+		read_series_uid(plan.images.at(0)) != plan.series_uid)
+	{
+		QMutexLocker locker(&load_plans_mutex);
+		load_plans.remove(key);
+		load_plans_order.removeAll(key);
+		return false;
+	}
+	return true;
+}
+
+static void store_load_plan(const QByteArray & key, const LoadPlan & plan)
+{
+	if (key.isEmpty()) return;
+	QMutexLocker locker(&load_plans_mutex);
+	if (!load_plans.contains(key))
+	{
+		while (load_plans_order.size() >= max_load_plans)
+		{
+			load_plans.remove(load_plans_order.takeFirst());
+		}
+		load_plans_order.push_back(key);
+	}
+	load_plans[key] = plan;
+}
+
+static QStringList sort_images_ipp(const QStringList & images)
+{
+	std::vector<QString> images__;
+	std::vector<QString> images_ipp;
+	for (int k = 0; k < images.size(); k++)
+	{
+		images__.push_back(images.at(k));
+	}
+	if (images__.size()>1)
+	{
+		mdcm::Sorter2 sorter;
+		sorter.SetSortFunction(sort0_);
+		sorter.StableSort(images__);
+		images_ipp = sorter.GetFilenames();
+	}
+	else if (images__.size()==1)
+	{
+		images_ipp.push_back(images__.at(0));
+	}
+	QStringList images_tmp;
+	for (size_t j = 0; j < images_ipp.size(); j++)
+	{
+		images_tmp << images_ipp.at(j);
+	}
+	return images_tmp;
+}
+
 QString DicomUtils::read_dicom(
 	std::vector<ImageVariant*> & ivariants,
 	const QStringList & filenames,
@@ -10194,13 +9680,31 @@ QString DicomUtils::read_dicom(
 	const float tolerance = 0.01f;
 	int count_images = 0;
 	int count_uid_errors = 0;
+	bool modality_lut_warning = false;
+	//
+	const QByteArray plan_key =
+		load_plan_key(filenames, wsettings->get_mosaic(), load_type);
+	LoadPlan plan;
+	const bool plan_hit = get_load_plan(plan_key, plan);
+	if (plan_hit)
+	{
+		images      = plan.images;
+		ultrasound  = plan.ultrasound;
+		multiframe  = plan.multiframe;
+		mixed       = plan.mixed;
+		multiseries = plan.multiseries;
+		mosaic      = plan.mosaic;
+		uihgrid     = plan.uihgrid;
+		elscint     = plan.elscint;
+		count_images = images.size();
+	}
 	//
 	//
 	//
 	const int filenames_size = filenames.size();
 	const QString filenames_num = QString(" / ") +
 		QString::number(filenames_size);
-	for (int x = 0; x < filenames_size; x++)
+	for (int x = 0; !plan_hit && x < filenames_size; x++)
 	{
 		if (pb)
 		{
@@ -10483,6 +9987,12 @@ QString DicomUtils::read_dicom(
 				&pr_,
 				&localizer_))
 		{
+			if (count_images == 0)
+			{
+				get_string_value(
+					ds, mdcm::Tag(0x0020,0x000e), plan.series_uid);
+				plan.series_uid.remove(QChar('\0'));
+			}
 			sop_tmp0 = sop;
 			rows_tmp0 = rows_;
 			columns_tmp0 = columns_;
@@ -10655,6 +10165,7 @@ QString DicomUtils::read_dicom(
 			{
 				if (has_modality_lut_sq(ds))
 				{
+					modality_lut_warning = true;
 					if (pb) pb->hide();
 					QApplication::processEvents();
 					QMessageBox mbox;
@@ -10680,6 +10191,7 @@ QString DicomUtils::read_dicom(
 	//
 	// is multiseries?
 	if (
+		!plan_hit &&
 		!ultrasound &&
 		!multiframe &&
 		!enhanced &&
@@ -10918,32 +10430,19 @@ QString DicomUtils::read_dicom(
 	else if (multiseries && (load_type == 0))
 	{
 		// TODO
-		for (int k = 0; k < extracted_images.size(); k++)
+		if (!plan_hit)
 		{
-			if (pb) pb->setValue(-1);
-			QApplication::processEvents();
-			std::vector<QString> images__;
-			std::vector<QString> images_ipp;
-			for (int j = 0; j < extracted_images.at(k).size(); j++)
-			{
-				images__.push_back(extracted_images.at(k).at(j));
-			}
-			if (images__.size()>1)
-			{
-				mdcm::Sorter2 sorter;
-				sorter.SetSortFunction(sort0_);
-				sorter.StableSort(images__);
-				images_ipp = sorter.GetFilenames();
-			}
-			else if (images__.size()==1)
-			{
-				images_ipp.push_back(images__.at(0));
-			}
-			QStringList images_tmp;
-			for (size_t j = 0; j < images_ipp.size(); j++)
+			for (int k = 0; k < extracted_images.size(); k++)
 			{
-				images_tmp << images_ipp.at(j);
+				plan.series.push_back(
+					sort_images_ipp(extracted_images.at(k)));
 			}
+		}
+		for (int k = 0; k < plan.series.size(); k++)
+		{
+			if (pb) pb->setValue(-1);
+			QApplication::processEvents();
+			const QStringList & images_tmp = plan.series.at(k);
 			{
 				ImageVariant * ivariant = new ImageVariant(
 					CommonUtils::get_next_id(),
@@ -11364,104 +10863,90 @@ QString DicomUtils::read_dicom(
 	else if (mixed && (load_type == 0||load_type == 2))
 	{
 		// TODO
-		const mdcm::Tag tt(0x0008,0x0008);
-		const mdcm::Tag tr(0x0028,0x0010);
-		const mdcm::Tag tc(0x0028,0x0011);
-		const mdcm::Tag ta(0x0028,0x0100);
-		std::vector<MixedDicomSeriesInfo> msi;
-		for (int x = 0; x < images.size(); x++)
-		{
-			MixedDicomSeriesInfo si;
-			si.rows      = -1;
-			si.columns   = -1;
-			si.allocated =  0;
-			si.localizer =  false;
-			si.file      = QString(images.at(x));
-			mdcm::Reader reader;
-			reader.SetFileName(
-				filenames.at(x).toLocal8Bit().constData());
-			if (!reader.ReadUpToTag(mdcm::Tag(0x0028,0x0101))) continue;
-			const mdcm::File    & file = reader.GetFile();
-			const mdcm::DataSet & ds   = file.GetDataSet();
-			if (ds.IsEmpty()) continue;
-			unsigned short r = 0, c = 0, a = 0;
-			if (get_us_value(ds,tr,&r))
-			{
-				si.rows = (int)r;
-			}
-			if (get_us_value(ds,tc,&c))
-			{
-				si.columns = (int)c;
-			}
-			if (get_us_value(ds,ta,&a))
-			{
-				si.allocated = a;
+		if (!plan_hit)
+		{
+			const mdcm::Tag tt(0x0008,0x0008);
+			const mdcm::Tag tr(0x0028,0x0010);
+			const mdcm::Tag tc(0x0028,0x0011);
+			const mdcm::Tag ta(0x0028,0x0100);
+			std::vector<MixedDicomSeriesInfo> msi;
+			for (int x = 0; x < images.size(); x++)
+			{
+				MixedDicomSeriesInfo si;
+				si.rows      = -1;
+				si.columns   = -1;
+				si.allocated =  0;
+				si.localizer =  false;
+				si.file      = QString(images.at(x));
+				mdcm::Reader reader;
+				reader.SetFileName(
+					filenames.at(x).toLocal8Bit().constData());
+				if (!reader.ReadUpToTag(mdcm::Tag(0x0028,0x0101))) continue;
+				const mdcm::File    & file = reader.GetFile();
+				const mdcm::DataSet & ds   = file.GetDataSet();
+				if (ds.IsEmpty()) continue;
+				unsigned short r = 0, c = 0, a = 0;
+				if (get_us_value(ds,tr,&r))
+				{
+					si.rows = (int)r;
+				}
+				if (get_us_value(ds,tc,&c))
+				{
+					si.columns = (int)c;
+				}
+				if (get_us_value(ds,ta,&a))
+				{
+					si.allocated = a;
+				}
+				QString s;
+				if (get_string_value(ds,tt,s))
+				{
+					if (s.contains(QString("LOCALIZER")))
+						si.localizer = true;
+				}
+				msi.push_back(si);
 			}
-			QString s;
-			if (get_string_value(ds,tt,s))
+			QMultiMap<QString, QString> l0;
+			for (size_t x = 0; x < msi.size(); x++)
 			{
-				if (s.contains(QString("LOCALIZER")))
-					si.localizer = true;
+				const MixedDicomSeriesInfo & i = msi.at(x);
+				if (i.rows != -1 && i.columns != -1 && i.allocated > 0)
+				{
+					const QString k1 =
+						QString::number(i.rows) +
+						QString("x") +
+						QString::number(i.columns) +
+						QString("x") +
+						QString::number((int)i.allocated) +
+						(i.localizer ? QString("L") : QString(""));
+					l0.insert(k1, i.file);
+				}
 			}
-			msi.push_back(si);
-		}
-		QMultiMap<QString, QString> l0;
-		for (size_t x = 0; x < msi.size(); x++)
-		{
-			const MixedDicomSeriesInfo & i = msi.at(x);
-			if (i.rows != -1 && i.columns != -1 && i.allocated > 0)
+			QList<QStringList> fff;
+			const QList<QString> & l1 = l0.keys();
+			const QSet<QString> s1 = l1.toSet();
+			QSet<QString>::const_iterator it1 = s1.begin();
+			while (it1 != s1.end())
 			{
-				const QString k1 =
-					QString::number(i.rows) +
-					QString("x") +
-					QString::number(i.columns) +
-					QString("x") +
-					QString::number((int)i.allocated) +
-					(i.localizer ? QString("L") : QString(""));
-				l0.insert(k1, i.file);
+				QStringList ff;
+				const QList<QString> & q = l0.values(*it1);
+				for (int y = 0; y < q.size(); y++)
+				{
+					ff.push_back(q.at(y));
+				}
+				fff.push_back(ff);
+				++it1;
 			}
-		}
-		QList<QStringList> fff;
-		const QList<QString> & l1 = l0.keys();
-		const QSet<QString> s1 = l1.toSet();
-		QSet<QString>::const_iterator it1 = s1.begin();
-		while (it1 != s1.end())
-		{
-			QStringList ff;
-			const QList<QString> & q = l0.values(*it1);
-			for (int y = 0; y < q.size(); y++)
+			for (int x = 0; x < fff.size(); x++)
 			{
-				ff.push_back(q.at(y));
+				plan.series.push_back(sort_images_ipp(fff.at(x)));
 			}
-			fff.push_back(ff);
-			++it1;
 		}
-		for (int x = 0; x < fff.size(); x++)
+		for (int x = 0; x < plan.series.size(); x++)
 		{
 			if (pb) pb->setValue(-1);
 			QApplication::processEvents();
-			std::vector<QString> images__;
-			std::vector<QString> images_ipp;
-			for (int k = 0; k < fff.at(x).size(); k++)
-			{
-				images__.push_back(fff.at(x).at(k));
-			}
-			if (images__.size()>1)
-			{
-				mdcm::Sorter2 sorter;
-				sorter.SetSortFunction(sort0_);
-				sorter.StableSort(images__);
-				images_ipp = sorter.GetFilenames();
-			}
-			else if (images__.size()==1)
-			{
-				images_ipp.push_back(images__.at(0));
-			}
-			QStringList images_tmp;
-			for (size_t j = 0; j < images_ipp.size(); j++)
-			{
-				images_tmp << images_ipp.at(j);
-			}
+			const QStringList & images_tmp = plan.series.at(x);
 			if (load_type == 0||load_type == 2)
 			{
 				ImageVariant * ivariant = new ImageVariant(
@@ -11538,28 +11023,11 @@ QString DicomUtils::read_dicom(
 		{
 			if (pb) pb->setValue(-1);
 			QApplication::processEvents();
-			std::vector<QString> images__;
-			std::vector<QString> images_ipp;
-			for (int k = 0; k < images.size(); k++)
-			{
-				images__.push_back(images.at(k));
-			}
-			if (images__.size()>1)
-			{
-				mdcm::Sorter2 sorter;
-				sorter.SetSortFunction(sort0_);
-				sorter.StableSort(images__);
-				images_ipp = sorter.GetFilenames();
-			}
-			else if (images__.size()==1)
+			if (plan.series.empty())
 			{
-				images_ipp.push_back(images__.at(0));
-			}
-			QStringList images_tmp;
-			for (size_t j = 0; j < images_ipp.size(); j++)
-			{
-				images_tmp << images_ipp.at(j);
+				plan.series.push_back(sort_images_ipp(images));
 			}
+			const QStringList & images_tmp = plan.series.at(0);
 			if (load_type == 0||load_type == 2)
 			{
 				ImageVariant * ivariant = new ImageVariant(
@@ -11658,6 +11126,23 @@ QString DicomUtils::read_dicom(
 			}
 		}
 	}
+	// only plain image series, other objects are processed every time
+	if (!plan_hit &&
+		!enhanced &&
+		!modality_lut_warning &&
+		count_images > 0 &&
+		count_images == filenames_size)
+	{
+		plan.images      = images;
+		plan.ultrasound  = ultrasound;
+		plan.multiframe  = multiframe;
+		plan.mixed       = mixed;
+		plan.multiseries = multiseries;
+		plan.mosaic      = mosaic;
+		plan.uihgrid     = uihgrid;
+		plan.elscint     = elscint;
+		store_load_plan(plan_key, plan);
+	}
 	if (count_uid_errors > 0)
 	{
 		if (!message_.isEmpty()) message_.append(QString("\n"));
@@ -10,6 +10,7 @@
 #include <mdcmDataSet.h>
 #include <mdcmPixelFormat.h>
 #include <mdcmPhotometricInterpretation.h>
+#include <mdcmOverlay.h>
 #include "structures.h"
 
 class GLWidget;
@@ -233,6 +234,10 @@ public:
 	static bool convert_elscint(
 		const QString,
 		const QString);
+	static bool read_overlay_frame(
+		const mdcm::Overlay&,
+		const unsigned int,
+		SliceOverlay&);
 	static QString read_buffer(
 		bool*, std::vector<char*> &,
 		ImageOverlays &, const int,
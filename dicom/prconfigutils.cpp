@@ -28,6 +28,9 @@
 #include <QMap>
 #include <QMultiMap>
 #include <QApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
 #include <vector>
 #include <iostream>
 #include "mdcmDataElement.h"
@@ -151,6 +154,49 @@ template<typename T> QString intensity_filter2(
 	return QString("");
 }
 
+template<typename T> QString intensity_filter3(
+	const typename T::Pointer & image,
+	typename ImageTypeF::Pointer & out_image,
+	const QList< QPair<double, double> > & slice_rescale)
+{
+	if (image.IsNull()) return QString("Image is NULL");
+	const typename T::RegionType region = image->GetLargestPossibleRegion();
+	const typename T::SizeType size = region.GetSize();
+	try
+	{
+		out_image = ImageTypeF::New();
+		out_image->SetRegions(region);
+		out_image->SetOrigin(image->GetOrigin());
+		out_image->SetSpacing(image->GetSpacing());
+		out_image->SetDirection(image->GetDirection());
+		out_image->Allocate();
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		out_image = NULL;
+		return QString(ex.GetDescription());
+	}
+	const size_t slice_size = size[0] * size[1];
+	const typename T::PixelType * in = image->GetBufferPointer();
+	float * out = out_image->GetBufferPointer();
+	for (size_t z = 0; z < size[2]; z++)
+	{
+		double intercept = 0.0, slope = 1.0;
+		if (z < static_cast<size_t>(slice_rescale.size()))
+		{
+			intercept = slice_rescale.at(z).first;
+			slope     = slice_rescale.at(z).second;
+		}
+		const size_t k = z * slice_size;
+		for (size_t j = 0; j < slice_size; j++)
+		{
+			out[k + j] = static_cast<float>(
+				static_cast<double>(in[k + j]) * slope + intercept);
+		}
+	}
+	return QString("");
+}
+
 template<typename T> QString to_char(
 	const typename T::Pointer & image,
 	typename ImageTypeUC::Pointer & out_image,
@@ -218,12 +264,27 @@ template<typename T> QString to_char_sigm(
 	return QString("");
 }
 
+// Filters of one slice run in the slice workers, the workers already
+// use the thread budget.
+template<typename T> void set_single_threaded(T * filter)
+{
+#if ITK_VERSION_MAJOR >= 5
+	filter->SetNumberOfWorkUnits(1);
+#else
+	filter->SetNumberOfThreads(1);
+#endif
+}
+
 template<typename Tin, typename Tout> QString extract_one_slice(
 	const typename Tin::Pointer & image,
 	typename Tout::Pointer & out_image,
 	const int idx)
 {
 	if (image.IsNull()) return QString("Image is NULL");
+	// The filter updates the requested region of the shared
+	// input image, slices are extracted one at a time.
+	static QMutex mutex;
+	QMutexLocker locker(&mutex);
 	typedef itk::ExtractImageFilter<Tin, Tout> FilterType;
 	const typename Tin::RegionType inRegion =
 		image->GetLargestPossibleRegion();
@@ -240,6 +301,7 @@ template<typename Tin, typename Tout> QString extract_one_slice(
 	outRegion.SetIndex(index);
 	try
 	{
+		set_single_threaded(filter.GetPointer());
 		filter->SetInput(image);
 		filter->SetExtractionRegion(outRegion);
 		filter->SetDirectionCollapseToIdentity();
@@ -940,6 +1002,409 @@ static void rotate_flip_points(
 	}
 }
 
+template<typename T, typename T2d> void copy_slice_to_volume(
+	const typename T2d::Pointer & slice,
+	typename T::Pointer & volume,
+	const int z)
+{
+	const typename T::SizeType size =
+		volume->GetLargestPossibleRegion().GetSize();
+	const typename T2d::SizeType ssize =
+		slice->GetLargestPossibleRegion().GetSize();
+	if (z < 0 || z >= static_cast<int>(size[2])) return;
+	const size_t dx = size[0];
+	const size_t dy = size[1];
+	const size_t sx = (ssize[0] < dx) ? ssize[0] : dx;
+	const size_t sy = (ssize[1] < dy) ? ssize[1] : dy;
+	const typename T2d::PixelType * in = slice->GetBufferPointer();
+	typename T::PixelType * out =
+		volume->GetBufferPointer() + static_cast<size_t>(z) * dx * dy;
+	for (size_t y = 0; y < sy; y++)
+	{
+		for (size_t x = 0; x < sx; x++)
+		{
+			out[y * dx + x] =
+				static_cast<typename T::PixelType>(in[y * ssize[0] + x]);
+		}
+	}
+}
+
+template<typename T> void wait_slice_threads(
+	std::vector<T*> & threads,
+	QString & error)
+{
+	while (true)
+	{
+		size_t b__ = 0;
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			if (threads.at(i)->isFinished()) { b__++; }
+		}
+		if (b__ == threads.size()) break;
+		QApplication::processEvents();
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		if (error.isEmpty()) error = threads.at(i)->error;
+		delete threads[i];
+	}
+	threads.clear();
+}
+
+// Spatial transform of one slice, the display area of the slice
+// is the center of the rotation and of the flip.
+template<typename T2d> QString rotate_flip_2d(
+	const typename T2d::Pointer & tmp0,
+	typename T2d::Pointer & tmp1,
+	const PRDisplayAreas & areas,
+	const double rotation,
+	const bool flip,
+	const int z,
+	const int dx,
+	const int dy)
+{
+	typedef itk::FlipImageFilter<T2d> FlipFilterType;
+	typedef itk::ResampleImageFilter<T2d,T2d> ResampleType;
+	typedef itk::AffineTransform<double, 2> TransformType;
+	typedef itk::LinearInterpolateImageFunction<T2d, double>
+		InterpolatorType;
+	typedef itk::ImageLinearIteratorWithIndex<T2d> LinearIterator;
+	typedef itk::ImageDuplicator<T2d> DuplicatorType;
+	int ax = 0;
+	int ay = 0;
+	int px = 0;
+	int py = 0;
+	if (tmp0.IsNull()) return QString("tmp0.IsNull()");
+	bool apply_display_area = false;
+	if (areas.contains(z))
+	{
+		const PRDisplayArea a = areas.value(z);
+		if (!(
+			a.top_left_x == 1 &&
+			a.top_left_y == 1 &&
+			dx == a.bottom_right_x &&
+			dy == a.bottom_right_y))
+		{
+			ax = a.bottom_right_x - a.top_left_x;
+			ay = a.bottom_right_y - a.top_left_y;
+			px = a.top_left_x;
+			py = a.top_left_y;
+			apply_display_area = true;
+		}
+	}
+	if (!apply_display_area)
+	{
+		if (rotation != 0.0)
+		{
+			const unsigned int dx0 =
+				tmp0->GetLargestPossibleRegion().GetSize()[0];
+			const unsigned int dy0 =
+				tmp0->GetLargestPossibleRegion().GetSize()[1];
+			const double sx = tmp0->GetSpacing()[0];
+			const double sy = tmp0->GetSpacing()[1];
+			const double ox = tmp0->GetOrigin()[0];
+			const double oy = tmp0->GetOrigin()[1];
+			typename TransformType::Pointer transform =
+				TransformType::New();
+			typename ResampleType::Pointer filter0 =
+				ResampleType::New();
+			typename InterpolatorType::Pointer interpolator =
+				InterpolatorType::New();
+			typename FlipFilterType::Pointer filter1 =
+				FlipFilterType::New();
+			const double cx = ox + dx0 * sx / 2.0;
+			const double cy = oy + dy0 * sy / 2.0;
+			typename TransformType::OutputVectorType translation1;
+			translation1[0] = -cx;
+			translation1[1] = -cy;
+			typename TransformType::OutputVectorType translation2;
+			translation2[0] = cx;
+			translation2[1] = cy;
+			const double a = rotation*0.0174532925199432957692369;
+			itk::FixedArray<bool, 2> f;
+			f[0] = true;
+			f[1] = false;
+			transform->SetIdentity();
+			transform->Translate(translation1);
+			transform->Rotate2D(-a, false);
+			transform->Translate(translation2, false);
+			try
+			{
+				set_single_threaded(filter0.GetPointer());
+				set_single_threaded(filter1.GetPointer());
+				filter0->SetInput(tmp0);
+				filter0->SetInterpolator(interpolator);
+				filter0->SetDefaultPixelValue(
+					itk::NumericTraits<
+						typename T2d::PixelType>::Zero);
+				filter0->SetTransform(transform);
+				filter0->SetOutputOrigin(tmp0->GetOrigin());
+				filter0->SetOutputSpacing(tmp0->GetSpacing());
+				filter0->SetOutputDirection(tmp0->GetDirection());
+				filter0->SetSize(
+					tmp0->GetLargestPossibleRegion().GetSize());
+				if (flip)
+				{
+					filter1->SetInput(filter0->GetOutput());
+					filter1->SetFlipAxes(f);
+					filter1->Update();
+					tmp1 = filter1->GetOutput();
+				}
+				else
+				{
+					filter0->Update();
+					tmp1 = filter0->GetOutput();
+				}
+			}
+			catch (itk::ExceptionObject & ex)
+			{
+				return QString(ex.GetDescription());
+			}
+		}
+		else if (flip)
+		{
+			typename FlipFilterType::Pointer filter =
+				FlipFilterType::New();
+			itk::FixedArray<bool, 2> f;
+			f[0] = true;
+			f[1] = false;
+			try
+			{
+				set_single_threaded(filter.GetPointer());
+				filter->SetInput(tmp0);
+				filter->SetFlipAxes(f);
+				filter->Update();
+				tmp1 = filter->GetOutput();
+			}
+			catch (itk::ExceptionObject & ex)
+			{
+				return QString(ex.GetDescription());
+			}
+		}
+		else
+		{
+			tmp1 = tmp0;
+		}
+	}
+	else
+	{
+		if (rotation != 0.0||flip)
+		{
+			if (rotation != 0.0)
+			{
+				const double sx = tmp0->GetSpacing()[0];
+				const double sy = tmp0->GetSpacing()[1];
+				const double ox = tmp0->GetOrigin()[0];
+				const double oy = tmp0->GetOrigin()[1];
+				typename TransformType::Pointer transform =
+					TransformType::New();
+				typename ResampleType::Pointer filter0 =
+					ResampleType::New();
+				typename InterpolatorType::Pointer interpolator =
+					InterpolatorType::New();
+				const double cx = ox + px*sx + ax*sx/2.0;
+				const double cy = oy + py*sy + ay*sy/2.0;
+				typename TransformType::OutputVectorType
+					translation1;
+				translation1[0] = -cx;
+				translation1[1] = -cy;
+				typename TransformType::OutputVectorType
+					translation2;
+				translation2[0] = cx;
+				translation2[1] = cy;
+				const double a =
+					rotation*0.0174532925199432957692369;
+				transform->SetIdentity();
+				transform->Translate(translation1);
+				transform->Rotate2D(-a, false);
+				transform->Translate(translation2, false);
+				try
+				{
+					set_single_threaded(filter0.GetPointer());
+					filter0->SetInput(tmp0);
+					filter0->SetInterpolator(interpolator);
+					filter0->SetDefaultPixelValue(
+						itk::NumericTraits<
+							typename
+								T2d::PixelType>::Zero);
+					filter0->SetTransform(transform);
+					filter0->SetOutputOrigin(tmp0->GetOrigin());
+					filter0->SetOutputSpacing(tmp0->GetSpacing());
+					filter0->SetOutputDirection(
+						tmp0->GetDirection());
+					filter0->SetSize(
+						tmp0->GetLargestPossibleRegion()
+							.GetSize());
+					filter0->Update();
+					tmp1 = filter0->GetOutput();
+				}
+				catch (itk::ExceptionObject & ex)
+				{
+					return QString(ex.GetDescription());
+				}
+			}
+			else
+			{
+				tmp1 = tmp0;
+			}
+			if (flip)
+			{
+				typename T2d::Pointer tmp2;
+				typename DuplicatorType::Pointer
+					duplicator = DuplicatorType::New();
+				try
+				{
+					duplicator->SetInputImage(tmp1);
+					duplicator->Update();
+					tmp2 = duplicator->GetOutput();
+				}
+				catch(itk::ExceptionObject & ex)
+				{
+					return QString(ex.GetDescription());
+				}
+				LinearIterator it(
+					tmp1,
+					tmp1->GetLargestPossibleRegion());
+				it.SetDirection(0);
+				it.GoToBegin();
+				const int j__ = px + ax/2;
+				int x__ = 0;
+				int y__ = 0;
+				const int idimx =
+					tmp1->GetLargestPossibleRegion().GetSize()[0];
+				while(!it.IsAtEnd())
+				{
+					while(!it.IsAtEndOfLine())
+					{
+						if (x__ < j__)
+						{
+							const int ix = x__ + 2*(j__ - x__);
+							if (ix >= idimx || ix < 0)
+							{
+								it.Set(itk::NumericTraits<
+									typename
+										T2d::PixelType>::Zero);
+							}
+							else
+							{
+								typename T2d::IndexType i;
+								i[0] = ix;
+								i[1] =  y__;
+								it.Set(tmp2->GetPixel(i));
+							}
+						}
+						else if (x__ > j__)
+						{
+							const int ix = x__ - 2*(x__ - j__);
+							if (ix >= idimx || ix < 0)
+							{
+								it.Set(itk::NumericTraits<
+									typename
+										T2d::PixelType>::Zero);
+							}
+							else
+							{
+								typename T2d::IndexType i;
+								i[0] = ix;
+								i[1] =  y__;
+								it.Set(tmp2->GetPixel(i));
+							}
+						}
+						else
+						{
+							typename T2d::IndexType i;
+							i[0] = x__;
+							i[1] = y__;
+							it.Set(tmp2->GetPixel(i));
+						}
+						x__++;
+						++it;
+					}
+					x__ = 0;
+					y__++;
+					it.NextLine();
+				}
+			}
+		}
+		else
+		{
+			tmp1 = tmp0;
+		}
+	}
+	if (tmp1.IsNull()) return QString("tmp1.IsNull()");
+	if (tmp1->GetLargestPossibleRegion().GetSize()[0] == 0 ||
+			tmp1->GetLargestPossibleRegion().GetSize()[1] == 0)
+	{
+		return QString("Internal error");
+	}
+	return QString("");
+}
+
+template<typename T, typename T2d> QString rotate_flip_one_slice(
+	const typename T::Pointer & image,
+	typename T::Pointer & out_image,
+	const ImageVariant * ivariant,
+	const double rotation,
+	const bool flip,
+	const int z)
+{
+	typename T2d::Pointer tmp0;
+	typename T2d::Pointer tmp1;
+	const QString error = extract_one_slice<T,T2d>(image, tmp0, z);
+	if (tmp0.IsNull()) return QString("tmp0.IsNull()");
+	if (!error.isEmpty()) return error;
+	const int dx = (int)image->GetLargestPossibleRegion().GetSize()[0];
+	const int dy = (int)image->GetLargestPossibleRegion().GetSize()[1];
+	const QString error1 = rotate_flip_2d<T2d>(
+		tmp0, tmp1, ivariant->pr_display_areas, rotation, flip, z, dx, dy);
+	if (!error1.isEmpty()) return error1;
+	copy_slice_to_volume<T, T2d>(tmp1, out_image, z);
+	return QString("");
+}
+
+template<typename T, typename T2d> class RotateFlipThread_ : public QThread
+{
+public:
+	RotateFlipThread_(
+		const typename T::Pointer & image_,
+		typename T::Pointer & out_image_,
+		const ImageVariant * ivariant_,
+		const double rotation_,
+		const bool flip_,
+		const int z0_,
+		const int z1_)
+		:
+		image(image_),
+		out_image(out_image_),
+		ivariant(ivariant_),
+		rotation(rotation_),
+		flip(flip_),
+		z0(z0_), z1(z1_)
+	{
+	}
+	~RotateFlipThread_()
+	{
+	}
+	void run()
+	{
+		for (int z = z0; z < z1; z++)
+		{
+			error = rotate_flip_one_slice<T,T2d>(
+				image, out_image, ivariant, rotation, flip, z);
+			if (!error.isEmpty()) return;
+		}
+	}
+	QString error;
+private:
+	const typename T::Pointer & image;
+	typename T::Pointer & out_image;
+	const ImageVariant * ivariant;
+	const double rotation;
+	const bool flip;
+	const int z0;
+	const int z1;
+};
+
 template<typename T, typename T2d> QString rotate_flip_slice_by_slice(
 	const typename T::Pointer & image,
 	typename T::Pointer & out_image,
@@ -950,587 +1415,958 @@ template<typename T, typename T2d> QString rotate_flip_slice_by_slice(
 	if (image.IsNull()) return QString("image.IsNull()");
 	try
 	{
-		out_image = T::New();
-		out_image->SetOrigin(image->GetOrigin());
-		out_image->SetSpacing(image->GetSpacing());
-		out_image->SetDirection(image->GetDirection());
-		out_image->SetRegions(image->GetLargestPossibleRegion());
-		out_image->Allocate();
-		out_image->FillBuffer(
-			itk::NumericTraits<typename T::PixelType>::Zero);
+		out_image = T::New();
+		out_image->SetOrigin(image->GetOrigin());
+		out_image->SetSpacing(image->GetSpacing());
+		out_image->SetDirection(image->GetDirection());
+		out_image->SetRegions(image->GetLargestPossibleRegion());
+		out_image->Allocate();
+		out_image->FillBuffer(
+			itk::NumericTraits<typename T::PixelType>::Zero);
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		return QString(ex.GetDescription());
+	}
+	const int dz = (int)image->GetLargestPossibleRegion().GetSize()[2];
+	if (dz < 1) return QString("dz < 1");
+	// Every slice is independent and is written to its own part of
+	// the output buffer, so blocks of slices are processed in parallel.
+	int num_threads = CommonUtils::get_max_threads();
+	if (num_threads < 1) num_threads = 1;
+	if (num_threads > dz) num_threads = dz;
+	const int block = dz / num_threads;
+	std::vector<RotateFlipThread_<T,T2d>*> threads;
+	for (int i = 0; i < num_threads; i++)
+	{
+		const int z0 = i * block;
+		const int z1 = (i == num_threads - 1) ? dz : z0 + block;
+		RotateFlipThread_<T,T2d> * t__ = new RotateFlipThread_<T,T2d>(
+			image, out_image, ivariant, rotation, flip, z0, z1);
+		threads.push_back(t__);
+		t__->start();
+	}
+	QString error("");
+	wait_slice_threads(threads, error);
+	if (!error.isEmpty()) return error;
+	if (out_image.IsNotNull()) out_image->DisconnectPipeline();
+	else return QString("Output image is NULL");
+	return QString("");
+}
+
+// VOI LUT 'k' of one slice, the output is 0-255, not rescaled.
+template<typename T2d> QString window_2d(
+	const typename T2d::Pointer & tmp0,
+	typename Image2DTypeUC::Pointer & tmp1,
+	const QMap<int, double> & widths,
+	const QMap<int, double> & centers,
+	const QMap<int, QString> & lut_functions,
+	const int k)
+{
+	typedef itk::IntensityWindowingImageFilter<T2d, Image2DTypeUC>
+		LinearFilterType;
+	typedef itk::Sigmoid2ImageFilter<T2d, Image2DTypeUC>
+		SigmoidFilterType;
+	if (tmp0.IsNull()) return QString("tmp0.IsNull()");
+	if (
+		lut_functions.contains(k) &&
+		(lut_functions.value(k)
+			.trimmed()
+			.remove(QChar('\0'))
+			.toUpper() ==
+		QString("SIGMOID")))
+	{
+		typename SigmoidFilterType::Pointer
+			filter0 = SigmoidFilterType::New();
+		try
+		{
+			set_single_threaded(filter0.GetPointer());
+			filter0->SetInput(tmp0);
+			filter0->SetAlpha(
+				static_cast<typename T2d::PixelType>(
+					widths.value(k)));
+			filter0->SetBeta(
+				static_cast<typename T2d::PixelType>(
+					centers.value(k)));
+			filter0->SetOutputMinimum(
+				static_cast<typename
+					Image2DTypeUC::PixelType>(0));
+			filter0->SetOutputMaximum(
+				static_cast<typename
+					Image2DTypeUC::PixelType>(255));
+			filter0->Update();
+			tmp1 = filter0->GetOutput();
+		}
+		catch (itk::ExceptionObject & ex)
+		{ return QString( ex.GetDescription()); }
+	}
+	else
+	{
+		typename LinearFilterType::Pointer
+			filter0 = LinearFilterType::New();
+		try
+		{
+			set_single_threaded(filter0.GetPointer());
+			filter0->SetInput(tmp0);
+			filter0->SetWindowLevel(
+				static_cast<typename T2d::PixelType>(
+					widths.value(k)),
+				static_cast<typename T2d::PixelType>(
+					centers.value(k)));
+			filter0->SetOutputMinimum(
+				static_cast<
+					typename
+						Image2DTypeUC::PixelType>(
+							0));
+			filter0->SetOutputMaximum(
+				static_cast<
+					typename
+						Image2DTypeUC::PixelType>(
+							255));
+			filter0->Update();
+			tmp1 = filter0->GetOutput();
+		}
+		catch (itk::ExceptionObject & ex)
+		{ return QString( ex.GetDescription()); }
+	}
+	if (tmp1.IsNull()) return QString("tmp1.IsNull()");
+	tmp1->DisconnectPipeline();
+	return QString("");
+}
+
+// VOI LUT 'k' of one slice, the output is rescaled to 0-255 with
+// the range of the slice.
+template<typename T2d> QString levels_2d(
+	const typename T2d::Pointer & tmp0,
+	typename Image2DTypeUC::Pointer & tmp1,
+	const QMap<int, double> & widths,
+	const QMap<int, double> & centers,
+	const QMap<int, QString> & lut_functions,
+	const int k)
+{
+	typedef itk::RescaleIntensityImageFilter<Image2DTypeUC, Image2DTypeUC>
+		RescaleFilterType;
+	typename Image2DTypeUC::Pointer tmp2;
+	const QString error =
+		window_2d<T2d>(tmp0, tmp2, widths, centers, lut_functions, k);
+	if (!error.isEmpty()) return error;
+	typename RescaleFilterType::Pointer
+		filter1 = RescaleFilterType::New();
+	try
+	{
+		set_single_threaded(filter1.GetPointer());
+		filter1->SetInput(tmp2);
+		filter1->Update();
+		tmp1 = filter1->GetOutput();
+	}
+	catch (itk::ExceptionObject & ex)
+	{ return QString( ex.GetDescription()); }
+	if (tmp1.IsNull()) return QString("tmp1.IsNull()");
+	return QString("");
+}
+
+// Rescales to 0-255 with the given input range, in place, same as
+// RescaleIntensityImageFilter with the range of the whole image.
+static void rescale_2d(
+	Image2DTypeUC::Pointer & image,
+	const double rmin,
+	const double rmax)
+{
+	double factor = 0.0;
+	if (rmin != rmax)   factor = 255.0 / (rmax - rmin);
+	else if (rmax != 0) factor = 255.0 / rmax;
+	const double offset = -rmin * factor;
+	const size_t n = image->GetLargestPossibleRegion().GetNumberOfPixels();
+	unsigned char * p = image->GetBufferPointer();
+	for (size_t j = 0; j < n; j++)
+	{
+		const double d = static_cast<double>(p[j]) * factor + offset;
+		p[j] = (d > 255.0) ? 255 :
+			((d < 0.0) ? 0 : static_cast<unsigned char>(d));
+	}
+}
+
+template<typename T, typename T2d> QString levels_one_slice(
+	const typename T::Pointer & image,
+	typename ImageTypeUC::Pointer & out_image,
+	const QMap<int, double> & widths,
+	const QMap<int, double> & centers,
+	const QMap<int, QString> & lut_functions,
+	const int k,
+	const int idx)
+{
+	typename T2d::Pointer tmp0;
+	typename Image2DTypeUC::Pointer tmp1;
+	const QString error =
+		extract_one_slice<T,T2d>(image, tmp0, idx);
+	if (tmp0.IsNull()) return QString("tmp0.IsNull()");
+	if (!error.isEmpty()) return error;
+	const QString error1 = levels_2d<T2d>(
+		tmp0, tmp1, widths, centers, lut_functions, k);
+	if (!error1.isEmpty()) return error1;
+	copy_slice_to_volume<ImageTypeUC, Image2DTypeUC>(tmp1, out_image, idx);
+	return QString("");
+}
+
+template<typename T, typename T2d> class LevelsThread_ : public QThread
+{
+public:
+	LevelsThread_(
+		const typename T::Pointer & image_,
+		typename ImageTypeUC::Pointer & out_image_,
+		const QMap<int, double> & widths_,
+		const QMap<int, double> & centers_,
+		const QMap<int, QString> & lut_functions_,
+		const std::vector<int> & idxs_,
+		const std::vector<int> & refs_,
+		const int j0_,
+		const int j1_)
+		:
+		image(image_),
+		out_image(out_image_),
+		widths(widths_),
+		centers(centers_),
+		lut_functions(lut_functions_),
+		idxs(idxs_),
+		refs(refs_),
+		j0(j0_), j1(j1_)
+	{
+	}
+	~LevelsThread_()
+	{
+	}
+	void run()
+	{
+		for (int j = j0; j < j1; j++)
+		{
+			error = levels_one_slice<T,T2d>(
+				image, out_image,
+				widths, centers, lut_functions,
+				refs.at(j), idxs.at(j));
+			if (!error.isEmpty()) return;
+		}
+	}
+	QString error;
+private:
+	const typename T::Pointer & image;
+	typename ImageTypeUC::Pointer & out_image;
+	const QMap<int, double> & widths;
+	const QMap<int, double> & centers;
+	const QMap<int, QString> & lut_functions;
+	const std::vector<int> & idxs;
+	const std::vector<int> & refs;
+	const int j0;
+	const int j1;
+};
+
+// Slice index -> VOI LUT item, the last matching item is used.
+static QMap<int, int> get_voi_jobs(
+	const QMap<int, QStringList> & refs,
+	const SOPInstanceUids & slices_uids)
+{
+	QMap<int, int> jobs;
+	for (
+		QMap<int, QStringList>::const_iterator it = refs.constBegin();
+		it != refs.constEnd();
+		++it)
+	{
+		const int k = it.key();
+		const QStringList & l = it.value();
+		for (int z = 0; z < l.size(); z+=2)
+		{
+			const QString uid =
+				l.at(z+0).trimmed().remove(QChar('\0'));
+			const QString frames =
+				l.at(z+1)
+					.trimmed()
+					.remove(QChar(' '))
+					.remove(QChar('\0'));
+			QList<int> idxs;
+			const QStringList frames_tmp1 = frames.split(
+				QString("\\"),
+				QString::SkipEmptyParts);
+			if (frames_tmp1.size() < 1)
+			{
+				SOPInstanceUids::const_iterator it1 =
+					slices_uids.constBegin();
+				while (it1 != slices_uids.constEnd())
+				{
+					if (uid == it1.value()
+						.trimmed()
+						.remove(QChar('\0')))
+					{
+						idxs.push_back(it1.key());
+					}
+					++it1;
+				}
+			}
+			else
+			{
+				for (int x = 0; x < frames_tmp1.size(); x++)
+				{
+					bool tmp99 = false;
+					const int tmp98 = QVariant(
+						frames_tmp1.at(x)
+							.trimmed()
+							.remove(QChar('\0'))).toInt(&tmp99);
+					if (tmp99 && tmp98 > 0)
+					{
+						idxs.push_back(tmp98-1);
+					}
+				}
+			}
+			if (idxs.empty())
+			{
+				std::cout
+					<< "idxs.size()<1 k=" << k << " "
+					<< uid.toStdString()
+					<< std::endl;
+				continue;
+			}
+			for (int x = 0; x < idxs.size(); x++)
+			{
+				const QString uid_ =
+					(slices_uids.contains(idxs.at(x)))
+					?
+					slices_uids.value(idxs.at(x))
+						.trimmed()
+						.remove(QChar('\0'))
+					:
+					QString("");
+				if (!uid_.isEmpty() && (uid_ == uid))
+				{
+					jobs[idxs.at(x)] = k;
+				}
+			}
+		}
+	}
+	return jobs;
+}
+
+template<typename T, typename T2d> QString levels_slice_by_slice(
+	const typename T::Pointer & image,
+	typename ImageTypeUC::Pointer & out_image,
+	const QMap<int, double> & widths,
+	const QMap<int, double> & centers,
+	const QMap<int, QString> & lut_functions,
+	const QMap<int, QStringList> & refs,
+	const SOPInstanceUids & slices_uids)
+{
+	if (image.IsNull()) return QString("image.IsNull()");
+	try
+	{
+		out_image = ImageTypeUC::New();
+		out_image->SetOrigin(static_cast<
+			typename ImageTypeUC::PointType>(
+				image->GetOrigin()));
+		out_image->SetSpacing(static_cast<
+			typename ImageTypeUC::SpacingType>(
+				image->GetSpacing()));
+		out_image->SetDirection(static_cast<
+			typename ImageTypeUC::DirectionType>(
+				image->GetDirection()));
+		out_image->SetRegions(static_cast<
+			typename ImageTypeUC::RegionType>(
+				image->GetLargestPossibleRegion()));
+		out_image->Allocate();
+		out_image->FillBuffer(0);
+	}
+	catch (itk::ExceptionObject & ex)
+	{ return QString(ex.GetDescription()); }
+	const QMap<int, int> jobs = get_voi_jobs(refs, slices_uids);
+	// Slices are independent, the VOI LUT is applied to blocks of
+	// slices in parallel, every slice is written once.
+	std::vector<int> job_idxs;
+	std::vector<int> job_refs;
+	for (
+		QMap<int, int>::const_iterator it = jobs.constBegin();
+		it != jobs.constEnd();
+		++it)
+	{
+		job_idxs.push_back(it.key());
+		job_refs.push_back(it.value());
+	}
+	const int jobs_size = static_cast<int>(job_idxs.size());
+	int num_threads = CommonUtils::get_max_threads();
+	if (num_threads > jobs_size) num_threads = jobs_size;
+	if (num_threads < 1) num_threads = 1;
+	const int block = jobs_size / num_threads;
+	std::vector<LevelsThread_<T,T2d>*> threads;
+	for (int i = 0; i < num_threads; i++)
+	{
+		const int j0 = i * block;
+		const int j1 = (i == num_threads - 1) ? jobs_size : j0 + block;
+		LevelsThread_<T,T2d> * t__ = new LevelsThread_<T,T2d>(
+			image, out_image,
+			widths, centers, lut_functions,
+			job_idxs, job_refs, j0, j1);
+		threads.push_back(t__);
+		t__->start();
+	}
+	QString error("");
+	wait_slice_threads(threads, error);
+	if (!error.isEmpty()) return error;
+	if (out_image.IsNotNull()) out_image->DisconnectPipeline();
+	else return QString("Output image is NULL");
+	return QString("");
+}
+
+// Copies slice 'z' of the referenced image and applies the Modality
+// LUT, spacing and origin are from the output geometry.
+template<typename T> QString pr_read_slice(
+	const itk::ImageBase<3> * source,
+	const itk::ImageBase<3> * geometry,
+	const int z,
+	const double intercept,
+	const double slope,
+	Image2DTypeF::Pointer & out_image)
+{
+	const T * image = dynamic_cast<const T*>(source);
+	if (!image || !image->GetBufferPointer())
+		return QString("Image is NULL");
+	const typename T::SizeType size =
+		image->GetLargestPossibleRegion().GetSize();
+	if (z < 0 || z >= static_cast<int>(size[2]))
+		return QString("Wrong slice index");
+	Image2DTypeF::RegionType region;
+	Image2DTypeF::SizeType out_size;
+	Image2DTypeF::IndexType out_index;
+	Image2DTypeF::SpacingType out_spacing;
+	Image2DTypeF::PointType out_origin;
+	out_size[0] = size[0];
+	out_size[1] = size[1];
+	out_index.Fill(0);
+	region.SetSize(out_size);
+	region.SetIndex(out_index);
+	out_spacing[0] = geometry->GetSpacing()[0];
+	out_spacing[1] = geometry->GetSpacing()[1];
+	out_origin[0] = geometry->GetOrigin()[0];
+	out_origin[1] = geometry->GetOrigin()[1];
+	try
+	{
+		out_image = Image2DTypeF::New();
+		out_image->SetRegions(region);
+		out_image->SetSpacing(out_spacing);
+		out_image->SetOrigin(out_origin);
+		out_image->Allocate();
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		out_image = NULL;
+		return QString(ex.GetDescription());
+	}
+	const size_t slice_size = size[0] * size[1];
+	const typename T::PixelType * in =
+		image->GetBufferPointer() + static_cast<size_t>(z) * slice_size;
+	float * out = out_image->GetBufferPointer();
+	for (size_t j = 0; j < slice_size; j++)
+	{
+		out[j] = static_cast<float>(
+			static_cast<double>(in[j]) * slope + intercept);
+	}
+	return QString("");
+}
+
+template<typename T> itk::ImageBase<2>::Pointer pr_empty_slice(
+	const itk::ImageBase<2>::Pointer & image)
+{
+	typename T::Pointer out_image;
+	try
+	{
+		out_image = T::New();
+		out_image->SetRegions(image->GetLargestPossibleRegion());
+		out_image->SetSpacing(image->GetSpacing());
+		out_image->SetOrigin(image->GetOrigin());
+		out_image->Allocate();
+		out_image->FillBuffer(
+			itk::NumericTraits<typename T::PixelType>::Zero);
+	}
+	catch (itk::ExceptionObject &)
+	{
+		return itk::ImageBase<2>::Pointer();
+	}
+	return itk::ImageBase<2>::Pointer(out_image.GetPointer());
+}
+
+template<typename T2d> QString pr_rotate_flip(
+	itk::ImageBase<2>::Pointer & image,
+	const PRDisplayAreas & areas,
+	const double rotation,
+	const bool flip,
+	const int z)
+{
+	const typename T2d::Pointer tmp0 =
+		dynamic_cast<T2d*>(image.GetPointer());
+	if (tmp0.IsNull()) return QString("tmp0.IsNull()");
+	typename T2d::Pointer tmp1;
+	const int dx = (int)tmp0->GetLargestPossibleRegion().GetSize()[0];
+	const int dy = (int)tmp0->GetLargestPossibleRegion().GetSize()[1];
+	const QString error = rotate_flip_2d<T2d>(
+		tmp0, tmp1, areas, rotation, flip, z, dx, dy);
+	if (!error.isEmpty()) return error;
+	tmp1->DisconnectPipeline();
+	image = itk::ImageBase<2>::Pointer(tmp1.GetPointer());
+	return QString("");
+}
+
+class PrSliceThread_ : public QThread
+{
+public:
+	PrSliceThread_(PrSlices * p_, const int z_) : p(p_), z(z_) {}
+	~PrSliceThread_() {}
+	void run()
+	{
+		itk::ImageBase<2>::Pointer s;
+		const QString error = p->compute(z, s);
+		if (!error.isEmpty()) s = NULL;
+		p->prefetched(z, s, error);
+	}
+
+private:
+	PrSlices * p;
+	const int z;
+};
+
+PrSlices::PrSlices()
+	:
+	source_type(-1),
+	shift(0.0),
+	scale(1.0),
+	voi_luts(0),
+	voi_per_slice(false),
+	voi_min(0.0),
+	voi_max(255.0),
+	rotation(0.0),
+	flip(false),
+	image_type(5),
+	vmin(0.0),
+	vmax(0.0)
+{
+}
+
+PrSlices::~PrSlices()
+{
+	for (int x = 0; x < threads.size(); x++)
+	{
+		threads[x]->wait();
+		delete threads[x];
+	}
+	threads.clear();
+}
+
+// Modality LUT, VOI LUT and spatial transformation of one slice,
+// may run in several threads at a time, the parameters are not
+// changed after make_pr_monochrome.
+QString PrSlices::compute(
+	const int z,
+	itk::ImageBase<2>::Pointer & out_image) const
+{
+	if (source.IsNull() || geometry.IsNull())
+		return QString("Image is NULL");
+	// ShiftScaleImageFilter is (x + shift) * scale
+	double intercept = shift * scale, slope = scale;
+	if (!slice_rescale.empty())
+	{
+		intercept = 0.0;
+		slope = 1.0;
+		if (z < slice_rescale.size())
+		{
+			intercept = slice_rescale.at(z).first;
+			slope     = slice_rescale.at(z).second;
+		}
+	}
+	Image2DTypeF::Pointer tmp0;
+	QString error;
+	switch (source_type)
+	{
+	case 0: error = pr_read_slice<ImageTypeSS> (source, geometry, z, intercept, slope, tmp0); break;
+	case 1: error = pr_read_slice<ImageTypeUS> (source, geometry, z, intercept, slope, tmp0); break;
+	case 2: error = pr_read_slice<ImageTypeSI> (source, geometry, z, intercept, slope, tmp0); break;
+	case 3: error = pr_read_slice<ImageTypeUI> (source, geometry, z, intercept, slope, tmp0); break;
+	case 4: error = pr_read_slice<ImageTypeUC> (source, geometry, z, intercept, slope, tmp0); break;
+	case 5: error = pr_read_slice<ImageTypeF>  (source, geometry, z, intercept, slope, tmp0); break;
+	case 6: error = pr_read_slice<ImageTypeD>  (source, geometry, z, intercept, slope, tmp0); break;
+	case 7: error = pr_read_slice<ImageTypeSLL>(source, geometry, z, intercept, slope, tmp0); break;
+	case 8: error = pr_read_slice<ImageTypeULL>(source, geometry, z, intercept, slope, tmp0); break;
+	default: error = QString("Wrong image type"); break;
+	}
+	if (!error.isEmpty()) return error;
+	if (voi_luts > 0)
+	{
+		// slices without a VOI LUT item are black, as in
+		// levels_slice_by_slice
+		if (voi_per_slice && !voi_jobs.contains(z))
+		{
+			out_image = pr_empty_slice<Image2DTypeUC>(
+				itk::ImageBase<2>::Pointer(tmp0.GetPointer()));
+			if (out_image.IsNull()) return QString("Out image is NULL");
+		}
+		else if (voi_per_slice)
+		{
+			Image2DTypeUC::Pointer tmp1;
+			error = levels_2d<Image2DTypeF>(
+				tmp0, tmp1, widths, centers, lut_functions,
+				voi_jobs.value(z));
+			if (!error.isEmpty()) return error;
+			tmp1->DisconnectPipeline();
+			out_image = itk::ImageBase<2>::Pointer(tmp1.GetPointer());
+		}
+		else
+		{
+			// one window for all slices, rescaled with the range
+			// of the whole image, as to_char and to_char_sigm
+			Image2DTypeUC::Pointer tmp1;
+			error = window_2d<Image2DTypeF>(
+				tmp0, tmp1, widths, centers, lut_functions, 0);
+			if (!error.isEmpty()) return error;
+			rescale_2d(tmp1, voi_min, voi_max);
+			out_image = itk::ImageBase<2>::Pointer(tmp1.GetPointer());
+		}
+	}
+	else
+	{
+		out_image = itk::ImageBase<2>::Pointer(tmp0.GetPointer());
+	}
+	if (rotation != 0.0 || flip)
+	{
+		if (voi_luts > 0)
+			error = pr_rotate_flip<Image2DTypeUC>(
+				out_image, display_areas, rotation, flip, z);
+		else
+			error = pr_rotate_flip<Image2DTypeF>(
+				out_image, display_areas, rotation, flip, z);
+		if (!error.isEmpty()) return error;
+	}
+	return QString("");
+}
+
+// Least recently used slices are removed above ~128 MB.
+void PrSlices::insert(
+	const int z,
+	const itk::ImageBase<2>::Pointer & s)
+{
+	if (s.IsNull()) return;
+	cache[z] = s;
+	lru.removeAll(z);
+	lru.push_back(z);
+	const itk::ImageBase<2>::SizeType size =
+		s->GetLargestPossibleRegion().GetSize();
+	const unsigned long long bytes =
+		static_cast<unsigned long long>(size[0]) * size[1] *
+		((image_type == 4) ? 1 : 4);
+	int max_slices = (bytes > 0) ? (int)(134217728ULL / bytes) : 1;
+	const int num_threads = CommonUtils::get_max_threads();
+	if (max_slices < num_threads + 2) max_slices = num_threads + 2;
+	while (lru.size() > max_slices)
+	{
+		cache.remove(lru.takeFirst());
+	}
+}
+
+void PrSlices::prefetched(
+	const int z,
+	const itk::ImageBase<2>::Pointer & s,
+	const QString & error)
+{
+	QMutexLocker locker(&mutex);
+	if (error.isEmpty()) insert(z, s);
+	else errors[z] = error;
+	pending.remove(z);
+}
+
+// Empty slice with the size of the referenced image.
+itk::ImageBase<2>::Pointer PrSlices::empty_slice() const
+{
+	itk::ImageBase<2>::RegionType region;
+	itk::ImageBase<2>::SizeType size;
+	itk::ImageBase<2>::IndexType index;
+	itk::ImageBase<2>::SpacingType spacing;
+	itk::ImageBase<2>::PointType origin;
+	size[0] = geometry->GetLargestPossibleRegion().GetSize()[0];
+	size[1] = geometry->GetLargestPossibleRegion().GetSize()[1];
+	index.Fill(0);
+	region.SetSize(size);
+	region.SetIndex(index);
+	spacing[0] = geometry->GetSpacing()[0];
+	spacing[1] = geometry->GetSpacing()[1];
+	origin[0] = geometry->GetOrigin()[0];
+	origin[1] = geometry->GetOrigin()[1];
+	itk::ImageBase<2>::Pointer tmp0 = itk::ImageBase<2>::New();
+	try
+	{
+		tmp0->SetRegions(region);
+		tmp0->SetSpacing(spacing);
+		tmp0->SetOrigin(origin);
+	}
+	catch (itk::ExceptionObject &)
+	{
+		return itk::ImageBase<2>::Pointer();
+	}
+	if (image_type == 4) return pr_empty_slice<Image2DTypeUC>(tmp0);
+	return pr_empty_slice<Image2DTypeF>(tmp0);
+}
+
+QString PrSlices::get_slice(
+	const int z,
+	ImageVariant2D * v2d,
+	bool * stand_in)
+{
+	if (!v2d) return QString("ImageVariant2D is NULL");
+	if (geometry.IsNull()) return QString("Image is NULL");
+	if (stand_in) *stand_in = false;
+	itk::ImageBase<2>::Pointer s;
+	{
+		QMutexLocker locker(&mutex);
+		if (errors.contains(z))
+		{
+			// processed again next time
+			return errors.take(z);
+		}
+		if (cache.contains(z))
+		{
+			s = cache.value(z);
+			lru.removeAll(z);
+			lru.push_back(z);
+		}
+		else if (stand_in && pending.contains(z))
+		{
+			s = (last.IsNotNull()) ? last : empty_slice();
+			if (s.IsNull()) return QString("Out image is NULL");
+			*stand_in = true;
+		}
+	}
+	if (s.IsNull())
+	{
+		const QString error = compute(z, s);
+		if (!error.isEmpty()) return error;
+		QMutexLocker locker(&mutex);
+		insert(z, s);
+	}
+	if (!(stand_in && *stand_in))
+	{
+		QMutexLocker locker(&mutex);
+		last = s;
+	}
+	// cached slices are not modified, the 2D image shares the buffer
+	if (image_type == 4)
+	{
+		v2d->pUC = dynamic_cast<Image2DTypeUC*>(s.GetPointer());
+		if (v2d->pUC.IsNull()) return QString("Wrong image type");
+	}
+	else
+	{
+		v2d->pF = dynamic_cast<Image2DTypeF*>(s.GetPointer());
+		if (v2d->pF.IsNull()) return QString("Wrong image type");
+	}
+	v2d->image_type = image_type;
+	v2d->idimx = s->GetLargestPossibleRegion().GetSize()[0];
+	v2d->idimy = s->GetLargestPossibleRegion().GetSize()[1];
+	return QString("");
+}
+
+bool PrSlices::get_value(
+	const int x,
+	const int y,
+	const int z,
+	double * d)
+{
+	ImageVariant2D tmp0;
+	if (!get_slice(z, &tmp0).isEmpty()) return false;
+	if (x < 0 || y < 0 ||
+		x >= static_cast<int>(tmp0.idimx) ||
+		y >= static_cast<int>(tmp0.idimy))
+	{
+		return false;
+	}
+	const size_t j = static_cast<size_t>(y) * tmp0.idimx + x;
+	if (image_type == 4)
+		*d = static_cast<double>(tmp0.pUC->GetBufferPointer()[j]);
+	else
+		*d = static_cast<double>(tmp0.pF->GetBufferPointer()[j]);
+	return true;
+}
+
+// Starts threads for the next slices (and the previous one), which
+// are not cached yet, at most one thread per core.
+void PrSlices::prefetch(const int z)
+{
+	if (geometry.IsNull()) return;
+	const int dimz =
+		static_cast<int>(geometry->GetLargestPossibleRegion().GetSize()[2]);
+	if (dimz < 2) return;
+	int num_threads = CommonUtils::get_max_threads();
+	if (num_threads < 1) num_threads = 1;
+	QMutexLocker locker(&mutex);
+	for (int x = threads.size() - 1; x >= 0; x--)
+	{
+		if (threads.at(x)->isFinished())
+		{
+			delete threads[x];
+			threads.removeAt(x);
+		}
+	}
+	for (int j = 0; j <= num_threads; j++)
+	{
+		if (threads.size() >= num_threads) break;
+		// next slices, the cine loop starts again at 0
+		const int k = (j == num_threads) ? z - 1 : (z + j + 1) % dimz;
+		if (k < 0 || k == z) continue;
+		if (cache.contains(k) || pending.contains(k)) continue;
+		pending.insert(k);
+		PrSliceThread_ * t__ = new PrSliceThread_(this, k);
+		threads.push_back(t__);
+		t__->start();
+	}
+}
+
+// Non-uniform and transformed images are processed per displayed
+// slice. Uniform images are processed per displayed slice too, if
+// there are many frames or the image is large, e.g. multi-frame XA
+// or US, except the whole image is required for 3D or for MPR, i.e.
+// 3D is enabled or the image has a patient orientation.
+static bool use_pr_slices(
+	const ImageVariant * ivariant,
+	const QList<PrConfig> & l,
+	bool volume_3d)
+{
+	if (ivariant->bricks) return false;
+	if (ivariant->di->idimz < 2) return false;
+	if (ivariant->image_type < 0 || ivariant->image_type > 8)
+		return false;
+	if (!ivariant->equi) return true;
+	for (int x = 0; x < l.size(); x++)
+	{
+		if (l.at(x).id == 3 && l.at(x).values.size() == 2)
+		{
+			const QString f = l.at(x).values.at(0).toString()
+				.trimmed()
+				.remove(QChar('\0'));
+			if (l.at(x).values.at(1).toInt() != 0 || f == QString("Y"))
+				return true;
+			break;
+		}
+	}
+	if (volume_3d) return false;
+	if (ivariant->orientation > 0 &&
+		!ivariant->orientation_string.isEmpty())
+	{
+		return false;
+	}
+	// float copy of the image
+	const unsigned long long size =
+		static_cast<unsigned long long>(ivariant->di->idimx) *
+		ivariant->di->idimy * ivariant->di->idimz * 4;
+	return (ivariant->di->idimz >= 16 || size >= 67108864ULL);
+}
+
+template<typename T> QString init_pr_slices(
+	PrSlices * p,
+	const typename T::Pointer & image)
+{
+	if (image.IsNull()) return QString("Image is NULL");
+	try
+	{
+		p->source = itk::ImageBase<3>::Pointer(image.GetPointer());
+		p->geometry = itk::ImageBase<3>::New();
+		p->geometry->SetRegions(image->GetLargestPossibleRegion());
+		p->geometry->SetSpacing(image->GetSpacing());
+		p->geometry->SetOrigin(image->GetOrigin());
+		p->geometry->SetDirection(image->GetDirection());
+	}
+	catch (itk::ExceptionObject & ex)
+	{
+		return QString(ex.GetDescription());
+	}
+	return QString("");
+}
+
+// Shares the referenced image, the range is from the range of
+// the referenced image, the pixels are not read.
+static QString init_pr_slices(
+	PrSlices * p,
+	const ImageVariant * ivariant,
+	double shift,
+	double scale,
+	bool use_slice_rescale)
+{
+	QString error("");
+	if (use_slice_rescale &&
+		(ivariant->image_type == 5 || ivariant->image_type == 6))
+	{
+		return QString("Wrong image type");
+	}
+	switch (ivariant->image_type)
+	{
+	case 0: error = init_pr_slices<ImageTypeSS> (p, ivariant->pSS);  break;
+	case 1: error = init_pr_slices<ImageTypeUS> (p, ivariant->pUS);  break;
+	case 2: error = init_pr_slices<ImageTypeSI> (p, ivariant->pSI);  break;
+	case 3: error = init_pr_slices<ImageTypeUI> (p, ivariant->pUI);  break;
+	case 4: error = init_pr_slices<ImageTypeUC> (p, ivariant->pUC);  break;
+	case 5: error = init_pr_slices<ImageTypeF>  (p, ivariant->pF);   break;
+	case 6: error = init_pr_slices<ImageTypeD>  (p, ivariant->pD);   break;
+	case 7: error = init_pr_slices<ImageTypeSLL>(p, ivariant->pSLL); break;
+	case 8: error = init_pr_slices<ImageTypeULL>(p, ivariant->pULL); break;
+	default: return QString("Wrong image type");
 	}
-	catch (itk::ExceptionObject & ex)
+	if (!error.isEmpty()) return error;
+	p->source_type = ivariant->image_type;
+	p->shift = shift;
+	p->scale = scale;
+	if (use_slice_rescale)
 	{
-		return QString(ex.GetDescription());
+		// di->vmin, di->vmax are rescaled values already
+		p->slice_rescale = ivariant->slice_rescale;
+		p->vmin = ivariant->di->vmin;
+		p->vmax = ivariant->di->vmax;
 	}
-	typedef itk::FlipImageFilter<T2d> FlipFilterType;
-	typedef itk::ResampleImageFilter<T2d,T2d> ResampleType;
-	typedef itk::AffineTransform<double, 2> TransformType;
-	typedef itk::LinearInterpolateImageFunction<T2d, double>
-		InterpolatorType;
-	typedef itk::ImageSliceIteratorWithIndex<T> SliceIterator;
-	typedef itk::ImageLinearConstIteratorWithIndex<T2d> ConstIterator;
-	typedef itk::ImageLinearIteratorWithIndex<T2d> LinearIterator;
-	typedef itk::ImageDuplicator<T2d> DuplicatorType;
-	const int dz = (int)image->GetLargestPossibleRegion().GetSize()[2];
-	for (int z = 0; z < dz; z++)
+	else
 	{
-		typename T2d::Pointer tmp0;
-		typename T2d::Pointer tmp1;
-		const QString error = extract_one_slice<T,T2d>(image, tmp0, z);
-		const int dx = (int)image->GetLargestPossibleRegion().GetSize()[0];
-		const int dy = (int)image->GetLargestPossibleRegion().GetSize()[1];
-		int ax = 0;
-		int ay = 0;
-		int px = 0;
-		int py = 0;
-		if (tmp0.IsNull()) return QString("tmp0.IsNull()");
-		if (error.isEmpty())
+		p->vmin = (ivariant->di->vmin + shift) * scale;
+		p->vmax = (ivariant->di->vmax + shift) * scale;
+		if (p->vmin > p->vmax)
 		{
-			bool apply_display_area = false;
-			if (ivariant->pr_display_areas.contains(z))
-			{
-				if (!(
-					ivariant->pr_display_areas.value(z).top_left_x == 1 &&
-					ivariant->pr_display_areas.value(z).top_left_y == 1 &&
-					dx == ivariant->pr_display_areas.value(z)
-						.bottom_right_x &&
-					dy == ivariant->pr_display_areas.value(z)
-						.bottom_right_y))
-				{
-					ax = ivariant->pr_display_areas.value(z)
-							.bottom_right_x -
-						ivariant->pr_display_areas.value(z).top_left_x;
-					ay = ivariant->pr_display_areas.value(z)
-							.bottom_right_y -
-						ivariant->pr_display_areas.value(z).top_left_y;
-					px = ivariant->pr_display_areas.value(z).top_left_x;
-					py = ivariant->pr_display_areas.value(z).top_left_y;
-					apply_display_area = true;
-				}
-			}
-			if (!apply_display_area)
-			{
-				if (rotation != 0.0)
-				{
-					const unsigned int dx0 =
-						tmp0->GetLargestPossibleRegion().GetSize()[0];
-					const unsigned int dy0 =
-						tmp0->GetLargestPossibleRegion().GetSize()[1];
-					const double sx = tmp0->GetSpacing()[0];
-					const double sy = tmp0->GetSpacing()[1];
-					const double ox = tmp0->GetOrigin()[0];
-					const double oy = tmp0->GetOrigin()[1];
-					typename TransformType::Pointer transform =
-						TransformType::New();
-					typename ResampleType::Pointer filter0 =
-						ResampleType::New();
-					typename InterpolatorType::Pointer interpolator =
-						InterpolatorType::New();
-					typename FlipFilterType::Pointer filter1 =
-						FlipFilterType::New();
-					const double cx = ox + dx0 * sx / 2.0;
-					const double cy = oy + dy0 * sy / 2.0;
-					typename TransformType::OutputVectorType translation1;
-					translation1[0] = -cx;
-					translation1[1] = -cy;
-					typename TransformType::OutputVectorType translation2;
-					translation2[0] = cx;
-					translation2[1] = cy;
-					const double a = rotation*0.0174532925199432957692369;
-					itk::FixedArray<bool, 2> f;
-					f[0] = true;
-					f[1] = false;
-					transform->SetIdentity();
-					transform->Translate(translation1);
-					transform->Rotate2D(-a, false);
-					transform->Translate(translation2, false);
-					try
-					{
-						filter0->SetInput(tmp0);
-						filter0->SetInterpolator(interpolator);
-						filter0->SetDefaultPixelValue(
-							itk::NumericTraits<
-								typename T2d::PixelType>::Zero);
-						filter0->SetTransform(transform);
-						filter0->SetOutputOrigin(tmp0->GetOrigin());
-						filter0->SetOutputSpacing(tmp0->GetSpacing());
-						filter0->SetOutputDirection(tmp0->GetDirection());
-						filter0->SetSize(
-							tmp0->GetLargestPossibleRegion().GetSize());
-						if (flip)
-						{
-							filter1->SetInput(filter0->GetOutput());
-							filter1->SetFlipAxes(f);
-							filter1->Update();
-							tmp1 = filter1->GetOutput();
-						}
-						else
-						{
-							filter0->Update();
-							tmp1 = filter0->GetOutput();
-						}
-					}
-					catch (itk::ExceptionObject & ex)
-					{
-						return QString(ex.GetDescription());
-					}
-				}
-				else if (flip)
-				{
-					typename FlipFilterType::Pointer filter =
-						FlipFilterType::New();
-					itk::FixedArray<bool, 2> f;
-					f[0] = true;
-					f[1] = false;
-					try
-					{
-						filter->SetInput(tmp0);
-						filter->SetFlipAxes(f);
-						filter->Update();
-						tmp1 = filter->GetOutput();
-					}
-					catch (itk::ExceptionObject & ex)
-					{
-						return QString(ex.GetDescription());
-					}
-				}
-				else
-				{
-					tmp1 = tmp0;
-				}
-			}
-			else
-			{
-				if (rotation != 0.0||flip)
-				{
-					if (rotation != 0.0)
-					{
-						const double sx = tmp0->GetSpacing()[0];
-						const double sy = tmp0->GetSpacing()[1];
-						const double ox = tmp0->GetOrigin()[0];
-						const double oy = tmp0->GetOrigin()[1];
-						typename TransformType::Pointer transform =
-							TransformType::New();
-						typename ResampleType::Pointer filter0 =
-							ResampleType::New();
-						typename InterpolatorType::Pointer interpolator =
-							InterpolatorType::New();
-						const double cx = ox + px*sx + ax*sx/2.0;
-						const double cy = oy + py*sy + ay*sy/2.0;
-						typename TransformType::OutputVectorType
-							translation1;
-						translation1[0] = -cx;
-						translation1[1] = -cy;
-						typename TransformType::OutputVectorType
-							translation2;
-						translation2[0] = cx;
-						translation2[1] = cy;
-						const double a =
-							rotation*0.0174532925199432957692369;
-						transform->SetIdentity();
-						transform->Translate(translation1);
-						transform->Rotate2D(-a, false);
-						transform->Translate(translation2, false);
-						try
-						{
-							filter0->SetInput(tmp0);
-							filter0->SetInterpolator(interpolator);
-							filter0->SetDefaultPixelValue(
-								itk::NumericTraits<
-									typename
-										T2d::PixelType>::Zero);
-							filter0->SetTransform(transform);
-							filter0->SetOutputOrigin(tmp0->GetOrigin());
-							filter0->SetOutputSpacing(tmp0->GetSpacing());
-							filter0->SetOutputDirection(
-								tmp0->GetDirection());
-							filter0->SetSize(
-								tmp0->GetLargestPossibleRegion()
-									.GetSize());
-							filter0->Update();
-							tmp1 = filter0->GetOutput();
-						}
-						catch (itk::ExceptionObject & ex)
-						{
-							return QString(ex.GetDescription());
-						}
-					}
-					else
-					{
-						tmp1 = tmp0;
-					}
-					if (flip)
-					{
-						typename T2d::Pointer tmp2;
-						typename DuplicatorType::Pointer
-							duplicator = DuplicatorType::New();
-						try
-						{
-							duplicator->SetInputImage(tmp1);
-							duplicator->Update();
-							tmp2 = duplicator->GetOutput();
-						}
-						catch(itk::ExceptionObject & ex)
-						{
-							return QString(ex.GetDescription());
-						}
-						LinearIterator it(
-							tmp1,
-							tmp1->GetLargestPossibleRegion());
-						it.SetDirection(0);
-						it.GoToBegin();
-						const int j__ = px + ax/2;
-						int x__ = 0;
-						int y__ = 0;
-						const int idimx =
-							tmp1->GetLargestPossibleRegion().GetSize()[0];
-						while(!it.IsAtEnd())
-						{
-							while(!it.IsAtEndOfLine())
-							{
-								if (x__ < j__)
-								{
-									const int ix = x__ + 2*(j__ - x__);
-									if (ix >= idimx || ix < 0)
-									{
-										it.Set(itk::NumericTraits<
-											typename
-												T2d::PixelType>::Zero);
-									}
-									else
-									{
-										typename T2d::IndexType i;
-										i[0] = ix;
-										i[1] =  y__;
-										it.Set(tmp2->GetPixel(i));
-									}
-								}
-								else if (x__ > j__)
-								{
-									const int ix = x__ - 2*(x__ - j__);
-									if (ix >= idimx || ix < 0)
-									{
-										it.Set(itk::NumericTraits<
-											typename
-												T2d::PixelType>::Zero);
-									}
-									else
-									{
-										typename T2d::IndexType i;
-										i[0] = ix;
-										i[1] =  y__;
-										it.Set(tmp2->GetPixel(i));
-									}
-								}
-								else
-								{
-									typename T2d::IndexType i;
-									i[0] = x__;
-									i[1] = y__;
-									it.Set(tmp2->GetPixel(i));
-								}
-								x__++;
-								++it;
-							}
-							x__ = 0;
-							y__++;
-							it.NextLine();
-						}
-					}
-				}
-				else
-				{
-					tmp1 = tmp0;
-				}
-			}
-			if (tmp1.IsNull()) return QString("tmp1.IsNull()");
-			if (tmp1->GetLargestPossibleRegion().GetSize()[0] == 0 ||
-					tmp1->GetLargestPossibleRegion().GetSize()[1] == 0)
-			{
-				return QString("Internal error");
-			}
-			QApplication::processEvents();
-			ConstIterator it0(
-				tmp1,
-				tmp1->GetLargestPossibleRegion());
-			it0.SetDirection(0);
-			SliceIterator it2(
-				out_image,
-				out_image->GetLargestPossibleRegion());
-			it2.SetFirstDirection(0);
-			it2.SetSecondDirection(1);
-			int j = 0;
-			it0.GoToBegin();
-			it2.GoToBegin();
-			while(!(it2.IsAtEnd() || it0.IsAtEnd()))
-			{
-				if (j == z)
-				{
-					while (!(it2.IsAtEndOfSlice() || it0.IsAtEnd()))
-					{
-						while (!it2.IsAtEndOfLine())
-						{
-							if (!it0.IsAtEnd())
-							{
-								it2.Set(static_cast<
-									typename T::PixelType>(
-										it0.Get()));
-								++it0;
-							}
-							++it2;
-						}
-						it0.NextLine();
-						it2.NextLine();
-					}
-				}
-				it2.NextSlice();
-				j++;
-				QApplication::processEvents();
-			}
+			const double tmp0 = p->vmin;
+			p->vmin = p->vmax;
+			p->vmax = tmp0;
 		}
-		else { return error; }
 	}
-	if (out_image.IsNotNull()) out_image->DisconnectPipeline();
-	else return QString("Output image is NULL");
+	p->image_type = 5;
 	return QString("");
 }
 
-template<typename T, typename T2d> QString levels_slice_by_slice(
-	const typename T::Pointer & image,
-	typename ImageTypeUC::Pointer & out_image,
-	const QMap<int, double> & widths,
-	const QMap<int, double> & centers,
-	const QMap<int, QString> & lut_functions,
-	const QMap<int, QStringList> & refs,
-	const SOPInstanceUids & slices_uids)
+// Windowed range of the whole image, the window is monotonic,
+// so it is the windowed range of the referenced image.
+static QString pr_voi_range(PrSlices * p)
 {
-	if (image.IsNull()) return QString("image.IsNull()");
+	Image2DTypeF::Pointer tmp0;
+	Image2DTypeUC::Pointer tmp1;
+	Image2DTypeF::RegionType region;
+	Image2DTypeF::SizeType size;
+	Image2DTypeF::IndexType index;
+	size[0] = 2;
+	size[1] = 1;
+	index.Fill(0);
+	region.SetSize(size);
+	region.SetIndex(index);
 	try
 	{
-		out_image = ImageTypeUC::New();
-		out_image->SetOrigin(static_cast<
-			typename ImageTypeUC::PointType>(
-				image->GetOrigin()));
-		out_image->SetSpacing(static_cast<
-			typename ImageTypeUC::SpacingType>(
-				image->GetSpacing()));
-		out_image->SetDirection(static_cast<
-			typename ImageTypeUC::DirectionType>(
-				image->GetDirection()));
-		out_image->SetRegions(static_cast<
-			typename ImageTypeUC::RegionType>(
-				image->GetLargestPossibleRegion()));
-		out_image->Allocate();
-		out_image->FillBuffer(0);
+		tmp0 = Image2DTypeF::New();
+		tmp0->SetRegions(region);
+		tmp0->Allocate();
 	}
 	catch (itk::ExceptionObject & ex)
-	{ return QString(ex.GetDescription()); }
-	typedef itk::IntensityWindowingImageFilter<T2d, Image2DTypeUC>
-		LinearFilterType;
-	typedef itk::Sigmoid2ImageFilter<T2d, Image2DTypeUC>
-		SigmoidFilterType;
-	typedef itk::RescaleIntensityImageFilter<Image2DTypeUC, Image2DTypeUC>
-		RescaleFilterType;
-	typedef itk::ImageSliceIteratorWithIndex<ImageTypeUC>
-		SliceIterator;
-	typedef itk::ImageLinearConstIteratorWithIndex<Image2DTypeUC>
-		ConstIterator;
-	for (
-		QMap<int, QStringList>::const_iterator it = refs.constBegin();
-		it != refs.constEnd();
-		++it)
 	{
-		const int k = it.key();
-		const QStringList & l = it.value();
-		for (int z = 0; z < l.size(); z+=2)
-		{
-			const QString uid =
-				l.at(z+0).trimmed().remove(QChar('\0'));
-			const QString frames =
-				l.at(z+1)
-					.trimmed()
-					.remove(QChar(' '))
-					.remove(QChar('\0'));
-			QList<int> idxs;
-			const QStringList frames_tmp1 = frames.split(
-				QString("\\"),
-				QString::SkipEmptyParts);
-			if (frames_tmp1.size() < 1)
-			{
-				SOPInstanceUids::const_iterator it1 =
-					slices_uids.constBegin();
-				while (it1 != slices_uids.constEnd())
-				{
-					if (uid == it1.value()
-						.trimmed()
-						.remove(QChar('\0')))
-					{
-						idxs.push_back(it1.key());
-					}
-					++it1;
-				}
-			}
-			else
-			{
-				for (int x = 0; x < frames_tmp1.size(); x++)
-				{
-					bool tmp99 = false;
-					const int tmp98 = QVariant(
-						frames_tmp1.at(x)
-							.trimmed()
-							.remove(QChar('\0'))).toInt(&tmp99);
-					if (tmp99 && tmp98 > 0)
-					{
-						idxs.push_back(tmp98-1);
-					}
-				}
-			}
-			if (idxs.empty())
-			{
-				std::cout
-					<< "idxs.size()<1 k=" << k << " "
-					<< uid.toStdString()
-					<< std::endl;
-				continue;
-			}
-			for (int x = 0; x < idxs.size(); x++)
-			{
-				const QString uid_ =
-					(slices_uids.contains(idxs.at(x)))
-					?
-					slices_uids.value(idxs.at(x))
-						.trimmed()
-						.remove(QChar('\0'))
-					:
-					QString("");
-				if (!uid_.isEmpty() && (uid_ == uid))
-				{
-					typename T2d::Pointer tmp0;
-					typename Image2DTypeUC::Pointer tmp1;
-					const QString error =
-						extract_one_slice<T,T2d>(image, tmp0, idxs.at(x));
-					if (tmp0.IsNull()) return QString("tmp0.IsNull()");
-					if (error.isEmpty())
-					{
-						if (
-							lut_functions.contains(k) &&
-							(lut_functions.value(k)
-								.trimmed()
-								.remove(QChar('\0'))
-								.toUpper() ==
-							QString("SIGMOID")))
-						{
-							typename SigmoidFilterType::Pointer
-								filter0 = SigmoidFilterType::New();
-							typename RescaleFilterType::Pointer
-								filter1 = RescaleFilterType::New();
-							try
-							{
-								filter0->SetInput(tmp0);
-								filter0->SetAlpha(
-									static_cast<typename T2d::PixelType>(
-										widths.value(k)));
-								filter0->SetBeta(
-									static_cast<typename T2d::PixelType>(
-										centers.value(k)));
-								filter0->SetOutputMinimum(
-									static_cast<typename
-										Image2DTypeUC::PixelType>(0));
-								filter0->SetOutputMaximum(
-									static_cast<typename
-										Image2DTypeUC::PixelType>(255));
-								filter1->SetInput(filter0->GetOutput());
-								filter1->Update();
-								tmp1 = filter1->GetOutput();
-							}
-							catch (itk::ExceptionObject & ex)
-							{ return QString( ex.GetDescription()); }
-						}
-						else
-						{
-							typename LinearFilterType::Pointer
-								filter0 = LinearFilterType::New();
-							typename RescaleFilterType::Pointer
-								filter1 = RescaleFilterType::New();
-							try
-							{
-								filter0->SetInput(tmp0);
-								filter0->SetWindowLevel(
-									static_cast<typename T2d::PixelType>(
-										widths.value(k)),
-									static_cast<typename T2d::PixelType>(
-										centers.value(k)));
-								filter0->SetOutputMinimum(
-									static_cast<
-										typename
-											Image2DTypeUC::PixelType>(
-												0));
-								filter0->SetOutputMaximum(
-									static_cast<
-										typename
-											Image2DTypeUC::PixelType>(
-												255));
-								filter1->SetInput(filter0->GetOutput());
-								filter1->Update();
-								tmp1 = filter1->GetOutput();
-							}
-							catch (itk::ExceptionObject & ex)
-							{ return QString( ex.GetDescription()); }
-						}
-						if (tmp1.IsNull()) return QString("tmp1.IsNull()");
-						//
-						QApplication::processEvents();
-						//
-						ConstIterator it0(
-							tmp1,
-							tmp1->GetLargestPossibleRegion());
-						it0.SetDirection(0);
-						SliceIterator it2(
-							out_image,
-							out_image->GetLargestPossibleRegion());
-						it2.SetFirstDirection(0);
-						it2.SetSecondDirection(1);
-						int j = 0;
-						it0.GoToBegin();
-						it2.GoToBegin();
-						while(!(it2.IsAtEnd() || it0.IsAtEnd()))
-						{
-							if (j == idxs.at(x))
-							{
-								while (!(it2.IsAtEndOfSlice() ||
-									it0.IsAtEnd()))
-								{
-									while (!it2.IsAtEndOfLine())
-									{
-										if (!it0.IsAtEnd())
-										{
-											it2.Set(
-												static_cast<
-													typename
-														ImageTypeUC::
-															PixelType>(
-												it0.Get()));
-											++it0;
-										}
-										++it2;
-									}
-									it0.NextLine();
-									it2.NextLine();
-								}
-							}
-							it2.NextSlice();
-							j++;
-							QApplication::processEvents();
-						}
-					}
-					else { return error; }
-				}
-			}
-		}
+		return QString(ex.GetDescription());
 	}
-	if (out_image.IsNotNull()) out_image->DisconnectPipeline();
-	else return QString("Output image is NULL");
+	tmp0->GetBufferPointer()[0] = static_cast<float>(p->vmin);
+	tmp0->GetBufferPointer()[1] = static_cast<float>(p->vmax);
+	const QString error = window_2d<Image2DTypeF>(
+		tmp0, tmp1, p->widths, p->centers, p->lut_functions, 0);
+	if (!error.isEmpty()) return error;
+	const unsigned char a = tmp1->GetBufferPointer()[0];
+	const unsigned char b = tmp1->GetBufferPointer()[1];
+	p->voi_min = static_cast<double>((a < b) ? a : b);
+	p->voi_max = static_cast<double>((a < b) ? b : a);
 	return QString("");
 }
 
@@ -2348,80 +3184,23 @@ static void read_overlays(
 			(unsigned int)o.GetNumberOfFrames();
 		const unsigned int FrameOrigin =
 			(unsigned int)o.GetFrameOrigin();
-		const int o_dimx = (int)o.GetColumns();
-		const int o_dimy = (int)o.GetRows();
-		const int o_x    = (int)o.GetOrigin()[0];
-		const int o_y    = (int)o.GetOrigin()[1];
 		if (NumberOfFrames > 0 && FrameOrigin > 0)
 		{
-			const size_t obuffer_size = o.GetUnpackBufferLength();
-			if (obuffer_size%NumberOfFrames != 0) continue;
-			const size_t fbuffer_size = obuffer_size/NumberOfFrames;
-			char * tmp0;
-			try { tmp0 = new char[obuffer_size]; }
-			catch (std::bad_alloc&) { continue; }
-			if (!tmp0) continue;
-			const bool obuffer_ok = o.GetUnpackBuffer(
-				tmp0, obuffer_size);
-			if (!obuffer_ok) continue;
-			int idx = FrameOrigin - 1;
 			for (unsigned int y = 0; y < NumberOfFrames; y++)
 			{
 				SliceOverlay overlay;
-				overlay.dimx = o_dimx;
-				overlay.dimy = o_dimy;
-				overlay.x    = o_x;
-				overlay.y    = o_y;
-				const size_t p = idx*o_dimx*o_dimy;
-				idx++;
-				for (size_t j = 0; j < fbuffer_size; j++)
-				{
-					const size_t jj = p + j;
-					if (!(jj < obuffer_size))
-					{
-						std::cout
-							<< "warning: read_buffer() jj="
-							<< jj << " obuffer_size"
-							<< obuffer_size << std::endl;
-					}
-					overlay.data.push_back(tmp0[jj]);
-				}
-				slice_overlays.insert(idx-1, overlay);
-#if 0
-				std::cout
-					<< "obuffer_size=" << obuffer_size
-					<< " fbuffer_size=" << fbuffer_size
-					<< " idx=" << idx-1
-					<< " p=" << p << std::endl;
-#endif
+				if (!DicomUtils::read_overlay_frame(o, y, overlay)) break;
+				slice_overlays.insert(FrameOrigin - 1 + y, overlay);
 			}
-			delete [] tmp0;
 		}
 		else
 		{
 			SliceOverlay overlay;
-			overlay.dimx = o_dimx;
-			overlay.dimy = o_dimy;
-			overlay.x    = o_x;
-			overlay.y    = o_y;
-			const size_t obuffer_size =
-				o.GetUnpackBufferLength();
-			char * tmp0;
-			try { tmp0 = new char[obuffer_size]; }
-			catch (std::bad_alloc&) { continue; }
-			if (!tmp0) continue;
-			const bool obuffer_ok = o.GetUnpackBuffer(
-				tmp0, obuffer_size);
-			if (!obuffer_ok) continue;
-			for (size_t j = 0; j < obuffer_size; j++)
-			{
-				overlay.data.push_back(tmp0[j]);
-			}
-			delete [] tmp0;
+			if (!DicomUtils::read_overlay_frame(o, 0, overlay)) continue;
 			slice_overlays.insert(0, overlay);
 		}
 	}
-	const QList<int> keys = slice_overlays.keys();
+	const QList<int> keys = slice_overlays.uniqueKeys();
 	for (int x = 0; x < keys.size(); x++)
 	{
 		const int idx = keys.at(x);
@@ -3346,6 +4125,8 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 		gl,
 		0);
 	v->di->filtering = w->get_filtering();
+	if (use_pr_slices(ivariant, l, (ok3d && w->get_3d())))
+		v->pr_slices = new PrSlices();
 	//
 	// Modality LUT
 	//
@@ -3384,7 +4165,24 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 			}
 		}
 #endif
-		if      (ivariant->image_type==0) error=intensity_filter2<ImageTypeSS> (ivariant->pSS, v->pF,shift,scale);
+		if (v->pr_slices)
+		{
+			error = init_pr_slices(
+				v->pr_slices, ivariant, shift, scale,
+				(!rescale_found && !ivariant->slice_rescale.empty()));
+		}
+		else if (!rescale_found && !ivariant->slice_rescale.empty())
+		{
+			if      (ivariant->image_type==0) error=intensity_filter3<ImageTypeSS> (ivariant->pSS, v->pF,ivariant->slice_rescale);
+			else if (ivariant->image_type==1) error=intensity_filter3<ImageTypeUS> (ivariant->pUS, v->pF,ivariant->slice_rescale);
+			else if (ivariant->image_type==2) error=intensity_filter3<ImageTypeSI> (ivariant->pSI, v->pF,ivariant->slice_rescale);
+			else if (ivariant->image_type==3) error=intensity_filter3<ImageTypeUI> (ivariant->pUI, v->pF,ivariant->slice_rescale);
+			else if (ivariant->image_type==4) error=intensity_filter3<ImageTypeUC> (ivariant->pUC, v->pF,ivariant->slice_rescale);
+			else if (ivariant->image_type==7) error=intensity_filter3<ImageTypeSLL>(ivariant->pSLL,v->pF,ivariant->slice_rescale);
+			else if (ivariant->image_type==8) error=intensity_filter3<ImageTypeULL>(ivariant->pULL,v->pF,ivariant->slice_rescale);
+			else { error = QString("Wrong image type"); }
+		}
+		else if (ivariant->image_type==0) error=intensity_filter2<ImageTypeSS> (ivariant->pSS, v->pF,shift,scale);
 		else if (ivariant->image_type==1) error=intensity_filter2<ImageTypeUS> (ivariant->pUS, v->pF,shift,scale);
 		else if (ivariant->image_type==2) error=intensity_filter2<ImageTypeSI> (ivariant->pSI, v->pF,shift,scale);
 		else if (ivariant->image_type==3) error=intensity_filter2<ImageTypeUI> (ivariant->pUI, v->pF,shift,scale);
@@ -3437,7 +4235,28 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 		QApplication::processEvents();
 		if (voi_luts > 0)
 		{
-			if (voi_lut_images.empty())
+			if (v->pr_slices)
+			{
+				v->pr_slices->voi_luts = voi_luts;
+				v->pr_slices->widths = window_widths;
+				v->pr_slices->centers = window_centers;
+				v->pr_slices->lut_functions = lut_functions;
+				v->pr_slices->voi_per_slice = !voi_lut_images.empty();
+				if (v->pr_slices->voi_per_slice)
+				{
+					v->pr_slices->voi_jobs = get_voi_jobs(
+						voi_lut_images,
+						ivariant->image_instance_uids);
+				}
+				else
+				{
+					error = pr_voi_range(v->pr_slices);
+				}
+				v->pr_slices->image_type = 4;
+				v->pr_slices->vmin = 0.0;
+				v->pr_slices->vmax = 255.0;
+			}
+			else if (voi_lut_images.empty())
 			{
 #ifdef PRINT_MAKE_PR_MONOCHROME
 					std::cout << "VOI LUT" << std::endl;
@@ -3559,7 +4378,8 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 					px > 0.99999 && px < 1.00001 &&
 					py > 0.99999 && py < 1.00001))
 				{
-					if      (v->image_type== 0) set_spacing<ImageTypeSS>   (v->pSS,    px,py);
+					if      (v->pr_slices)      set_spacing<itk::ImageBase<3> >(v->pr_slices->geometry,px,py);
+					else if (v->image_type== 0) set_spacing<ImageTypeSS>   (v->pSS,    px,py);
 					else if (v->image_type== 1) set_spacing<ImageTypeUS>   (v->pUS,    px,py);
 					else if (v->image_type== 2) set_spacing<ImageTypeSI>   (v->pSI,    px,py);
 					else if (v->image_type== 3) set_spacing<ImageTypeUI>   (v->pUI,    px,py);
@@ -3585,7 +4405,8 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 					ax > 0.99999f && ax < 1.00001 &&
 					ay > 0.99999f && ay < 1.00001))
 				{
-					if      (v->image_type== 0) set_asp_ratio<ImageTypeSS>   (v->pSS,    ax,ay);
+					if      (v->pr_slices)      set_asp_ratio<itk::ImageBase<3> >(v->pr_slices->geometry,ax,ay);
+					else if (v->image_type== 0) set_asp_ratio<ImageTypeSS>   (v->pSS,    ax,ay);
 					else if (v->image_type== 1) set_asp_ratio<ImageTypeUS>   (v->pUS,    ax,ay);
 					else if (v->image_type== 2) set_asp_ratio<ImageTypeSI>   (v->pSI,    ax,ay);
 					else if (v->image_type== 3) set_asp_ratio<ImageTypeUI>   (v->pUI,    ax,ay);
@@ -3613,7 +4434,8 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 					const int aTLy = areasTLy.value(0);
 					const int aBRx = areasBRx.value(0);
 					const int aBRy = areasBRy.value(0);
-					if      (v->image_type== 0) set_darea<ImageTypeSS>   (v, v->pSS,    aTLx, aTLy, aBRx, aBRy);
+					if      (v->pr_slices)      set_darea<itk::ImageBase<3> >(v, v->pr_slices->geometry, aTLx, aTLy, aBRx, aBRy);
+					else if (v->image_type== 0) set_darea<ImageTypeSS>   (v, v->pSS,    aTLx, aTLy, aBRx, aBRy);
 					else if (v->image_type== 1) set_darea<ImageTypeUS>   (v, v->pUS,    aTLx, aTLy, aBRx, aBRy);
 					else if (v->image_type== 2) set_darea<ImageTypeSI>   (v, v->pSI,    aTLx, aTLy, aBRx, aBRy);
 					else if (v->image_type== 3) set_darea<ImageTypeUI>   (v, v->pUI,    aTLx, aTLy, aBRx, aBRy);
@@ -3671,7 +4493,8 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 					}
 					if (one_spacing)
 					{
-						if      (v->image_type== 0) set_spacing<ImageTypeSS>   (v->pSS,    px,py);
+						if      (v->pr_slices)      set_spacing<itk::ImageBase<3> >(v->pr_slices->geometry,px,py);
+						else if (v->image_type== 0) set_spacing<ImageTypeSS>   (v->pSS,    px,py);
 						else if (v->image_type== 1) set_spacing<ImageTypeUS>   (v->pUS,    px,py);
 						else if (v->image_type== 2) set_spacing<ImageTypeSI>   (v->pSI,    px,py);
 						else if (v->image_type== 3) set_spacing<ImageTypeUI>   (v->pUI,    px,py);
@@ -3725,7 +4548,8 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 					}
 					if (one_aspect)
 					{
-						if      (v->image_type== 0) set_asp_ratio<ImageTypeSS>   (v->pSS,    ax,ay);
+						if      (v->pr_slices)      set_asp_ratio<itk::ImageBase<3> >(v->pr_slices->geometry,ax,ay);
+						else if (v->image_type== 0) set_asp_ratio<ImageTypeSS>   (v->pSS,    ax,ay);
 						else if (v->image_type== 1) set_asp_ratio<ImageTypeUS>   (v->pUS,    ax,ay);
 						else if (v->image_type== 2) set_asp_ratio<ImageTypeSI>   (v->pSI,    ax,ay);
 						else if (v->image_type== 3) set_asp_ratio<ImageTypeUI>   (v->pUI,    ax,ay);
@@ -3776,7 +4600,13 @@ ImageVariant * PrConfigUtils::make_pr_monochrome(
 				if (d != 0.0 || flip)
 				{
 					*spatial_transform = true;
-					if (v->image_type == 14)
+					if (v->pr_slices)
+					{
+						v->pr_slices->rotation = d;
+						v->pr_slices->flip = flip;
+						v->pr_slices->display_areas = v->pr_display_areas;
+					}
+					else if (v->image_type == 14)
 					{
 						RGBImageTypeUC::Pointer tmp0;
 						error = rotate_flip_slice_by_slice<
@@ -2,13 +2,83 @@
 #define PrConfigUtils_H__
 
 #include "mdcmDataSet.h"
+#include "structures.h"
 #include <QList>
+#include <QMap>
+#include <QSet>
+#include <QPair>
+#include <QString>
+#include <QMutex>
 
 class PrRefSeries;
 class ImageVariant;
+class ImageVariant2D;
 class PrConfig;
 class SettingsWidget;
 class GLWidget;
+class QThread;
+
+// Presentation state applied to one slice at a time, instead of
+// to a copy of the volume, see make_pr_monochrome. The referenced
+// image is shared, processed slices are cached, the slices next to
+// the displayed one are processed in threads. get_slice does not
+// wait for these threads, if 'stand_in' is not NULL and the slice
+// is not ready yet, the previous slice (or an empty slice) is
+// returned and 'stand_in' is set, else the slice is processed in
+// the calling thread.
+class PrSlices
+{
+public:
+	PrSlices();
+	~PrSlices();
+	QString get_slice(const int, ImageVariant2D*, bool * stand_in = NULL);
+	bool get_value(const int, const int, const int, double*);
+	void prefetch(const int);
+	// referenced image
+	itk::ImageBase<3>::Pointer source;
+	short source_type;
+	// Modality LUT, per-slice table if not empty
+	double shift;
+	double scale;
+	QList< QPair<double, double> > slice_rescale;
+	// VOI LUT, the output is 0-255 if 'voi_luts' > 0
+	int voi_luts;
+	QMap<int, double>  widths;
+	QMap<int, double>  centers;
+	QMap<int, QString> lut_functions;
+	bool voi_per_slice;
+	QMap<int, int> voi_jobs;
+	// windowed range of the whole image, the output of the VOI LUT
+	// is rescaled with this range if 'voi_per_slice' is false
+	double voi_min;
+	double voi_max;
+	// Spatial transformation
+	double rotation;
+	bool flip;
+	PRDisplayAreas display_areas;
+	// output, the geometry has no buffer
+	itk::ImageBase<3>::Pointer geometry;
+	short image_type;
+	double vmin;
+	double vmax;
+
+private:
+	friend class PrSliceThread_;
+	QString compute(const int, itk::ImageBase<2>::Pointer&) const;
+	void prefetched(
+		const int, const itk::ImageBase<2>::Pointer&, const QString&);
+	void insert(const int, const itk::ImageBase<2>::Pointer&);
+	itk::ImageBase<2>::Pointer empty_slice() const;
+	QMutex mutex;
+	QMap<int, itk::ImageBase<2>::Pointer> cache;
+	QList<int> lru;
+	QSet<int> pending;
+	// errors of prefetch threads, reported by get_slice
+	QMap<int, QString> errors;
+	itk::ImageBase<2>::Pointer last;
+	QList<QThread*> threads;
+};
+
 class PrConfigUtils
 {
 public:
@@ -148,8 +148,8 @@ QString SpectroscopyUtils::ProcessData(
 		for (unsigned int x = 0; x < values.size(); x++)
 		{
 			if (!(
-				values.at(x).stack_id_ok &&
-				values.at(x).in_stack_pos_num_ok))
+				values.stack_id_ok[x] &&
+				values.in_stack_pos_num_ok[x]))
 			{
 				tmp12 = true;
 				break;
@@ -160,9 +160,9 @@ QString SpectroscopyUtils::ProcessData(
 			for (unsigned int x = 0; x < values.size(); x++)
 			{
 				DimIndexValue tmp13;
-				tmp13.id = values.at(x).id;
-				tmp13.idx.push_back(values.at(x).stack_id);
-				tmp13.idx.push_back(values.at(x).in_stack_pos_num);
+				tmp13.id = x;
+				tmp13.idx.push_back(values.stack_id[x]);
+				tmp13.idx.push_back(values.in_stack_pos_num[x]);
 				idx_values_tmp.push_back(tmp13);
 			}
 			for (unsigned int x = 0; x < idx_values_tmp.size(); x++)
@@ -263,7 +263,7 @@ QString SpectroscopyUtils::ProcessData(
 		bool error = false;
 		std::vector<float*>  tmp3;
 		std::vector<double*> tmp4;
-		QStringList tmp5;
+		std::vector<const double*> tmp5;
 		unsigned int j = 0;
 		std::map<
 			unsigned int,
@@ -305,43 +305,17 @@ QString SpectroscopyUtils::ProcessData(
 #endif
 			{
 				double * ss = new double[9];
-				if (!values.at(idx__).pat_pos.isEmpty() &&
-					!values.at(idx__).pat_orient.isEmpty())
+				if (values.pat_pos_ok[idx__] &&
+					values.pat_orient_ok[idx__])
 				{
-					double pat_pos[3];
-					double pat_orient[6];
-					const bool ok_p
-						= DicomUtils::get_patient_position(
-							values.at(idx__).pat_pos,
-							pat_pos);
-					const bool ok_o
-						= DicomUtils::get_patient_orientation(
-							values.at(idx__).pat_orient,
-							pat_orient);
-					if (ok_o && ok_p)
-					{
-						ss[0] = pat_pos[0];
-						ss[1] = pat_pos[1];
-						ss[2] = pat_pos[2];
-						ss[3] = pat_orient[0];
-						ss[4] = pat_orient[1];
-						ss[5] = pat_orient[2];
-						ss[6] = pat_orient[3];
-						ss[7] = pat_orient[4];
-						ss[8] = pat_orient[5];
-						tmp4.push_back(ss);
+					for (int k = 0; k < 3; k++)
+						ss[k] = values.pat_pos[3*idx__+k];
+					for (int k = 0; k < 6; k++)
+						ss[3+k] = values.pat_orient[6*idx__+k];
+					tmp4.push_back(ss);
 #if LOAD_SPECT_DATA___
-						tmp3.push_back(data.at(idx__));
-#endif
-					}
-					else
-					{
-#if 1
-						std::cout << "!(ok_o && ok_p)"
-							<< std::endl;
+					tmp3.push_back(data.at(idx__));
 #endif
-						error = true; delete [] ss; break;
-					}
 				}
 				else
 				{
@@ -352,14 +326,10 @@ QString SpectroscopyUtils::ProcessData(
 					error = true; delete [] ss; break;
 				}
 				
-				if (!values.at(idx__).pix_spacing.isEmpty())
-				{
-					tmp5.push_back(values.at(idx__).pix_spacing);
-				}
-				else
-				{
-					tmp5.push_back(QString(""));
-				}
+				tmp5.push_back(
+					values.pix_spacing_ok[idx__]
+					? &values.pix_spacing[2*idx__]
+					: NULL);
 				//
 				j++;
 			}
@@ -395,11 +365,12 @@ QString SpectroscopyUtils::ProcessData(
 			double spacing_tmp0[2] = {0.0, 0.0 };
 			double spacing_tmp1[2] = {0.0, 0.0 };
 			bool spacing_ok = false;
-			for (int i = 0; i < tmp5.size(); i++)
+			for (size_t i = 0; i < tmp5.size(); i++)
 			{
-				spacing_ok = DicomUtils::get_pixel_spacing(
-					tmp5.at(i), spacing_tmp0);
+				spacing_ok = (tmp5.at(i) != NULL);
 				if (!spacing_ok) break;
+				spacing_tmp0[0] = tmp5.at(i)[0];
+				spacing_tmp0[1] = tmp5.at(i)[1];
 				if (i > 0)
 				{
 					if (!(
@@ -8,6 +8,8 @@
 #include "mdcmVR.h"
 #include "mdcmVM.h"
 #include "mdcmVL.h"
+#include "mdcmByteValue.h"
+#include "mdcmSplitMosaicFilter.h"
 #include <math.h>
 #include <iostream>
 #include <vector>
@@ -15,37 +17,6 @@
 
 //#include "mdcmImageWriter.h"
 
-template<typename T> bool reorganize_uih_grid(
-	const T * input,
-	const unsigned int * indims,
-	const unsigned int * outdims,
-	T * output)
-{
-	const unsigned int div =
-		(unsigned int)ceil(sqrt((double)outdims[2]));
-	if (!(div > 0)) return false;
-	const size_t insize  = indims[0]*indims[1]*indims[2];
-	const size_t outsize = outdims[0]*outdims[1]*outdims[2];
-	for (unsigned int x = 0; x < outdims[0]; x++)
-	{
-		for (unsigned int y = 0; y < outdims[1]; y++)
-		{
-			for (unsigned int z = 0; z < outdims[2]; z++)
-			{
-				const size_t outidx =
-					x + y*outdims[0] + z*outdims[0]*outdims[1];
-				const size_t inidx =
-					(x + (z%div)*outdims[0]) +
-					(y + (z/div)*outdims[1])*indims[0];
-				if (!(outidx < outsize && inidx < insize))
-					return false;
-				output[outidx] = input[inidx];
-			}
-		}
-	}
-	return true;
-}
-
 namespace mdcm
 {
 
@@ -206,44 +177,38 @@ bool SplitUihGridFilter::Split()
 		return false;
 	}
 	const Image & inputimage = GetImage();
-	unsigned long l = inputimage.GetBufferLength();
+	unsigned int pixelsize = 0;
+	if (inputimage.GetPixelFormat() == PixelFormat::UINT16 ||
+		inputimage.GetPixelFormat() == PixelFormat::INT16)
+		pixelsize = 2;
+	else if (inputimage.GetPixelFormat() == PixelFormat::UINT8 ||
+		inputimage.GetPixelFormat() == PixelFormat::INT8)
+		pixelsize = 1;
+	else
+		return false;
+	const unsigned int div =
+		(unsigned int)ceil(sqrt((double)dims[2]));
+	const unsigned long long l = inputimage.GetBufferLength();
 	std::vector<char> buf;
 	buf.resize(l);
 	inputimage.GetBuffer(&buf[0]);
+	// gather into the new Pixel Data value
+	ByteValue * bv = new ByteValue(NULL, (VL::Type)l);
 	DataElement pixeldata(Tag(0x7fe0,0x0010));
-	std::vector<char> outbuf;
-	outbuf.resize(l);
-	bool b = false;
-	if (inputimage.GetPixelFormat() == PixelFormat::UINT16)
-		b = reorganize_uih_grid<unsigned short>(
-			(unsigned short*)&buf[0],
-			inputimage.GetDimensions(),
-			dims,
-			(unsigned short*)&outbuf[0]);
-	else if (inputimage.GetPixelFormat() == PixelFormat::INT16)
-		b = reorganize_uih_grid<signed short>(
-			(signed short*)&buf[0],
-			inputimage.GetDimensions(),
-			dims,
-			(signed short*)&outbuf[0]);
-	else if (inputimage.GetPixelFormat() == PixelFormat::UINT8)
-		b = reorganize_uih_grid<unsigned char>(
-			(unsigned char*)&buf[0],
-			inputimage.GetDimensions(),
-			dims,
-			(unsigned char*)&outbuf[0]);
-	else if (inputimage.GetPixelFormat() == PixelFormat::INT8)
-		b = reorganize_uih_grid<signed char>(
-			(signed char*)&buf[0],
-			inputimage.GetDimensions(),
-			dims,
-			(signed char*)&outbuf[0]);
+	pixeldata.SetValue(*bv);
+	const bool b = SplitMosaicFilter::ReorganizeTiles(
+		&buf[0], l,
+		inputimage.GetDimensions(),
+		div,
+		dims,
+		pixelsize,
+		false,
+		(char*)bv->GetVoidPointer());
 	if (!b)
 	{
-		//std::cout << "!reorganize_uih_grid" << std::endl;
+		//std::cout << "!ReorganizeTiles" << std::endl;
 		return false;
 	}
-	pixeldata.SetByteValue(&outbuf[0], (VL::Type)outbuf.size());
 	Image & image = GetImage();
 	const TransferSyntax &ts = image.GetTransferSyntax();
 	if (ts.IsExplicit())
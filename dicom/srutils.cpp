@@ -94,7 +94,7 @@ template<typename T> SRImage li3(
 	if (!p) return SRImage();
 	//
 	std::vector<QThread*> threadsLUT_;
-	const int num_threads = QThread::idealThreadCount();
+	const int num_threads = CommonUtils::get_max_threads();
 	const int tmp99 = size[1]%num_threads;
 	const double center = ivariant->di->us_window_center;
 	const double width  = ivariant->di->us_window_width;
@@ -472,6 +472,7 @@ void SRUtils::read_IMAGE(
 			{
 				ImageVariant * v = ivariants[0];
 				ImageVariant2D * v2 = new ImageVariant2D();
+				CommonUtils::materialize_slice_rescale(v);
 				CommonUtils::get_dimensions_(v);
 				CommonUtils::calculate_minmax_scalar(v);
 				switch(v->image_type)
@@ -0,0 +1,147 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "mdcmArena.h"
+#include <cassert>
+#include <map>
+#include <mutex>
+
+namespace mdcm
+{
+
+static thread_local Arena * current_arena = NULL;
+
+// Keep all allocations aligned to 16 bytes
+static const size_t arena_alignment = 16;
+
+// Start of each chunk and block of all Arenas -> (size, Arena),
+// 'arena_count' allows to skip the search if there is no Arena.
+typedef std::map<const char*, std::pair<size_t, Arena*> > ArenaRanges;
+static std::mutex arena_mutex;
+static ArenaRanges arena_ranges;
+static std::atomic<long> arena_count(0);
+
+Arena * Arena::New(size_t chunksize)
+{
+  return new Arena(chunksize);
+}
+
+Arena::Arena(size_t chunksize) :
+  ReferenceCount(1),
+  ChunkSize(chunksize < 1024 ? 1024 : chunksize),
+  Used(0),
+  Allocated(0)
+{
+  arena_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+Arena::~Arena()
+{
+  {
+    std::lock_guard<std::mutex> lock(arena_mutex);
+    for (size_t i = 0; i < Chunks.size(); ++i)
+    {
+      arena_ranges.erase(Chunks[i]);
+    }
+    for (size_t i = 0; i < Blocks.size(); ++i)
+    {
+      arena_ranges.erase(Blocks[i]);
+    }
+  }
+  arena_count.fetch_sub(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < Chunks.size(); ++i)
+  {
+    delete [] Chunks[i];
+  }
+  for (size_t i = 0; i < Blocks.size(); ++i)
+  {
+    delete [] Blocks[i];
+  }
+}
+
+void Arena::Register(const char * p, size_t n)
+{
+  std::lock_guard<std::mutex> lock(arena_mutex);
+  arena_ranges[p] = std::make_pair(n, this);
+}
+
+void * Arena::Allocate(size_t n)
+{
+  n = (n + arena_alignment - 1) & ~(arena_alignment - 1);
+  if (n > ChunkSize / 4)
+  {
+    // Large request, own block, kept apart from the chunks, so the
+    // remaining space in the current chunk is still used and no
+    // other request is placed after the end of the block.
+    char * p = new char[n];
+    Blocks.push_back(p);
+    Register(p, n);
+    Allocated += n;
+    return p;
+  }
+  if (Chunks.empty() || Used + n > ChunkSize)
+  {
+    char * c = new char[ChunkSize];
+    Chunks.push_back(c);
+    Register(c, ChunkSize);
+    Used = 0;
+    Allocated += ChunkSize;
+  }
+  char * p = Chunks.back() + Used;
+  Used += n;
+  return p;
+}
+
+void Arena::Acquire()
+{
+  ReferenceCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Arena::Release()
+{
+  const long c = ReferenceCount.fetch_sub(1, std::memory_order_acq_rel);
+  assert(c > 0);
+  if (c == 1)
+  {
+    delete this;
+  }
+}
+
+size_t Arena::GetAllocatedSize() const
+{
+  return Allocated;
+}
+
+Arena * Arena::GetCurrent()
+{
+  return current_arena;
+}
+
+void Arena::SetCurrent(Arena * a)
+{
+  current_arena = a;
+}
+
+Arena * Arena::Find(const void * ptr)
+{
+  if (arena_count.load(std::memory_order_relaxed) < 1) return NULL;
+  const char * p = static_cast<const char*>(ptr);
+  std::lock_guard<std::mutex> lock(arena_mutex);
+  ArenaRanges::const_iterator it = arena_ranges.upper_bound(p);
+  if (it == arena_ranges.begin()) return NULL;
+  --it;
+  if (p < it->first + it->second.first) return it->second.second;
+  return NULL;
+}
+
+} // end namespace mdcm
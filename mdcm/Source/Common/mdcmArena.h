@@ -0,0 +1,89 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef MDCMARENA_H
+#define MDCMARENA_H
+
+#include "mdcmTypes.h"
+#include <atomic>
+#include <vector>
+
+namespace mdcm
+{
+/**
+ * \brief Monotonic allocator used while parsing a File
+ * \details Memory is handed out from large chunks and is never
+ * given back individually, all chunks are released at once when
+ * the last reference goes away. Reader holds one reference for
+ * the duration of the read, each object allocated from the arena
+ * holds another one, so values may safely outlive the Reader and
+ * the File (e.g. after DataSet::Insert into an other DataSet).
+ *
+ * \see Reader::SetUseArena Value
+ */
+class MDCM_EXPORT Arena
+{
+public:
+  static Arena * New(size_t chunksize = 65536);
+  void * Allocate(size_t);
+  void Acquire();
+  void Release();
+  size_t GetAllocatedSize() const;
+
+  /// Arena used for allocations on the current thread, may be NULL
+  static Arena * GetCurrent();
+  static void SetCurrent(Arena *);
+  /// Arena which memory contains the pointer, NULL if the pointer
+  /// was not allocated from an Arena, only searched while at least
+  /// one Arena exists.
+  static Arena * Find(const void *);
+
+private:
+  Arena(size_t);
+  ~Arena();
+  Arena(const Arena &);
+  void operator=(const Arena &);
+  void Register(const char *, size_t);
+  std::vector<char*> Chunks;
+  // Blocks of large requests, never used for other requests
+  std::vector<char*> Blocks;
+  std::atomic<long> ReferenceCount;
+  size_t ChunkSize;
+  size_t Used;
+  size_t Allocated;
+};
+
+/**
+ * \brief Set the current thread's Arena for the lifetime of the object
+ */
+class MDCM_EXPORT ArenaScope
+{
+public:
+  ArenaScope(Arena * a) : Previous(Arena::GetCurrent())
+  {
+    Arena::SetCurrent(a);
+  }
+  ~ArenaScope()
+  {
+    Arena::SetCurrent(Previous);
+  }
+
+private:
+  ArenaScope(const ArenaScope &);
+  void operator=(const ArenaScope &);
+  Arena * Previous;
+};
+
+} // end namespace mdcm
+
+#endif //MDCMARENA_H
@@ -13,27 +13,190 @@
 =========================================================================*/
 
 #include "mdcmUnpacker12Bits.h"
+#include <cstring>
+
+// SSSE3 kernels are used if the compiler targets SSSE3 or, with
+// GCC and Clang on x86, if the processor supports it at run time.
+// MDCM_UNPACKER12_NO_SSSE3 disables them (tests of the other kernels).
+#if defined(MDCM_UNPACKER12_NO_SSSE3)
+#elif defined(__SSSE3__)
+#define MDCM_UNPACKER12_SSSE3 1
+#define MDCM_UNPACKER12_TARGET
+#elif (defined(__x86_64__) || defined(__i386__)) && \
+      (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define MDCM_UNPACKER12_SSSE3 2
+#define MDCM_UNPACKER12_TARGET __attribute__((target("ssse3")))
+#endif
+
+#ifdef MDCM_UNPACKER12_SSSE3
+#include <tmmintrin.h>
+#endif
 
 namespace mdcm
 {
 
+namespace
+{
+
+// Scalar kernels, also used for the tails of the block kernels.
+// 3 bytes are 2 words, little endian 12 bits.
+
+inline void UnpackScalar(
+  unsigned short * q, const unsigned char * p, size_t pairs)
+{
+  for(size_t i = 0; i < pairs; ++i)
+  {
+    const unsigned char b0 = p[0];
+    const unsigned char b1 = p[1];
+    const unsigned char b2 = p[2];
+    q[0] = (unsigned short)(((b1 & 0xf) << 8) + b0);
+    q[1] = (unsigned short)((b1 >> 4) + (b2 << 4));
+    p += 3;
+    q += 2;
+  }
+}
+
+inline void PackScalar(
+  unsigned char * q, const unsigned short * p, size_t pairs)
+{
+  for(size_t i = 0; i < pairs; ++i)
+  {
+    const unsigned short b0 = p[0];
+    const unsigned short b1 = p[1];
+    q[0] = (unsigned char)(b0 & 0xff);
+    q[1] = (unsigned char)((b0 >> 8) + ((b1 & 0xf) << 4));
+    q[2] = (unsigned char)(b1 >> 4);
+    p += 2;
+    q += 3;
+  }
+}
+
+#ifdef MDCM_UNPACKER12_SSSE3
+
+bool HasSSSE3()
+{
+#if MDCM_UNPACKER12_SSSE3 == 1
+  return true;
+#else
+  static const bool b = (__builtin_cpu_supports("ssse3") != 0);
+  return b;
+#endif
+}
+
+// 12 bytes in, 8 words out. The loads are 16 bytes, 4 readable
+// bytes are left after the last block.
+MDCM_UNPACKER12_TARGET
+size_t UnpackBlocksSSSE3(
+  unsigned short * q, const unsigned char * p, size_t pairs)
+{
+  const __m128i shuffle = _mm_setr_epi8(
+    0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+  const __m128i even = _mm_set1_epi32(0x00000fff);
+  const __m128i odd  = _mm_set1_epi32(0x0fff0000);
+  size_t i = 0;
+  for(; i + 6 <= pairs; i += 4)
+  {
+    const __m128i v = _mm_shuffle_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), shuffle);
+    const __m128i r = _mm_or_si128(
+      _mm_and_si128(v, even),
+      _mm_and_si128(_mm_srli_epi16(v, 4), odd));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(q), r);
+    p += 12;
+    q += 8;
+  }
+  return i;
+}
+
+// 8 words in, 12 bytes out. The second byte is the sum, not OR,
+// as in the scalar version, values may be out of 12 bits range.
+MDCM_UNPACKER12_TARGET
+size_t PackBlocksSSSE3(
+  unsigned char * q, const unsigned short * p, size_t pairs)
+{
+  const __m128i shuffle = _mm_setr_epi8(
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m128i nibble = _mm_set1_epi32(0x0000000f);
+  const __m128i lo = _mm_set1_epi32(0x0000ffff);
+  const __m128i hi = _mm_set1_epi32((int)0xffff0000);
+  size_t i = 0;
+  for(; i + 4 <= pairs; i += 4)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i b1 = _mm_and_si128(_mm_srli_epi32(v, 16), nibble);
+    const __m128i t = _mm_add_epi16(v, _mm_slli_epi16(b1, 12));
+    const __m128i r = _mm_shuffle_epi8(
+      _mm_or_si128(
+        _mm_and_si128(t, lo),
+        _mm_and_si128(_mm_srli_epi16(v, 4), hi)),
+      shuffle);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(q), r);
+    const int x = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+    memcpy(q + 8, &x, 4);
+    p += 8;
+    q += 12;
+  }
+  return i;
+}
+
+#endif
+
+// 64 bits SWAR, 6 bytes in, 4 words out. The loads are 8 bytes,
+// 2 readable bytes are left after the last block.
+inline size_t UnpackBlocks(
+  unsigned short * q, const unsigned char * p, size_t pairs)
+{
+#ifdef MDCM_UNPACKER12_SSSE3
+  if(HasSSSE3()) return UnpackBlocksSSSE3(q, p, pairs);
+#endif
+  size_t i = 0;
+#ifndef MDCM_WORDS_BIGENDIAN
+  for(; i + 3 <= pairs; i += 2)
+  {
+    uint64_t x;
+    memcpy(&x, p, 8);
+    const uint64_t r =
+       (x        & 0xfffULL)         |
+      ((x <<  4) & 0xfff0000ULL)     |
+      ((x <<  8) & 0xfff00000000ULL) |
+      ((x << 12) & 0xfff000000000000ULL);
+    memcpy(q, &r, 8);
+    p += 6;
+    q += 4;
+  }
+#else
+  (void)q;
+  (void)p;
+  (void)pairs;
+#endif
+  return i;
+}
+
+inline size_t PackBlocks(
+  unsigned char * q, const unsigned short * p, size_t pairs)
+{
+#ifdef MDCM_UNPACKER12_SSSE3
+  if(HasSSSE3()) return PackBlocksSSSE3(q, p, pairs);
+#else
+  (void)q;
+  (void)p;
+  (void)pairs;
+#endif
+  return 0;
+}
+
+}
+
 bool Unpacker12Bits::Unpack(char * out, const char * in, size_t n)
 {
   // 3bytes are actually 2 words
   // http://groups.google.com/group/comp.lang.c/msg/572bc9b085c717f3
   if(n % 3) return false;
-  short * q = (short*)out;
-  const unsigned char * p = (const unsigned char*)in;
-  const unsigned char * end = p+n;
-  unsigned char b0, b1, b2;
-  while (p != end)
-  {
-    b0 = *p++;
-    b1 = *p++;
-    b2 = *p++;
-    *q++ = (short)(((b1 & 0xf) << 8) + b0);
-    *q++ = (short)((b1>>4) + (b2<<4));
-  }
+  const size_t pairs = n / 3;
+  unsigned short * q = reinterpret_cast<unsigned short*>(out);
+  const unsigned char * p = reinterpret_cast<const unsigned char*>(in);
+  const size_t done = UnpackBlocks(q, p, pairs);
+  UnpackScalar(q + 2 * done, p + 3 * done, pairs - done);
   return true;
 }
 
@@ -41,18 +204,12 @@ bool Unpacker12Bits::Pack(char * out, const char * in, size_t n)
 {
   // we need an even number of 'words' so that 2 words are split in 3 bytes
   if(n % 4) return false;
-  unsigned char * q = (unsigned char*)out;
-  const unsigned short * p = (const unsigned short*)(const void*)in;
-  const unsigned short * end = (const unsigned short*)(const void*)(in+n);
-  unsigned short b0, b1;
-  while(p != end)
-  {
-    b0 = *p++;
-    b1 = *p++;
-    *q++ = (unsigned char)(b0 & 0xff);
-    *q++ = (unsigned char)((b0 >> 8) + ((b1 & 0xf) << 4));
-    *q++ = (unsigned char)(b1 >> 4);
-  }
+  const size_t pairs = n / 4;
+  unsigned char * q = reinterpret_cast<unsigned char*>(out);
+  const unsigned short * p = reinterpret_cast<const unsigned short*>(
+    static_cast<const void*>(in));
+  const size_t done = PackBlocks(q, p, pairs);
+  PackScalar(q + 3 * done, p + 2 * done, pairs - done);
   return true;
 }
 
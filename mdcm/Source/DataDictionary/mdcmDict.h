@@ -21,7 +21,12 @@
 #include "mdcmSystem.h"
 #include <iostream>
 #include <iomanip>
-#include <map>
+#include <vector>
+#include <list>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <cstring>
 
 /*
  * TODO class template should work for both a public and a private dict
@@ -40,7 +45,9 @@ namespace mdcm
 class MDCM_EXPORT Dict
 {
 public:
-  typedef std::map<Tag, DictEntry> MapDictEntry;
+  // Sorted by Tag, s. LoadDefault, the default dictionary table
+  // is already sorted, no per-entry allocation, binary search lookup.
+  typedef std::vector<std::pair<Tag, DictEntry> > MapDictEntry;
   typedef MapDictEntry::iterator Iterator;
   typedef MapDictEntry::const_iterator ConstIterator;
   Dict() : DictInternal() { assert(DictInternal.empty()); }
@@ -51,16 +58,15 @@ public:
 
   void AddDictEntry(const Tag & tag, const DictEntry & de)
   {
-#ifndef NDEBUG
-    MapDictEntry::size_type s = DictInternal.size();
-#endif
-    DictInternal.insert(MapDictEntry::value_type(tag, de));
-    assert(s < DictInternal.size());
+    Iterator it = LowerBound(tag);
+    // same as std::map::insert, existing entry is not replaced
+    if (it != DictInternal.end() && it->first == tag) return;
+    DictInternal.insert(it, MapDictEntry::value_type(tag, de));
   }
 
   const DictEntry & GetDictEntry(const Tag & tag) const
   {
-    MapDictEntry::const_iterator it = DictInternal.find(tag);
+    ConstIterator it = Find(tag);
     if (it == DictInternal.end())
     {
 #ifdef UNKNOWNPUBLICTAG
@@ -75,21 +81,20 @@ public:
         assert(0 && "Impossible");
       }
 #endif
-      it = DictInternal.find(Tag(0xffff,0xffff));
+      it = Find(Tag(0xffff,0xffff));
+      assert(it != DictInternal.end());
       return it->second;
     }
-    assert(DictInternal.count(tag) == 1);
     return it->second;
   }
 
   const char * GetKeywordFromTag(Tag const & tag) const
   {
-    MapDictEntry::const_iterator it = DictInternal.find(tag);
+    ConstIterator it = Find(tag);
     if (it == DictInternal.end())
     {
       return NULL;
     }
-    assert(DictInternal.count(tag) == 1);
     return it->second.GetKeyword();
   }
 
@@ -119,10 +124,9 @@ public:
     if (it == DictInternal.end())
     {
       tag = Tag(0xffff,0xffff);
-      it = DictInternal.find(tag);
+      it = Find(tag);
       return it->second;
     }
-    assert(DictInternal.count(tag) == 1);
     return it->second;
   }
 
@@ -150,10 +154,9 @@ public:
     if (it == DictInternal.end())
     {
       tag = Tag(0xffff,0xffff);
-      it = DictInternal.find(tag);
+      it = Find(tag);
       return it->second;
     }
-    assert(DictInternal.count(tag) == 1);
     return it->second;
   }
 
@@ -162,6 +165,25 @@ protected:
   void LoadDefault();
 
 private:
+  struct TagLess
+  {
+    bool operator()(const MapDictEntry::value_type & v, const Tag & t) const
+    {
+      return v.first < t;
+    }
+  };
+  Iterator LowerBound(const Tag & tag)
+  {
+    return std::lower_bound(
+      DictInternal.begin(), DictInternal.end(), tag, TagLess());
+  }
+  ConstIterator Find(const Tag & tag) const
+  {
+    ConstIterator it = std::lower_bound(
+      DictInternal.begin(), DictInternal.end(), tag, TagLess());
+    if (it != DictInternal.end() && it->first == tag) return it;
+    return DictInternal.end();
+  }
   Dict &operator=(const Dict &); // purposely not implemented
   Dict(const Dict &); // purposely not implemented
   MapDictEntry DictInternal;
@@ -192,75 +214,58 @@ inline std::ostream& operator<<(std::ostream & os, const Dict & val)
  */
 class MDCM_EXPORT PrivateDict
 {
-  typedef std::map<PrivateTag, DictEntry> MapDictEntry;
+  // Owner is not copied for default entries (static table),
+  // owners of entries added with AddDictEntry are kept in OwnerStorage.
+  struct PrivateKey
+  {
+    PrivateKey(const Tag & t, const char * o) : tag(t), owner(o) {}
+    Tag tag;
+    const char * owner;
+  };
+  typedef std::vector<std::pair<PrivateKey, DictEntry> > MapDictEntry;
   friend std::ostream& operator<<(std::ostream &, const PrivateDict &);
 public:
   PrivateDict()  {}
   ~PrivateDict() {}
   void AddDictEntry(const PrivateTag & tag, const DictEntry & de)
   {
-#ifndef NDEBUG
-    MapDictEntry::size_type s = DictInternal.size();
-#endif
-    DictInternal.insert(
-      MapDictEntry::value_type(tag, de));
-   // The following code should only be used when
-   // manually constructing a Private.xml file by hand
-   // it will get rid of VR::UN duplicate
-   // (ie. if a VR != VR::Un can be found)
-#if defined(NDEBUG) && 0
-    if(s == DictInternal.size())
+    MapDictEntry::iterator it = LowerBound(tag, tag.GetOwner());
+    if (it != DictInternal.end() && IsEqual(it->first, tag, tag.GetOwner()))
     {
-      MapDictEntry::iterator it = DictInternal.find(tag);
-      assert(it != DictInternal.end());
-      DictEntry &duplicate = it->second;
-      assert(de.GetVR() == VR::UN || duplicate.GetVR() == VR::UN);
-      assert(de.GetVR() != duplicate.GetVR());
-      if(duplicate.GetVR() == VR::UN)
-      {
-        assert(de.GetVR() != VR::UN);
-        duplicate.SetVR(de.GetVR());
-        duplicate.SetVM(de.GetVM());
-        assert(GetDictEntry(tag).GetVR() != VR::UN);
-        assert(GetDictEntry(tag).GetVR() == de.GetVR());
-        assert(GetDictEntry(tag).GetVM() == de.GetVM());
-      }
       return;
     }
-#endif
-    assert(s < DictInternal.size());
+    OwnerStorage.push_back(std::string(tag.GetOwner()));
+    DictInternal.insert(
+      it,
+      MapDictEntry::value_type(
+        PrivateKey(tag, OwnerStorage.back().c_str()), de));
   }
 
   bool RemoveDictEntry(const PrivateTag & tag)
   {
-    MapDictEntry::size_type s =
-      DictInternal.erase(tag);
-    assert(s == 1 || s == 0);
-    return s == 1;
+    MapDictEntry::iterator it = LowerBound(tag, tag.GetOwner());
+    if (it != DictInternal.end() && IsEqual(it->first, tag, tag.GetOwner()))
+    {
+      DictInternal.erase(it);
+      return true;
+    }
+    return false;
   }
 
   bool FindDictEntry(const PrivateTag & tag) const
   {
-    MapDictEntry::const_iterator it =
-      DictInternal.find(tag);
-    if (it == DictInternal.end())
-    {
-      return false;
-    }
-    return true;
+    return (Find(tag, tag.GetOwner()) != DictInternal.end());
   }
 
   const DictEntry & GetDictEntry(const PrivateTag & tag) const
   {
-    MapDictEntry::const_iterator it = DictInternal.find(tag);
+    MapDictEntry::const_iterator it = Find(tag, tag.GetOwner());
     if (it == DictInternal.end())
     {
-      it = DictInternal.find(PrivateTag(
-        0xffff,0xffff,"MDCM Private Sentinel"));
+      it = Find(Tag(0xffff,0xff), "MDCM Private Sentinel");
       assert (it != DictInternal.end());
       return it->second;
     }
-    assert(DictInternal.count(tag) == 1);
     return it->second;
   }
 
@@ -270,14 +275,14 @@ public:
     std::cout << "<dict edition=\"2008\">\n";
     for(;it != DictInternal.end(); ++it)
     {
-      const PrivateTag & t = it->first;
+      const PrivateKey & t = it->first;
       const DictEntry & de = it->second;
       std::cout << "  <entry group=\"" << std::hex << std::setw(4)
-        << std::setfill('0') << t.GetGroup() << "\"" <<
+        << std::setfill('0') << t.tag.GetGroup() << "\"" <<
         " element=\"xx" << std::setw(2) << std::setfill('0')
-        << t.GetElement() << "\"" << " vr=\""
+        << t.tag.GetElement() << "\"" << " vr=\""
         << de.GetVR() << "\" vm=\"" << de.GetVM() << "\" owner=\""
-        << t.GetOwner();
+        << t.owner;
       const char * name = de.GetName();
       if(*name == 0)
       {
@@ -298,9 +303,49 @@ protected:
   void LoadDefault();
 
 private:
+  static int Compare(const PrivateKey & k, const Tag & t, const char * owner)
+  {
+    if (k.tag == t) return strcmp(k.owner, owner);
+    return (k.tag < t) ? -1 : 1;
+  }
+  static bool IsEqual(const PrivateKey & k, const Tag & t, const char * owner)
+  {
+    return (Compare(k, t, owner) == 0);
+  }
+  size_t LowerBoundIndex(const Tag & t, const char * owner) const
+  {
+    size_t first = 0;
+    size_t count = DictInternal.size();
+    while (count > 0)
+    {
+      const size_t step = count / 2;
+      if (Compare(DictInternal[first + step].first, t, owner) < 0)
+      {
+        first += step + 1;
+        count -= step + 1;
+      }
+      else
+      {
+        count = step;
+      }
+    }
+    return first;
+  }
+  MapDictEntry::iterator LowerBound(const Tag & t, const char * owner)
+  {
+    return DictInternal.begin() + LowerBoundIndex(t, owner);
+  }
+  MapDictEntry::const_iterator Find(const Tag & t, const char * owner) const
+  {
+    MapDictEntry::const_iterator it =
+      DictInternal.begin() + LowerBoundIndex(t, owner);
+    if (it != DictInternal.end() && IsEqual(it->first, t, owner)) return it;
+    return DictInternal.end();
+  }
   PrivateDict &operator=(const PrivateDict &); // purposely not implemented
   PrivateDict(const PrivateDict &); // purposely not implemented
   MapDictEntry DictInternal;
+  std::list<std::string> OwnerStorage;
 };
 
 inline std::ostream& operator<<(std::ostream & os, const PrivateDict & val)
@@ -308,7 +353,7 @@ inline std::ostream& operator<<(std::ostream & os, const PrivateDict & val)
   PrivateDict::MapDictEntry::const_iterator it = val.DictInternal.begin();
   for(;it != val.DictInternal.end(); ++it)
   {
-    const PrivateTag & t = it->first;
+    const PrivateTag t(it->first.tag, it->first.owner);
     const DictEntry & de = it->second;
     os << t << " " << de << '\n';
   }
@@ -35,6 +35,9 @@ namespace mdcm
 class MDCM_EXPORT DictEntry
 {
 public:
+  // Name and keyword passed to the constructor are not copied, they
+  // are expected to be static strings (s. default dictionaries).
+  // Strings passed to SetName/SetKeyword are copied.
   DictEntry(
     const char * name = "",
     const char * keyword = "",
@@ -42,22 +45,59 @@ public:
     VM const &vm = VM::VM0,
     bool ret = false)
     :
-    Name(name),
-    Keyword(keyword),
+    Name(name ? name : ""),
+    Keyword(keyword ? keyword : ""),
     ValueRepresentation(vr),
     ValueMultiplicity(vm),
     Retired(ret),
     GroupXX(false),
     ElementXX(false) {}
+  DictEntry(const DictEntry & val)
+    :
+    NameStorage(val.NameStorage),
+    KeywordStorage(val.KeywordStorage),
+    ValueRepresentation(val.ValueRepresentation),
+    ValueMultiplicity(val.ValueMultiplicity),
+    Retired(val.Retired),
+    GroupXX(val.GroupXX),
+    ElementXX(val.ElementXX)
+  {
+    Name = val.OwnsName() ? NameStorage.c_str() : val.Name;
+    Keyword = val.OwnsKeyword() ? KeywordStorage.c_str() : val.Keyword;
+  }
+  DictEntry & operator=(const DictEntry & val)
+  {
+    if(this != &val)
+    {
+      NameStorage = val.NameStorage;
+      KeywordStorage = val.KeywordStorage;
+      Name = val.OwnsName() ? NameStorage.c_str() : val.Name;
+      Keyword = val.OwnsKeyword() ? KeywordStorage.c_str() : val.Keyword;
+      ValueRepresentation = val.ValueRepresentation;
+      ValueMultiplicity = val.ValueMultiplicity;
+      Retired = val.Retired;
+      GroupXX = val.GroupXX;
+      ElementXX = val.ElementXX;
+    }
+    return *this;
+  }
   friend std::ostream& operator<<(std::ostream & _os, const DictEntry & _val);
   const VR &GetVR() const { return ValueRepresentation; }
   void SetVR(const VR & vr) { ValueRepresentation = vr; }
   const VM &GetVM() const { return ValueMultiplicity; }
   void SetVM(VM const & vm) { ValueMultiplicity = vm; }
-  const char *GetName() const { return Name.c_str(); }
-  void SetName(const char* name) { Name = name; }
-  const char *GetKeyword() const { return Keyword.c_str(); }
-  void SetKeyword(const char* keyword) { Keyword = keyword; }
+  const char *GetName() const { return Name; }
+  void SetName(const char* name)
+  {
+    NameStorage = name ? name : "";
+    Name = NameStorage.c_str();
+  }
+  const char *GetKeyword() const { return Keyword; }
+  void SetKeyword(const char* keyword)
+  {
+    KeywordStorage = keyword ? keyword : "";
+    Keyword = KeywordStorage.c_str();
+  }
   bool GetRetired() const { return Retired; }
   void SetRetired(bool retired) { Retired = retired; }
   void SetGroupXX(bool v) { GroupXX = v; }
@@ -66,9 +106,13 @@ public:
 private:
   friend class Dict;
   static bool CheckKeywordAgainstName(const char * name, const char * keyword);
+  bool OwnsName() const { return Name == NameStorage.c_str(); }
+  bool OwnsKeyword() const { return Keyword == KeywordStorage.c_str(); }
 private:
-  std::string Name;
-  std::string Keyword;
+  std::string NameStorage;
+  std::string KeywordStorage;
+  const char * Name;
+  const char * Keyword;
   VR ValueRepresentation;
   VM ValueMultiplicity;
   bool Retired : 1;
@@ -78,7 +122,7 @@ private:
 
 inline std::ostream& operator<<(std::ostream & os, const DictEntry & val)
 {
-  if(val.Name.empty())
+  if(*val.Name == 0)
   {
     os << "[No name]";
   }
@@ -86,7 +130,7 @@ inline std::ostream& operator<<(std::ostream & os, const DictEntry & val)
   {
     os << val.Name;
   }
-  if(val.Keyword.empty())
+  if(*val.Keyword == 0)
   {
     os << "[No keyword]";
   }
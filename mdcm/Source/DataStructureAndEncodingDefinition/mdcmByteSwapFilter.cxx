@@ -124,7 +124,6 @@ bool ByteSwapFilter::ByteSwap()
           SwapperDoOp::Swap(
             tag.GetElement())));
       copy.Insert(de);
-      DS.Remove(de.GetTag());
     }
     DS = copy;
   }
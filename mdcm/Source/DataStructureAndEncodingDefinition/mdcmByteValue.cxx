@@ -44,7 +44,7 @@ namespace mdcm_ns
 #ifdef SHORT_READ_HACK
       if(l <= 0xff)
 #endif
-      Internal.resize(l);
+      Resize(l);
     }
     catch(...)
     {
@@ -59,7 +59,7 @@ namespace mdcm_ns
     // Special case for VR::UI, do not print the trailing \0
     if(length && length == Length)
     {
-      if(Internal[length-1] == 0)
+      if(GetData()[length-1] == 0)
       {
         length = length - 1;
       }
@@ -67,10 +67,10 @@ namespace mdcm_ns
     // I cannot check IsPrintable some file contains \2 or \0 in a VR::LO element
     // See: acr_image_with_non_printable_in_0051_1010.acr
     //assert(IsPrintable(length));
-    std::vector<char>::const_iterator it = Internal.begin();
-    for(; it != Internal.begin()+length; ++it)
+    const char * d = GetData();
+    for(VL i = 0; i < length; ++i)
     {
-      const char &c = *it;
+      const char &c = d[i];
       if (!(isprint((unsigned char)c) || isspace((unsigned char)c))) os << ".";
       else os << c;
     }
@@ -79,12 +79,12 @@ namespace mdcm_ns
   void ByteValue::PrintHex(std::ostream &os, VL maxlength) const
   {
     VL length = std::min(maxlength, Length);
-    std::vector<char>::const_iterator it = Internal.begin();
+    const char * d = GetData();
     os << std::hex;
-    for(; it != Internal.begin()+length; ++it)
+    for(VL i = 0; i < length; ++i)
     {
-      uint8_t v = *it;
-      if(it != Internal.begin()) os << "\\";
+      uint8_t v = d[i];
+      if(i) os << "\\";
       os << std::setw(2) << std::setfill('0') << (uint16_t)v;
     }
     os << std::dec;
@@ -92,9 +92,9 @@ namespace mdcm_ns
 
   bool ByteValue::GetBuffer(char * buffer, unsigned long long length) const
   {
-    if(length <= Internal.size())
+    if(length <= Size)
     {
-      if (!Internal.empty()) memcpy(buffer, &Internal[0], length);
+      if (Size) memcpy(buffer, GetData(), length);
       return true;
     }
     mdcmDebugMacro("Could not handle length= " << length);
@@ -107,10 +107,10 @@ namespace mdcm_ns
     count1=count2=1;
     os << "<PersonName number = \"" << count1 << "\" >\n" ;
     os << "<SingleByte>\n<FamilyName> " ;
-    std::vector<char>::const_iterator it = Internal.begin();
-    for(; it != (Internal.begin() + Length); ++it)
+    const char * d = GetData();
+    for(VL i = 0; i < Length; ++i)
     {
-      const char &c = *it;
+      const char &c = d[i];
       if (c == '^')
       {
         if(count2==1)
@@ -247,11 +247,11 @@ namespace mdcm_ns
 
     int count = 1;
     os << "<Value number = \"" << count << "\" >";
-    std::vector<char>::const_iterator it = Internal.begin();
+    const char * d = GetData();
 
-    for(; it != (Internal.begin() + Length); ++it)
+    for(VL i = 0; i < Length; ++i)
     {
-      const char &c = *it;
+      const char &c = d[i];
       if (c == '\\')
       {
         count++;
@@ -280,12 +280,12 @@ namespace mdcm_ns
 
   void ByteValue::PrintHexXML(std::ostream & os) const
   {
-    std::vector<char>::const_iterator it = Internal.begin();
+    const char * d = GetData();
     os << std::hex;
-    for(; it != Internal.begin() + Length; ++it)
+    for(VL i = 0; i < Length; ++i)
     {
-      uint8_t v = *it;
-      if(it != Internal.begin()) os << "\\";
+      uint8_t v = d[i];
+      if(i) os << "\\";
       os << std::setw(2) << std::setfill('0') << (uint16_t)v;
     }
     os << std::dec;
@@ -293,9 +293,12 @@ namespace mdcm_ns
    
   void ByteValue::Append(ByteValue const & bv)
   {
-    Internal.insert(Internal.end(), bv.Internal.begin(), bv.Internal.end());
+    const size_t s = Size;
+    const size_t n = bv.Size;
+    Resize(s + n);
+    if(n) memcpy(GetData() + s, bv.GetData(), n);
     Length += bv.Length;
-    assert(Internal.size() % 2 == 0 && Internal.size() == Length);
+    assert(Size % 2 == 0 && Size == Length);
   }
    
 } // end namespace mdcm_ns
@@ -21,6 +21,7 @@
 #include <iterator>
 #include <iomanip>
 #include <algorithm>
+#include <cstring>
 
 namespace mdcm_ns
 {
@@ -38,22 +39,37 @@ class MDCM_EXPORT ByteValue : public Value
 public:
   ByteValue(const char * array = NULL, VL const & vl = 0)
     :
-    Internal(array, array+vl),
+    Size(0),
     Length(vl)
   {
-      if(vl.IsOdd())
-      {
-        mdcmDebugMacro("Odd length");
-        Internal.resize(vl+1);
-        Length++;
-      }
+    Resize(vl);
+    if(array && vl) memcpy(GetData(), array, vl);
+    if(vl.IsOdd())
+    {
+      mdcmDebugMacro("Odd length");
+      Resize(vl+1);
+      Length++;
+    }
   }
 
   ByteValue(std::vector<char> & v)
     :
-    Internal(v),Length((uint32_t)v.size()) {}
+    Size(0),
+    Length((uint32_t)v.size())
+  {
+    if(v.size() > SmallSize)
+    {
+      Internal = v;
+      Size = v.size();
+    }
+    else
+    {
+      Resize(v.size());
+      if(!v.empty()) memcpy(Small, &v[0], v.size());
+    }
+  }
 
-  ~ByteValue() { Internal.clear(); }
+  ~ByteValue() { Clear(); }
   void PrintASCII(std::ostream &, VL) const;
   void PrintHex(std::ostream &, VL) const;
 
@@ -69,64 +85,88 @@ public:
   VL ComputeLength() const { return Length + Length % 2; }
   void SetLength(VL vl);
 
-  operator const std::vector<char>& () const { return Internal; }
-
   ByteValue &operator=(const ByteValue & val)
   {
-    Internal = val.Internal;
-    Length = val.Length;
+    if(this != &val)
+    {
+      Resize(val.Size);
+      if(val.Size) memcpy(GetData(), val.GetData(), val.Size);
+      Length = val.Length;
+    }
     return *this;
   }
 
   bool operator==(const ByteValue & val) const
   {
-    if(Length != val.Length)     return false;
-    if(Internal == val.Internal) return true;
-    return false;
+    if(Length != val.Length) return false;
+    return IsSameData(val);
   }
 
   bool operator==(const Value &val) const
   {
     const ByteValue &bv = dynamic_cast<const ByteValue&>(val);
-    return Length == bv.Length && Internal == bv.Internal;
+    return Length == bv.Length && IsSameData(bv);
   }
 
   void Append(ByteValue const & bv);
 
-  void Clear() {  Internal.clear(); }
+  void Clear()
+  {
+    std::vector<char>().swap(Internal);
+    Size = 0;
+  }
 
   const char * GetPointer() const
   {
-    if(!Internal.empty()) return &Internal[0];
+    if(Size) return GetData();
     return NULL;
   }
 
   const void * GetVoidPointer() const
   {
-    if(!Internal.empty()) return &Internal[0];
+    if(Size) return GetData();
     return NULL;
   }
 
   void * GetVoidPointer()
   {
-    if(!Internal.empty()) return &Internal[0];
+    if(Size) return GetData();
     return NULL;
   }
 
   void Fill(char c)
   {
-    std::vector<char>::iterator it = Internal.begin();
-    for(; it != Internal.end(); ++it) *it = c;
+    if(Size) memset(GetData(), c, Size);
   }
 
   bool GetBuffer(char*, unsigned long long) const;
 
+  // Takes over the content of 'v' without a copy, 'v' is left empty.
+  // Odd length is padded with \0 as in the constructor.
+  void SwapBuffer(std::vector<char> & v)
+  {
+    if(v.size() % 2) v.push_back(0);
+    if(v.size() > SmallSize)
+    {
+      Internal.swap(v);
+      Size = Internal.size();
+    }
+    else
+    {
+      Clear();
+      Resize(v.size());
+      if(!v.empty()) memcpy(Small, &v[0], v.size());
+    }
+    std::vector<char>().swap(v);
+    Length = (uint32_t)Size;
+  }
+
   bool WriteBuffer(std::ostream & os) const
   {
     if(Length)
     {
-      assert(!(Internal.size() % 2));
-      os.write(&Internal[0], Internal.size());
+      assert(!(Size % 2));
+      os.write(GetData(), Size);
     }
     return true;
   }
@@ -135,16 +175,16 @@ public:
   std::istream & Read(std::istream & is, bool readvalues = true)
   {
     // If Length is odd we have detected that in SetLength
-    // and calling std::vector::resize make sure to allocate *AND*
+    // and calling Resize make sure to allocate *AND*
     // initialize values to 0 so we are sure to have a \0 at the end
     // even in this case
     if(Length)
     {
       if(readvalues)
       {
-        is.read(&Internal[0], Length);
-        assert(Internal.size() == Length || Internal.size() == Length + 1);
-        TSwap::SwapArray((TType*)GetVoidPointer(), Internal.size()/sizeof(TType));
+        is.read(GetData(), Length);
+        assert(Size == Length || Size == Length + 1);
+        TSwap::SwapArray((TType*)GetVoidPointer(), Size/sizeof(TType));
       }
       else
       {
@@ -163,12 +203,12 @@ public:
   template <typename TSwap, typename TType>
   std::ostream const & Write(std::ostream & os) const
   {
-    assert(!(Internal.size() % 2));
-    if(!Internal.empty())
+    assert(!(Size % 2));
+    if(Size)
     {
-      std::vector<char> copy = Internal;
+      std::vector<char> copy(GetData(), GetData() + Size);
       TSwap::SwapArray(
-        (TType*)(void*)&copy[0], Internal.size()/sizeof(TType));
+        (TType*)(void*)&copy[0], Size/sizeof(TType));
       os.write(&copy[0], copy.size());
     }
     return os;
@@ -189,11 +229,12 @@ public:
   bool IsPrintable(VL length) const
   {
     assert(length <= Length);
+    const char * d = GetData();
     for(unsigned int i=0; i<length; i++)
     {
-      if (i == (length-1) && Internal[i] == '\0') continue;
-      if (!(isprint((unsigned char)Internal[i]) ||
-              isspace((unsigned char)Internal[i])))
+      if (i == (length-1) && d[i] == '\0') continue;
+      if (!(isprint((unsigned char)d[i]) ||
+              isspace((unsigned char)d[i])))
       {
         return false;
       }
@@ -208,20 +249,21 @@ public:
 protected:
   void Print(std::ostream & os) const
   {
-    if(!Internal.empty())
+    if(Size)
     {
       if(IsPrintable(Length))
       {
-        std::vector<char>::size_type length = Length;
-        if(Internal.back() == 0) --length;
+        size_t length = Length;
+        const char * d = GetData();
+        if(d[Size-1] == 0) --length;
         std::copy(
-          Internal.begin(),
-          Internal.begin()+length,
+          d,
+          d+length,
           std::ostream_iterator<char>(os));
       }
       else
       {
-        os << "Loaded:" << Internal.size();
+        os << "Loaded:" << Size;
       }
     }
     else
@@ -233,9 +275,55 @@ protected:
   void SetLengthOnly(VL vl) { Length = vl; }
 
 private:
+  // Values up to SmallSize bytes (US, UL, CS, DA, TM, short IS/DS, ...)
+  // are stored inline, without the std::vector allocation.
+  enum { SmallSize = 16 };
+
+  char * GetData() { return (Size > SmallSize) ? &Internal[0] : Small; }
+  const char * GetData() const { return (Size > SmallSize) ? &Internal[0] : Small; }
+
+  // Same as std::vector::resize, new bytes are zero-initialized
+  void Resize(size_t n)
+  {
+    if(n > SmallSize)
+    {
+      if(Size <= SmallSize)
+      {
+        Internal.resize(n);
+        if(Size) memcpy(&Internal[0], Small, Size);
+      }
+      else
+      {
+        Internal.resize(n);
+      }
+    }
+    else
+    {
+      if(Size > SmallSize)
+      {
+        memcpy(Small, &Internal[0], n);
+        std::vector<char>().swap(Internal);
+      }
+      else if(n > Size)
+      {
+        memset(Small + Size, 0, n - Size);
+      }
+    }
+    Size = n;
+  }
+
+  bool IsSameData(const ByteValue & val) const
+  {
+    if(Size != val.Size) return false;
+    if(!Size) return true;
+    return (memcmp(GetData(), val.GetData(), Size) == 0);
+  }
+
   std::vector<char> Internal;
+  char Small[SmallSize];
+  size_t Size;
 
-  // WARNING Length IS NOT Internal.size() some *featured* DICOM
+  // WARNING Length IS NOT Size some *featured* DICOM
   // implementation define odd length, we always load them as even number
   // of byte, so we need to keep the right Length
   VL Length;
@@ -30,8 +30,7 @@ std::string DataSet::GetPrivateCreator(const Tag & t) const
     Tag pc = t.GetPrivateCreator();
     if(pc.GetElement())
     {
-      const DataElement r(pc);
-      ConstIterator it = DES.find(r);
+      ConstIterator it = Find(pc);
       if(it == DES.end()) return "";
       const DataElement & de = *it;
       if(de.IsEmpty()) return "";
@@ -54,8 +53,7 @@ Tag DataSet::ComputeDataElement(const PrivateTag & t) const
   mdcmDebugMacro( "Entering ComputeDataElement" );
   // First private creator (0x0 -> 0x9 are reserved...)
   const Tag start(t.GetGroup(), 0x0010); 
-  const DataElement r(start);
-  ConstIterator it = DES.lower_bound(r);
+  ConstIterator it = LowerBound(start);
   const char *refowner = t.GetOwner();
   assert( refowner );
   bool found = false;
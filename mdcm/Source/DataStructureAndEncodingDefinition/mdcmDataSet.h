@@ -20,7 +20,9 @@
 #include "mdcmElement.h"
 #include "mdcmMediaStorage.h"
 #include <set>
+#include <vector>
 #include <iterator>
+#include <algorithm>
 
 namespace mdcm_ns
 {
@@ -55,18 +57,21 @@ class MDCM_EXPORT DataSet
 {
   friend class CSAHeader;
 public:
-#if 0
-  typedef std::set<DataElement> DataElementSet;
-#else
-  typedef std::multiset<DataElement> DataElementSet;
-#endif
+  // Flat storage, sorted by Tag, same semantic as std::multiset
+  // (duplicates are kept after existing equal elements).
+  // Elements are read mostly in ascending order, so insert is
+  // usually an append. Elements must not be modified through
+  // iterators, Iterator is a const iterator as it was with std::multiset.
+  // Note: as with std::vector, inserting or removing elements
+  // invalidates iterators and references to elements.
+  typedef std::vector<DataElement> DataElementSet;
   typedef DataElementSet::const_iterator ConstIterator;
-  typedef DataElementSet::iterator Iterator;
+  typedef DataElementSet::const_iterator Iterator;
   typedef DataElementSet::size_type SizeType;
   ConstIterator Begin() const { return DES.begin(); }
-  Iterator Begin() { return DES.begin(); }
+  Iterator Begin() { return Iterator(DES.begin()); }
   ConstIterator End() const { return DES.end(); }
-  Iterator End() { return DES.end(); }
+  Iterator End() { return Iterator(DES.end()); }
   const DataElementSet & GetDES() const { return DES; }
   DataElementSet & GetDES() { return DES; }
 
@@ -94,9 +99,9 @@ public:
   unsigned int ComputeGroupLength(Tag const &tag) const
   {
     assert( tag.GetElement() == 0x0 );
-    const DataElement r(tag);
-    ConstIterator it = DES.find(r);
+    ConstIterator it = Find(tag);
     unsigned int res = 0;
+    if(it == DES.end()) return res;
     for(++it; it != DES.end() && it->GetTag().GetGroup() == tag.GetGroup(); ++it)
     {
       assert(it->GetTag().GetElement() != 0x0);
@@ -152,32 +157,38 @@ public:
 
   void Replace(const DataElement& de)
   {
-    ConstIterator it = DES.find(de);
-	if(it != DES.end())
-	{
-	  // detect loop
-	  mdcmAssertAlwaysMacro(&*it != &de);
-	  DES.erase(it);
-	}
-    DES.insert(de);
+    DataElementSet::iterator it = FindMutable(de.GetTag());
+    if(it != DES.end())
+    {
+      // detect loop
+      mdcmAssertAlwaysMacro(&*it != &de);
+      *it = de;
+      return;
+    }
+    InsertSorted(de);
   }
 
   void ReplaceEmpty(const DataElement & de)
   {
-    ConstIterator it = DES.find(de);
+    DataElementSet::iterator it = FindMutable(de.GetTag());
     if(it != DES.end() && it->IsEmpty())
     {
       // detect loop
-	  mdcmAssertAlwaysMacro(&*it != &de);
-	  DES.erase(it);
+      mdcmAssertAlwaysMacro(&*it != &de);
+      *it = de;
+      return;
     }
-	DES.insert(de);
+    InsertSorted(de);
   }
 
   SizeType Remove(const Tag & tag)
   {
-    DataElementSet::size_type count = DES.erase(tag);
+    DataElementSet::iterator first = LowerBound(tag);
+    DataElementSet::iterator last = first;
+    while(last != DES.end() && last->GetTag() == tag) ++last;
+    const SizeType count = (SizeType)(last - first);
     assert(count == 0 || count == 1);
+    DES.erase(first, last);
     return count;
   }
 
@@ -186,8 +197,7 @@ public:
   /// This only search at the 'root level' of the DataSet
   const DataElement & GetDataElement(const Tag & t) const
   {
-    const DataElement r(t);
-    ConstIterator it = DES.find(r);
+    ConstIterator it = Find(t);
     if(it != DES.end()) return *it;
     return GetDEEnd();
   }
@@ -203,16 +213,13 @@ public:
   // this only search within the level of the current DataSet
   bool FindDataElement(const Tag & t) const
   {
-    const DataElement r(t);
-    if(DES.find(r) != DES.end()) return true;
-    return false;
+    return (Find(t) != DES.end());
   }
 
   // WARNING: This only search at the same level as the DataSet is!
   const DataElement& FindNextDataElement(const Tag & t) const
   {
-    const DataElement r(t);
-    ConstIterator it = DES.lower_bound(r);
+    ConstIterator it = LowerBound(t);
     if(it != DES.end()) return *it;
     return GetDEEnd();
   }
@@ -267,18 +274,60 @@ protected:
   // the condition is different
   void InsertDataElement(const DataElement & de)
   {
-#if 0
-    std::pair<Iterator, bool> pr = DES.insert(de);
-    if(pr.second == false)
+    InsertSorted(de);
+    assert(de.IsEmpty() || de.GetVL() == de.GetValue().GetLength());
+  }
+
+  // Same as std::multiset::insert
+  void InsertSorted(const DataElement & de)
+  {
+    if(DES.empty() || !(de.GetTag() < DES.back().GetTag()))
     {
-      mdcmAlwaysWarnMacro(
-        "DataElement: " << de << " was already found, skipping duplicate entry.\n"
-        "Original entry kept is: " << *pr.first);
+      DES.push_back(de);
+      return;
     }
-#else
-    DES.insert(de);
-#endif
-    assert(de.IsEmpty() || de.GetVL() == de.GetValue().GetLength());
+    DES.insert(UpperBound(de.GetTag()), de);
+  }
+
+  struct TagLess
+  {
+    bool operator()(const DataElement & de, const Tag & t) const
+    {
+      return de.GetTag() < t;
+    }
+    bool operator()(const Tag & t, const DataElement & de) const
+    {
+      return t < de.GetTag();
+    }
+  };
+
+  ConstIterator LowerBound(const Tag & t) const
+  {
+    return std::lower_bound(DES.begin(), DES.end(), t, TagLess());
+  }
+
+  DataElementSet::iterator LowerBound(const Tag & t)
+  {
+    return std::lower_bound(DES.begin(), DES.end(), t, TagLess());
+  }
+
+  DataElementSet::iterator UpperBound(const Tag & t)
+  {
+    return std::upper_bound(DES.begin(), DES.end(), t, TagLess());
+  }
+
+  ConstIterator Find(const Tag & t) const
+  {
+    ConstIterator it = LowerBound(t);
+    if(it != DES.end() && it->GetTag() == t) return it;
+    return DES.end();
+  }
+
+  DataElementSet::iterator FindMutable(const Tag & t)
+  {
+    DataElementSet::iterator it = LowerBound(t);
+    if(it != DES.end() && it->GetTag() == t) return it;
+    return DES.end();
   }
 
 protected:
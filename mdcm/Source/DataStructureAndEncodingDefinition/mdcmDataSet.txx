@@ -236,7 +236,7 @@ std::istream & DataSet::ReadSelectedPrivateTags(
 
       if(tag.GetPrivateCreator() == refPTag)
       {
-        DES.insert(dataElem);
+        InsertSorted(dataElem);
       }
       if (! (tag < maxTag))
       {
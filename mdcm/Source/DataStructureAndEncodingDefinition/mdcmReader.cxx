@@ -20,6 +20,7 @@
 #include "mdcmSystem.h"
 #include "mdcmExplicitDataElement.h"
 #include "mdcmImplicitDataElement.h"
+#include "mdcmArena.h"
 #ifdef _MSC_VER
 #include <windows.h> // MultiByteToWideChar 
 #endif
@@ -38,6 +39,7 @@ Reader::Reader():F(new File)
 {
   Stream = NULL;
   Ifstream = NULL;
+  UseArena = false;
 }
 
 Reader::~Reader()
@@ -297,6 +299,18 @@ namespace details
 
     static void Check(bool , std::istream &)  {}
   };
+
+  // Current Arena for the duration of the read, Values hold their
+  // own references, so the Reader's one is released at the end.
+  class ReaderArena
+  {
+  private:
+    Arena * m_arena;
+    ArenaScope m_scope;
+  public:
+    ReaderArena(bool use) : m_arena(use ? Arena::New() : NULL), m_scope(m_arena) {}
+    ~ReaderArena() { if (m_arena) m_arena->Release(); }
+  };
 }
 
 bool Reader::Read()
@@ -331,6 +345,7 @@ bool Reader::InternalReadCommon(const T_Caller &caller)
     mdcmErrorMacro("No File");
     return false;
   }
+  details::ReaderArena arena(UseArena);
   bool success = true;
 
   try
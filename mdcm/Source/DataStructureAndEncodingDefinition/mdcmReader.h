@@ -97,6 +97,13 @@ public:
   /// Use native std::streampos / std::streamoff directly from the stream from C++
   size_t GetStreamCurrentPosition() const;
 
+  /// Allocate the Values of the DataSet from a single Arena, all memory
+  /// is released at once, when the last Value is gone. Useful for
+  /// large nested DataSets, e.g. Per-frame Functional Groups Sequence.
+  /// Default is false.
+  void SetUseArena(bool b) { UseArena = b; }
+  bool GetUseArena() const { return UseArena; }
+
 protected:
   bool ReadPreamble();
   bool ReadMetaInformation();
@@ -120,6 +127,7 @@ private:
   TransferSyntax GuessTransferSyntax();
   std::istream  * Stream;
   std::ifstream * Ifstream;
+  bool UseArena;
 };
 
 } // end namespace mdcm_ns
@@ -13,10 +13,34 @@
 =========================================================================*/
 #include "mdcmValue.h"
 #include "mdcmVL.h"
+#include "mdcmArena.h"
+#include <new>
 
 namespace mdcm_ns
 {
 
+// No header, the owning Arena is found from the address, so Values
+// allocated without an Arena have no overhead.
+void * Value::operator new(size_t n)
+{
+  Arena * a = Arena::GetCurrent();
+  if (a)
+  {
+    void * p = a->Allocate(n);
+    a->Acquire();
+    return p;
+  }
+  return ::operator new(n);
+}
+
+void Value::operator delete(void * ptr)
+{
+  if (!ptr) return;
+  Arena * a = Arena::Find(ptr);
+  if (a) a->Release();
+  else ::operator delete(ptr);
+}
+
 void Value::SetLengthOnly(VL l)
 {
   SetLength(l);
@@ -15,6 +15,7 @@
 #define MDCMVALUE_H
 
 #include "mdcmObject.h"
+#include <cstddef>
 
 namespace mdcm { class VL; }
 
@@ -40,6 +41,9 @@ public:
   virtual void SetLength(VL) = 0;
   virtual void Clear() = 0;
   virtual bool operator==(const Value &) const = 0;
+  /// Values are allocated from the current Arena, if any
+  static void * operator new(size_t);
+  static void operator delete(void *);
 
 protected:
   friend class DataElement;
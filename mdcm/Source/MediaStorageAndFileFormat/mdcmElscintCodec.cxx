@@ -0,0 +1,309 @@
+#include "mdcmElscintCodec.h"
+#include "mdcmDataSet.h"
+#include "mdcmDataElement.h"
+#include "mdcmByteValue.h"
+#include "mdcmPrivateTag.h"
+#include "mdcmAttribute.h"
+#include "mdcmTrace.h"
+#include <vector>
+#include <cstring>
+
+namespace mdcm
+{
+
+namespace
+{
+
+enum ElscintCompression
+{
+  ELSCINT_NONE = 0,
+  ELSCINT_RLE  = 1,
+  ELSCINT_RGB  = 2
+};
+
+ElscintCompression GetCompression(DataSet const & ds)
+{
+  const PrivateTag tcompressiontype(0x07a1,0x11,"ELSCINT1");
+  if(!ds.FindDataElement(tcompressiontype)) return ELSCINT_NONE;
+  const DataElement & compressiontype = ds.GetDataElement(tcompressiontype);
+  if(compressiontype.IsEmpty()) return ELSCINT_NONE;
+  const ByteValue * bv = compressiontype.GetByteValue();
+  if(!bv || bv->GetLength() < 10) return ELSCINT_NONE;
+  if(strncmp(bv->GetPointer(), "PMSCT_RLE1", 10) == 0) return ELSCINT_RLE;
+  if(strncmp(bv->GetPointer(), "PMSCT_RGB1", 10) == 0) return ELSCINT_RGB;
+  return ELSCINT_NONE;
+}
+
+// Byte source over the RLE layer, 0xa5 n v expands to n+1 times v
+struct RLEReader
+{
+  const unsigned char * p;
+  const unsigned char * end;
+  unsigned int run;
+  unsigned char value;
+
+  RLEReader(const unsigned char * b, const unsigned char * e)
+    : p(b), end(e), run(0), value(0) {}
+
+  inline bool Next(unsigned char & b)
+  {
+    if(run > 0)
+    {
+      --run;
+      b = value;
+      return true;
+    }
+    if(p >= end) return false;
+    if(*p == 0xa5)
+    {
+      if(end - p < 3)
+      {
+        p = end;
+        return false;
+      }
+      run = p[1];
+      value = p[2];
+      p += 3;
+      b = value;
+      return true;
+    }
+    b = *p++;
+    return true;
+  }
+};
+
+}
+
+bool ElscintCodec::IsElscint(DataSet const & ds)
+{
+  return (GetCompression(ds) != ELSCINT_NONE);
+}
+
+size_t ElscintCodec::DeltaDecode(
+  const char * in, size_t in_len,
+  unsigned short * out, size_t out_len)
+{
+  RLEReader r(
+    reinterpret_cast<const unsigned char*>(in),
+    reinterpret_cast<const unsigned char*>(in) + in_len);
+  unsigned short delta = 0;
+  size_t j = 0;
+  unsigned char b;
+  while(j < out_len)
+  {
+    // whole run of the same delta
+    if(r.run > 0 && r.value != 0x5a)
+    {
+      const short d = static_cast<signed char>(r.value);
+      size_t n = r.run;
+      if(n > out_len - j) n = out_len - j;
+      r.run -= static_cast<unsigned int>(n);
+      for(size_t k = 0; k < n; ++k)
+      {
+        delta = static_cast<unsigned short>(delta + d);
+        out[j++] = delta;
+      }
+      continue;
+    }
+    if(!r.Next(b)) break;
+    if(b == 0x5a)
+    {
+      // absolute value, little endian
+      unsigned char v1, v2;
+      if(!r.Next(v1) || !r.Next(v2)) break;
+      delta = static_cast<unsigned short>(v2 * 256 + v1);
+    }
+    else
+    {
+      delta = static_cast<unsigned short>(
+        delta + static_cast<signed char>(b));
+    }
+    out[j++] = delta;
+  }
+  if(j < out_len)
+  {
+    memset(out + j, 0, (out_len - j) * sizeof(unsigned short));
+  }
+  return j;
+}
+
+bool ElscintCodec::DeltaDecodeRGB(
+  const unsigned char * in, size_t in_len,
+  unsigned char * out,
+  unsigned short pc, size_t w, size_t h)
+{
+  enum
+  {
+    COLORMODE  = 0x81,
+    ESCMODE    = 0x82,
+    REPEATMODE = 0x83
+  };
+  const size_t plane_size = w * h;
+  memset(out, 0, 3 * plane_size);
+  const unsigned char * src = in;
+  const unsigned char * const end = in + in_len;
+  unsigned char * dest = out;
+  // Algorithm works with both planar configurations.
+  size_t dx = 1;
+  size_t dy = 3;
+  if(pc)
+  {
+    dx = plane_size;
+    dy = 1;
+  }
+  unsigned char gray = 0;
+  unsigned char rgb[3] = { 0, 0, 0 };
+  // Start in grayscale mode
+  bool graymode = true;
+  size_t ps = plane_size;
+  while(ps)
+  {
+    if(src >= end) return false;
+    unsigned char c = *src++;
+    switch(c)
+    {
+    case COLORMODE:
+      // The stream contains an intermixed compression of RGB codec and
+      // GRAY codec. Each one not knowing of the other reset old value to 0.
+      graymode = !graymode;
+      gray = 0;
+      rgb[0] = rgb[1] = rgb[2] = 0;
+      break;
+    case REPEATMODE:
+      {
+        // Repeat mode (RLE)
+        if(src >= end) return false;
+        size_t n = *src++;
+        if(n > ps) n = ps;
+        ps -= n;
+        const unsigned char c0 = graymode ? gray : rgb[0];
+        const unsigned char c1 = graymode ? gray : rgb[1];
+        const unsigned char c2 = graymode ? gray : rgb[2];
+        while(n-- > 0)
+        {
+          dest[0]      = c0;
+          dest[dx]     = c1;
+          dest[2 * dx] = c2;
+          dest += dy;
+        }
+      }
+      break;
+    case ESCMODE:
+      // Used to treat a byte 81/82/83 as a normal byte
+      if(src >= end) return false;
+      c = *src++;
+      // fall through
+    default:
+      if(graymode)
+      {
+        gray += c;
+        dest[0]      = gray;
+        dest[dx]     = gray;
+        dest[2 * dx] = gray;
+      }
+      else
+      {
+        if(end - src < 2) return false;
+        rgb[0] += c;
+        rgb[1] += *src++;
+        rgb[2] += *src++;
+        dest[0]      = rgb[0];
+        dest[dx]     = rgb[1];
+        dest[2 * dx] = rgb[2];
+      }
+      dest += dy;
+      ps--;
+      break;
+    }
+  }
+  return true;
+}
+
+bool ElscintCodec::Decode(DataSet & ds)
+{
+  const ElscintCompression compression = GetCompression(ds);
+  if(compression == ELSCINT_NONE) return false;
+  const Tag tpixeldata(0x7fe0, 0x0010);
+  const PrivateTag tprivatepixeldata(0x07a1,0x0a,"ELSCINT1");
+  const bool private_pixeldata = ds.FindDataElement(tprivatepixeldata);
+  if(!private_pixeldata && !ds.FindDataElement(tpixeldata)) return false;
+  DataElement pixeldata(tpixeldata, 0, VR::OW);
+  {
+    const DataElement & compressed = private_pixeldata
+      ? ds.GetDataElement(tprivatepixeldata)
+      : ds.GetDataElement(tpixeldata);
+    if(compressed.IsEmpty()) return false;
+    const ByteValue * bv = compressed.GetByteValue();
+    if(!bv) return false;
+    Attribute<0x0028,0x0010> rows;
+    rows.SetFromDataSet(ds);
+    Attribute<0x0028,0x0011> columns;
+    columns.SetFromDataSet(ds);
+    const size_t w = rows.GetValue();
+    const size_t h = columns.GetValue();
+    if(w < 1 || h < 1) return false;
+    const size_t len = bv->GetLength();
+    if(compression == ELSCINT_RLE)
+    {
+      const size_t out_len = w * h;
+      if(len == out_len * sizeof(unsigned short))
+      {
+        mdcmWarningMacro("Elscint data seems to be not compressed");
+        if(!private_pixeldata) return true;
+        pixeldata.SetByteValue(bv->GetPointer(), bv->GetLength());
+      }
+      else
+      {
+        std::vector<unsigned short> buffer(out_len);
+        const size_t n =
+          DeltaDecode(bv->GetPointer(), len, &buffer[0], out_len);
+        if(n < 1) return false;
+        if(n < out_len)
+        {
+          mdcmWarningMacro("Elscint data is truncated");
+        }
+        pixeldata.SetByteValue(
+          reinterpret_cast<char*>(&buffer[0]),
+          static_cast<uint32_t>(out_len * sizeof(unsigned short)));
+      }
+    }
+    else
+    {
+      Attribute<0x0028,0x0006> pc;
+      pc.SetFromDataSet(ds);
+      const size_t out_len = 3 * w * h;
+      if(len == out_len)
+      {
+        mdcmWarningMacro("Elscint data seems to be not compressed");
+        if(!private_pixeldata) return true;
+        pixeldata.SetByteValue(bv->GetPointer(), bv->GetLength());
+      }
+      else
+      {
+        std::vector<unsigned char> buffer(out_len);
+        if(!DeltaDecodeRGB(
+          reinterpret_cast<const unsigned char*>(bv->GetPointer()),
+          len, &buffer[0], pc.GetValue(), w, h))
+        {
+          mdcmWarningMacro("Elscint data is truncated");
+        }
+        pixeldata.SetByteValue(
+          reinterpret_cast<char*>(&buffer[0]),
+          static_cast<uint32_t>(out_len));
+      }
+    }
+  }
+  ds.Replace(pixeldata);
+  if(ds.FindDataElement(Tag(0x07a1,0x0010)))
+  {
+    ds.Remove(Tag(0x07a1,0x0010));
+    if(private_pixeldata) ds.Remove(Tag(0x07a1,0x100a));
+    ds.Remove(Tag(0x07a1,0x1010));
+    ds.Remove(Tag(0x07a1,0x1011));
+  }
+  ds.Remove(Tag(0x7fe0,0x0000));
+  ds.Remove(Tag(0xfffc,0xfffc));
+  return true;
+}
+
+} // end namespace mdcm
@@ -0,0 +1,38 @@
+#ifndef MDCMELSCINTCODEC_H
+#define MDCMELSCINTCODEC_H
+
+#include "mdcmTypes.h"
+#include <cstddef>
+
+namespace mdcm
+{
+
+class DataSet;
+/**
+ * \brief ElscintCodec class
+ * \details Decodes ELSCINT1 private compression (PMSCT_RLE1, PMSCT_RGB1).
+ * Compression is not a Transfer Syntax, the codec works on the data set:
+ * compressed pixels are replaced with uncompressed OW Pixel Data and
+ * the private compression elements are removed.
+ */
+class MDCM_EXPORT ElscintCodec
+{
+public:
+  ElscintCodec() {}
+  ~ElscintCodec() {}
+  static bool IsElscint(DataSet const &);
+  bool Decode(DataSet &);
+  // RLE + delta decoding, returns number of pixels written to 'out'
+  static size_t DeltaDecode(
+    const char * in, size_t in_len,
+    unsigned short * out, size_t out_len);
+  // Returns false if the input is truncated
+  static bool DeltaDecodeRGB(
+    const unsigned char * in, size_t in_len,
+    unsigned char * out,
+    unsigned short pc, size_t w, size_t h);
+};
+
+} // end namespace mdcm
+
+#endif //MDCMELSCINTCODEC_H
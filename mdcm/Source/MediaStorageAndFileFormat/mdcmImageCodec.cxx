@@ -20,6 +20,8 @@
 #include <iomanip>
 #include <iterator>
 #include <cstring>
+#include <vector>
+#include <new>
 #include <limits.h>
 
 namespace mdcm
@@ -332,46 +334,179 @@ bool ImageCodec::DoInvertMonochrome(std::istream & is, std::ostream & os)
   return true;
 }
 
+// One pass kernels for 16 bits pixels, the loops have no branches
+// and no aliasing between input and output, so that compilers can
+// vectorize them. 't' is the shift of the high bit, 'd' the number of
+// unused bits, signed values are sign extended from the high bit.
+
+template<bool TSigned>
+static inline uint16_t CleanupValue16(uint16_t c, unsigned int t, unsigned int d)
+{
+  c = (uint16_t)(c >> t);
+  c = (uint16_t)(c << d);
+  if(TSigned) return (uint16_t)((int16_t)c >> d);
+  return (uint16_t)(c >> d);
+}
+
+template<bool TSigned>
+static void CleanupUnusedBits16(uint16_t * p, size_t n, unsigned int t, unsigned int d)
+{
+  for(size_t i = 0; i < n; ++i)
+  {
+    p[i] = CleanupValue16<TSigned>(p[i], t, d);
+  }
+}
+
+// byte swap and unused bits
+template<bool TSigned>
+static void ByteSwapCleanupUnusedBits16(uint16_t * p, size_t n, unsigned int t, unsigned int d)
+{
+  for(size_t i = 0; i < n; ++i)
+  {
+    const uint16_t c = (uint16_t)((p[i] >> 8) | (p[i] << 8));
+    p[i] = CleanupValue16<TSigned>(c, t, d);
+  }
+}
+
+// padded composite pixel code (most significant bytes first, then the
+// least significant) and unused bits, the value does not depend on the
+// byte order of the system
+template<bool TSigned, bool TCleanup>
+static void PaddedCompositeCleanupUnusedBits16(
+  const unsigned char * s, uint16_t * p, size_t n, unsigned int t, unsigned int d)
+{
+  const unsigned char * hi = s;
+  const unsigned char * lo = s + n;
+  for(size_t i = 0; i < n; ++i)
+  {
+    const uint16_t c = (uint16_t)((hi[i] << 8) | lo[i]);
+    p[i] = TCleanup ? CleanupValue16<TSigned>(c, t, d) : c;
+  }
+}
+
+// In place versions of the above, used by DecodeByBuffer
+
+bool ImageCodec::DoByteSwap(char * data, size_t len)
+{
+  if(len % 2) return false;
+#ifdef MDCM_WORDS_BIGENDIAN
+  if(PF.GetBitsAllocated() == 16)
+  {
+    ByteSwap<uint16_t>::SwapRangeFromSwapCodeIntoSystem((uint16_t*)
+      data, SwapCode::LittleEndian, len/2);
+  }
+#else
+  if (PF.GetBitsAllocated() == 16)
+  {
+    ByteSwap<uint16_t>::SwapRangeFromSwapCodeIntoSystem((uint16_t*)
+      data, SwapCode::BigEndian, len/2);
+  }
+#endif
+  return true;
+}
+
+// 'data' must hold len * 3 / 2 bytes, the buffer is processed
+// from the end, so the output never overwrites unread input
+bool ImageCodec::DoYBRFull422(char * data, size_t len)
+{
+  if (len % 2 != 0) return false;
+  const size_t rgb_len = len * 3 / 2;
+  if (rgb_len % 3 != 0) return false;
+  unsigned char * buffer = (unsigned char*)data;
+  const size_t size = len/4;
+  if (rgb_len > size * 6)
+  {
+    memset(buffer + size * 6, 0, rgb_len - size * 6);
+  }
+  for (size_t j = size; j > 0; --j)
+  {
+    const unsigned char * ybr422 = buffer + 4 * (j - 1);
+    const unsigned char y0 = ybr422[0];
+    const unsigned char y1 = ybr422[1];
+    const unsigned char cb = ybr422[2];
+    const unsigned char cr = ybr422[3];
+    unsigned char * ybr = buffer + 6 * (j - 1);
+    ybr[0] = y0;
+    ybr[1] = cb;
+    ybr[2] = cr;
+    ybr[3] = y1;
+    ybr[4] = cb;
+    ybr[5] = cr;
+  }
+  return true;
+}
+
+bool ImageCodec::DoPlanarConfiguration(char * data, size_t len)
+{
+  if (len % 3 != 0) return false;
+  const size_t size = len/3;
+  std::vector<char> copy;
+  try { copy.assign(data, data + len); }
+  catch (std::bad_alloc&) { return false; }
+  const char * r = &copy[0];
+  const char * g = r + size;
+  const char * b = g + size;
+  char * p = data;
+  for (size_t j = 0; j < size; ++j)
+  {
+    *(p++) = *(r++);
+    *(p++) = *(g++);
+    *(p++) = *(b++);
+  }
+  return true;
+}
+
+bool ImageCodec::DoPaddedCompositePixelCode(char * data, size_t len)
+{
+  if (len % 2) return false;
+  const unsigned short ba = GetPixelFormat().GetBitsAllocated();
+  if (ba != 16 && ba != 32) return false;
+  std::vector<char> copy;
+  try { copy.assign(data, data + len); }
+  catch (std::bad_alloc&) { return false; }
+  const char * s = &copy[0];
+  char * p = data;
+  if (ba == 16)
+  {
+    PaddedCompositeCleanupUnusedBits16<false, false>(
+      (const unsigned char*)s, (uint16_t*)data, len/2, 0, 0);
+  }
+  else
+  {
+    if (len % 4) return false;
+    const size_t n = len/4;
+    for (size_t i = 0; i < n; ++i)
+    {
+#ifdef MDCM_WORDS_BIGENDIAN
+      *(p++) = s[i];
+      *(p++) = s[i+1*n];
+      *(p++) = s[i+2*n];
+      *(p++) = s[i+3*n];
+#else
+      *(p++) = s[i+3*n];
+      *(p++) = s[i+2*n];
+      *(p++) = s[i+1*n];
+      *(p++) = s[i];
+#endif
+    }
+  }
+  return true;
+}
+
 bool ImageCodec::CleanupUnusedBits(char * data, size_t datalen)
 {
   if(!NeedOverlayCleanup) return true;
   if(PF.GetBitsAllocated() == 16)
   {
-    const uint16_t d = PF.GetBitsAllocated() - PF.GetBitsStored();
-    const uint16_t t = PF.GetBitsStored() - PF.GetHighBit() - 1;
-    // mask unused bits
-    const uint16_t pmask = (uint16_t)(0xffff >> d);
+    const unsigned int d = PF.GetBitsAllocated() - PF.GetBitsStored();
+    const unsigned int t = PF.GetBitsStored() - PF.GetHighBit() - 1;
     if(PF.GetPixelRepresentation() == 1)
     {
-      // check sign
-      const uint16_t smask = (uint16_t)(0x0001 << (16 - (d + 1)));
-      // propagate sign bit on negative values
-      const int16_t nmask = (int16_t)(0x8000 >> (d - 1));
-      uint16_t * start = (uint16_t*)data;
-      for(uint16_t * p = start; p != start + datalen / 2; ++p)
-      {
-        uint16_t c = *p;
-        c = c >> t;
-        if (c & smask)
-        {
-          c = (uint16_t)(c | nmask);
-        }
-        else
-        {
-          c = c & pmask;
-        }
-        *p = c;
-      }
+      CleanupUnusedBits16<true>((uint16_t*)data, datalen / 2, t, d);
     }
-    else // unsigned
+    else
     {
-      uint16_t * start = (uint16_t*)data;
-      for(uint16_t * p = start; p != start + datalen / 2; ++p)
-      {
-        uint16_t c = *p;
-        c = (uint16_t)((c >> t) & pmask);
-        *p = c;
-      }
+      CleanupUnusedBits16<false>((uint16_t*)data, datalen / 2, t, d);
     }
   }
   else
@@ -386,55 +521,19 @@ bool ImageCodec::DoOverlayCleanup(std::istream &is, std::ostream &os)
 {
   if(PF.GetBitsAllocated() == 16)
   {
-    const uint16_t d = PF.GetBitsAllocated() - PF.GetBitsStored();
-    const uint16_t t = PF.GetBitsStored() - PF.GetHighBit() - 1;
-    // mask unused bits
-    const uint16_t pmask = (uint16_t)(0xffff >> d);
+    const unsigned int d = PF.GetBitsAllocated() - PF.GetBitsStored();
+    const unsigned int t = PF.GetBitsStored() - PF.GetHighBit() - 1;
+    const bool sgn = (PF.GetPixelRepresentation() == 1);
     const size_t s16 = sizeof(uint16_t);
     const size_t bsize = 1000;
-    if(PF.GetPixelRepresentation() == 1)
+    std::vector<uint16_t> b(bsize);
+    while(is)
     {
-      // check sign
-      const uint16_t smask = (uint16_t)(0x0001 << (16 - (d + 1)));
-      // propagate sign bit on negative values
-      const int16_t nmask = (int16_t)(0x8000 >> (d - 1));
-      std::vector<uint16_t> b(bsize);
-      while(is)
-      {
-        is.read((char*)&b[0], bsize * s16);
-        std::streamsize read = is.gcount();
-        std::vector<uint16_t>::iterator bend = b.begin() + read / s16;
-        for (std::vector<uint16_t>::iterator it = b.begin(); it != bend; ++it)
-        {
-          uint16_t c = (*it) >> t;
-          if (c & smask)
-          {
-            c = (uint16_t)(c | nmask);
-          }
-          else
-          {
-            c = c & pmask;
-          }
-          *it = c;
-        }
-        os.write((char*)&b[0], read);
-      }
-    }
-    else // unsigned
-    {
-      std::vector<uint16_t> b(bsize);
-      while(is)
-      {
-        is.read((char*)&b[0], bsize * s16);
-        std::streamsize rs = is.gcount();
-        std::vector<uint16_t>::iterator bend = b.begin() + rs / s16;
-        for (std::vector<uint16_t>::iterator it = b.begin(); it != bend; ++it)
-        {
-          const uint16_t c = ((*it) >> t) & pmask;
-          *it = c;
-        }
-        os.write((char*)&b[0], rs);
-      }
+      is.read((char*)&b[0], bsize * s16);
+      const std::streamsize rs = is.gcount();
+      if(sgn) CleanupUnusedBits16<true>(&b[0], (size_t)rs / s16, t, d);
+      else    CleanupUnusedBits16<false>(&b[0], (size_t)rs / s16, t, d);
+      os.write((char*)&b[0], rs);
     }
   }
   else
@@ -530,6 +629,122 @@ bool ImageCodec::DecodeByStreams(std::istream &is, std::ostream &os)
   return true;
 }
 
+size_t ImageCodec::GetDecodedLength(size_t len) const
+{
+  if (PI == PhotometricInterpretation::YBR_FULL_422 &&
+      !dynamic_cast<const JPEGCodec*>(this))
+  {
+    return len * 3 / 2;
+  }
+  return len;
+}
+
+bool ImageCodec::DecodeByBuffer(char * data, size_t & len, size_t capacity)
+{
+  assert(PlanarConfiguration == 0 || PlanarConfiguration == 1);
+  assert(PI != PhotometricInterpretation::UNKNOWN);
+  if (!data || len > capacity) return false;
+  // The unused bits of 16 bits pixels are cleaned up in the same pass
+  // as the byte swap or the padded composite pixel code, if samples
+  // are not reordered later.
+  const bool expand422 =
+    PI == PhotometricInterpretation::YBR_FULL_422 &&
+    !dynamic_cast<const JPEGCodec*>(this);
+  bool cleanup =
+    NeedOverlayCleanup &&
+    PF.GetBitsAllocated() != PF.GetBitsStored() &&
+    PF.GetBitsAllocated() != 8;
+  const bool fuse =
+    cleanup &&
+    PF.GetBitsAllocated() == 16 &&
+    !RequestPlanarConfiguration &&
+    !expand422 &&
+    len % 2 == 0;
+  const unsigned int d = PF.GetBitsAllocated() - PF.GetBitsStored();
+  const unsigned int t = PF.GetBitsStored() - PF.GetHighBit() - 1;
+  const bool sgn = (PF.GetPixelRepresentation() == 1);
+  // Byte swap
+  if(NeedByteSwap)
+  {
+    if (fuse && !RequestPaddedCompositePixelCode)
+    {
+      if (sgn) ByteSwapCleanupUnusedBits16<true>((uint16_t*)data, len/2, t, d);
+      else     ByteSwapCleanupUnusedBits16<false>((uint16_t*)data, len/2, t, d);
+      cleanup = false;
+    }
+    else if (!DoByteSwap(data, len))
+    {
+      return false;
+    }
+  }
+  if (RequestPaddedCompositePixelCode)
+  {
+    if (fuse && cleanup)
+    {
+      std::vector<unsigned char> copy;
+      try { copy.assign(data, data + len); }
+      catch (std::bad_alloc&) { return false; }
+      if (sgn)
+      {
+        PaddedCompositeCleanupUnusedBits16<true, true>(
+          &copy[0], (uint16_t*)data, len/2, t, d);
+      }
+      else
+      {
+        PaddedCompositeCleanupUnusedBits16<false, true>(
+          &copy[0], (uint16_t*)data, len/2, t, d);
+      }
+      cleanup = false;
+    }
+    else if (!DoPaddedCompositePixelCode(data, len))
+    {
+      return false;
+    }
+  }
+  switch(PI)
+  {
+  case PhotometricInterpretation::MONOCHROME2:
+  case PhotometricInterpretation::RGB:
+  case PhotometricInterpretation::ARGB:
+  case PhotometricInterpretation::YBR_ICT:
+  case PhotometricInterpretation::YBR_RCT:
+  case PhotometricInterpretation::MONOCHROME1:
+  case PhotometricInterpretation::PALETTE_COLOR:
+  case PhotometricInterpretation::YBR_FULL:
+    break;
+  case PhotometricInterpretation::YBR_FULL_422:
+    if(expand422)
+    {
+      // try raw/YBR_FULL_422
+      const size_t rgb_len = len * 3 / 2;
+      if (rgb_len > capacity) return false;
+      if (!DoYBRFull422(data, len)) return false;
+      len = rgb_len;
+    }
+    break;
+  case PhotometricInterpretation::YBR_PARTIAL_422: // retired
+  case PhotometricInterpretation::YBR_PARTIAL_420: // not supported
+    { // try JPEG
+      const JPEGCodec * c = dynamic_cast<const JPEGCodec*>(this);
+      if(!c) return false;
+    }
+    break;
+  default:
+    mdcmErrorMacro("Unhandled PhotometricInterpretation: " << PI);
+    return false;
+  }
+  if(RequestPlanarConfiguration)
+  {
+    if (!DoPlanarConfiguration(data, len)) return false;
+  }
+  // Overlay cleanup or cleanup the unused bits
+  if (cleanup)
+  {
+    if (!CleanupUnusedBits(data, len)) return false;
+  }
+  return true;
+}
+
 bool ImageCodec::IsValid(PhotometricInterpretation const &)
 {
   return false;
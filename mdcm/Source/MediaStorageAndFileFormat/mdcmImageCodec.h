@@ -44,6 +44,11 @@ public:
 protected:
 
   bool DecodeByStreams(std::istream & is_, std::ostream & os);
+  // Same steps as DecodeByStreams, but done in place, 'len' is the size
+  // of the decoded data and is updated, 'capacity' is the size of the
+  // buffer, see GetDecodedLength.
+  bool DecodeByBuffer(char * data, size_t & len, size_t capacity);
+  size_t GetDecodedLength(size_t len) const;
   virtual bool IsValid(PhotometricInterpretation const & pi);
 public:
 
@@ -144,6 +149,10 @@ protected:
   bool DoSimpleCopy(std::istream &is_, std::ostream & os);
   bool DoPaddedCompositePixelCode(std::istream &, std::ostream &);
   bool DoInvertMonochrome(std::istream &, std::ostream &);
+  bool DoByteSwap(char *, size_t);
+  bool DoYBRFull422(char *, size_t);
+  bool DoPlanarConfiguration(char *, size_t);
+  bool DoPaddedCompositePixelCode(char *, size_t);
 };
 
 } // end namespace mdcm
@@ -21,6 +21,7 @@
 #include <cstring>
 #include <cstdio>
 #include <numeric>
+#include <atomic>
 #ifdef _WIN32
 #define snprintf _snprintf
 #endif
@@ -435,13 +436,28 @@ void JPEG2000Codec::SetReversible(bool res)
   Internals->coder_param.irreversible = !res;
 }
 
+// Set from the GUI thread, read by loader threads
+static std::atomic<int> MaxNumberOfThreads(0);
+
+void JPEG2000Codec::SetMaxNumberOfThreads(int x)
+{
+  MaxNumberOfThreads.store((x > 0) ? x : 0);
+}
+
+int JPEG2000Codec::GetMaxNumberOfThreads()
+{
+  return MaxNumberOfThreads.load();
+}
+
 JPEG2000Codec::JPEG2000Codec()
 {
   Internals = new JPEG2000Internals;
 #if (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 3)
   if (opj_has_thread_support())
   {
-    const int x = opj_get_num_cpus();
+    int x = opj_get_num_cpus();
+    const int max_threads = MaxNumberOfThreads.load();
+    if (max_threads > 0 && max_threads < x) x = max_threads;
     Internals->nNumberOfThreadsForDecompression = (x == 1) ? 0 : x;
   }
 #endif
@@ -508,19 +524,17 @@ bool JPEG2000Codec::Decode(DataElement const &in, DataElement &out)
       sf = &*sf_bug;
     }
     if(!sf) return false;
-    std::stringstream is;
-    unsigned long long totalLen = sf->ComputeByteLength();
-    char *buffer = new char[totalLen];
-    sf->GetBuffer(buffer, totalLen);
-    is.write(buffer, totalLen);
-    delete[] buffer;
-    std::stringstream os;
-    bool r = DecodeByStreams(is, os);
-    if(!r) return false;
+    const size_t totalLen = (size_t)sf->ComputeByteLength();
+    if(totalLen < 1) return false;
+    std::vector<char> buffer(totalLen);
+    sf->GetBuffer(&buffer[0], totalLen);
+    std::vector<char> raw;
+    if(!DecodeFrame(&buffer[0], totalLen, raw)) return false;
     out = in;
-    std::string str = os.str();
-    out.SetByteValue(&str[0], (uint32_t)str.size());
-    return r;
+    ByteValue *bv = new ByteValue;
+    bv->SwapBuffer(raw);
+    out.SetValue(*bv);
+    return true;
   }
   else if (NumberOfDimensions == 3)
   {
@@ -532,31 +546,27 @@ bool JPEG2000Codec::Decode(DataElement const &in, DataElement &out)
      */
     const SequenceOfFragments *sf = in.GetSequenceOfFragments();
     if(!sf) return false;
-    std::stringstream os;
     if(sf->GetNumberOfFragments() != Dimensions[2])
     {
       mdcmErrorMacro("Not handled");
       return false;
     }
+    std::vector<char> buffer;
+    std::vector<char> raw;
     for(unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i)
     {
-      std::stringstream is;
       const Fragment &frag = sf->GetFragment(i);
       if(frag.IsEmpty()) return false;
       const ByteValue *bv = frag.GetByteValue();
       if(!bv) return false;
-      size_t bv_len = bv->GetLength();
-      char *mybuffer = new char[bv_len];
-      bv->GetBuffer(mybuffer, bv->GetLength());
-      is.write(mybuffer, bv->GetLength());
-      delete[] mybuffer;
-      bool r = DecodeByStreams(is, os);
+      buffer.assign(bv->GetPointer(), bv->GetPointer() + bv->GetLength());
+      bool r = DecodeFrame(&buffer[0], buffer.size(), raw);
       if(!r) return false;
-      assert(r == true);
     }
-    std::string str = os.str();
-    assert(str.size());
-    out.SetByteValue(&str[0], (uint32_t)str.size());
+    assert(raw.size());
+    ByteValue *obv = new ByteValue;
+    obv->SwapBuffer(raw);
+    out.SetValue(*obv);
     return true;
   }
   return false;
@@ -585,9 +595,14 @@ static inline bool check_comp_valid(opj_image_t *image)
   return !invalid;
 }
 
+// If 'out' is not NULL and 'out_len' is large enough the pixels are
+// written to 'out', otherwise in a new buffer, the caller has to
+// delete[] the returned pointer if it is not 'out'.
 std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(
   char *dummy_buffer,
-  size_t buf_size)
+  size_t buf_size,
+  char *out,
+  size_t out_len)
 {
   opj_dparameters_t parameters; // decompression parameters
   opj_codec_t* dinfo = NULL; // handle to a decompressor
@@ -742,7 +757,7 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(
   /* close the byte stream */
   opj_stream_destroy(cio);
   unsigned long long len = Dimensions[0]*Dimensions[1] * (PF.GetBitsAllocated() / 8) * image->numcomps;
-  char * raw = new char[len];
+  char * raw = (out && out_len >= len) ? out : new char[len];
   for (unsigned int compno = 0; compno < (unsigned int)image->numcomps; compno++)
   {
     opj_image_comp_t *comp = &image->comps[compno];
@@ -831,6 +846,40 @@ bool JPEG2000Codec::DecodeByStreams(std::istream &is, std::ostream &os)
   return true;
 }
 
+// Decodes one frame and appends it to 'out'
+bool JPEG2000Codec::DecodeFrame(char *buffer, size_t buf_size, std::vector<char> &out)
+{
+  if(!buffer || buf_size < 1) return false;
+  const size_t len =
+    (size_t)Dimensions[0] * Dimensions[1] *
+    (PF.GetBitsAllocated() / 8) * PF.GetSamplesPerPixel();
+  const size_t pos = out.size();
+  if(pos == 0 && NumberOfDimensions == 3 && Dimensions[2] > 1)
+  {
+    out.reserve(len * Dimensions[2]);
+  }
+  out.resize(pos + len);
+  std::pair<char*,size_t> raw_len =
+    this->DecodeByStreamsCommon(buffer, buf_size, (len > 0 ? &out[pos] : NULL), len);
+  if(!raw_len.first || !raw_len.second)
+  {
+    out.resize(pos);
+    return false;
+  }
+  if(raw_len.first != &out[pos])
+  {
+    // number of components differs from the header
+    out.resize(pos + raw_len.second);
+    memcpy(&out[pos], raw_len.first, raw_len.second);
+    delete[] raw_len.first;
+  }
+  else if(raw_len.second != len)
+  {
+    out.resize(pos + raw_len.second);
+  }
+  return true;
+}
+
 template<typename T>
 void rawtoimage_fill2(
   const T * inputbuffer,
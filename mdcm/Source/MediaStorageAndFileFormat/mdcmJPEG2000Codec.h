@@ -47,6 +47,10 @@ public:
   void SetTileSize(unsigned int, unsigned int);
   void SetNumberOfResolutions(unsigned int);
   void SetReversible(bool);
+  // Limit of decoder threads for all codecs created later,
+  // 0 - number of processors
+  static void SetMaxNumberOfThreads(int);
+  static int GetMaxNumberOfThreads();
 
 protected:
   bool DecodeExtent(
@@ -64,7 +68,8 @@ protected:
   bool StopEncode(std::ostream &);
 
 private:
-  std::pair<char *, size_t> DecodeByStreamsCommon(char *, size_t);
+  std::pair<char *, size_t> DecodeByStreamsCommon(char *, size_t, char * = NULL, size_t = 0);
+  bool DecodeFrame(char *, size_t, std::vector<char> &);
   bool CodeFrameIntoBuffer(char *, size_t, size_t &, const char *, size_t);
   bool GetHeaderInfo(const char *, size_t, TransferSyntax &);
   JPEG2000Internals * Internals;
@@ -167,25 +167,70 @@ bool JPEGLSCodec::DecodeByStreamsCommon(char *buffer, size_t totalLen, std::vect
   return true;
 }
 
-bool JPEGLSCodec::Decode(DataElement const &in, DataElement &out)
+// Decodes one frame and appends it to 'out', without temporary copies
+bool JPEGLSCodec::DecodeFrame(const char *buffer, size_t totalLen, std::vector<char> &out)
 {
   using namespace charls;
+  const unsigned char* pbyteCompressed = (const unsigned char*)buffer;
+  size_t cbyteCompressed = totalLen;
+
+  JlsParameters params = {};
+  if(JpegLsReadHeader(pbyteCompressed, cbyteCompressed, &params, NULL) != ApiResult::OK )
+    {
+    mdcmDebugMacro( "Could not parse JPEG-LS header" );
+    return false;
+    }
+
+  // allowedlossyerror == 0 => Lossless
+  LossyFlag = params.allowedLossyError!= 0;
+
+  const size_t len = (size_t)params.height * params.width * ((params.bitsPerSample + 7) / 8) * params.components;
+  if( len < 1 ) return false;
+  const size_t pos = out.size();
+  if( pos == 0 && NumberOfDimensions == 3 && Dimensions[2] > 1 )
+    {
+    out.reserve( len * Dimensions[2] );
+    }
+  out.resize( pos + len );
+
+  ApiResult result = JpegLsDecode(&out[pos], len, pbyteCompressed, cbyteCompressed, &params, NULL);
+
+  if (result != ApiResult::OK)
+    {
+    mdcmErrorMacro( "Could not decode JPEG-LS stream" );
+    return false;
+    }
+
+  return true;
+}
+
+bool JPEGLSCodec::Decode(DataElement const &in, DataElement &out)
+{
   if( NumberOfDimensions == 2 )
     {
     const SequenceOfFragments *sf = in.GetSequenceOfFragments();
     if (!sf) return false;
-    size_t totalLen = sf->ComputeByteLength();
-    char *buffer = new char[totalLen];
-    sf->GetBuffer(buffer, totalLen);
-
-    std::vector<unsigned char> rgbyteOut;
-    bool b = DecodeByStreamsCommon(buffer, totalLen, rgbyteOut);
-    if( !b ) return false;
-    delete[] buffer;
+    std::vector<char> rgbyteOut;
+    if( sf->GetNumberOfFragments() == 1 )
+      {
+      const ByteValue *bv = sf->GetFragment(0).GetByteValue();
+      if (!bv) return false;
+      if( !DecodeFrame(bv->GetPointer(), bv->GetLength(), rgbyteOut) ) return false;
+      }
+    else
+      {
+      size_t totalLen = (size_t)sf->ComputeByteLength();
+      if( totalLen < 1 ) return false;
+      std::vector<char> buffer(totalLen);
+      sf->GetBuffer(&buffer[0], totalLen);
+      if( !DecodeFrame(&buffer[0], totalLen, rgbyteOut) ) return false;
+      }
 
     out = in;
 
-    out.SetByteValue( (char*)&rgbyteOut[0], (uint32_t)rgbyteOut.size() );
+    ByteValue *obv = new ByteValue;
+    obv->SwapBuffer( rgbyteOut );
+    out.SetValue( *obv );
     return true;
     }
   else if( NumberOfDimensions == 3 )
@@ -193,7 +238,7 @@ bool JPEGLSCodec::Decode(DataElement const &in, DataElement &out)
     const SequenceOfFragments *sf = in.GetSequenceOfFragments();
     if (!sf) return false;
     if (sf->GetNumberOfFragments() != Dimensions[2]) return false;
-    std::stringstream os;
+    std::vector<char> rgbyteOut;
     for(unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i)
       {
       const Fragment &frag = sf->GetFragment(i);
@@ -201,11 +246,8 @@ bool JPEGLSCodec::Decode(DataElement const &in, DataElement &out)
       const ByteValue *bv = frag.GetByteValue();
       if (!bv) return false;
       size_t totalLen = bv->GetLength();
-      char *mybuffer = new char[totalLen];
 
-      bv->GetBuffer(mybuffer, bv->GetLength());
-
-      const unsigned char* pbyteCompressed = (const unsigned char*)mybuffer;
+      const unsigned char* pbyteCompressed = (const unsigned char*)bv->GetPointer();
       while( totalLen > 0 && pbyteCompressed[totalLen-1] != 0xd9 )
         {
         totalLen--;
@@ -213,37 +255,13 @@ bool JPEGLSCodec::Decode(DataElement const &in, DataElement &out)
       // what if 0xd9 is never found ?
       assert( totalLen > 0 && pbyteCompressed[totalLen-1] == 0xd9 );
 
-      size_t cbyteCompressed = totalLen;
-
-      JlsParameters params = {};
-      if( JpegLsReadHeader(pbyteCompressed, cbyteCompressed, &params, NULL) != ApiResult::OK )
-        {
-        mdcmDebugMacro( "Could not parse JPEG-LS header" );
-        return false;
-        }
-
-      // allowedlossyerror == 0 => Lossless
-      LossyFlag = params.allowedLossyError!= 0;
-
-      std::vector<unsigned char> rgbyteOut;
-      rgbyteOut.resize(params.height *params.width * ((params.bitsPerSample + 7) / 8) * params.components);
-
-      ApiResult result = JpegLsDecode(&rgbyteOut[0], rgbyteOut.size(), pbyteCompressed, cbyteCompressed, &params, NULL);
-      bool r = true;
-
-      delete[] mybuffer;
-      if (result != ApiResult::OK)
-        {
-        return false;
-        }
-      os.write( (const char*)&rgbyteOut[0], rgbyteOut.size() );
-
-      if(!r) return false;
-      assert( r == true );
+      if( !DecodeFrame(bv->GetPointer(), totalLen, rgbyteOut) ) return false;
       }
-    std::string str = os.str();
-    assert( str.size() );
-    out.SetByteValue( &str[0], (uint32_t)str.size() );
+    assert( rgbyteOut.size() );
+
+    ByteValue *obv = new ByteValue;
+    obv->SwapBuffer( rgbyteOut );
+    out.SetValue( *obv );
 
     return true;
     }
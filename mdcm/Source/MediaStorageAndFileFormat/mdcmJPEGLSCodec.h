@@ -81,6 +81,7 @@ protected:
 
 private:
   bool DecodeByStreamsCommon(char * buffer, size_t totalLen, std::vector<unsigned char> & rgbyteOut);
+  bool DecodeFrame(const char * buffer, size_t totalLen, std::vector<char> & out);
   bool CodeFrameIntoBuffer(char * outdata, size_t outlen, size_t & complen, const char * indata, size_t inlen );
   unsigned long long BufferLength;
   int LossyError;
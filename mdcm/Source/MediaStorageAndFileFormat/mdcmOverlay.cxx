@@ -420,6 +420,17 @@ const ByteValue &Overlay::GetOverlayData() const
   return bv;
 }
 
+const char * Overlay::GetPackedBuffer() const
+{
+  if (Internal->Data.empty()) return NULL;
+  return &Internal->Data[0];
+}
+
+size_t Overlay::GetPackedBufferLength() const
+{
+  return Internal->Data.size();
+}
+
 size_t Overlay::GetUnpackBufferLength() const
 {
   if (Internal->NumberOfFrames > 0)
@@ -125,6 +125,13 @@ public:
   /// the size if below GetUnpackBufferLength()
   bool GetUnpackBuffer(char *buffer, size_t len) const;
 
+  /// Direct access to the packed OverlayData (one bit per pixel,
+  /// least significant bit first), NULL if empty
+  const char * GetPackedBuffer() const;
+
+  /// Size in bytes of the packed OverlayData
+  size_t GetPackedBufferLength() const;
+
   Overlay(Overlay const &ov);
   Overlay &operator=(Overlay const &ov);
 
@@ -27,6 +27,7 @@
 #include "mdcmPrivateTag.h"
 #include "mdcmJPEGCodec.h"
 #include "mdcmImageHelper.h"
+#include "mdcmElscintCodec.h"
 
 namespace mdcm
 {
@@ -35,7 +36,8 @@ PixmapReader::PixmapReader() :
   m_AlppySupplementalLUT(false),
   m_ProcessOverlays(true),
   m_ProcessIcons(false),
-  m_ProcessCurves(false) {}
+  m_ProcessCurves(false),
+  m_DecodeElscint(false) {}
 
 PixmapReader::~PixmapReader()
 {
@@ -57,6 +59,23 @@ bool PixmapReader::Read()
   {
     return false;
   }
+  if(m_DecodeElscint)
+  {
+    ElscintCodec codec;
+    if(!codec.Decode(F->GetDataSet()))
+    {
+      mdcmErrorMacro("Can not decode ELSCINT1 pixel data");
+      return false;
+    }
+    // Uncompressed little endian now
+    const TransferSyntax & ts0 = F->GetHeader().GetDataSetTransferSyntax();
+    if(ts0 != TransferSyntax::ImplicitVRLittleEndian &&
+       ts0 != TransferSyntax::ExplicitVRLittleEndian)
+    {
+      F->GetHeader().SetDataSetTransferSyntax(
+        TransferSyntax::ExplicitVRLittleEndian);
+    }
+  }
   const FileMetaInformation &header = F->GetHeader();
   const DataSet & ds = F->GetDataSet();
   const TransferSyntax & ts = header.GetDataSetTransferSyntax();
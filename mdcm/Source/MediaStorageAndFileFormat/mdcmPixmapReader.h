@@ -50,6 +50,9 @@ public:
   bool GetProcessIcons() const { return m_ProcessIcons; }
   void SetProcessCurves(bool t) { m_ProcessCurves = t; }
   bool GetProcessCurves() const { return m_ProcessCurves; }
+  // Decode ELSCINT1 private compression in memory, see ElscintCodec
+  void SetDecodeElscint(bool t) { m_DecodeElscint = t; }
+  bool GetDecodeElscint() const { return m_DecodeElscint; }
   virtual bool Read();
   // Following methods are valid only after a call to 'Read'
   const Pixmap& GetPixmap() const;
@@ -63,6 +66,7 @@ protected:
   bool m_ProcessOverlays;
   bool m_ProcessIcons;
   bool m_ProcessCurves;
+  bool m_DecodeElscint;
 };
 
 } // end namespace mdcm
@@ -19,6 +19,7 @@
 #include "mdcmUnpacker12Bits.h"
 #include <limits>
 #include <sstream>
+#include <vector>
 #include <cstring>
 
 namespace mdcm
@@ -84,28 +85,46 @@ bool RAWCodec::DecodeBytes(
     }
     return true;
   }
-  std::stringstream is;
-  is.write(inBytes, inBufferLength);
-  std::stringstream os;
-  const bool r = DecodeByStreams(is, os);
-  if(!r) return false;
-  std::string str = os.str();
-  if(this->GetPixelFormat() == PixelFormat::UINT12 ||
-     this->GetPixelFormat() == PixelFormat::INT12)
+  const bool unpack12 =
+    this->GetPixelFormat() == PixelFormat::UINT12 ||
+    this->GetPixelFormat() == PixelFormat::INT12;
+  size_t len = inBufferLength;
+  const size_t capacity = GetDecodedLength(len);
+  if(!unpack12 && capacity <= inOutBufferLength)
   {
-    const size_t len = str.size() * 16 / 12;
-    char * copy = new char[len];
-    const bool b = Unpacker12Bits::Unpack(copy, &str[0], str.size());
-    if (!b) return false;
-    memcpy(outBytes, copy, len);
-    delete [] copy;
+    // decode in the output buffer
+    memcpy(outBytes, inBytes, len);
+    return DecodeByBuffer(outBytes, len, inOutBufferLength);
+  }
+  std::vector<char> buffer(capacity);
+  if(len > 0) memcpy(&buffer[0], inBytes, len);
+  if(!DecodeByBuffer(&buffer[0], len, capacity)) return false;
+  if(unpack12)
+  {
+    const size_t len16 = len * 16 / 12;
+    if(len16 <= inOutBufferLength)
+    {
+      if(!Unpacker12Bits::Unpack(outBytes, &buffer[0], len)) return false;
+    }
+    else
+    {
+      std::vector<char> copy(len16);
+      if(!Unpacker12Bits::Unpack(&copy[0], &buffer[0], len)) return false;
+      mdcmWarningMacro("Truncating result");
+      memcpy(outBytes, &copy[0], inOutBufferLength);
+    }
     this->GetPixelFormat().SetBitsAllocated(16);
   }
   else
   {
-    memcpy(outBytes, str.c_str(), inOutBufferLength);
+    if(len > inOutBufferLength)
+    {
+      mdcmWarningMacro("Truncating result");
+      len = inOutBufferLength;
+    }
+    memcpy(outBytes, &buffer[0], len);
   }
-  return r;
+  return true;
 }
 
 bool RAWCodec::Decode(DataElement const & in, DataElement & out)
@@ -122,31 +141,31 @@ bool RAWCodec::Decode(DataElement const & in, DataElement & out)
   }
   const ByteValue * bv = in.GetByteValue();
   if (!bv) return false;
-  std::stringstream is;
-  is.write(bv->GetPointer(), bv->GetLength());
-  std::stringstream os;
-  const bool r = DecodeByStreams(is, os);
-  if(!r) return false;
-  std::string str = os.str();
-  out = in;
+  size_t len = bv->GetLength();
+  if (len < 1)
+  {
+    out = in;
+    return true;
+  }
+  // decode in the buffer of the new value, no intermediate streams
+  std::vector<char> buffer(GetDecodedLength(len));
+  memcpy(&buffer[0], bv->GetPointer(), len);
+  if(!DecodeByBuffer(&buffer[0], len, buffer.size())) return false;
+  buffer.resize(len);
   if(this->GetPixelFormat() == PixelFormat::UINT12 ||
      this->GetPixelFormat() == PixelFormat::INT12)
   {
-    const size_t len = str.size() * 16 / 12;
-    char * copy = new char[len];
-    const bool b = Unpacker12Bits::Unpack(copy, &str[0], str.size());
+    std::vector<char> copy(len * 16 / 12);
+    const bool b = Unpacker12Bits::Unpack(&copy[0], &buffer[0], len);
     if (!b) return false;
-    VL::Type lenSize = (VL::Type)len;
-    out.SetByteValue(copy, lenSize);
-    delete [] copy;
+    buffer.swap(copy);
     this->GetPixelFormat().SetBitsAllocated(16);
   }
-  else
-  {
-    VL::Type strSize = (VL::Type) str.size();
-    out.SetByteValue(&str[0], strSize);
-  }
-  return r;
+  out = in;
+  ByteValue * obv = new ByteValue;
+  obv->SwapBuffer(buffer);
+  out.SetValue(*obv);
+  return true;
 }
 
 bool RAWCodec::DecodeByStreams(std::istream & is, std::ostream & os)
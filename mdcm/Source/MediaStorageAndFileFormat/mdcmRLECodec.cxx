@@ -470,24 +470,93 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
 
 size_t RLECodec::DecodeFragment(Fragment const & frag, char *buffer, size_t llen)
 {
-
-  std::stringstream is;
-  const ByteValue & bv = dynamic_cast<const ByteValue&>(frag.GetValue());
-  const size_t bv_len = bv.GetLength();
-  char * mybuffer = new char[bv_len];
-  bv.GetBuffer(mybuffer, bv.GetLength());
-  is.write(mybuffer, bv.GetLength());
-  delete [] mybuffer;
-  std::stringstream os;
+  const ByteValue * bv = frag.GetByteValue();
+  if(!bv || bv->IsEmpty()) return 0;
   SetLength((unsigned long)llen);
-  const bool r = DecodeByStreams(is, os);
-  if(!r) return 0;
-  std::streampos p = is.tellg();
-  std::string::size_type check = os.str().size();
-  memcpy(buffer, os.str().c_str(), check);
+  size_t check = 0;
+  if(!DecodeFrame(bv->GetPointer(), bv->GetLength(), buffer, llen, check))
+  {
+    return 0;
+  }
   return check;
 }
 
+// Same as DecodeByStreams, but from memory, the segments are decoded
+// in 'out' and post-processed in place, 'len' is the decoded length.
+bool RLECodec::DecodeFrame(
+  const char * in, size_t in_len,
+  char * out, size_t capacity, size_t & len)
+{
+  len = 0;
+  if(!in || !out || in_len < sizeof(RLEHeader)) return false;
+  RLEHeader header;
+  memcpy(&header, in, sizeof(RLEHeader));
+  SwapperNoOp::SwapArray((uint32_t*)&header,16);
+  const unsigned long long numSegments = header.NumSegments;
+  if(numSegments < 1 || numSegments > 15 || header.Offset[0] != 64)
+  {
+    mdcmErrorMacro("Could not decode");
+    return false;
+  }
+  unsigned long long length = Length;
+  if(length < 1 || length > capacity) return false;
+  assert(GetPixelFormat().GetBitsAllocated() == 32 ||
+         GetPixelFormat().GetBitsAllocated() == 16 ||
+         GetPixelFormat().GetBitsAllocated() == 8);
+  if(GetPixelFormat().GetBitsAllocated() > 8)
+  {
+    RequestPaddedCompositePixelCode = true;
+  }
+  // see the footnote in DecodeByStreams
+  if(GetPixelFormat().GetSamplesPerPixel() == 3 && GetPlanarConfiguration() == 0)
+  {
+    RequestPlanarConfiguration = true;
+  }
+  length /= numSegments;
+  const signed char * const end = (const signed char*)in + in_len;
+  for(unsigned long long i = 0; i < numSegments; ++i)
+  {
+    if(header.Offset[i] >= in_len)
+    {
+      mdcmErrorMacro("Could not decode");
+      return false;
+    }
+    const signed char * p = (const signed char*)in + header.Offset[i];
+    char * o = out + i * length;
+    unsigned long long numOutBytes = 0;
+    while(numOutBytes < length)
+    {
+      if(p >= end)
+      {
+        mdcmErrorMacro("Could not decode");
+        return false;
+      }
+      const signed char byte = *(p++);
+      if(byte >= 0)
+      {
+        const unsigned long long n = byte + 1;
+        if(n > length - numOutBytes || (unsigned long long)(end - p) < n)
+        {
+          return false;
+        }
+        memcpy(o + numOutBytes, p, (size_t)n);
+        p += n;
+        numOutBytes += n;
+      }
+      else if(byte >= -127)
+      {
+        const unsigned long long n = -byte + 1;
+        if(n > length - numOutBytes || p >= end) return false;
+        memset(o + numOutBytes, *(p++), (size_t)n);
+        numOutBytes += n;
+      }
+      // byte == -128, nothing
+    }
+  }
+  len = (size_t)(length * numSegments);
+  return DecodeByBuffer(out, len, capacity);
+}
+
 bool RLECodec::Decode(DataElement const &in, DataElement &out)
 {
   if(NumberOfDimensions == 2)
@@ -496,21 +565,40 @@ bool RLECodec::Decode(DataElement const &in, DataElement &out)
     const SequenceOfFragments * sf = in.GetSequenceOfFragments();
     if(!sf) return false;
     const unsigned long long len = GetBufferLength();
-    std::stringstream is;
-    sf->WriteBuffer(is);
     SetLength(len);
-    std::stringstream os;
-    const bool r = DecodeByStreams(is, os);
+    // a single fragment is decoded from its own buffer
+    std::vector<char> frags;
+    const char * in_buffer = NULL;
+    size_t in_len = 0;
+    if(sf->GetNumberOfFragments() == 1)
+    {
+      const ByteValue * bv = sf->GetFragment(0).GetByteValue();
+      if(!bv) return false;
+      in_buffer = bv->GetPointer();
+      in_len = bv->GetLength();
+    }
+    else
+    {
+      in_len = (size_t)sf->ComputeByteLength();
+      if(in_len < 1) return false;
+      frags.resize(in_len);
+      if(!sf->GetBuffer(&frags[0], in_len)) return false;
+      in_buffer = &frags[0];
+    }
+    std::vector<char> buffer(GetDecodedLength((size_t)len));
+    size_t check = 0;
+    const bool r = !buffer.empty() &&
+      DecodeFrame(in_buffer, in_len, &buffer[0], buffer.size(), check);
     if(!r)
     {
-      mdcmErrorMacro("DecodeByStreams failure.");
+      mdcmErrorMacro("DecodeFrame failure.");
       return false;
     }
-    std::string str = os.str();
-    std::string::size_type check = str.size();
     assert(check == len);
-    VL::Type checkCast = (VL::Type)check;
-    out.SetByteValue(&str[0], checkCast);
+    buffer.resize(check);
+    ByteValue * bv = new ByteValue;
+    bv->SwapBuffer(buffer);
+    out.SetValue(*bv);
     return true;
   }
   else if (NumberOfDimensions == 3)
@@ -528,13 +616,14 @@ bool RLECodec::Decode(DataElement const &in, DataElement &out)
       mdcmErrorMacro("Invalid number of fragments: " << nframes << " should be: " << zdim);
       return false;
     }
-    char * buffer = new char[len];
+    if(len < 1) return false;
+    std::vector<char> buffer((size_t)len);
     const size_t llen = len / nframes;
     bool corruption = false;
     for(unsigned int i = 0; i < nframes; ++i)
     {
       const Fragment &frag = sf->GetFragment(i);
-      const size_t check = DecodeFragment(frag, buffer + pos, llen);
+      const size_t check = DecodeFragment(frag, &buffer[pos], llen);
       if(check != llen)
       {
         mdcmDebugMacro("RLE pb with frag: " << i);
@@ -543,8 +632,9 @@ bool RLECodec::Decode(DataElement const &in, DataElement &out)
       pos += (unsigned long)llen;
     }
     if(!corruption) { assert(pos == len); }
-    out.SetByteValue(buffer, (uint32_t)len);
-    delete [] buffer;
+    ByteValue * bv = new ByteValue;
+    bv->SwapBuffer(buffer);
+    out.SetValue(*bv);
     return !corruption;
   }
   return false;
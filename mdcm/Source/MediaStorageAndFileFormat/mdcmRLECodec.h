@@ -74,6 +74,7 @@ private:
   unsigned long long Length;
   unsigned long long BufferLength;
   size_t DecodeFragment(Fragment const & frag, char * buffer, size_t llen);
+  bool DecodeFrame(const char *, size_t, char *, size_t, size_t &);
 };
 
 } // end namespace mdcm
@@ -18,6 +18,11 @@
 #include "mdcmImageHelper.h"
 #include "mdcmDirectionCosines.h"
 #include <cmath>
+#include <atomic>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 namespace mdcm
 {
@@ -25,50 +30,123 @@ SplitMosaicFilter::SplitMosaicFilter():F(new File),I(new Image) {}
 SplitMosaicFilter::~SplitMosaicFilter() {}
 
 namespace details {
+
+// Set from the GUI thread, read by loader threads
+static std::atomic<int> MaxNumberOfThreads(0);
+
+// Below this size per thread starting threads costs more than the copy.
+static std::atomic<unsigned long long> MinBytesPerThread(4ULL * 1024 * 1024);
+
 /*
  *  mdcmDataExtra/mdcmSampleData/images_of_interest/MR-sonata-3D-as-Tile.dcm
  */
-static bool reorganize_mosaic(const unsigned short *input, const unsigned int *inputdims,
-  unsigned int square, const unsigned int *outputdims, unsigned short *output )
+static void reorganize_tiles(const char *input, const unsigned int *inputdims,
+  unsigned int square, const unsigned int *outputdims, size_t pixelsize,
+  bool inverted, unsigned int z0, unsigned int z1, char *output )
 {
-  for(unsigned int x = 0; x < outputdims[0]; ++x)
+  const size_t inputrow = inputdims[0] * pixelsize;
+  const size_t row = outputdims[0] * pixelsize;
+  const size_t slice = row * outputdims[1];
+  for(unsigned int z = z0; z < z1; ++z)
     {
+    const size_t outputz = inverted ? outputdims[2] - 1 - z : z;
+    char *out = output + outputz * slice;
+    const char *in = input + (z%square) * row +
+      (size_t)(z/square) * outputdims[1] * inputrow;
     for(unsigned int y = 0; y < outputdims[1]; ++y)
       {
-      for(unsigned int z = 0; z < outputdims[2]; ++z)
-        {
-        const size_t outputidx = x + y*outputdims[0] + z*outputdims[0]*outputdims[1];
-        const size_t inputidx = (x + (z%square)*outputdims[0]) +
-          (y + (z/square)*outputdims[1])*inputdims[0];
-        output[ outputidx ] = input[ inputidx ];
-        }
+      memcpy( out, in, row );
+      out += row;
+      in += inputrow;
       }
     }
-  return true;
 }
 
-#ifdef SNVINVERT
-static bool reorganize_mosaic_invert(const unsigned short *input, const unsigned int *inputdims,
-  unsigned int square, const unsigned int *outputdims, unsigned short *output )
+}
+
+void SplitMosaicFilter::SetMaxNumberOfThreads(int x)
+{
+  details::MaxNumberOfThreads.store((x > 0) ? x : 0);
+}
+
+int SplitMosaicFilter::GetMaxNumberOfThreads()
+{
+  return details::MaxNumberOfThreads.load();
+}
+
+void SplitMosaicFilter::SetMinBytesPerThread(unsigned long long x)
+{
+  details::MinBytesPerThread.store((x > 0) ? x : 1);
+}
+
+unsigned long long SplitMosaicFilter::GetMinBytesPerThread()
+{
+  return details::MinBytesPerThread.load();
+}
+
+bool SplitMosaicFilter::ReorganizeTiles(
+  const char * input, unsigned long long inputlength,
+  const unsigned int * inputdims, unsigned int square,
+  const unsigned int * outputdims, unsigned int pixelsize,
+  bool inverted, char * output )
 {
-  for(unsigned int x = 0; x < outputdims[0]; ++x)
+  if( !input || !output || square < 1 || pixelsize < 1 ) return false;
+  const unsigned int tiles = outputdims[2];
+  if( tiles < 1 || outputdims[0] < 1 || outputdims[1] < 1 ) return false;
+  // Last row of every tile has to be inside the input, rows of a tile
+  // may wrap if the tiles are wider than the input.
+  const unsigned long long inputpixels = inputlength / pixelsize;
+  for(unsigned int z = 0; z < tiles; ++z)
     {
-    for(unsigned int y = 0; y < outputdims[1]; ++y)
+    const unsigned long long last =
+      (unsigned long long)(z%square) * outputdims[0] +
+      ((unsigned long long)(z/square) * outputdims[1] + outputdims[1] - 1) * inputdims[0] +
+      outputdims[0];
+    if( last > inputpixels ) return false;
+    }
+  const unsigned long long bytes =
+    (unsigned long long)outputdims[0] * outputdims[1] * tiles * pixelsize;
+  // The caller caps the number of threads to the number of processors.
+  const int max_threads = details::MaxNumberOfThreads.load();
+  unsigned int n = (max_threads > 0) ?
+    (unsigned int)max_threads : std::thread::hardware_concurrency();
+  if( n > tiles ) n = tiles;
+  const unsigned long long min_bytes = details::MinBytesPerThread.load();
+  if( n > bytes / min_bytes ) n = (unsigned int)(bytes / min_bytes);
+  if( n < 2 )
+    {
+    details::reorganize_tiles( input, inputdims, square, outputdims,
+      pixelsize, inverted, 0, tiles, output );
+    return true;
+    }
+  std::vector<std::thread> threads;
+  threads.reserve( n - 1 );
+  for(unsigned int k = 0; k < n; ++k)
+    {
+    const unsigned int z0 = (unsigned int)((unsigned long long)tiles * k / n);
+    const unsigned int z1 = (unsigned int)((unsigned long long)tiles * (k + 1) / n);
+    if( k + 1 < n )
       {
-      for(unsigned int z = 0; z < outputdims[2]; ++z)
+      try
+        {
+        threads.push_back( std::thread( details::reorganize_tiles, input,
+          inputdims, square, outputdims, (size_t)pixelsize, inverted,
+          z0, z1, output ) );
+        continue;
+        }
+      catch( std::system_error & )
         {
-        const size_t outputidx = x + y*outputdims[0] + (outputdims[2]-1-z)*outputdims[0]*outputdims[1];
-        const size_t inputidx = (x + (z%square)*outputdims[0]) +
-          (y + (z/square)*outputdims[1])*inputdims[0];
-        output[ outputidx ] = input[ inputidx ];
         }
       }
+    details::reorganize_tiles( input, inputdims, square, outputdims,
+      pixelsize, inverted, z0, z1, output );
+    }
+  for(size_t k = 0; k < threads.size(); ++k)
+    {
+    threads[k].join();
     }
   return true;
 }
-#endif
-
-}
 
 void SplitMosaicFilter::SetImage(const Image& image)
 {
@@ -266,35 +344,26 @@ bool SplitMosaicFilter::Split()
     mdcmErrorMacro( "Expecting UINT16 PixelFormat" );
     return false;
     }
-  unsigned long long l = inputimage.GetBufferLength();
+  const unsigned long long l = inputimage.GetBufferLength();
   std::vector<char> buf;
   buf.resize(l);
   inputimage.GetBuffer( &buf[0] );
-  DataElement pixeldata( Tag(0x7fe0,0x0010) );
 
-  std::vector<char> outbuf;
-  outbuf.resize(l);
+  // Tiles are gathered directly into the new Pixel Data value
+  ByteValue *bv = new ByteValue( NULL, (VL::Type)l );
+  DataElement pixeldata( Tag(0x7fe0,0x0010) );
+  pixeldata.SetValue( *bv );
 
-  bool b;
 #ifdef SNVINVERT
-  if( inverted )
-  {
-    b = details::reorganize_mosaic_invert(
-        (unsigned short*)&buf[0], inputimage.GetDimensions(), div, dims,
-        (unsigned short*)&outbuf[0] );
-  }
-  else
+  const bool invert = inverted;
+#else
+  const bool invert = false;
 #endif
-  {
-    b = details::reorganize_mosaic(
-        (unsigned short*)&buf[0], inputimage.GetDimensions(), div, dims,
-        (unsigned short*)&outbuf[0] );
-  }
+  const bool b = ReorganizeTiles(
+    &buf[0], l, inputimage.GetDimensions(), div, dims, 2, invert,
+    (char*)bv->GetVoidPointer() );
   if( !b ) return false;
 
-  VL::Type outbufSize = (VL::Type)outbuf.size();
-  pixeldata.SetByteValue( &outbuf[0], outbufSize );
-
   Image &image = GetImage();
   const TransferSyntax &ts = image.GetTransferSyntax();
   if( ts.IsExplicit() )
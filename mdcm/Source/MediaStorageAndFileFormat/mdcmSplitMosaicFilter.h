@@ -53,6 +53,25 @@ public:
   /// Extract the value for ImagePositionPatient (requires inverted flag)
   bool ComputeMOSAICSlicePosition( double pos[3], bool inverted );
 
+  /// Gather square x square tiles of 'inputdims' into 'outputdims[2]'
+  /// consecutive slices, rows are copied directly to 'output'.
+  /// Large images are split by tiles between threads.
+  static bool ReorganizeTiles(
+    const char * input, unsigned long long inputlength,
+    const unsigned int * inputdims, unsigned int square,
+    const unsigned int * outputdims, unsigned int pixelsize,
+    bool inverted, char * output );
+
+  /// Number of threads for ReorganizeTiles, at most one per tile,
+  /// 0 - number of processors
+  static void SetMaxNumberOfThreads(int);
+  static int GetMaxNumberOfThreads();
+
+  /// Minimum size of the output per thread for ReorganizeTiles,
+  /// default 4 MB
+  static void SetMinBytesPerThread(unsigned long long);
+  static unsigned long long GetMinBytesPerThread();
+
   void SetImage(const Image& image);
   const Image &GetImage() const { return *I; }
   Image &GetImage() { return *I; }
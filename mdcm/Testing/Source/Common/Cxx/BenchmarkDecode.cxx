@@ -0,0 +1,264 @@
+#include "mdcmImage.h"
+#include "mdcmImageChangeTransferSyntax.h"
+#include "mdcmImageCodec.h"
+#include "mdcmPhotometricInterpretation.h"
+#include "mdcmPixelFormat.h"
+#include "mdcmSmartPointer.h"
+#include "mdcmTransferSyntax.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Decodes the same volume stored with every transfer syntax that
+// mdcm can write, with Bitmap::GetBuffer as the application does,
+// prints the time per decode and checks the lossless result. Also
+// times ImageCodec::DecodeByStreams against DecodeByBuffer for
+// RAW big endian with unused bits cleanup.
+//
+// BenchmarkDecode [iterations]
+
+namespace
+{
+
+class TestCodec : public mdcm::ImageCodec
+{
+public:
+  TestCodec() {}
+  ~TestCodec() {}
+  mdcm::ImageCodec * Clone() const { return NULL; }
+  bool Streams(const std::vector<char> & in, std::string & out)
+  {
+    std::stringstream is;
+    is.write(&in[0], in.size());
+    std::stringstream os;
+    if(!DecodeByStreams(is, os)) return false;
+    out = os.str();
+    return true;
+  }
+  bool Buffer(const std::vector<char> & in, std::vector<char> & out)
+  {
+    size_t len = in.size();
+    out.assign(GetDecodedLength(len), 0);
+    memcpy(&out[0], &in[0], len);
+    if(!DecodeByBuffer(&out[0], len, out.size())) return false;
+    out.resize(len);
+    return true;
+  }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double Milliseconds(const Clock::time_point & t0)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+unsigned int Seed = 1;
+
+unsigned short Random16()
+{
+  Seed = Seed * 1103515245u + 12345u;
+  return (unsigned short)(Seed >> 16);
+}
+
+// smooth gradient plus a little noise, so that the lossless
+// compressors see data close to a real image
+void Fill16(std::vector<char> & v, unsigned int x, unsigned int y,
+  unsigned int z, unsigned short mask)
+{
+  v.resize((size_t)x * y * z * 2);
+  unsigned short * p = (unsigned short*)&v[0];
+  for(unsigned int k = 0; k < z; ++k)
+    for(unsigned int j = 0; j < y; ++j)
+      for(unsigned int i = 0; i < x; ++i)
+        *p++ = (unsigned short)((i * 3 + j * 5 + k * 7 + (Random16() & 15)) & mask);
+}
+
+void Fill8RGB(std::vector<char> & v, unsigned int x, unsigned int y,
+  unsigned int z)
+{
+  v.resize((size_t)x * y * z * 3);
+  unsigned char * p = (unsigned char*)&v[0];
+  for(unsigned int k = 0; k < z; ++k)
+    for(unsigned int j = 0; j < y; ++j)
+      for(unsigned int i = 0; i < x; ++i)
+      {
+        *p++ = (unsigned char)(i + (Random16() & 3));
+        *p++ = (unsigned char)(j + (Random16() & 3));
+        *p++ = (unsigned char)(i + j + k);
+      }
+}
+
+void SetImage(mdcm::Image & image, const std::vector<char> & v,
+  unsigned int x, unsigned int y, unsigned int z,
+  const mdcm::PixelFormat & pf, mdcm::PhotometricInterpretation::PIType pi,
+  const mdcm::TransferSyntax & ts)
+{
+  image.SetNumberOfDimensions(3);
+  image.SetDimension(0, x);
+  image.SetDimension(1, y);
+  image.SetDimension(2, z);
+  image.SetPixelFormat(pf);
+  image.SetPhotometricInterpretation(pi);
+  image.SetPlanarConfiguration(0);
+  image.SetTransferSyntax(ts);
+  mdcm::DataElement pixeldata(mdcm::Tag(0x7fe0,0x0010));
+  pixeldata.SetByteValue(&v[0], (uint32_t)v.size());
+  image.SetDataElement(pixeldata);
+}
+
+int Decode(const char * name, const mdcm::Image & image,
+  const std::vector<char> & reference, bool needbyteswap, int iterations)
+{
+  std::vector<char> buffer((size_t)image.GetBufferLength());
+  if(buffer.size() != reference.size())
+  {
+    fprintf(stderr, "%s: buffer length %u, expected %u\n", name,
+      (unsigned int)buffer.size(), (unsigned int)reference.size());
+    return 1;
+  }
+  double best = 0;
+  for(int i = 0; i < iterations; ++i)
+  {
+    // GetBuffer clears the flag after the first RAW decode
+    const_cast<mdcm::Image&>(image).SetNeedByteSwap(needbyteswap);
+    const Clock::time_point t0 = Clock::now();
+    if(!image.GetBuffer(&buffer[0]))
+    {
+      fprintf(stderr, "%s: GetBuffer failed\n", name);
+      return 1;
+    }
+    const double t = Milliseconds(t0);
+    if(i == 0 || t < best) best = t;
+  }
+  printf("%-38s %10.2f ms %10.1f MB/s\n", name, best,
+    (double)buffer.size() / (best * 1000.0));
+  if(memcmp(&buffer[0], &reference[0], buffer.size()) != 0)
+  {
+    fprintf(stderr, "%s: decoded pixels differ\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+int Encode(const char * name, const mdcm::Image & input,
+  const mdcm::TransferSyntax & ts, const std::vector<char> & reference,
+  int iterations)
+{
+  mdcm::ImageChangeTransferSyntax change;
+  change.SetTransferSyntax(ts);
+  change.SetInput(input);
+  if(!change.Change())
+  {
+    fprintf(stderr, "%s: encoding failed\n", name);
+    return 1;
+  }
+  return Decode(name, change.GetOutput(), reference, false, iterations);
+}
+
+int Volume(const char * name, const std::vector<char> & v,
+  unsigned int x, unsigned int y, unsigned int z,
+  const mdcm::PixelFormat & pf, mdcm::PhotometricInterpretation::PIType pi,
+  int iterations)
+{
+  printf("%s, %ux%ux%u\n", name, x, y, z);
+  int r = 0;
+  // the filter keeps a smart pointer to its input
+  mdcm::SmartPointer<mdcm::Image> image = new mdcm::Image;
+  SetImage(*image, v, x, y, z, pf, pi, mdcm::TransferSyntax::ExplicitVRLittleEndian);
+  r += Decode("Explicit VR Little Endian", *image, v, false, iterations);
+  mdcm::Image implicit;
+  SetImage(implicit, v, x, y, z, pf, pi, mdcm::TransferSyntax::ImplicitVRLittleEndian);
+  r += Decode("Implicit VR Little Endian", implicit, v, false, iterations);
+  if(pf.GetBitsAllocated() == 16)
+  {
+    std::vector<char> be(v);
+    for(size_t i = 0; i + 1 < be.size(); i += 2)
+    {
+      const char c = be[i];
+      be[i] = be[i + 1];
+      be[i + 1] = c;
+    }
+    mdcm::Image bigendian;
+    SetImage(bigendian, be, x, y, z, pf, pi, mdcm::TransferSyntax::ExplicitVRBigEndian);
+    r += Decode("Explicit VR Big Endian", bigendian, v, true, iterations);
+  }
+  r += Encode("RLE Lossless", *image,
+    mdcm::TransferSyntax::RLELossless, v, iterations);
+  r += Encode("JPEG Lossless, first order prediction", *image,
+    mdcm::TransferSyntax::JPEGLosslessProcess14_1, v, iterations);
+  r += Encode("JPEG-LS Lossless", *image,
+    mdcm::TransferSyntax::JPEGLSLossless, v, iterations);
+  r += Encode("JPEG 2000 Lossless", *image,
+    mdcm::TransferSyntax::JPEG2000Lossless, v, iterations);
+  return r;
+}
+
+int StreamsAndBuffer(const std::vector<char> & v, int iterations)
+{
+  TestCodec codec;
+  codec.SetPixelFormat(mdcm::PixelFormat(1, 16, 12, 11, 1));
+  codec.SetPhotometricInterpretation(mdcm::PhotometricInterpretation::MONOCHROME2);
+  codec.SetPlanarConfiguration(0);
+  codec.SetNeedByteSwap(true);
+  codec.SetNeedOverlayCleanup(true);
+  std::string out0;
+  std::vector<char> out1;
+  double t0 = 0, t1 = 0;
+  for(int i = 0; i < iterations; ++i)
+  {
+    Clock::time_point t = Clock::now();
+    if(!codec.Streams(v, out0))
+    {
+      fprintf(stderr, "DecodeByStreams failed\n");
+      return 1;
+    }
+    const double a = Milliseconds(t);
+    t = Clock::now();
+    if(!codec.Buffer(v, out1))
+    {
+      fprintf(stderr, "DecodeByBuffer failed\n");
+      return 1;
+    }
+    const double b = Milliseconds(t);
+    if(i == 0 || a < t0) t0 = a;
+    if(i == 0 || b < t1) t1 = b;
+  }
+  printf("RAW big endian, 12 bits signed, cleanup\n");
+  printf("%-38s %10.2f ms\n", "DecodeByStreams", t0);
+  printf("%-38s %10.2f ms\n", "DecodeByBuffer", t1);
+  if(out0.size() != out1.size() ||
+    memcmp(out0.data(), &out1[0], out1.size()) != 0)
+  {
+    fprintf(stderr, "DecodeByStreams and DecodeByBuffer differ\n");
+    return 1;
+  }
+  return 0;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+  int iterations = 3;
+  if(argc > 1) iterations = atoi(argv[1]);
+  if(iterations < 1) iterations = 1;
+  int r = 0;
+  std::vector<char> v;
+  Fill16(v, 512, 512, 16, 0x0fff);
+  r += Volume("MONOCHROME2 16 bits allocated, 12 stored", v, 512, 512, 16,
+    mdcm::PixelFormat(1, 16, 12, 11, 0),
+    mdcm::PhotometricInterpretation::MONOCHROME2, iterations);
+  r += StreamsAndBuffer(v, iterations);
+  std::vector<char> rgb;
+  Fill8RGB(rgb, 512, 512, 4);
+  r += Volume("RGB 8 bits", rgb, 512, 512, 4,
+    mdcm::PixelFormat(3, 8, 8, 7, 0),
+    mdcm::PhotometricInterpretation::RGB, iterations);
+  if(r) fprintf(stderr, "%d errors\n", r);
+  return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
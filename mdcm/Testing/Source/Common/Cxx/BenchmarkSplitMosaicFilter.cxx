@@ -0,0 +1,117 @@
+#include "mdcmSplitMosaicFilter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Splits a SIEMENS mosaic of 36 tiles 64x64, 16 bits (384x384), with
+// the former per-pixel code and with SplitMosaicFilter::ReorganizeTiles,
+// single thread and threads with a lowered size threshold, prints the
+// time per split and checks the results.
+//
+// BenchmarkSplitMosaicFilter [iterations]
+
+namespace
+{
+
+// former code, unchanged
+bool reorganize_mosaic(const unsigned short *input, const unsigned int *inputdims,
+  unsigned int square, const unsigned int *outputdims, unsigned short *output )
+{
+  for(unsigned int x = 0; x < outputdims[0]; ++x)
+    {
+    for(unsigned int y = 0; y < outputdims[1]; ++y)
+      {
+      for(unsigned int z = 0; z < outputdims[2]; ++z)
+        {
+        const size_t outputidx = x + y*outputdims[0] + z*outputdims[0]*outputdims[1];
+        const size_t inputidx = (x + (z%square)*outputdims[0]) +
+          (y + (z/square)*outputdims[1])*inputdims[0];
+        output[ outputidx ] = input[ inputidx ];
+        }
+      }
+    }
+  return true;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+double Microseconds(const Clock::time_point & t0)
+{
+  return std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+}
+
+unsigned int Seed = 1;
+
+unsigned short Random16()
+{
+  Seed = Seed * 1103515245u + 12345u;
+  return (unsigned short)(Seed >> 16);
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+  int iterations = 200;
+  if(argc > 1) iterations = atoi(argv[1]);
+  if(iterations < 1) iterations = 1;
+  const unsigned int square = 6;
+  const unsigned int inputdims[3] = { 64 * square, 64 * square, 1 };
+  const unsigned int outputdims[3] = { 64, 64, 36 };
+  const size_t n = (size_t)inputdims[0] * inputdims[1];
+  std::vector<unsigned short> input(n);
+  for(size_t i = 0; i < n; ++i) input[i] = Random16();
+  std::vector<unsigned short> output0(n);
+  std::vector<unsigned short> output1(n);
+  int r = 0;
+  printf("SIEMENS mosaic %ux%u, %u tiles %ux%u, 16 bits\n",
+    inputdims[0], inputdims[1], outputdims[2], outputdims[0], outputdims[1]);
+  double best = 0;
+  for(int i = 0; i < iterations; ++i)
+    {
+    const Clock::time_point t0 = Clock::now();
+    reorganize_mosaic(&input[0], inputdims, square, outputdims, &output0[0]);
+    const double t = Microseconds(t0);
+    if(i == 0 || t < best) best = t;
+    }
+  printf("%-36s %10.1f us\n", "former per-pixel code", best);
+  const unsigned long long minbytes =
+    mdcm::SplitMosaicFilter::GetMinBytesPerThread();
+  const int threads[] = { 1, 2, 4, 6 };
+  for(size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); ++k)
+    {
+    mdcm::SplitMosaicFilter::SetMaxNumberOfThreads(threads[k]);
+    // the whole mosaic is below the default threshold
+    mdcm::SplitMosaicFilter::SetMinBytesPerThread(threads[k] > 1 ? 1 : minbytes);
+    memset(&output1[0], 0, n * sizeof(unsigned short));
+    for(int i = 0; i < iterations; ++i)
+      {
+      const Clock::time_point t0 = Clock::now();
+      if( !mdcm::SplitMosaicFilter::ReorganizeTiles(
+        (const char*)&input[0], n * sizeof(unsigned short), inputdims, square,
+        outputdims, sizeof(unsigned short), false, (char*)&output1[0]) )
+        {
+        fprintf(stderr, "ReorganizeTiles failed, %d threads\n", threads[k]);
+        ++r;
+        break;
+        }
+      const double t = Microseconds(t0);
+      if(i == 0 || t < best) best = t;
+      }
+    char name[64];
+    snprintf(name, sizeof(name), "ReorganizeTiles, %d thread%s",
+      threads[k], threads[k] > 1 ? "s" : "");
+    printf("%-36s %10.1f us\n", name, best);
+    if(memcmp(&output0[0], &output1[0], n * sizeof(unsigned short)) != 0)
+      {
+      fprintf(stderr, "%s: results differ\n", name);
+      ++r;
+      }
+    }
+  mdcm::SplitMosaicFilter::SetMinBytesPerThread(minbytes);
+  mdcm::SplitMosaicFilter::SetMaxNumberOfThreads(0);
+  if(r) fprintf(stderr, "%d errors\n", r);
+  return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
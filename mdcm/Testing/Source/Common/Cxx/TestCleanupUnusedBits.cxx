@@ -0,0 +1,179 @@
+#include "mdcmImageCodec.h"
+#include "mdcmPhotometricInterpretation.h"
+#include "mdcmPixelFormat.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Unused bits cleanup of 16 bits pixels, for every 16 bits value,
+// 9 to 15 bits stored, signed and unsigned. The fused kernels of
+// DecodeByBuffer (byte swap + cleanup, padded composite pixel code +
+// cleanup) are compared with the unfused DecodeByStreams path and
+// both, as well as CleanupUnusedBits, with a per-pixel reference.
+
+namespace
+{
+
+class TestCodec : public mdcm::ImageCodec
+{
+public:
+  TestCodec() {}
+  ~TestCodec() {}
+  mdcm::ImageCodec * Clone() const { return NULL; }
+  void SetRequestPaddedCompositePixelCode(bool b)
+  {
+    RequestPaddedCompositePixelCode = b;
+  }
+  bool Streams(const std::vector<char> & in, std::string & out)
+  {
+    std::stringstream is;
+    is.write(&in[0], in.size());
+    std::stringstream os;
+    if(!DecodeByStreams(is, os)) return false;
+    out = os.str();
+    return true;
+  }
+  bool Buffer(const std::vector<char> & in, std::vector<char> & out)
+  {
+    size_t len = in.size();
+    out.assign(GetDecodedLength(len), 0);
+    memcpy(&out[0], &in[0], len);
+    if(!DecodeByBuffer(&out[0], len, out.size())) return false;
+    out.resize(len);
+    return true;
+  }
+};
+
+// former per-pixel code, the sign is extended from the high bit
+// (the former negative mask set only one bit if d > 1)
+uint16_t Reference(uint16_t c, unsigned int bitsstored, bool sgn)
+{
+  const unsigned int d = 16 - bitsstored;
+  const unsigned int t = 0;
+  const uint16_t pmask = (uint16_t)(0xffff >> d);
+  c = (uint16_t)(c >> t);
+  if(sgn)
+  {
+    const uint16_t smask = (uint16_t)(0x0001 << (16 - (d + 1)));
+    if(c & smask) return (uint16_t)(c | (uint16_t)~pmask);
+  }
+  return (uint16_t)(c & pmask);
+}
+
+int Compare(const char * name, const char * path, unsigned int bitsstored,
+  bool sgn, const char * p, size_t len, const std::vector<uint16_t> & ref)
+{
+  if(len != ref.size() * 2)
+  {
+    fprintf(stderr, "%s, %s: length %u, bits stored %u, %s\n", name, path,
+      (unsigned int)len, bitsstored, sgn ? "signed" : "unsigned");
+    return 1;
+  }
+  for(size_t i = 0; i < ref.size(); ++i)
+  {
+    uint16_t c;
+    memcpy(&c, p + 2 * i, 2);
+    if(c != ref[i])
+    {
+      fprintf(stderr, "%s, %s: bits stored %u, %s, 0x%04x -> 0x%04x, expected 0x%04x\n",
+        name, path, bitsstored, sgn ? "signed" : "unsigned",
+        (unsigned int)i, (unsigned int)c, (unsigned int)ref[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int TestPaths(const char * name, TestCodec & codec, const std::vector<char> & in,
+  unsigned int bitsstored, bool sgn, const std::vector<uint16_t> & ref)
+{
+  std::string out0;
+  std::vector<char> out1;
+  if(!codec.Streams(in, out0))
+  {
+    fprintf(stderr, "%s: DecodeByStreams failed\n", name);
+    return 1;
+  }
+  if(!codec.Buffer(in, out1))
+  {
+    fprintf(stderr, "%s: DecodeByBuffer failed\n", name);
+    return 1;
+  }
+  int r = 0;
+  r += Compare(name, "DecodeByStreams", bitsstored, sgn, out0.data(), out0.size(), ref);
+  r += Compare(name, "DecodeByBuffer", bitsstored, sgn, &out1[0], out1.size(), ref);
+  return r;
+}
+
+int TestBitsStored(unsigned int bitsstored, bool sgn)
+{
+  const size_t n = 65536;
+  std::vector<uint16_t> values(n);
+  std::vector<uint16_t> ref(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    values[i] = (uint16_t)i;
+    ref[i] = Reference((uint16_t)i, bitsstored, sgn);
+  }
+  const mdcm::PixelFormat pf(1, 16, (unsigned short)bitsstored,
+    (unsigned short)(bitsstored - 1), sgn ? 1 : 0);
+  int r = 0;
+  // in place cleanup
+  {
+    TestCodec codec;
+    codec.SetPixelFormat(pf);
+    codec.SetNeedOverlayCleanup(true);
+    std::vector<uint16_t> v(values);
+    codec.CleanupUnusedBits((char*)&v[0], 2 * n);
+    r += Compare("CleanupUnusedBits", "in place", bitsstored, sgn,
+      (const char*)&v[0], 2 * n, ref);
+  }
+  // byte swap, big endian input
+  {
+    TestCodec codec;
+    codec.SetPixelFormat(pf);
+    codec.SetPhotometricInterpretation(mdcm::PhotometricInterpretation::MONOCHROME2);
+    codec.SetNeedByteSwap(true);
+    codec.SetNeedOverlayCleanup(true);
+    std::vector<char> in(2 * n);
+    for(size_t i = 0; i < n; ++i)
+    {
+      in[2 * i]     = (char)(values[i] >> 8);
+      in[2 * i + 1] = (char)(values[i] & 0xff);
+    }
+    r += TestPaths("byte swap", codec, in, bitsstored, sgn, ref);
+  }
+  // padded composite pixel code, most significant bytes first
+  {
+    TestCodec codec;
+    codec.SetPixelFormat(pf);
+    codec.SetPhotometricInterpretation(mdcm::PhotometricInterpretation::MONOCHROME2);
+    codec.SetNeedOverlayCleanup(true);
+    codec.SetRequestPaddedCompositePixelCode(true);
+    std::vector<char> in(2 * n);
+    for(size_t i = 0; i < n; ++i)
+    {
+      in[i]     = (char)(values[i] >> 8);
+      in[n + i] = (char)(values[i] & 0xff);
+    }
+    r += TestPaths("padded composite", codec, in, bitsstored, sgn, ref);
+  }
+  return r;
+}
+
+}
+
+int main(int, char *[])
+{
+  int r = 0;
+  for(unsigned int bitsstored = 9; bitsstored <= 15; ++bitsstored)
+  {
+    r += TestBitsStored(bitsstored, false);
+    r += TestBitsStored(bitsstored, true);
+  }
+  if(r) fprintf(stderr, "%d errors\n", r);
+  return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
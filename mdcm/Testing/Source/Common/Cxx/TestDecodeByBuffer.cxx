@@ -0,0 +1,162 @@
+#include "mdcmImageCodec.h"
+#include "mdcmPhotometricInterpretation.h"
+#include "mdcmPixelFormat.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compares ImageCodec::DecodeByBuffer with DecodeByStreams byte for
+// byte: RAW big endian, RLE (padded composite pixel code) with 16 and
+// 32 bits allocated, planar configuration 1 and raw YBR_FULL_422, with
+// and without unused bits cleanup. Lengths are not multiples of the
+// stream block size.
+
+namespace
+{
+
+class TestCodec : public mdcm::ImageCodec
+{
+public:
+  TestCodec() {}
+  ~TestCodec() {}
+  mdcm::ImageCodec * Clone() const { return NULL; }
+  void SetRequestPlanarConfiguration(bool b)
+  {
+    RequestPlanarConfiguration = b;
+  }
+  void SetRequestPaddedCompositePixelCode(bool b)
+  {
+    RequestPaddedCompositePixelCode = b;
+  }
+  bool Streams(const std::vector<char> & in, std::string & out)
+  {
+    std::stringstream is;
+    is.write(&in[0], in.size());
+    std::stringstream os;
+    if(!DecodeByStreams(is, os)) return false;
+    out = os.str();
+    return true;
+  }
+  bool Buffer(const std::vector<char> & in, std::vector<char> & out)
+  {
+    size_t len = in.size();
+    out.assign(GetDecodedLength(len), 0);
+    memcpy(&out[0], &in[0], len);
+    if(!DecodeByBuffer(&out[0], len, out.size())) return false;
+    out.resize(len);
+    return true;
+  }
+};
+
+unsigned int Seed = 1;
+
+unsigned short Random16()
+{
+  Seed = Seed * 1103515245u + 12345u;
+  return (unsigned short)(Seed >> 16);
+}
+
+struct Case
+{
+  const char * Name;
+  mdcm::PhotometricInterpretation::PIType PI;
+  unsigned short SamplesPerPixel;
+  unsigned short BitsAllocated;
+  unsigned short BitsStored;
+  unsigned short PixelRepresentation;
+  bool ByteSwap;
+  bool PaddedComposite;
+  bool Planar;
+  bool Cleanup;
+};
+
+const Case Cases[] =
+{
+  { "RAW big endian 16 bits",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 16, 16, 0, true, false, false, false },
+  { "RAW big endian 12 bits unsigned",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 16, 12, 0, true, false, false, true },
+  { "RAW big endian 12 bits signed",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 16, 12, 1, true, false, false, true },
+  { "RAW big endian RGB 16 bits",
+    mdcm::PhotometricInterpretation::RGB, 3, 16, 16, 0, true, false, false, false },
+  { "RLE 16 bits",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 16, 16, 1, false, true, false, false },
+  { "RLE 16 bits, 12 bits stored unsigned",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 16, 12, 0, false, true, false, true },
+  { "RLE 16 bits, 10 bits stored signed",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 16, 10, 1, false, true, false, true },
+  { "RLE 32 bits",
+    mdcm::PhotometricInterpretation::MONOCHROME2, 1, 32, 32, 0, false, true, false, false },
+  { "RAW RGB 8 bits, planar configuration 1",
+    mdcm::PhotometricInterpretation::RGB, 3, 8, 8, 0, false, false, true, false },
+  { "RAW YBR_FULL 8 bits, planar configuration 1",
+    mdcm::PhotometricInterpretation::YBR_FULL, 3, 8, 8, 0, false, false, true, false },
+  { "RAW YBR_FULL_422",
+    mdcm::PhotometricInterpretation::YBR_FULL_422, 3, 8, 8, 0, false, false, false, false }
+};
+
+int TestCase(const Case & c, size_t pixels)
+{
+  TestCodec codec;
+  mdcm::PixelFormat pf(c.SamplesPerPixel, c.BitsAllocated, c.BitsStored,
+    (unsigned short)(c.BitsStored - 1), c.PixelRepresentation);
+  codec.SetPixelFormat(pf);
+  codec.SetPhotometricInterpretation(c.PI);
+  codec.SetPlanarConfiguration(c.Planar ? 1 : 0);
+  codec.SetNeedByteSwap(c.ByteSwap);
+  codec.SetNeedOverlayCleanup(c.Cleanup);
+  codec.SetRequestPaddedCompositePixelCode(c.PaddedComposite);
+  codec.SetRequestPlanarConfiguration(c.Planar);
+  size_t len = pixels * c.SamplesPerPixel * (c.BitsAllocated / 8);
+  if(c.PI == mdcm::PhotometricInterpretation::YBR_FULL_422)
+  {
+    // Y0 Y1 Cb Cr, 2 pixels
+    len = (pixels / 2) * 4;
+  }
+  std::vector<char> in(len);
+  for(size_t i = 0; i < len; ++i) in[i] = (char)Random16();
+  std::string out0;
+  std::vector<char> out1;
+  int r = 0;
+  if(!codec.Streams(in, out0))
+  {
+    fprintf(stderr, "%s: DecodeByStreams failed, pixels=%u\n", c.Name,
+      (unsigned int)pixels);
+    r = 1;
+  }
+  else if(!codec.Buffer(in, out1))
+  {
+    fprintf(stderr, "%s: DecodeByBuffer failed, pixels=%u\n", c.Name,
+      (unsigned int)pixels);
+    r = 1;
+  }
+  else if(out0.size() != out1.size() ||
+    (!out1.empty() && memcmp(out0.data(), &out1[0], out1.size()) != 0))
+  {
+    fprintf(stderr, "%s: results differ, pixels=%u\n", c.Name,
+      (unsigned int)pixels);
+    r = 1;
+  }
+  return r;
+}
+
+}
+
+int main(int, char *[])
+{
+  const size_t sizes[] = { 2, 38, 1000, 1002, 4094, 65536, 512 * 511 };
+  int r = 0;
+  for(size_t i = 0; i < sizeof(Cases) / sizeof(Cases[0]); ++i)
+  {
+    for(size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j)
+    {
+      r += TestCase(Cases[i], sizes[j]);
+    }
+  }
+  if(r) fprintf(stderr, "%d errors\n", r);
+  return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+#include "mdcmSplitMosaicFilter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Compares SplitMosaicFilter::ReorganizeTiles with the former
+// per-pixel code, byte for byte: SIEMENS mosaics, incomplete last row
+// of tiles, tiles wider than the input (rows wrap), inverted slice
+// order (SliceNormalVector), 1, 2 and 4 bytes per pixel, single
+// thread and threads with a lowered size threshold.
+
+namespace
+{
+
+// former code, unchanged but for the pixel type
+template<typename T> bool reorganize_mosaic(const T *input, const unsigned int *inputdims,
+  unsigned int square, const unsigned int *outputdims, T *output )
+{
+  for(unsigned int x = 0; x < outputdims[0]; ++x)
+    {
+    for(unsigned int y = 0; y < outputdims[1]; ++y)
+      {
+      for(unsigned int z = 0; z < outputdims[2]; ++z)
+        {
+        const size_t outputidx = x + y*outputdims[0] + z*outputdims[0]*outputdims[1];
+        const size_t inputidx = (x + (z%square)*outputdims[0]) +
+          (y + (z/square)*outputdims[1])*inputdims[0];
+        output[ outputidx ] = input[ inputidx ];
+        }
+      }
+    }
+  return true;
+}
+
+template<typename T> bool reorganize_mosaic_invert(const T *input, const unsigned int *inputdims,
+  unsigned int square, const unsigned int *outputdims, T *output )
+{
+  for(unsigned int x = 0; x < outputdims[0]; ++x)
+    {
+    for(unsigned int y = 0; y < outputdims[1]; ++y)
+      {
+      for(unsigned int z = 0; z < outputdims[2]; ++z)
+        {
+        const size_t outputidx = x + y*outputdims[0] + (outputdims[2]-1-z)*outputdims[0]*outputdims[1];
+        const size_t inputidx = (x + (z%square)*outputdims[0]) +
+          (y + (z/square)*outputdims[1])*inputdims[0];
+        output[ outputidx ] = input[ inputidx ];
+        }
+      }
+    }
+  return true;
+}
+
+unsigned int Seed = 1;
+
+unsigned short Random16()
+{
+  Seed = Seed * 1103515245u + 12345u;
+  return (unsigned short)(Seed >> 16);
+}
+
+struct Case
+{
+  const char * Name;
+  unsigned int InputX;
+  unsigned int Square;
+  unsigned int X;
+  unsigned int Y;
+  unsigned int Tiles;
+};
+
+const Case Cases[] =
+{
+  { "SIEMENS 64x64x36",              384, 6, 64, 64, 36 },
+  { "SIEMENS 128x128x40",            768, 6, 128, 128, 40 },
+  { "incomplete last row of tiles",  384, 6, 64, 64, 31 },
+  { "one tile",                      64, 1, 64, 64, 1 },
+  { "odd sizes",                     21, 3, 7, 5, 8 },
+  { "tiles wider than the input",    10, 2, 6, 4, 4 },
+  { "tiles wider than the input, 3", 17, 3, 9, 5, 7 },
+  { "rows of one pixel",             5, 5, 1, 3, 25 }
+};
+
+// Input length up to the end of the last row of the last tile, as
+// checked by ReorganizeTiles.
+unsigned long long InputPixels(const Case & c)
+{
+  unsigned long long m = 0;
+  for(unsigned int z = 0; z < c.Tiles; ++z)
+    {
+    const unsigned long long last =
+      (unsigned long long)(z%c.Square) * c.X +
+      ((unsigned long long)(z/c.Square) * c.Y + c.Y - 1) * c.InputX + c.X;
+    if( last > m ) m = last;
+    }
+  return m;
+}
+
+template<typename T> int TestCase(const Case & c, bool inverted, int threads)
+{
+  const unsigned long long pixels = InputPixels(c);
+  const unsigned int inputdims[3] =
+    { c.InputX, (unsigned int)((pixels + c.InputX - 1) / c.InputX), 1 };
+  const unsigned int outputdims[3] = { c.X, c.Y, c.Tiles };
+  const size_t outputpixels = (size_t)c.X * c.Y * c.Tiles;
+  std::vector<T> input((size_t)pixels);
+  for(size_t i = 0; i < input.size(); ++i)
+    {
+    input[i] = (T)(((unsigned int)Random16() << 16) | Random16());
+    }
+  std::vector<T> output0(outputpixels);
+  std::vector<T> output1(outputpixels, 0);
+  if( inverted )
+    reorganize_mosaic_invert<T>(&input[0], inputdims, c.Square, outputdims, &output0[0]);
+  else
+    reorganize_mosaic<T>(&input[0], inputdims, c.Square, outputdims, &output0[0]);
+  mdcm::SplitMosaicFilter::SetMaxNumberOfThreads(threads);
+  const bool b = mdcm::SplitMosaicFilter::ReorganizeTiles(
+    (const char*)&input[0], pixels * sizeof(T), inputdims, c.Square,
+    outputdims, sizeof(T), inverted, (char*)&output1[0]);
+  int r = 0;
+  if( !b )
+    {
+    fprintf(stderr, "%s: ReorganizeTiles failed, %u bytes, %s, %d threads\n",
+      c.Name, (unsigned int)sizeof(T), inverted ? "inverted" : "not inverted",
+      threads);
+    r = 1;
+    }
+  else if( memcmp(&output0[0], &output1[0], outputpixels * sizeof(T)) != 0 )
+    {
+    fprintf(stderr, "%s: results differ, %u bytes, %s, %d threads\n",
+      c.Name, (unsigned int)sizeof(T), inverted ? "inverted" : "not inverted",
+      threads);
+    r = 1;
+    }
+  // one pixel less than the last row of the last tile
+  if( mdcm::SplitMosaicFilter::ReorganizeTiles(
+    (const char*)&input[0], (pixels - 1) * sizeof(T), inputdims, c.Square,
+    outputdims, sizeof(T), inverted, (char*)&output1[0]) )
+    {
+    fprintf(stderr, "%s: short input accepted, %u bytes\n",
+      c.Name, (unsigned int)sizeof(T));
+    r = 1;
+    }
+  return r;
+}
+
+}
+
+int main(int, char *[])
+{
+  // every tile in its own thread, at most
+  mdcm::SplitMosaicFilter::SetMinBytesPerThread(1);
+  const int threads[] = { 1, 2, 3, 7, 0 };
+  int r = 0;
+  for(size_t i = 0; i < sizeof(Cases) / sizeof(Cases[0]); ++i)
+    {
+    for(size_t j = 0; j < sizeof(threads) / sizeof(threads[0]); ++j)
+      {
+      for(int inverted = 0; inverted < 2; ++inverted)
+        {
+        r += TestCase<unsigned char>(Cases[i], inverted != 0, threads[j]);
+        r += TestCase<unsigned short>(Cases[i], inverted != 0, threads[j]);
+        r += TestCase<unsigned int>(Cases[i], inverted != 0, threads[j]);
+        }
+      }
+    }
+  mdcm::SplitMosaicFilter::SetMaxNumberOfThreads(0);
+  if(r) fprintf(stderr, "%d errors\n", r);
+  return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}
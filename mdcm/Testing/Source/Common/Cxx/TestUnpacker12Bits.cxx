@@ -0,0 +1,141 @@
+#include "mdcmUnpacker12Bits.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Compares Unpacker12Bits with the scalar reference for all lengths
+// up to MaxPairs pixel pairs. Buffers have the exact size, build with
+// -fsanitize=address to check reads and writes past the end. Built
+// with the default flags (run-time dispatch), with -mssse3 and with
+// MDCM_UNPACKER12_NO_SSSE3 (SWAR and scalar kernels).
+
+namespace
+{
+
+const size_t MaxPairs = 256;
+
+void UnpackReference(unsigned short * q, const unsigned char * p, size_t n)
+{
+  const unsigned char * end = p + n;
+  while(p != end)
+  {
+    const unsigned char b0 = *p++;
+    const unsigned char b1 = *p++;
+    const unsigned char b2 = *p++;
+    *q++ = (unsigned short)(((b1 & 0xf) << 8) + b0);
+    *q++ = (unsigned short)((b1 >> 4) + (b2 << 4));
+  }
+}
+
+void PackReference(unsigned char * q, const unsigned short * p, size_t n)
+{
+  const unsigned short * end = p + n / 2;
+  while(p != end)
+  {
+    const unsigned short b0 = *p++;
+    const unsigned short b1 = *p++;
+    *q++ = (unsigned char)(b0 & 0xff);
+    *q++ = (unsigned char)((b0 >> 8) + ((b1 & 0xf) << 4));
+    *q++ = (unsigned char)(b1 >> 4);
+  }
+}
+
+unsigned int Seed = 1;
+
+unsigned short Random16()
+{
+  Seed = Seed * 1103515245u + 12345u;
+  return (unsigned short)(Seed >> 16);
+}
+
+int TestUnpack(size_t pairs)
+{
+  const size_t n = 3 * pairs;
+  unsigned char * p = new unsigned char[n];
+  unsigned short * q0 = new unsigned short[2 * pairs];
+  unsigned short * q1 = new unsigned short[2 * pairs];
+  for(size_t i = 0; i < n; ++i) p[i] = (unsigned char)Random16();
+  UnpackReference(q0, p, n);
+  int r = 0;
+  if(!mdcm::Unpacker12Bits::Unpack(reinterpret_cast<char*>(q1),
+    reinterpret_cast<const char*>(p), n))
+  {
+    fprintf(stderr, "Unpack failed, pairs=%u\n", (unsigned int)pairs);
+    r = 1;
+  }
+  else if(memcmp(q0, q1, 2 * pairs * sizeof(unsigned short)) != 0)
+  {
+    fprintf(stderr, "Unpack differs, pairs=%u\n", (unsigned int)pairs);
+    r = 1;
+  }
+  delete [] p;
+  delete [] q0;
+  delete [] q1;
+  return r;
+}
+
+// Arbitrary 16 bits words, not only 12 bits values, the packed
+// bytes have to be the same as the reference anyway.
+int TestPack(size_t pairs, bool mask)
+{
+  const size_t n = 4 * pairs;
+  unsigned short * p = new unsigned short[2 * pairs];
+  unsigned char * q0 = new unsigned char[3 * pairs];
+  unsigned char * q1 = new unsigned char[3 * pairs];
+  unsigned short * u = new unsigned short[2 * pairs];
+  for(size_t i = 0; i < 2 * pairs; ++i)
+  {
+    p[i] = mask ? (unsigned short)(Random16() & 0xfff) : Random16();
+  }
+  PackReference(q0, p, n);
+  int r = 0;
+  if(!mdcm::Unpacker12Bits::Pack(reinterpret_cast<char*>(q1),
+    reinterpret_cast<const char*>(p), n))
+  {
+    fprintf(stderr, "Pack failed, pairs=%u\n", (unsigned int)pairs);
+    r = 1;
+  }
+  else if(memcmp(q0, q1, 3 * pairs) != 0)
+  {
+    fprintf(stderr, "Pack differs, pairs=%u\n", (unsigned int)pairs);
+    r = 1;
+  }
+  else if(mask)
+  {
+    // round trip
+    if(!mdcm::Unpacker12Bits::Unpack(reinterpret_cast<char*>(u),
+        reinterpret_cast<const char*>(q1), 3 * pairs) ||
+      memcmp(p, u, 2 * pairs * sizeof(unsigned short)) != 0)
+    {
+      fprintf(stderr, "Round trip differs, pairs=%u\n", (unsigned int)pairs);
+      r = 1;
+    }
+  }
+  delete [] p;
+  delete [] q0;
+  delete [] q1;
+  delete [] u;
+  return r;
+}
+
+}
+
+int main(int, char *[])
+{
+  int r = 0;
+  for(size_t pairs = 0; pairs <= MaxPairs; ++pairs)
+  {
+    for(int k = 0; k < 4; ++k)
+    {
+      r += TestUnpack(pairs);
+      r += TestPack(pairs, false);
+      r += TestPack(pairs, true);
+    }
+  }
+  // lengths which are not multiples
+  char b[8] = {};
+  if(mdcm::Unpacker12Bits::Unpack(b, b, 4)) ++r;
+  if(mdcm::Unpacker12Bits::Pack(b, b, 6)) ++r;
+  if(r) fprintf(stderr, "%d errors\n", r);
+  return r ? EXIT_FAILURE : EXIT_SUCCESS;
+}